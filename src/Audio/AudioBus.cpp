@@ -0,0 +1,222 @@
+﻿#include "AudioBus.h"
+
+#include <algorithm>
+#include <cmath>
+#include <Siv3D.hpp>
+
+namespace
+{
+	// 追従の時定数[秒]．短すぎるとプツッと鳴り，長すぎると反応が鈍い
+	constexpr float kSmoothingTime = 0.02f;
+
+	// 係数の再計算はこのサンプル数ごとにまとめて行う
+	constexpr size_t kCoefficientBlock = 32;
+
+	// 2段の各段の Q（合わせてなだらかな肩になる）
+	constexpr float kFilterQ = 0.707f;
+}
+
+void AudioBus::SetGain(double gain)
+{
+	const float value = static_cast<float>(Max(gain, 0.0));
+	if(value == sent_gain_)
+	{
+		return;
+	}
+
+	// キューが満杯なら次のフレームで送り直す
+	if(param_changes_.TryPush(ParamChange{ Param::Gain, value }))
+	{
+		sent_gain_ = value;
+	}
+}
+
+void AudioBus::SetLowPassCutoff(double cutoff_hz)
+{
+	const float value = static_cast<float>(Clamp(cutoff_hz, static_cast<double>(kMinCutoffHz), static_cast<double>(kMaxCutoffHz)));
+	if(value == sent_cutoff_)
+	{
+		return;
+	}
+
+	if(param_changes_.TryPush(ParamChange{ Param::Cutoff, value }))
+	{
+		sent_cutoff_ = value;
+	}
+}
+
+void AudioBus::ReceiveParams()
+{
+	ParamChange change;
+	while(param_changes_.TryPop(change))
+	{
+		if(change.param == Param::Gain)
+		{
+			target_gain_ = change.value;
+		}
+		else
+		{
+			target_cutoff_ = change.value;
+		}
+	}
+}
+
+void AudioBus::Process(float* left, float* right, size_t samples, uint32 sample_rate)
+{
+	ReceiveParams();
+
+	const float smoothing = 1.0f - std::exp(-1.0f / (kSmoothingTime * static_cast<float>(sample_rate)));
+	const float block_smoothing = 1.0f - std::exp(-static_cast<float>(kCoefficientBlock) / (kSmoothingTime * static_cast<float>(sample_rate)));
+
+	for(size_t offset = 0; offset < samples; offset += kCoefficientBlock)
+	{
+		const size_t count = Min(kCoefficientBlock, samples - offset);
+
+		// カットオフは耳の感覚に合わせて対数軸で追従させる
+		if(cutoff_ != target_cutoff_)
+		{
+			const float log_cutoff = std::log(cutoff_) + (std::log(target_cutoff_) - std::log(cutoff_)) * block_smoothing;
+			cutoff_ = std::exp(log_cutoff);
+			if(std::abs(cutoff_ - target_cutoff_) < 1.0f)
+			{
+				cutoff_ = target_cutoff_;
+			}
+		}
+
+		const bool should_filter = (cutoff_ < kMaxCutoffHz);
+		if(should_filter != is_filter_active_)
+		{
+			if(should_filter)
+			{
+				// 素通しから戻るときは前回の状態を捨てる
+#ifdef AUDIO_BUS_USE_SSE
+				z1_ = _mm_setzero_ps();
+				z2_ = _mm_setzero_ps();
+#else
+				z1_.fill(0.0f);
+				z2_.fill(0.0f);
+#endif
+				stage1_left_ = 0.0f;
+				stage1_right_ = 0.0f;
+			}
+
+			// 瞬時に切り替えるとプツッと鳴るので，このブロックだけフィルタを通した音と素通しの音をクロスフェードする
+			float filtered_left[kCoefficientBlock];
+			float filtered_right[kCoefficientBlock];
+			std::copy_n(left + offset, count, filtered_left);
+			std::copy_n(right + offset, count, filtered_right);
+
+			UpdateCoefficients(cutoff_, sample_rate);
+			ProcessLowPass(filtered_left, filtered_right, count);
+
+			for(size_t i = 0; i < count; ++i)
+			{
+				const float t = (static_cast<float>(i + 1) / static_cast<float>(count));
+				const float filtered_weight = (should_filter ? t : (1.0f - t));
+				left[offset + i] += (filtered_left[i] - left[offset + i]) * filtered_weight;
+				right[offset + i] += (filtered_right[i] - right[offset + i]) * filtered_weight;
+			}
+
+			is_filter_active_ = should_filter;
+		}
+		else if(is_filter_active_)
+		{
+			UpdateCoefficients(cutoff_, sample_rate);
+			ProcessLowPass(left + offset, right + offset, count);
+		}
+
+		// 音量はサンプル単位で追従させる
+		for(size_t i = offset; i < (offset + count); ++i)
+		{
+			gain_ += (target_gain_ - gain_) * smoothing;
+			left[i] *= gain_;
+			right[i] *= gain_;
+		}
+	}
+}
+
+void AudioBus::UpdateCoefficients(float cutoff_hz, uint32 sample_rate)
+{
+	if((cutoff_hz == coefficient_cutoff_) && (sample_rate == coefficient_sample_rate_))
+	{
+		return;
+	}
+
+	coefficient_cutoff_ = cutoff_hz;
+	coefficient_sample_rate_ = sample_rate;
+
+	// RBJ Audio EQ Cookbook のローパス
+	const float nyquist_safe = Min(cutoff_hz, static_cast<float>(sample_rate) * 0.45f);
+	const float omega = 2.0f * Math::PiF * nyquist_safe / static_cast<float>(sample_rate);
+	const float cos_omega = std::cos(omega);
+	const float alpha = std::sin(omega) / (2.0f * kFilterQ);
+	const float a0 = 1.0f + alpha;
+
+	b0_ = ((1.0f - cos_omega) * 0.5f) / a0;
+	b1_ = (1.0f - cos_omega) / a0;
+	b2_ = b0_;
+	a1_ = (-2.0f * cos_omega) / a0;
+	a2_ = (1.0f - alpha) / a0;
+}
+
+void AudioBus::ProcessLowPass(float* left, float* right, size_t samples)
+{
+	// 転置型 直接形II: y = b0*x + z1, z1 = b1*x - a1*y + z2, z2 = b2*x - a2*y
+#ifdef AUDIO_BUS_USE_SSE
+	const __m128 b0 = _mm_set1_ps(b0_);
+	const __m128 b1 = _mm_set1_ps(b1_);
+	const __m128 b2 = _mm_set1_ps(b2_);
+	const __m128 a1 = _mm_set1_ps(a1_);
+	const __m128 a2 = _mm_set1_ps(a2_);
+
+	__m128 z1 = z1_;
+	__m128 z2 = z2_;
+	alignas(16) float y[4];
+
+	for(size_t i = 0; i < samples; ++i)
+	{
+		// { 入力L, 入力R, 1段目の前回出力L, 1段目の前回出力R }
+		const __m128 x = _mm_set_ps(stage1_right_, stage1_left_, right[i], left[i]);
+		const __m128 out = _mm_add_ps(_mm_mul_ps(b0, x), z1);
+		z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, out)), z2);
+		z2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, out));
+
+		_mm_store_ps(y, out);
+		stage1_left_ = y[0];
+		stage1_right_ = y[1];
+		left[i] = y[2];
+		right[i] = y[3];
+	}
+
+	z1_ = z1;
+	z2_ = z2;
+#else
+	for(size_t i = 0; i < samples; ++i)
+	{
+		const float x[4] = { left[i], right[i], stage1_left_, stage1_right_ };
+		float y[4];
+		for(size_t lane = 0; lane < 4; ++lane)
+		{
+			y[lane] = b0_ * x[lane] + z1_[lane];
+			z1_[lane] = b1_ * x[lane] - a1_ * y[lane] + z2_[lane];
+			z2_[lane] = b2_ * x[lane] - a2_ * y[lane];
+		}
+
+		stage1_left_ = y[0];
+		stage1_right_ = y[1];
+		left[i] = y[2];
+		right[i] = y[3];
+	}
+#endif
+}
+
+AudioMixer& AudioMixer::GetInstance()
+{
+	static AudioMixer instance;
+	return instance;
+}
+
+AudioBus& AudioMixer::GetBus(AudioBusId bus)
+{
+	return buses_[static_cast<size_t>(bus)];
+}
@@ -0,0 +1,107 @@
+﻿#pragma once
+
+#include "../Core/LockFreeQueue.h"
+
+#include <array>
+#include <Siv3D.hpp>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define AUDIO_BUS_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// ミックスバスの種類
+enum class AudioBusId : uint8
+{
+	Music,
+	Sfx,
+};
+
+// 音量とローパスフィルタを持つミックスバス
+// パラメータはメインスレッドから Set*() で目標値を送り，オーディオスレッドがサンプル単位でなめらかに追従する
+// フィルタを通すか素通しにするかが変わるときは，1ブロックかけてクロスフェードする
+// 1つのバスは1つのストリームの getAudio() からだけ Process() すること（フィルタの状態を共有するため）
+class AudioBus
+{
+public:
+	// 目標値を設定する（メインスレッド）．前回と同じ値なら何も送らない
+	void SetGain(double gain);
+
+	// ローパスのカットオフ周波数[Hz]．kMaxCutoffHz 以上でフィルタを通さない
+	void SetLowPassCutoff(double cutoff_hz);
+
+	// バスの処理を通す（オーディオスレッド）
+	void Process(float* left, float* right, size_t samples, uint32 sample_rate);
+
+	static constexpr float kMaxCutoffHz = 20000.0f;
+	static constexpr float kMinCutoffHz = 80.0f;
+
+private:
+	enum class Param : uint8
+	{
+		Gain,
+		Cutoff,
+	};
+
+	struct ParamChange
+	{
+		Param param = Param::Gain;
+		float value = 0.0f;
+	};
+
+	// 送られてきた目標値を取り込む
+	void ReceiveParams();
+
+	// カットオフからフィルタ係数を求める
+	void UpdateCoefficients(float cutoff_hz, uint32 sample_rate);
+
+	// 2次のローパスを2段（-24dB/oct）かける
+	void ProcessLowPass(float* left, float* right, size_t samples);
+
+	// メインスレッド側で最後に送った値
+	float sent_gain_ = 1.0f;
+	float sent_cutoff_ = kMaxCutoffHz;
+
+	LockFreeQueue<ParamChange, 64> param_changes_;
+
+	// ここから下はオーディオスレッドだけが触る
+	float target_gain_ = 1.0f;
+	float target_cutoff_ = kMaxCutoffHz;
+	float gain_ = 1.0f;
+	float cutoff_ = kMaxCutoffHz;
+	float coefficient_cutoff_ = -1.0f;
+	uint32 coefficient_sample_rate_ = 0;
+	bool is_filter_active_ = false;
+
+	// 双2次フィルタの係数（a0 で正規化済み）
+	float b0_ = 1.0f, b1_ = 0.0f, b2_ = 0.0f, a1_ = 0.0f, a2_ = 0.0f;
+
+	// 4レーン = { 1段目L, 1段目R, 2段目L, 2段目R }
+	// 2段目には1段目の1サンプル前の出力を入れることで，直列の2段を1命令列で同時に計算する
+#ifdef AUDIO_BUS_USE_SSE
+	__m128 z1_ = _mm_setzero_ps();
+	__m128 z2_ = _mm_setzero_ps();
+#else
+	std::array<float, 4> z1_{};
+	std::array<float, 4> z2_{};
+#endif
+	float stage1_left_ = 0.0f;
+	float stage1_right_ = 0.0f;
+};
+
+// 名前付きのミックスバスを持つ
+class AudioMixer
+{
+public:
+	static AudioMixer& GetInstance();
+
+	AudioBus& GetBus(AudioBusId bus);
+
+	AudioMixer(const AudioMixer&) = delete;
+	AudioMixer& operator=(const AudioMixer&) = delete;
+
+private:
+	AudioMixer() = default;
+
+	std::array<AudioBus, 2> buses_;
+};
@@ -0,0 +1,399 @@
+﻿#include "MediaFoundationDecoder.h"
+
+#include <Siv3D.hpp>
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <mfapi.h>
+#include <mfidl.h>
+#include <mfreadwrite.h>
+#include <propvarutil.h>
+
+#pragma comment(lib, "mfplat.lib")
+#pragma comment(lib, "mfreadwrite.lib")
+#pragma comment(lib, "mfuuid.lib")
+#pragma comment(lib, "propsys.lib")
+
+namespace
+{
+	template<class T>
+	void SafeRelease(T*& p)
+	{
+		if(p)
+		{
+			p->Release();
+			p = nullptr;
+		}
+	}
+
+	// LAME のリファレンスデコーダーが出す遅延（エンコーダー遅延に足して読み捨てる）
+	// Media Foundation の MP3 デコーダーも同じだけ遅れ，Xing/Info フレーム自体は音として出さない
+	constexpr uint64 kMp3DecoderDelay = 529;
+
+	// LAME が MP3 の先頭に書く Xing/Info ヘッダーから読んだギャップレス情報
+	struct Mp3GaplessInfo
+	{
+		uint64 total_frames = 0;	// エンコーダー遅延とパディングを含むサンプル数
+		uint32 encoder_delay = 0;
+		uint32 padding = 0;
+	};
+
+	uint32 ReadBigEndian32(const uint8* p)
+	{
+		return ((uint32{ p[0] } << 24) | (uint32{ p[1] } << 16) | (uint32{ p[2] } << 8) | uint32{ p[3] });
+	}
+
+	// ID3v2 タグを飛ばして最初の MPEG フレームを探し，その中の Xing/Info ヘッダーと LAME 拡張を読む
+	// 無い（MP3 でない，LAME 以外で作られた）ときは none
+	Optional<Mp3GaplessInfo> ReadMp3GaplessInfo(const FilePath& path)
+	{
+		BinaryReader reader{ path };
+		if(not reader)
+		{
+			return none;
+		}
+
+		int64 frame_search_pos = 0;
+		uint8 id3_header[10] = {};
+		if((reader.read(id3_header, sizeof(id3_header)) == sizeof(id3_header)) && (std::memcmp(id3_header, "ID3", 3) == 0))
+		{
+			// サイズは 7bit ずつの4バイト．フッターがあればさらに 10 バイト
+			const int64 tag_size = ((int64{ id3_header[6] & 0x7F } << 21) | (int64{ id3_header[7] & 0x7F } << 14) | (int64{ id3_header[8] & 0x7F } << 7) | int64{ id3_header[9] & 0x7F });
+			frame_search_pos = (10 + tag_size + ((id3_header[5] & 0x10) ? 10 : 0));
+		}
+
+		// 最初のフレームは Xing/Info ヘッダーを入れた無音のフレームで，これだけ読めば足りる
+		constexpr size_t kReadSize = 4096;
+		uint8 data[kReadSize] = {};
+		reader.setPos(frame_search_pos);
+		const size_t size = static_cast<size_t>(Max<int64>(reader.read(data, kReadSize), 0));
+
+		for(size_t pos = 0; (pos + 4) <= size; ++pos)
+		{
+			// フレーム同期（11bit）と，予約値でないバージョン・レイヤー III
+			if((data[pos] != 0xFF) || ((data[pos + 1] & 0xE0) != 0xE0))
+			{
+				continue;
+			}
+			const uint32 version = ((data[pos + 1] >> 3) & 0x03);	// 3: MPEG-1，2: MPEG-2，0: MPEG-2.5
+			const uint32 layer = ((data[pos + 1] >> 1) & 0x03);		// 1: レイヤー III
+			if((version == 1) || (layer != 1))
+			{
+				continue;
+			}
+
+			const bool is_mpeg1 = (version == 3);
+			const bool is_mono = (((data[pos + 3] >> 6) & 0x03) == 3);
+			const size_t side_info_size = (is_mpeg1 ? (is_mono ? 17 : 32) : (is_mono ? 9 : 17));
+
+			size_t p = (pos + 4 + side_info_size);
+			if(((p + 8) > size) || ((std::memcmp(data + p, "Xing", 4) != 0) && (std::memcmp(data + p, "Info", 4) != 0)))
+			{
+				return none;
+			}
+
+			const uint32 flags = ReadBigEndian32(data + p + 4);
+			p += 8;
+
+			// フレーム数が無いと曲の長さが分からない
+			if(((flags & 0x01) == 0) || ((p + 4) > size))
+			{
+				return none;
+			}
+			const uint32 mpeg_frames = ReadBigEndian32(data + p);
+			p += 4;
+			if(flags & 0x02) p += 4;	// バイト数
+			if(flags & 0x04) p += 100;	// シーク用の目次
+			if(flags & 0x08) p += 4;	// 品質
+
+			// LAME 拡張の 21 バイト目から 12bit ずつ遅延とパディング
+			if(((p + 24) > size) || (std::memcmp(data + p, "LAME", 4) != 0))
+			{
+				return none;
+			}
+			const uint8* delay_padding = (data + p + 21);
+
+			Mp3GaplessInfo info;
+			info.total_frames = (uint64{ mpeg_frames } * (is_mpeg1 ? 1152 : 576));
+			info.encoder_delay = ((uint32{ delay_padding[0] } << 4) | (delay_padding[1] >> 4));
+			info.padding = (((uint32{ delay_padding[1] } & 0x0F) << 8) | delay_padding[2]);
+			return info;
+		}
+
+		return none;
+	}
+}
+
+std::unique_ptr<IMusicDecoder> CreateMusicDecoder(const FilePath& path, String& error)
+{
+	auto decoder = std::make_unique<MediaFoundationDecoder>(path);
+	if(not decoder->IsOpen())
+	{
+		error = U"エラー: 音楽ファイル'{}'を開けませんでした．"_fmt(path);
+		return nullptr;
+	}
+	return decoder;
+}
+
+MusicDecoderThreadScope::MusicDecoderThreadScope()
+{
+	// S_FALSE（同じ形で初期化済み）でも CoUninitialize() と対にする．RPC_E_CHANGED_MODE（STA で初期化済み）なら何もしない
+	is_initialized_ = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+}
+
+MusicDecoderThreadScope::~MusicDecoderThreadScope()
+{
+	if(is_initialized_)
+	{
+		CoUninitialize();
+	}
+}
+
+MediaFoundationDecoder::MediaFoundationDecoder(const FilePath& path)
+{
+	// COM の初期化は呼び出し側のスレッドで済ませておく（MusicDecoderThreadScope）
+	// SourceReader はフリースレッドなので，開いたスレッドと読むスレッドが違ってもよい
+
+	// MFStartup は参照カウント式なので Siv3D 側の初期化と重なっても問題ない
+	if(FAILED(MFStartup(MF_VERSION, MFSTARTUP_LITE)))
+	{
+		return;
+	}
+	is_mf_started_ = true;
+
+	if(FAILED(MFCreateSourceReaderFromURL(FileSystem::FullPath(path).toWstr().c_str(), nullptr, &reader_)))
+	{
+		reader_ = nullptr;
+		return;
+	}
+
+	// 最初の音声ストリームだけを有効にし，32bit float PCM でデコードさせる
+	reader_->SetStreamSelection(static_cast<DWORD>(MF_SOURCE_READER_ALL_STREAMS), FALSE);
+	reader_->SetStreamSelection(static_cast<DWORD>(MF_SOURCE_READER_FIRST_AUDIO_STREAM), TRUE);
+
+	IMFMediaType* partial_type = nullptr;
+	MFCreateMediaType(&partial_type);
+	partial_type->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Audio);
+	partial_type->SetGUID(MF_MT_SUBTYPE, MFAudioFormat_Float);
+	const HRESULT set_result = reader_->SetCurrentMediaType(static_cast<DWORD>(MF_SOURCE_READER_FIRST_AUDIO_STREAM), nullptr, partial_type);
+	SafeRelease(partial_type);
+
+	if(FAILED(set_result))
+	{
+		SafeRelease(reader_);
+		return;
+	}
+
+	// 実際に決まった出力形式を取得
+	IMFMediaType* output_type = nullptr;
+	if(SUCCEEDED(reader_->GetCurrentMediaType(static_cast<DWORD>(MF_SOURCE_READER_FIRST_AUDIO_STREAM), &output_type)))
+	{
+		UINT32 value = 0;
+		if(SUCCEEDED(output_type->GetUINT32(MF_MT_AUDIO_SAMPLES_PER_SECOND, &value)))
+		{
+			sample_rate_ = value;
+		}
+		if(SUCCEEDED(output_type->GetUINT32(MF_MT_AUDIO_NUM_CHANNELS, &value)))
+		{
+			channels_ = Max<uint32>(value, 1);
+		}
+		SafeRelease(output_type);
+	}
+
+	// イントロからループへ切れ目なくつなぐため，前後の無音は曲に含めない
+	if(const auto gapless = ReadMp3GaplessInfo(path))
+	{
+		start_frame_ = (gapless->encoder_delay + kMp3DecoderDelay);
+		const uint64 trimmed = (uint64{ gapless->encoder_delay } + gapless->padding);
+		if(trimmed < gapless->total_frames)
+		{
+			end_frame_ = (start_frame_ + (gapless->total_frames - trimmed));
+		}
+	}
+	skip_until_frame_ = start_frame_;
+}
+
+MediaFoundationDecoder::~MediaFoundationDecoder()
+{
+	ReleaseChunk();
+	SafeRelease(reader_);
+
+	if(is_mf_started_)
+	{
+		MFShutdown();
+	}
+}
+
+size_t MediaFoundationDecoder::Read(float* left, float* right, size_t frames)
+{
+	size_t written = 0;
+
+	while(written < frames)
+	{
+		if(chunk_read_pos_ >= chunk_frames_)
+		{
+			if(not DecodeNextChunk())
+			{
+				break;
+			}
+		}
+
+		// エンコーダー遅延（と Seek() の端数）を読み捨てる
+		if(decoded_frame_ < skip_until_frame_)
+		{
+			const size_t skip = static_cast<size_t>(Min<uint64>(skip_until_frame_ - decoded_frame_, chunk_frames_ - chunk_read_pos_));
+			chunk_read_pos_ += skip;
+			decoded_frame_ += skip;
+			continue;
+		}
+
+		size_t count = Min(frames - written, chunk_frames_ - chunk_read_pos_);
+
+		// 末尾のパディングは返さない
+		if(end_frame_)
+		{
+			if(decoded_frame_ >= *end_frame_)
+			{
+				ReleaseChunk();
+				is_end_of_stream_ = true;
+				break;
+			}
+			count = static_cast<size_t>(Min<uint64>(count, *end_frame_ - decoded_frame_));
+		}
+
+		const float* src = chunk_ + (chunk_read_pos_ * channels_);
+
+		if(channels_ == 1)
+		{
+			for(size_t i = 0; i < count; ++i)
+			{
+				left[written + i] = src[i];
+				right[written + i] = src[i];
+			}
+		}
+		else
+		{
+			for(size_t i = 0; i < count; ++i)
+			{
+				left[written + i] = src[i * channels_];
+				right[written + i] = src[i * channels_ + 1];
+			}
+		}
+
+		chunk_read_pos_ += count;
+		decoded_frame_ += count;
+		written += count;
+	}
+
+	return written;
+}
+
+void MediaFoundationDecoder::Rewind()
+{
+	Seek(0);
+}
+
+void MediaFoundationDecoder::Seek(uint64 frame)
+{
+	if(not reader_)
+	{
+		return;
+	}
+
+	// 位置は 100 ナノ秒単位で指定する．行き先はおおよそなので，残りはデコードしてから読み捨てる
+	const uint64 target_frame = (start_frame_ + frame);
+	PROPVARIANT position;
+	InitPropVariantFromInt64(static_cast<LONGLONG>((target_frame * 10'000'000) / sample_rate_), &position);
+	reader_->SetCurrentPosition(GUID_NULL, position);
+	PropVariantClear(&position);
+
+	ReleaseChunk();
+	is_end_of_stream_ = false;
+	decoded_frame_ = 0;
+	is_position_pending_ = true;
+	skip_until_frame_ = target_frame;
+}
+
+void MediaFoundationDecoder::ReleaseChunk()
+{
+	if(chunk_buffer_)
+	{
+		chunk_buffer_->Unlock();
+		SafeRelease(chunk_buffer_);
+	}
+	chunk_ = nullptr;
+	chunk_read_pos_ = 0;
+	chunk_frames_ = 0;
+}
+
+bool MediaFoundationDecoder::DecodeNextChunk()
+{
+	ReleaseChunk();
+
+	if((not reader_) || is_end_of_stream_)
+	{
+		return false;
+	}
+
+	// 空のサンプル（ストリームの切れ目など）は読み飛ばす
+	while(chunk_frames_ == 0)
+	{
+		DWORD flags = 0;
+		LONGLONG timestamp = 0;
+		IMFSample* sample = nullptr;
+		if(FAILED(reader_->ReadSample(static_cast<DWORD>(MF_SOURCE_READER_FIRST_AUDIO_STREAM), 0, nullptr, &flags, &timestamp, &sample)))
+		{
+			is_end_of_stream_ = true;
+			return false;
+		}
+
+		if(flags & MF_SOURCE_READERF_ENDOFSTREAM)
+		{
+			SafeRelease(sample);
+			is_end_of_stream_ = true;
+			return false;
+		}
+
+		if(not sample)
+		{
+			continue;
+		}
+
+		// 音声のサンプルはバッファ1つなので，ConvertToContiguousBuffer() は同じバッファを返すだけで確保しない
+		IMFMediaBuffer* buffer = nullptr;
+		if(SUCCEEDED(sample->ConvertToContiguousBuffer(&buffer)))
+		{
+			BYTE* data = nullptr;
+			DWORD length = 0;
+			if(SUCCEEDED(buffer->Lock(&data, nullptr, &length)) && ((length / sizeof(float) / channels_) != 0))
+			{
+				// 読み終わるまでロックしたまま持っておく
+				chunk_buffer_ = buffer;
+				chunk_ = reinterpret_cast<const float*>(data);
+				chunk_frames_ = (length / sizeof(float) / channels_);
+
+				if(is_position_pending_)
+				{
+					decoded_frame_ = static_cast<uint64>((Max<LONGLONG>(timestamp, 0) * sample_rate_ + 5'000'000) / 10'000'000);
+					is_position_pending_ = false;
+				}
+			}
+			else
+			{
+				if(data)
+				{
+					buffer->Unlock();
+				}
+				SafeRelease(buffer);
+			}
+		}
+		SafeRelease(sample);
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+﻿#pragma once
+
+#include "MusicDecoder.h"
+
+#include <Siv3D.hpp>
+
+struct IMFSourceReader;
+struct IMFMediaBuffer;
+
+// Media Foundation の SourceReader で MP3 などを逐次デコードするデコーダー
+// 一度に保持するのは圧縮フレーム1つ分のPCMだけなので，曲の長さに関係なくメモリ使用量は一定
+// MP3 に LAME のギャップレス情報（Xing/Info ヘッダー）があれば，先頭のエンコーダー遅延と末尾のパディングを除いたサンプルだけを返す
+class MediaFoundationDecoder final : public IMusicDecoder
+{
+public:
+	explicit MediaFoundationDecoder(const FilePath& path);
+	~MediaFoundationDecoder() override;
+
+	MediaFoundationDecoder(const MediaFoundationDecoder&) = delete;
+	MediaFoundationDecoder& operator=(const MediaFoundationDecoder&) = delete;
+
+	size_t Read(float* left, float* right, size_t frames) override;
+	void Rewind() override;
+	void Seek(uint64 frame) override;
+
+	uint32 GetSampleRate() const override { return sample_rate_; }
+	bool IsOpen() const override { return (reader_ != nullptr); }
+
+private:
+	// 次の圧縮フレームをデコードして chunk_ に指させる．終端なら false
+	bool DecodeNextChunk();
+
+	// 読み終えた chunk_ のバッファを返す
+	void ReleaseChunk();
+
+	IMFSourceReader* reader_ = nullptr;
+	bool is_mf_started_ = false;
+
+	uint32 sample_rate_ = 44100;
+	uint32 channels_ = 2;
+
+	// デコード済みのインタリーブPCM（SourceReader が返したバッファをロックしたまま直接読む）
+	// オーディオスレッドで確保し直さないように，こちらでは写し取らない
+	IMFMediaBuffer* chunk_buffer_ = nullptr;
+	const float* chunk_ = nullptr;
+	size_t chunk_read_pos_ = 0;	// chunk_ 内の読み出し位置（サンプル単位）
+	size_t chunk_frames_ = 0;	// chunk_ に入っているサンプル数
+	bool is_end_of_stream_ = false;
+
+	// デコーダーが出した音の先頭から数えた，次に読むサンプルの位置
+	uint64 decoded_frame_ = 0;
+
+	// Seek() のあとは最初のサンプルの時刻から decoded_frame_ を合わせ直す
+	bool is_position_pending_ = false;
+
+	// ここまでは読み捨てる（エンコーダー遅延と，Seek() で指定した位置までの端数）
+	uint64 skip_until_frame_ = 0;
+
+	// ギャップレス情報から求めた曲の範囲（デコーダーが出した音の中での位置．情報が無ければ終端まで）
+	uint64 start_frame_ = 0;
+	Optional<uint64> end_frame_;
+};
@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <Siv3D.hpp>
+
+// 圧縮音声を少しずつデコードして取り出すためのインタフェース
+// MusicStream からオーディオスレッド上で呼ばれる
+class IMusicDecoder
+{
+public:
+	virtual ~IMusicDecoder() = default;
+
+	// 最大 frames サンプル分をデコードして左右チャンネルに書き込む
+	// 書き込んだサンプル数を返す（frames 未満ならトラックの終端に達した）
+	virtual size_t Read(float* left, float* right, size_t frames) = 0;
+
+	// 先頭に戻す
+	virtual void Rewind() = 0;
+
+	// 先頭から frame サンプル目に移る（圧縮形式によってはおおよその位置になる）
+	virtual void Seek(uint64 frame) = 0;
+
+	virtual uint32 GetSampleRate() const = 0;
+
+	virtual bool IsOpen() const = 0;
+};
+
+// 指定ファイルを開くデコーダーを作成する
+// 開けなければ nullptr を返し，error に理由を入れる（ワーカースレッドからも呼ぶので，ここでは表示しない）
+std::unique_ptr<IMusicDecoder> CreateMusicDecoder(const FilePath& path, String& error);
+
+// デコーダーを開く・読むスレッドで，その間だけ必要な初期化をしておく（Media Foundation では COM を MTA で初期化する）
+// 初期化したスレッドではデストラクタで元に戻す．別の形で初期化済みのスレッド（メインスレッドなど）では何もしない
+class MusicDecoderThreadScope
+{
+public:
+	MusicDecoderThreadScope();
+	~MusicDecoderThreadScope();
+
+	MusicDecoderThreadScope(const MusicDecoderThreadScope&) = delete;
+	MusicDecoderThreadScope& operator=(const MusicDecoderThreadScope&) = delete;
+
+private:
+	bool is_initialized_ = false;
+};
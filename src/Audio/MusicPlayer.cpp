@@ -0,0 +1,93 @@
+﻿#include "MusicPlayer.h"
+#include "../Core/TraceRecorder.h"
+
+#include <Siv3D.hpp>
+
+bool MusicPlayer::Open(const FilePath& intro_path, const FilePath& loop_path, AudioBus* bus)
+{
+	String error;
+	std::unique_ptr<IMusicDecoder> intro;
+	if(not intro_path.isEmpty())
+	{
+		intro = CreateMusicDecoder(intro_path, error);
+		if(not intro)
+		{
+			Print << error;
+		}
+	}
+
+	std::unique_ptr<IMusicDecoder> loop = CreateMusicDecoder(loop_path, error);
+	if(not loop)
+	{
+		Print << error;
+	}
+
+	return Open(std::move(intro), std::move(loop), bus);
+}
+
+bool MusicPlayer::Open(std::unique_ptr<IMusicDecoder> intro, std::unique_ptr<IMusicDecoder> loop, AudioBus* bus)
+{
+	Stop();
+
+	if((not intro) && (not loop))
+	{
+		return false;
+	}
+
+	// イントロとループは同じバッファにつなげて鳴らすので，サンプリングレートが違うと片方の音程がずれる
+	if(intro && loop && (intro->GetSampleRate() != loop->GetSampleRate()))
+	{
+		Print << U"エラー: BGM のイントロ（{} Hz）とループ（{} Hz）のサンプリングレートが違います．"_fmt(intro->GetSampleRate(), loop->GetSampleRate());
+		return false;
+	}
+
+	TraceRecorder::Instant(U"BGM Open", U"audio", {}, TraceTrack::Bgm);
+
+	stream_ = std::make_shared<MusicStream>(std::move(intro), std::move(loop), bus);
+	audio_ = Audio{ stream_, Arg::sampleRate = stream_->GetSampleRate() };
+
+	return true;
+}
+
+void MusicPlayer::Play()
+{
+	PlayFrom(MusicPosition{});
+}
+
+void MusicPlayer::PlayFrom(const MusicPosition& position)
+{
+	if(not stream_)
+	{
+		return;
+	}
+
+	TraceRecorder::Instant(U"BGM Play", U"audio", {}, TraceTrack::Bgm);
+
+	audio_.stop();
+	stream_->RequestRestartAt(position);
+	audio_.play();
+}
+
+void MusicPlayer::Stop()
+{
+	if(audio_)
+	{
+		TraceRecorder::Instant(U"BGM Stop", U"audio", {}, TraceTrack::Bgm);
+		audio_.stop();
+	}
+}
+
+bool MusicPlayer::IsPlaying() const
+{
+	return (stream_ && audio_.isPlaying());
+}
+
+bool MusicPlayer::IsInLoop() const
+{
+	return (stream_ && stream_->IsInLoop());
+}
+
+MusicPosition MusicPlayer::GetPosition() const
+{
+	return (stream_ ? stream_->GetPosition() : MusicPosition{});
+}
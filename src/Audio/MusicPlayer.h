@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include "AudioBus.h"
+#include "MusicStream.h"
+
+#include <memory>
+#include <Siv3D.hpp>
+
+// BGMをストリーミング再生するクラス
+// 曲全体をメモリに展開せず，再生しながら少しずつデコードする（デコードは MusicStream のワーカースレッド）
+class MusicPlayer
+{
+public:
+	MusicPlayer() = default;
+
+	// イントロ付きのループ曲を開く（intro_path は空でもよい）
+	// イントロとループのサンプリングレートが違うときは開かずに false を返す
+	// 音量やフィルタは bus 側で調整する
+	bool Open(const FilePath& intro_path, const FilePath& loop_path, AudioBus* bus = nullptr);
+
+	// 開いてあるデコーダーを渡す（起動時に別スレッドで開いたものなど）
+	bool Open(std::unique_ptr<IMusicDecoder> intro, std::unique_ptr<IMusicDecoder> loop, AudioBus* bus = nullptr);
+
+	// イントロの先頭から再生する（再生中なら頭出し）
+	void Play();
+
+	// position から再生する（中断セーブから再開するとき）
+	void PlayFrom(const MusicPosition& position);
+
+	void Stop();
+
+	[[nodiscard]]
+	bool IsPlaying() const;
+
+	// イントロが終わってループ区間に入っているか
+	[[nodiscard]]
+	bool IsInLoop() const;
+
+	// 今の再生位置（開いていなければ先頭）
+	[[nodiscard]]
+	MusicPosition GetPosition() const;
+
+private:
+	std::shared_ptr<MusicStream> stream_;
+	Audio audio_;
+};
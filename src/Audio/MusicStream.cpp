@@ -0,0 +1,284 @@
+﻿#include "MusicStream.h"
+#include "../Core/TraceRecorder.h"
+
+#include <Siv3D.hpp>
+
+MusicStream::MusicStream(std::unique_ptr<IMusicDecoder> intro, std::unique_ptr<IMusicDecoder> loop, AudioBus* bus)
+	: intro_(std::move(intro))
+	, loop_(std::move(loop))
+	, bus_(bus)
+	, ring_left_(kRingFrames, 0.0f)
+	, ring_right_(kRingFrames, 0.0f)
+	, ring_positions_(kRingFrames, 0)
+{
+	if(intro_)
+	{
+		sample_rate_ = intro_->GetSampleRate();
+	}
+	else if(loop_)
+	{
+		sample_rate_ = loop_->GetSampleRate();
+	}
+
+	worker_ = std::thread{ [this]() { DecodeWorkerLoop(); } };
+}
+
+MusicStream::~MusicStream()
+{
+	{
+		std::lock_guard lock{ worker_mutex_ };
+		stop_worker_ = true;
+	}
+	worker_cv_.notify_all();
+	worker_.join();
+}
+
+void MusicStream::getAudio(float* left, float* right, size_t samples_to_write)
+{
+	TraceRecorder::SetThreadName(U"Audio");
+	const TraceScope trace_scope{ U"MusicStream::getAudio", U"audio" };
+
+	const uint32 requested_generation = restart_generation_.load(std::memory_order_acquire);
+	const uint32 ready_generation = ready_generation_.load(std::memory_order_acquire);
+
+	// ワーカーが鳴らし直す位置に合わせたら，それより前にデコードしてあった分を読み捨てる
+	uint64 read_index = read_index_.load(std::memory_order_relaxed);
+	if(ready_generation != applied_generation_)
+	{
+		applied_generation_ = ready_generation;
+		read_index = Max(read_index, flush_index_.load(std::memory_order_acquire));
+	}
+
+	size_t written = 0;
+
+	// 鳴らし直しを頼んだあとは，ワーカーが位置を合わせるまで古い位置の音を出さない
+	if(ready_generation == requested_generation)
+	{
+		const uint64 write_index = write_index_.load(std::memory_order_acquire);
+		written = static_cast<size_t>(Min<uint64>(write_index - read_index, samples_to_write));
+
+		for(size_t i = 0; i < written; ++i)
+		{
+			const size_t offset = static_cast<size_t>((read_index + i) & kRingMask);
+			left[i] = ring_left_[offset];
+			right[i] = ring_right_[offset];
+		}
+
+		if(written != 0)
+		{
+			const uint64 last_position = ring_positions_[static_cast<size_t>((read_index + written - 1) & kRingMask)];
+			const bool is_in_loop = ((last_position & kLoopPositionFlag) != 0);
+
+			if(is_in_loop && (not is_in_loop_.exchange(true, std::memory_order_acq_rel)))
+			{
+				TraceRecorder::Instant(U"BGM Intro -> Loop", U"audio", {}, TraceTrack::Bgm);
+			}
+			else if(not is_in_loop)
+			{
+				is_in_loop_.store(false, std::memory_order_release);
+			}
+
+			position_.store((last_position + 1), std::memory_order_release);
+		}
+
+		read_index += written;
+
+		if((read_index == write_index) && is_decode_finished_.load(std::memory_order_acquire))
+		{
+			has_ended_.store(true, std::memory_order_release);
+		}
+	}
+
+	read_index_.store(read_index, std::memory_order_release);
+
+	// 書き込めなかった分は無音
+	for(size_t i = written; i < samples_to_write; ++i)
+	{
+		left[i] = 0.0f;
+		right[i] = 0.0f;
+	}
+
+	if(bus_)
+	{
+		bus_->Process(left, right, samples_to_write, sample_rate_);
+	}
+}
+
+void MusicStream::DecodeWorkerLoop()
+{
+	TraceRecorder::SetThreadName(U"MusicDecode");
+
+	// デコーダーを読んでいる間だけ，このスレッドで COM などを初期化しておく
+	const MusicDecoderThreadScope decoder_thread_scope;
+
+	uint32 generation = 0;
+
+	for(;;)
+	{
+		{
+			std::unique_lock lock{ worker_mutex_ };
+			worker_cv_.wait_for(lock, kRefillInterval, [&]()
+				{
+					return (stop_worker_ || (restart_generation_.load(std::memory_order_acquire) != generation));
+				});
+
+			if(stop_worker_)
+			{
+				return;
+			}
+		}
+
+		const uint32 requested_generation = restart_generation_.load(std::memory_order_acquire);
+		if(requested_generation != generation)
+		{
+			generation = requested_generation;
+			SeekToRestartPosition();
+
+			// ここまでに書いた分は鳴らし直す前の音なので，オーディオスレッドに読み捨てさせる
+			flush_index_.store(write_index_.load(std::memory_order_relaxed), std::memory_order_release);
+			ready_generation_.store(generation, std::memory_order_release);
+		}
+
+		FillRing();
+	}
+}
+
+void MusicStream::SeekToRestartPosition()
+{
+	const TraceScope trace_scope{ U"MusicStream::Seek", U"audio" };
+
+	const uint64 restart_position = restart_position_.load(std::memory_order_acquire);
+	const bool is_loop_requested = (((restart_position & kLoopPositionFlag) != 0) && loop_);
+	current_frame_ = (restart_position & ~kLoopPositionFlag);
+
+	if(intro_)
+	{
+		intro_->Rewind();
+	}
+	if(loop_)
+	{
+		loop_->Rewind();
+	}
+
+	current_ = (intro_ && (not is_loop_requested)) ? intro_.get() : loop_.get();
+	if(current_ && (current_frame_ != 0))
+	{
+		current_->Seek(current_frame_);
+	}
+
+	is_decode_finished_.store((current_ == nullptr), std::memory_order_release);
+}
+
+void MusicStream::FillRing()
+{
+	const uint64 read_index = read_index_.load(std::memory_order_acquire);
+	uint64 write_index = write_index_.load(std::memory_order_relaxed);
+
+	size_t free_frames = static_cast<size_t>(kRingFrames - (write_index - read_index));
+	if((free_frames < kMinFillFrames) || (not current_))
+	{
+		return;
+	}
+
+	const TraceScope trace_scope{ U"MusicStream::Decode", U"audio" };
+
+	int32 empty_reads = 0;
+
+	while((free_frames != 0) && current_)
+	{
+		// リングバッファの終端で折り返すので，一度に書くのは終端まで
+		const size_t offset = static_cast<size_t>(write_index & kRingMask);
+		const size_t count = Min(free_frames, (kRingFrames - offset));
+		const size_t read = current_->Read(ring_left_.data() + offset, ring_right_.data() + offset, count);
+
+		const uint64 loop_flag = ((current_ == loop_.get()) ? kLoopPositionFlag : 0);
+		for(size_t i = 0; i < read; ++i)
+		{
+			ring_positions_[offset + i] = ((current_frame_ + i) | loop_flag);
+		}
+
+		current_frame_ += read;
+		write_index += read;
+		free_frames -= read;
+		write_index_.store(write_index, std::memory_order_release);
+
+		if(read == count)
+		{
+			continue;
+		}
+
+		// 終端に達したら続きに次のトラックを書き込む
+		AdvanceTrack();
+
+		// 中身の無いファイルで無限ループしないように
+		empty_reads = (read == 0) ? (empty_reads + 1) : 0;
+		if(empty_reads >= 2)
+		{
+			current_ = nullptr;
+			is_decode_finished_.store(true, std::memory_order_release);
+		}
+	}
+}
+
+void MusicStream::AdvanceTrack()
+{
+	if((current_ == intro_.get()) && loop_)
+	{
+		// ループ曲は鳴らし直すときに先頭へ戻してあるので，そのまま続ける
+		current_ = loop_.get();
+		current_frame_ = 0;
+	}
+	else if(current_ == loop_.get())
+	{
+		loop_->Rewind();
+		current_frame_ = 0;
+	}
+	else
+	{
+		current_ = nullptr;
+		is_decode_finished_.store(true, std::memory_order_release);
+	}
+}
+
+bool MusicStream::hasEnded()
+{
+	return has_ended_.load(std::memory_order_acquire);
+}
+
+void MusicStream::rewind()
+{
+	RequestRestart();
+}
+
+void MusicStream::RequestRestart()
+{
+	RequestRestartAt(MusicPosition{});
+}
+
+void MusicStream::RequestRestartAt(const MusicPosition& position)
+{
+	has_ended_.store(false, std::memory_order_release);
+	is_in_loop_.store(position.is_in_loop, std::memory_order_release);
+	restart_position_.store(((position.frame & ~kLoopPositionFlag) | (position.is_in_loop ? kLoopPositionFlag : 0)), std::memory_order_release);
+	position_.store(restart_position_.load(std::memory_order_relaxed), std::memory_order_release);
+	restart_generation_.fetch_add(1, std::memory_order_acq_rel);
+
+	// ワーカーは一定の間隔でも起きるので，ロックは取らずに知らせるだけ
+	worker_cv_.notify_one();
+}
+
+MusicPosition MusicStream::GetPosition() const
+{
+	const uint64 position = position_.load(std::memory_order_acquire);
+	return MusicPosition{ ((position & kLoopPositionFlag) != 0), (position & ~kLoopPositionFlag) };
+}
+
+bool MusicStream::IsInLoop() const
+{
+	return is_in_loop_.load(std::memory_order_acquire);
+}
+
+uint32 MusicStream::GetSampleRate() const
+{
+	return sample_rate_;
+}
@@ -0,0 +1,122 @@
+﻿#pragma once
+
+#include "AudioBus.h"
+#include "MusicDecoder.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <Siv3D.hpp>
+#include <thread>
+
+// 再生位置（どちらの曲の，先頭から何サンプル目か）
+struct MusicPosition
+{
+	bool is_in_loop = false;
+	uint64 frame = 0;
+};
+
+// イントロ→ループの2曲をつなげて再生する IAudioStream
+// デコードは専用のワーカースレッドが行い，デコードした PCM をリングバッファに書き溜める
+// getAudio() はオーディオスレッドから呼ばれ，リングバッファからコピーするだけ（ファイルの読み込みもデコードもしない）
+// イントロの終端とループの先頭はリングバッファ内で連結するので，切り替えはサンプル単位で途切れない
+class MusicStream : public IAudioStream
+{
+public:
+	// intro は nullptr でもよい（その場合はループ曲だけを繰り返す）
+	// intro と loop のサンプリングレートは同じであること（MusicPlayer::Open() で確かめる）
+	// bus を渡すとデコードした音をそのバスに通してから出力する
+	MusicStream(std::unique_ptr<IMusicDecoder> intro, std::unique_ptr<IMusicDecoder> loop, AudioBus* bus = nullptr);
+
+	~MusicStream();
+
+	// IAudioStream（オーディオスレッド）
+	void getAudio(float* left, float* right, size_t samples_to_write) override;
+	bool hasEnded() override;
+	void rewind() override;
+
+	// イントロの先頭から鳴らし直す（メインスレッド）
+	void RequestRestart();
+
+	// position から鳴らし直す（メインスレッド）
+	// ワーカーがその位置からデコードし直すまで，getAudio() は無音を返す
+	void RequestRestartAt(const MusicPosition& position);
+
+	// オーディオスレッドに渡し終えた位置（メインスレッド．オーディオのバッファの分だけ先に進んでいる）
+	MusicPosition GetPosition() const;
+
+	// ループ区間に入っているか（メインスレッド）
+	bool IsInLoop() const;
+
+	uint32 GetSampleRate() const;
+
+	MusicStream(const MusicStream&) = delete;
+	MusicStream& operator=(const MusicStream&) = delete;
+
+private:
+	// デコード用ワーカースレッドの本体
+	void DecodeWorkerLoop();
+
+	// 鳴らし直す位置にデコーダーを合わせる（ワーカー）
+	void SeekToRestartPosition();
+
+	// リングバッファの空きをデコードで埋める（ワーカー）
+	void FillRing();
+
+	// 現在のトラックが終端に達したときに次のトラックへ切り替える（ワーカー）
+	void AdvanceTrack();
+
+	// リングバッファの大きさ（2のべき乗．44.1kHz で約 0.74 秒）
+	static constexpr size_t kRingFrames = 32768;
+	static constexpr size_t kRingMask = (kRingFrames - 1);
+
+	// 空きがこれより少なければデコードしない（細切れに読まない）
+	static constexpr size_t kMinFillFrames = 2048;
+
+	// ワーカーが空きを確かめる間隔（この間にオーディオスレッドが読む量よりリングバッファは十分大きい）
+	static constexpr std::chrono::milliseconds kRefillInterval{ 5 };
+
+	std::unique_ptr<IMusicDecoder> intro_;
+	std::unique_ptr<IMusicDecoder> loop_;
+	AudioBus* bus_ = nullptr;
+	uint32 sample_rate_ = 44100;
+
+	// デコードした PCM と，それぞれのサンプルの位置（最上位のビットがループ区間の印）
+	// ワーカーが write_index_ の先に書き，オーディオスレッドが read_index_ から読む（どちらも増え続ける通し番号）
+	Array<float> ring_left_;
+	Array<float> ring_right_;
+	Array<uint64> ring_positions_;
+	std::atomic<uint64> write_index_{ 0 };
+	std::atomic<uint64> read_index_{ 0 };
+
+	// ワーカーだけが触る
+	IMusicDecoder* current_ = nullptr;
+	uint64 current_frame_ = 0;
+
+	// 鳴らし直しの受け渡し
+	// メインスレッドが restart_generation_ を進め，ワーカーが位置を合わせたら flush_index_ と ready_generation_ を書く
+	// オーディオスレッドは flush_index_ より前（鳴らし直す前の音）を読み捨てる
+	std::atomic<uint32> restart_generation_{ 1 };
+	std::atomic<uint32> ready_generation_{ 0 };
+	std::atomic<uint64> flush_index_{ 0 };
+	std::atomic<bool> is_decode_finished_{ false };
+
+	// オーディオスレッドだけが触る
+	uint32 applied_generation_ = 0;
+
+	// メインスレッドとオーディオスレッドの間の受け渡し
+	std::atomic<bool> is_in_loop_{ false };
+	std::atomic<bool> has_ended_{ false };
+
+	// 鳴らし直す位置（最上位のビットがループ区間の印）と，今の位置（同じ形）
+	static constexpr uint64 kLoopPositionFlag = (uint64{ 1 } << 63);
+	std::atomic<uint64> restart_position_{ 0 };
+	std::atomic<uint64> position_{ 0 };
+
+	std::mutex worker_mutex_;
+	std::condition_variable worker_cv_;
+	bool stop_worker_ = false;
+	std::thread worker_;
+};
@@ -0,0 +1,330 @@
+﻿#include "SfxEngine.h"
+#include "../Core/TraceRecorder.h"
+
+#include <Siv3D.hpp>
+
+SfxEngine& SfxEngine::GetInstance()
+{
+	static SfxEngine instance;
+	return instance;
+}
+
+SfxEngine::SfxEngine()
+	: mixer_(std::make_shared<Mixer>(*this))
+{
+	output_ = Audio{ mixer_, Arg::sampleRate = kOutputSampleRate };
+	output_.play();
+}
+
+SfxEngine::~SfxEngine()
+{
+	Shutdown();
+}
+
+void SfxEngine::Shutdown()
+{
+	if(output_)
+	{
+		output_.stop();
+		output_ = Audio{};
+	}
+}
+
+SoundId SfxEngine::Register(const String& name, const SfxOptions& options)
+{
+	if(auto it = sound_ids_.find(name); it != sound_ids_.end())
+	{
+		// オーディオスレッドが設定を読むのはデータが届いてからなので，それまでは上書きしてよい
+		SoundSlot& slot = sounds_[it->second];
+		if(slot.data.load(std::memory_order_acquire) == nullptr)
+		{
+			slot.options = options;
+		}
+		return it->second;
+	}
+
+	if(sound_count_ >= kMaxSounds)
+	{
+		Print << U"エラー: 効果音'{}'を登録できません（最大{}個）．"_fmt(name, kMaxSounds);
+		return kInvalidSoundId;
+	}
+
+	const SoundId id = static_cast<SoundId>(sound_count_++);
+	sounds_[id].name = name;
+	sounds_[id].options = options;
+	sound_ids_.emplace(name, id);
+	return id;
+}
+
+SoundId SfxEngine::GetOrCreateId(const String& name)
+{
+	if(const SoundId id = Find(name); id != kInvalidSoundId)
+	{
+		return id;
+	}
+	return Register(name, SfxOptions{});
+}
+
+SoundId SfxEngine::Find(const String& name) const
+{
+	if(auto it = sound_ids_.find(name); it != sound_ids_.end())
+	{
+		return it->second;
+	}
+	return kInvalidSoundId;
+}
+
+void SfxEngine::SetSoundData(const String& name, Wave&& wave)
+{
+	const SoundId id = GetOrCreateId(name);
+	if(id == kInvalidSoundId)
+	{
+		return;
+	}
+
+	// 前に外したデータのうち，オーディオスレッドが使い終えたものを解放する
+	retired_sound_data_.remove_if([this](const RetiredSoundData& retired)
+		{
+			const uint32 acknowledged = sounds_[retired.sound].acknowledged_swap_count.load(std::memory_order_acquire);
+			return (static_cast<int32>(acknowledged - retired.swap_count) >= 0);
+		});
+
+	auto data = std::make_unique<SoundData>();
+	data->step = static_cast<double>(wave.sampleRate()) / kOutputSampleRate;
+	data->wave = std::move(wave);
+
+	SoundSlot& slot = sounds_[id];
+	slot.data.store(data.get(), std::memory_order_release);
+	const uint32 swap_count = (slot.swap_count.fetch_add(1, std::memory_order_acq_rel) + 1);
+
+	if(slot.storage)
+	{
+		retired_sound_data_.push_back(RetiredSoundData{ id, swap_count, std::move(slot.storage) });
+	}
+	slot.storage = std::move(data);
+}
+
+SfxHandle SfxEngine::Play(SoundId id, double volume)
+{
+	if((id >= kMaxSounds) || (sounds_[id].data.load(std::memory_order_acquire) == nullptr))
+	{
+		// 非ブロッキング: まだロードされていないので再生リクエストを無視
+		return kInvalidSfxHandle;
+	}
+
+	SfxHandle handle = next_handle_.fetch_add(1, std::memory_order_relaxed);
+	if(handle == kInvalidSfxHandle)
+	{
+		handle = next_handle_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if(not commands_.TryPush(Command{ CommandType::Play, id, handle, static_cast<float>(volume) }))
+	{
+		// キューが溢れるほど同一フレームに鳴らした場合は捨てる
+		return kInvalidSfxHandle;
+	}
+
+	return handle;
+}
+
+void SfxEngine::Stop(SfxHandle handle)
+{
+	if(handle == kInvalidSfxHandle)
+	{
+		return;
+	}
+
+	commands_.TryPush(Command{ CommandType::Stop, kInvalidSoundId, handle, 0.0f });
+}
+
+void SfxEngine::StopAll()
+{
+	commands_.TryPush(Command{ CommandType::StopAll, kInvalidSoundId, kInvalidSfxHandle, 0.0f });
+}
+
+SfxEngine::Mixer::Mixer(SfxEngine& engine)
+	: engine_(engine)
+{
+}
+
+void SfxEngine::Mixer::getAudio(float* left, float* right, size_t samples_to_write)
+{
+	TraceRecorder::SetThreadName(U"Audio");
+	const TraceScope trace_scope{ U"SfxEngine::Mixer::getAudio", U"audio" };
+
+	ProcessCommands();
+
+	for(size_t i = 0; i < samples_to_write; ++i)
+	{
+		left[i] = 0.0f;
+		right[i] = 0.0f;
+	}
+
+	for(auto& voice : voices_)
+	{
+		if(not voice.data)
+		{
+			continue;
+		}
+
+		const Wave& wave = voice.data->wave;
+		const size_t length = wave.size();
+		const double step = voice.data->step;
+
+		for(size_t i = 0; i < samples_to_write; ++i)
+		{
+			const size_t index = static_cast<size_t>(voice.position);
+			if(index >= length)
+			{
+				voice.data = nullptr;
+				break;
+			}
+
+			// サンプルレートが違う素材は線形補間で合わせる（最後のサンプルはそのまま鳴らす）
+			const float t = static_cast<float>(voice.position - index);
+			const WaveSample& s0 = wave[index];
+			const WaveSample& s1 = wave[Min(index + 1, length - 1)];
+			left[i] += (s0.left + (s1.left - s0.left) * t) * voice.volume;
+			right[i] += (s0.right + (s1.right - s0.right) * t) * voice.volume;
+
+			voice.position += step;
+		}
+	}
+
+	AcknowledgeSwaps();
+
+	AudioMixer::GetInstance().GetBus(AudioBusId::Sfx).Process(left, right, samples_to_write, kOutputSampleRate);
+}
+
+void SfxEngine::Mixer::AcknowledgeSwaps()
+{
+	for(size_t id = 0; id < kMaxSounds; ++id)
+	{
+		SoundSlot& slot = engine_.sounds_[id];
+		const uint32 swap_count = slot.swap_count.load(std::memory_order_acquire);
+		if(slot.acknowledged_swap_count.load(std::memory_order_relaxed) == swap_count)
+		{
+			continue;
+		}
+
+		// ボイスは鳴らし始めたときの data を使うので，今の data より古いものを使うボイスが無ければ
+		// swap_count 回目までに外したデータはもう参照されない
+		const SoundData* data = slot.data.load(std::memory_order_acquire);
+		const bool is_old_data_playing = std::any_of(voices_.begin(), voices_.end(), [&](const Voice& voice)
+			{
+				return (voice.data && (voice.sound == id) && (voice.data != data));
+			});
+
+		if(not is_old_data_playing)
+		{
+			slot.acknowledged_swap_count.store(swap_count, std::memory_order_release);
+		}
+	}
+}
+
+void SfxEngine::Mixer::ProcessCommands()
+{
+	Command command;
+	while(engine_.commands_.TryPop(command))
+	{
+		switch(command.type)
+		{
+		case CommandType::Play:
+			StartVoice(command);
+			break;
+		case CommandType::Stop:
+			for(auto& voice : voices_)
+			{
+				if(voice.data && (voice.handle == command.handle))
+				{
+					voice.data = nullptr;
+				}
+			}
+			break;
+		case CommandType::StopAll:
+			for(auto& voice : voices_)
+			{
+				voice.data = nullptr;
+			}
+			break;
+		}
+	}
+}
+
+void SfxEngine::Mixer::StartVoice(const Command& command)
+{
+	const SoundSlot& slot = engine_.sounds_[command.sound];
+	const SoundData* data = slot.data.load(std::memory_order_acquire);
+	if(not data)
+	{
+		return;
+	}
+
+	Voice* voice = FindVoiceFor(command, slot);
+	if(not voice)
+	{
+		// 空きが無く，奪えるボイスも無い
+		return;
+	}
+
+	voice->data = data;
+	voice->position = 0.0;
+	voice->volume = command.volume;
+	voice->handle = command.handle;
+	voice->sound = command.sound;
+	voice->priority = slot.options.priority;
+	voice->start_order = start_counter_++;
+}
+
+SfxEngine::Voice* SfxEngine::Mixer::FindVoiceFor(const Command& command, const SoundSlot& slot)
+{
+	// 同じ効果音が上限まで鳴っていれば，その中で一番古いものを置き換える
+	int32 same_sound_count = 0;
+	Voice* oldest_same_sound = nullptr;
+	Voice* free_voice = nullptr;
+	Voice* steal_candidate = nullptr;
+
+	for(auto& voice : voices_)
+	{
+		if(not voice.data)
+		{
+			if(not free_voice)
+			{
+				free_voice = &voice;
+			}
+			continue;
+		}
+
+		if(voice.sound == command.sound)
+		{
+			++same_sound_count;
+			if((not oldest_same_sound) || (voice.start_order < oldest_same_sound->start_order))
+			{
+				oldest_same_sound = &voice;
+			}
+		}
+
+		// 優先度が低い順，同じなら古い順に奪う候補を選ぶ
+		if(voice.priority <= slot.options.priority)
+		{
+			if((not steal_candidate)
+				|| (voice.priority < steal_candidate->priority)
+				|| ((voice.priority == steal_candidate->priority) && (voice.start_order < steal_candidate->start_order)))
+			{
+				steal_candidate = &voice;
+			}
+		}
+	}
+
+	if(oldest_same_sound && (same_sound_count >= Max(slot.options.max_polyphony, 1)))
+	{
+		return oldest_same_sound;
+	}
+
+	if(free_voice)
+	{
+		return free_voice;
+	}
+
+	return steal_candidate;
+}
@@ -0,0 +1,160 @@
+﻿#pragma once
+
+#include "../Core/LockFreeQueue.h"
+#include "AudioBus.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <Siv3D.hpp>
+
+// 登録済み効果音の番号（名前の検索は登録時だけ行い，再生時はこの番号を使う）
+using SoundId = uint16;
+inline constexpr SoundId kInvalidSoundId = 0xFFFF;
+
+// 再生中の1発ごとのハンドル（0 は無効）
+using SfxHandle = uint32;
+inline constexpr SfxHandle kInvalidSfxHandle = 0;
+
+// 効果音ごとの再生設定
+struct SfxOptions
+{
+	// 同時に鳴らせる数．超えた場合は同じ効果音の一番古いボイスを止めて鳴らす
+	int32 max_polyphony = 4;
+
+	// ボイスが足りないときに，これ以下の優先度のボイスを奪って鳴らす
+	int32 priority = 0;
+};
+
+// ボイスを事前確保した効果音ミキサー
+// Play() / Stop() はロックフリーのキューにコマンドを積むだけなので，ゲーム側がオーディオスレッドを待つことはない
+class SfxEngine
+{
+public:
+	static SfxEngine& GetInstance();
+
+	~SfxEngine();
+
+	// 名前に対応する番号を登録し，再生設定を与える（データが届く前でもよい）
+	SoundId Register(const String& name, const SfxOptions& options);
+
+	// 名前に対応する番号を返す．未登録なら既定の設定で番号だけ確保する
+	// エンティティは構築時にこれで番号を取っておき，再生時は番号だけを使う
+	SoundId GetOrCreateId(const String& name);
+
+	// 登録済みの番号を引く．未登録なら kInvalidSoundId
+	SoundId Find(const String& name) const;
+
+	// デコード済みのデータを設定する（メインスレッド）
+	void SetSoundData(const String& name, Wave&& wave);
+
+	// 効果音を鳴らす．データがまだ無い場合は kInvalidSfxHandle を返して何もしない
+	SfxHandle Play(SoundId id, double volume = 1.0);
+
+	void Stop(SfxHandle handle);
+	void StopAll();
+
+	// 終了時に Siv3D のエンジンが生きているうちに出力を止める
+	void Shutdown();
+
+	SfxEngine(const SfxEngine&) = delete;
+	SfxEngine& operator=(const SfxEngine&) = delete;
+
+private:
+	SfxEngine();
+
+	static constexpr size_t kMaxSounds = 64;
+	static constexpr size_t kMaxVoices = 32;
+	static constexpr size_t kCommandQueueSize = 256;
+	static constexpr uint32 kOutputSampleRate = 44100;
+
+	struct SoundData
+	{
+		Wave wave;
+		double step = 1.0; // 出力1サンプルあたりに進む元データのサンプル数
+	};
+
+	struct SoundSlot
+	{
+		String name;
+		SfxOptions options;
+		std::atomic<const SoundData*> data{ nullptr };
+
+		// data の持ち主（メインスレッドだけが触る）
+		std::unique_ptr<SoundData> storage;
+
+		// データを差し替えた回数と，オーディオスレッドが古いデータを使い終えたと確認した回数
+		std::atomic<uint32> swap_count{ 0 };
+		std::atomic<uint32> acknowledged_swap_count{ 0 };
+	};
+
+	// 差し替えで外したデータ．オーディオスレッドが swap_count 回目までの差し替えを確認したら解放する
+	struct RetiredSoundData
+	{
+		SoundId sound = kInvalidSoundId;
+		uint32 swap_count = 0;
+		std::unique_ptr<SoundData> data;
+	};
+
+	enum class CommandType : uint8
+	{
+		Play,
+		Stop,
+		StopAll,
+	};
+
+	struct Command
+	{
+		CommandType type = CommandType::Play;
+		SoundId sound = kInvalidSoundId;
+		SfxHandle handle = kInvalidSfxHandle;
+		float volume = 1.0f;
+	};
+
+	struct Voice
+	{
+		const SoundData* data = nullptr;
+		double position = 0.0;
+		float volume = 1.0f;
+		SfxHandle handle = kInvalidSfxHandle;
+		SoundId sound = kInvalidSoundId;
+		int32 priority = 0;
+		uint64 start_order = 0;
+	};
+
+	// オーディオスレッド側でボイスを管理してミックスする
+	class Mixer : public IAudioStream
+	{
+	public:
+		explicit Mixer(SfxEngine& engine);
+
+		void getAudio(float* left, float* right, size_t samples_to_write) override;
+		bool hasEnded() override { return false; }
+		void rewind() override {}
+
+	private:
+		void ProcessCommands();
+
+		// 差し替え前のデータを鳴らしているボイスが無くなった効果音を，メインスレッドに知らせる
+		void AcknowledgeSwaps();
+		void StartVoice(const Command& command);
+		Voice* FindVoiceFor(const Command& command, const SoundSlot& slot);
+
+		SfxEngine& engine_;
+		std::array<Voice, kMaxVoices> voices_{};
+		uint64 start_counter_ = 0;
+	};
+
+	std::array<SoundSlot, kMaxSounds> sounds_;
+	size_t sound_count_ = 0;
+	HashTable<String, SoundId> sound_ids_;
+
+	// 差し替えたデータはオーディオスレッドが参照中かもしれないので，確認が取れるまで保持する
+	Array<RetiredSoundData> retired_sound_data_;
+
+	LockFreeQueue<Command, kCommandQueueSize> commands_;
+	std::atomic<SfxHandle> next_handle_{ 1 };
+
+	std::shared_ptr<Mixer> mixer_;
+	Audio output_;
+};
@@ -0,0 +1,460 @@
+﻿#include "AllocationTracker.h"
+
+#include <Siv3D.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+// デバッグビルドでは確保した場所ごとに集計する（Windows の呼び出し履歴の API を使う）
+#if defined(_DEBUG) && defined(_WIN32)
+#define ALLOCATION_TRACKER_CALL_SITES
+#endif
+
+#ifdef ALLOCATION_TRACKER_CALL_SITES
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <DbgHelp.h>
+
+#pragma comment(lib, "dbghelp.lib")
+#endif
+
+namespace
+{
+	// 全スレッドの合計（フレームの集計用）
+	constinit std::atomic<uint64> g_total_count{ 0 };
+	constinit std::atomic<uint64> g_total_bytes{ 0 };
+
+	// スレッドごとの合計（スコープの集計用）
+	thread_local uint64 t_count = 0;
+	thread_local uint64 t_bytes = 0;
+
+	// 内訳を書き出している間の確保は数えない
+	thread_local bool t_is_reporting = false;
+
+	// BeginFrame() / EndFrame() を呼ぶスレッド（メインスレッド）か．予算と場所ごとの集計はこのスレッドの確保だけにする
+	thread_local bool t_is_frame_thread = false;
+
+	struct ReportingGuard
+	{
+		bool previous = t_is_reporting;
+
+		ReportingGuard() { t_is_reporting = true; }
+		~ReportingGuard() { t_is_reporting = previous; }
+	};
+
+#ifdef ALLOCATION_TRACKER_CALL_SITES
+	// 呼び出し履歴の深さと，1フレームに集計できる場所の数
+	constexpr size_t kCallStackDepth = 8;
+	constexpr size_t kMaxCallSites = 256;
+
+	// 呼び出し履歴から除く，この集計自身と operator new のフレーム数（RecordCallSite, Record, Allocate, operator new）
+	constexpr ULONG kSkipFrames = 4;
+
+	// 書き出すときに表示する場所の数
+	constexpr size_t kReportedCallSites = 10;
+
+	struct CallSite
+	{
+		ULONG hash = 0;
+		USHORT depth = 0;
+		void* frames[kCallStackDepth] = {};
+		AllocationStats stats;
+	};
+
+	constinit std::atomic<bool> g_capture_call_sites{ false };
+
+	// 確保のたびにロックするが，デバッグビルドで有効にしたときだけなのでよしとする
+	std::mutex g_call_site_mutex;
+	std::array<CallSite, kMaxCallSites> g_call_sites;
+	size_t g_call_site_count = 0;
+	std::array<CallSite, kMaxCallSites> g_last_call_sites;
+	size_t g_last_call_site_count = 0;
+
+	// 表が埋まって数えられなかった確保
+	AllocationStats g_dropped_call_sites;
+	AllocationStats g_last_dropped_call_sites;
+
+	void RecordCallSite(size_t bytes)
+	{
+		void* frames[kCallStackDepth];
+		ULONG hash = 0;
+		const USHORT depth = RtlCaptureStackBackTrace(kSkipFrames, static_cast<ULONG>(kCallStackDepth), frames, &hash);
+
+		std::lock_guard lock{ g_call_site_mutex };
+		for(size_t i = 0; i < g_call_site_count; ++i)
+		{
+			CallSite& site = g_call_sites[i];
+			if((site.hash == hash) && (site.depth == depth) && std::equal(frames, (frames + depth), site.frames))
+			{
+				++site.stats.count;
+				site.stats.bytes += bytes;
+				return;
+			}
+		}
+
+		if(g_call_site_count == kMaxCallSites)
+		{
+			++g_dropped_call_sites.count;
+			g_dropped_call_sites.bytes += bytes;
+			return;
+		}
+
+		CallSite& site = g_call_sites[g_call_site_count++];
+		site.hash = hash;
+		site.depth = depth;
+		std::copy(frames, (frames + depth), site.frames);
+		site.stats = AllocationStats{ 1, bytes };
+	}
+
+	// アドレスを「関数名 (ファイル名:行)」にする
+	String DescribeAddress(void* address)
+	{
+		static const bool is_initialized = (SymInitialize(GetCurrentProcess(), nullptr, TRUE) != FALSE);
+		if(not is_initialized)
+		{
+			return U"{}"_fmt(address);
+		}
+
+		alignas(SYMBOL_INFO) char buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME];
+		SYMBOL_INFO* symbol = reinterpret_cast<SYMBOL_INFO*>(buffer);
+		symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+		symbol->MaxNameLen = MAX_SYM_NAME;
+
+		const DWORD64 address64 = reinterpret_cast<DWORD64>(address);
+		String description = (SymFromAddr(GetCurrentProcess(), address64, nullptr, symbol)
+			? Unicode::Widen(std::string_view{ symbol->Name })
+			: U"{}"_fmt(address));
+
+		IMAGEHLP_LINE64 line{};
+		line.SizeOfStruct = sizeof(IMAGEHLP_LINE64);
+		DWORD displacement = 0;
+		if(SymGetLineFromAddr64(GetCurrentProcess(), address64, &displacement, &line))
+		{
+			description += U" ({}:{})"_fmt(FileSystem::FileName(Unicode::Widen(std::string_view{ line.FileName })), line.LineNumber);
+		}
+		return description;
+	}
+#endif
+
+	void* Allocate(size_t size)
+	{
+		AllocationTracker::Record(size);
+		return std::malloc((size != 0) ? size : 1);
+	}
+
+	void* AllocateAligned(size_t size, std::align_val_t alignment)
+	{
+		AllocationTracker::Record(size);
+		const size_t align = static_cast<size_t>(alignment);
+#ifdef _MSC_VER
+		return _aligned_malloc(((size != 0) ? size : 1), align);
+#else
+		// aligned_alloc は大きさがアライメントの倍数でないといけない
+		return std::aligned_alloc(align, ((Max<size_t>(size, 1) + align - 1) / align) * align);
+#endif
+	}
+
+	void FreeAligned(void* ptr)
+	{
+#ifdef _MSC_VER
+		_aligned_free(ptr);
+#else
+		std::free(ptr);
+#endif
+	}
+}
+
+// グローバルの operator new / delete の置き換え
+void* operator new(size_t size)
+{
+	if(void* ptr = Allocate(size))
+	{
+		return ptr;
+	}
+	throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size)
+{
+	if(void* ptr = Allocate(size))
+	{
+		return ptr;
+	}
+	throw std::bad_alloc{};
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	if(void* ptr = AllocateAligned(size, alignment))
+	{
+		return ptr;
+	}
+	throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	if(void* ptr = AllocateAligned(size, alignment))
+	{
+		return ptr;
+	}
+	throw std::bad_alloc{};
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return AllocateAligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return AllocateAligned(size, alignment); }
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::align_val_t) noexcept { FreeAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { FreeAligned(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { FreeAligned(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { FreeAligned(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { FreeAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { FreeAligned(ptr); }
+
+AllocationTracker& AllocationTracker::GetInstance()
+{
+	static AllocationTracker instance;
+	return instance;
+}
+
+void AllocationTracker::Record(size_t bytes)
+{
+	if(t_is_reporting)
+	{
+		return;
+	}
+
+	++t_count;
+	t_bytes += bytes;
+	g_total_count.fetch_add(1, std::memory_order_relaxed);
+	g_total_bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+#ifdef ALLOCATION_TRACKER_CALL_SITES
+	if(t_is_frame_thread && g_capture_call_sites.load(std::memory_order_relaxed))
+	{
+		RecordCallSite(bytes);
+	}
+#endif
+}
+
+AllocationStats AllocationTracker::GetThreadTotals()
+{
+	return AllocationStats{ t_count, t_bytes };
+}
+
+void AllocationTracker::SetCallSiteCaptureEnabled([[maybe_unused]] bool enabled)
+{
+#ifdef ALLOCATION_TRACKER_CALL_SITES
+	g_capture_call_sites.store(enabled, std::memory_order_relaxed);
+#endif
+}
+
+void AllocationTracker::ConfigureFromCommandLine(const Array<String>& args)
+{
+	for(size_t i = 0; i < args.size(); ++i)
+	{
+		const String& key = args[i];
+		const bool has_value = ((i + 1) < args.size());
+
+		if((key == U"--alloc-budget") && has_value)
+		{
+			is_test_mode_ = true;
+			budget_count_ = ParseOr<uint64>(args[i + 1], 0);
+		}
+		else if((key == U"--alloc-test-frames") && has_value)
+		{
+			test_frames_ = Max<uint32>(ParseOr<uint32>(args[i + 1], kDefaultTestFrames), 1);
+		}
+		else if(key == U"--alloc-call-sites")
+		{
+			SetCallSiteCaptureEnabled(true);
+		}
+	}
+
+	// 失敗したときに場所まで分かるように，テストでは場所ごとの集計もする
+	if(is_test_mode_)
+	{
+		SetCallSiteCaptureEnabled(true);
+		Console << U"AllocationTracker: 定常状態のゲームプレイ {} フレームで，1フレームの確保が {} 回以下かを調べます"_fmt(test_frames_, budget_count_);
+	}
+}
+
+void AllocationTracker::BeginFrame()
+{
+	t_is_frame_thread = true;
+	frame_start_thread_totals_ = GetThreadTotals();
+	frame_start_totals_ = AllocationStats{ g_total_count.load(std::memory_order_relaxed), g_total_bytes.load(std::memory_order_relaxed) };
+	frame_scope_count_ = 0;
+
+#ifdef ALLOCATION_TRACKER_CALL_SITES
+	std::lock_guard lock{ g_call_site_mutex };
+	g_call_site_count = 0;
+	g_dropped_call_sites = AllocationStats{};
+#endif
+}
+
+void AllocationTracker::EndFrame()
+{
+	const AllocationStats thread_totals = GetThreadTotals();
+	last_frame_stats_ = AllocationStats{
+		(thread_totals.count - frame_start_thread_totals_.count),
+		(thread_totals.bytes - frame_start_thread_totals_.bytes)
+	};
+
+	const uint64 total_count = (g_total_count.load(std::memory_order_relaxed) - frame_start_totals_.count);
+	const uint64 total_bytes = (g_total_bytes.load(std::memory_order_relaxed) - frame_start_totals_.bytes);
+	last_frame_other_stats_ = AllocationStats{
+		(total_count - Min(total_count, last_frame_stats_.count)),
+		(total_bytes - Min(total_bytes, last_frame_stats_.bytes))
+	};
+
+	last_frame_scopes_ = frame_scopes_;
+	last_frame_scope_count_ = frame_scope_count_;
+
+#ifdef ALLOCATION_TRACKER_CALL_SITES
+	{
+		std::lock_guard lock{ g_call_site_mutex };
+		std::copy_n(g_call_sites.begin(), g_call_site_count, g_last_call_sites.begin());
+		g_last_call_site_count = g_call_site_count;
+		g_last_dropped_call_sites = g_dropped_call_sites;
+	}
+#endif
+
+	CheckBudget();
+	is_gameplay_frame_ = false;
+}
+
+void AllocationTracker::CheckBudget()
+{
+	if((not is_test_mode_) || is_test_finished_ || (not is_gameplay_frame_))
+	{
+		return;
+	}
+
+	++gameplay_frame_count_;
+	if(gameplay_frame_count_ <= kWarmupFrames)
+	{
+		return;
+	}
+
+	++tested_frame_count_;
+	if(last_frame_stats_.count > budget_count_)
+	{
+		has_test_failed_ = true;
+		is_test_finished_ = true;
+
+		{
+			const ReportingGuard guard;
+			Console << U"AllocationTracker: FAIL  ゲームプレイの {} フレーム目でメインスレッドが {} 回（{} バイト）確保しました（予算 {} 回）"_fmt(
+				gameplay_frame_count_, last_frame_stats_.count, last_frame_stats_.bytes, budget_count_);
+		}
+		PrintLastFrame();
+		return;
+	}
+
+	if(tested_frame_count_ >= test_frames_)
+	{
+		is_test_finished_ = true;
+
+		const ReportingGuard guard;
+		Console << U"AllocationTracker: PASS  {} フレームとも予算 {} 回以内でした"_fmt(tested_frame_count_, budget_count_);
+	}
+}
+
+void AllocationTracker::PrintLastFrame() const
+{
+	const ReportingGuard guard;
+
+	Console << U"AllocationTracker: 1フレームでメインスレッドが {} 回，{} バイト（ほかのスレッドが {} 回，{} バイト）"_fmt(
+		last_frame_stats_.count, last_frame_stats_.bytes, last_frame_other_stats_.count, last_frame_other_stats_.bytes);
+
+	// スコープは入れ子になるので，合計は全体と一致しない
+	Array<AllocationScopeStats> scopes(last_frame_scopes_.begin(), (last_frame_scopes_.begin() + last_frame_scope_count_));
+	scopes.sort_by([](const AllocationScopeStats& a, const AllocationScopeStats& b) { return (a.stats.count > b.stats.count); });
+	for(const auto& scope : scopes)
+	{
+		Console << U"  {:>6} 回 {:>8} バイト  {}（{} 回通過）"_fmt(scope.stats.count, scope.stats.bytes, scope.name, scope.calls);
+	}
+
+#ifdef ALLOCATION_TRACKER_CALL_SITES
+	Array<CallSite> sites(g_last_call_sites.begin(), (g_last_call_sites.begin() + g_last_call_site_count));
+	sites.sort_by([](const CallSite& a, const CallSite& b) { return (a.stats.count > b.stats.count); });
+	sites.resize(Min(sites.size(), kReportedCallSites));
+
+	for(const auto& site : sites)
+	{
+		Console << U"  {:>6} 回 {:>8} バイト"_fmt(site.stats.count, site.stats.bytes);
+		for(USHORT i = 0; i < site.depth; ++i)
+		{
+			Console << U"      {}"_fmt(DescribeAddress(site.frames[i]));
+		}
+	}
+
+	if(g_last_dropped_call_sites.count != 0)
+	{
+		Console << U"  （ほか {} 回は場所を記録できませんでした）"_fmt(g_last_dropped_call_sites.count);
+	}
+#endif
+}
+
+bool AllocationTracker::IsScopeRecordingThread() const
+{
+	// ワーカーは t_is_frame_thread が false なので，is_test_mode_ を読む前に抜ける
+	return (t_is_frame_thread && is_test_mode_);
+}
+
+void AllocationTracker::AddScope(StringView name, const AllocationStats& stats)
+{
+	for(size_t i = 0; i < frame_scope_count_; ++i)
+	{
+		AllocationScopeStats& scope = frame_scopes_[i];
+		if(scope.name.data() == name.data())
+		{
+			++scope.calls;
+			scope.stats.count += stats.count;
+			scope.stats.bytes += stats.bytes;
+			return;
+		}
+	}
+
+	if(frame_scope_count_ < kMaxScopes)
+	{
+		frame_scopes_[frame_scope_count_++] = AllocationScopeStats{ name, 1, stats };
+	}
+}
+
+AllocationScope::AllocationScope(StringView name)
+	: name_(name)
+	, start_(AllocationTracker::GetThreadTotals())
+	, is_recording_(AllocationTracker::GetInstance().IsScopeRecordingThread())
+{
+}
+
+AllocationScope::~AllocationScope()
+{
+	if(not is_recording_)
+	{
+		return;
+	}
+
+	const AllocationStats end = AllocationTracker::GetThreadTotals();
+	AllocationTracker::GetInstance().AddScope(name_, AllocationStats{ (end.count - start_.count), (end.bytes - start_.bytes) });
+}
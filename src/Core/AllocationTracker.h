@@ -0,0 +1,133 @@
+﻿#pragma once
+
+#include <Siv3D.hpp>
+
+#include <array>
+
+// ヒープ確保の回数とバイト数
+struct AllocationStats
+{
+	uint64 count = 0;
+	uint64 bytes = 0;
+};
+
+// AllocationScope ごとの1フレーム分の集計
+struct AllocationScopeStats
+{
+	StringView name;
+	uint32 calls = 0;
+	AllocationStats stats;
+};
+
+// グローバルの operator new を置き換えて，ヒープ確保を数える
+// 1フレームの確保の回数とバイト数と，AllocationScope ごとの内訳を取る
+// デバッグビルドではメインスレッドが確保した場所（呼び出し履歴）ごとにも集計し，内訳を書き出すときに関数名と行番号にする
+//
+// --alloc-budget <回数> を指定するとテストとして動かす
+// タイトルを飛ばして遊び始め，落ち着くまでの kWarmupFrames を除いたゲームプレイのフレームで
+// メインスレッドの確保の回数が予算を超えたら内訳を書き出して失敗で終了する（--alloc-test-frames で調べるフレーム数を変えられる）
+// ワーカーやオーディオのスレッドの確保は，メインスレッドのフレームと関係なく起きるので予算には含めず，別に書き出す
+class AllocationTracker
+{
+public:
+	// 1フレームに集計できるスコープの名前の数
+	static constexpr size_t kMaxScopes = 32;
+
+	static AllocationTracker& GetInstance();
+
+	// operator new から呼ばれる．どのスレッドから呼ばれてもよく，中ではヒープを確保しない
+	static void Record(size_t bytes);
+
+	// このスレッドでこれまでに確保した回数とバイト数（AllocationScope が差を取るのに使う）
+	static AllocationStats GetThreadTotals();
+
+	// デバッグビルドで，確保した場所ごとの集計をするか（呼び出し履歴を取るので重い）
+	static void SetCallSiteCaptureEnabled(bool enabled);
+
+	// --alloc-budget / --alloc-test-frames / --alloc-call-sites を読む
+	void ConfigureFromCommandLine(const Array<String>& args);
+
+	// メインループの先頭と最後に呼ぶ（メインスレッドから呼ぶ）
+	void BeginFrame();
+	void EndFrame();
+
+	// 今のフレームが定常状態のゲームプレイであることを記録する（予算の確認の対象になる）
+	void MarkGameplayFrame() { is_gameplay_frame_ = true; }
+
+	// 直前のフレームでメインスレッドが確保した回数とバイト数
+	const AllocationStats& GetLastFrameStats() const { return last_frame_stats_; }
+
+	// 直前のフレームの間にメインスレッド以外のスレッドが確保した回数とバイト数
+	const AllocationStats& GetLastFrameOtherThreadStats() const { return last_frame_other_stats_; }
+
+	// 直前のフレームのスコープごとの内訳（--alloc-budget のテストのときだけ集計する）
+	const std::array<AllocationScopeStats, kMaxScopes>& GetLastFrameScopes() const { return last_frame_scopes_; }
+	size_t GetLastFrameScopeCount() const { return last_frame_scope_count_; }
+
+	bool IsTestMode() const { return is_test_mode_; }
+	bool IsTestFinished() const { return is_test_finished_; }
+	bool HasTestFailed() const { return has_test_failed_; }
+
+	// 直前のフレームの内訳を Console に書き出す
+	void PrintLastFrame() const;
+
+private:
+	friend class AllocationScope;
+
+	AllocationTracker() = default;
+
+	// このスレッドの AllocationScope を集計するか（テスト中のメインスレッドだけ）
+	bool IsScopeRecordingThread() const;
+
+	// 名前ごとの集計に足す（名前は文字列リテラルの先頭のアドレスで区別する．メインスレッドから呼ぶ）
+	void AddScope(StringView name, const AllocationStats& stats);
+
+	// テストの対象のフレームなら予算と比べる
+	void CheckBudget();
+
+	// 起動直後の非同期ロードなどが落ち着くまで，予算の確認をしないフレーム数
+	static constexpr uint32 kWarmupFrames = 180;
+
+	// テストで予算を確認するフレーム数（--alloc-test-frames で変えられる）
+	static constexpr uint32 kDefaultTestFrames = 600;
+
+	// フレームの始めのメインスレッドと全スレッドの合計
+	AllocationStats frame_start_thread_totals_;
+	AllocationStats frame_start_totals_;
+	AllocationStats last_frame_stats_;
+	AllocationStats last_frame_other_stats_;
+
+	// スコープはメインスレッドでしか集計しないので，ロックは要らない
+	std::array<AllocationScopeStats, kMaxScopes> frame_scopes_;
+	size_t frame_scope_count_ = 0;
+	std::array<AllocationScopeStats, kMaxScopes> last_frame_scopes_;
+	size_t last_frame_scope_count_ = 0;
+
+	bool is_gameplay_frame_ = false;
+
+	bool is_test_mode_ = false;
+	bool is_test_finished_ = false;
+	bool has_test_failed_ = false;
+	uint64 budget_count_ = 0;
+	uint32 test_frames_ = kDefaultTestFrames;
+	uint32 gameplay_frame_count_ = 0;
+	uint32 tested_frame_count_ = 0;
+};
+
+// スコープの中でこのスレッドが確保した回数とバイト数を，名前ごとに1フレーム分集計する
+// 名前には文字列リテラルを渡す
+// 集計するのは --alloc-budget のテスト中のメインスレッドだけで，それ以外（ワーカーで進めるワールドなど）では何もしない
+class AllocationScope
+{
+public:
+	explicit AllocationScope(StringView name);
+	~AllocationScope();
+
+	AllocationScope(const AllocationScope&) = delete;
+	AllocationScope& operator=(const AllocationScope&) = delete;
+
+private:
+	StringView name_;
+	AllocationStats start_;
+	bool is_recording_ = false;
+};
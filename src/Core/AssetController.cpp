@@ -1,7 +1,29 @@
 ﻿#include "AssetController.h"
+#include "TraceRecorder.h"
 
 #include <Siv3D.hpp>
 
+bool AssetReadyAwaiter::await_ready() const
+{
+	if(asset_type.isEmpty())
+	{
+		return controller.IsSceneAssetsReady();
+	}
+	return controller.IsAssetReady(asset_type, asset_base_name);
+}
+
+bool AssetReadyAwaiter::await_suspend(std::coroutine_handle<> handle) const
+{
+	if(asset_type.isEmpty())
+	{
+		controller.OnSceneReady([handle]() { handle.resume(); });
+		return true;
+	}
+
+	// 未登録なら中断せずにそのまま進める
+	return controller.OnAssetReady(asset_type, asset_base_name, [handle]() { handle.resume(); });
+}
+
 AssetController& AssetController::GetInstance()
 {
 	static AssetController instance;
@@ -18,6 +40,11 @@ AssetController::AssetController()
 	}
 }
 
+AssetController::~AssetController()
+{
+	StopDecodeWorkers();
+}
+
 static AssetController::LoadMode ParseLoadModeFromJson(const JSON& j)
 {
 	if(j.isString())
@@ -53,6 +80,27 @@ static String ParseAssetFileNameFromJson(const JSON& entry)
 	return String();
 }
 
+// 効果音として SfxEngine で鳴らす指定があれば読み取る
+// {"path": "water_craw.mp3", "sfx": true, "maxPolyphony": 4, "priority": 1}
+static Optional<SfxOptions> ParseSfxOptionsFromJson(const JSON& entry)
+{
+	if((not entry.isObject()) || (not entry.hasElement(U"sfx")) || (not entry[U"sfx"].get<bool>()))
+	{
+		return none;
+	}
+
+	SfxOptions options;
+	if(entry.hasElement(U"maxPolyphony"))
+	{
+		options.max_polyphony = entry[U"maxPolyphony"].get<int32>();
+	}
+	if(entry.hasElement(U"priority"))
+	{
+		options.priority = entry[U"priority"].get<int32>();
+	}
+	return options;
+}
+
 void AssetController::PrepareAssets(const String& scene_name)
 {
 	// コンストラクタで読み込み失敗した場合は即時リターン
@@ -61,6 +109,11 @@ void AssetController::PrepareAssets(const String& scene_name)
 		return;
 	}
 
+	if((current_scene_name_ == scene_name) && (not registered_assets_.isEmpty()))
+	{
+		return;
+	}
+
 	if((not current_scene_name_.isEmpty()) && (current_scene_name_ != scene_name))
 	{
 		//先に古いシーンのアセットを解放する
@@ -69,6 +122,13 @@ void AssetController::PrepareAssets(const String& scene_name)
 
 	current_scene_name_ = scene_name;
 
+	// シーン完了通知を作り直す
+	scene_promise_ = std::promise<void>{};
+	scene_future_ = scene_promise_.get_future().share();
+	is_scene_resolved_ = false;
+
+	StartDecodeWorkers();
+
 	for(const auto& asset_type : asset_types_)
 	{
 		for(const auto& file_name_json : asset_json_[current_scene_name_][asset_type])
@@ -89,12 +149,27 @@ void AssetController::PrepareAssets(const String& scene_name)
 
 			const String asset_filepath = U"asset/" + asset_type + U"/" + asset_file_name;
 
-			if(FileSystem::Exists(asset_filepath))
+			if(not FileSystem::Exists(asset_filepath))
 			{
-				RegisterAndLoadAsset(asset_type, asset_filepath, mode);
+				continue;
 			}
+
+			// 効果音は AudioAsset ではなく SfxEngine のボイスで鳴らす
+			if(asset_type == U"Sound")
+			{
+				if(const auto sfx_options = ParseSfxOptionsFromJson(file_name_json.value))
+				{
+					RegisterSfxAsset(FileSystem::BaseName(asset_filepath), asset_filepath, *sfx_options);
+					continue;
+				}
+			}
+
+			RegisterAndLoadAsset(asset_type, asset_filepath, mode);
 		}
 	}
+
+	// 非同期アセットが無ければこの時点で完了
+	ResolveSceneIfComplete();
 }
 
 void AssetController::UnregisterAssets()
@@ -104,10 +179,26 @@ void AssetController::UnregisterAssets()
 		return;
 	}
 
-	// 非同期読み込みが終わるまで待つ
-	WaitUntilReady();
+	// 未着手のデコード要求は破棄し，実行中のものだけ終わるまで待つ
+	{
+		std::unique_lock lock{ decode_mutex_ };
+		decode_requests_.clear();
+		decoded_cv_.wait(lock, [&]() { return (in_flight_decodes_ == 0); });
+		decoded_keys_.clear();
+		has_decoded_.store(false, std::memory_order_relaxed);
+	}
+
+	// 待っていたコールバックは登録を解除したあとで呼ぶ（future は broken_promise になる）
+	// コールバックの中から PrepareAssets() されても安全なように先に取り外す
+	HashTable<String, std::unique_ptr<PendingAsset>> cancelled_assets;
+	cancelled_assets.swap(pending_assets_);
+
+	Array<ReadyCallback> scene_callbacks;
+	scene_callbacks.swap(scene_callbacks_);
+	is_scene_resolved_ = true;
 
 	// 登録したものだけを解除する
+	// （効果音のデータはオーディオスレッドが参照中かもしれないので SfxEngine が終了まで保持する）
 	for(const auto& item : registered_assets_)
 	{
 		const String& asset_type = item.first;
@@ -137,50 +228,359 @@ void AssetController::UnregisterAssets()
 	}
 
 	registered_assets_.clear();
+
+	for(auto& [key, pending] : cancelled_assets)
+	{
+		for(auto& callback : pending->callbacks)
+		{
+			callback();
+		}
+	}
+
+	for(auto& callback : scene_callbacks)
+	{
+		callback();
+	}
 }
 
-bool AssetController::IsSceneAssetsReady()
+bool AssetController::IsSceneAssetsReady() const
 {
-	// より読みやすく: pending_assets_ を走査して未完了のみを残す
-	Array<std::pair<String, String>> remaining;
-	remaining.reserve(pending_assets_.size());
+	return pending_assets_.empty();
+}
 
-	for(const auto& p : pending_assets_)
+Array<String> AssetController::GetPendingAssetNames(StringView asset_type) const
+{
+	Array<String> names;
+	for(const auto& [key, pending] : pending_assets_)
 	{
-		const String& type = p.first;
-		const String& baseName = p.second;
+		if(pending->type == asset_type)
+		{
+			names.push_back(pending->base_name);
+		}
+	}
+	return names;
+}
 
-		bool ready = true;
+bool AssetController::IsAssetReady(const String& asset_type, const String& asset_base_name) const
+{
+	if(pending_assets_.contains(MakeAssetKey(asset_type, asset_base_name)))
+	{
+		return false;
+	}
+	return registered_assets_.contains(std::pair<String, String>{ asset_type, asset_base_name });
+}
 
-		if(type == U"Texture")
+void AssetController::WaitUntilReady()
+{
+	while(not IsSceneAssetsReady())
+	{
 		{
-			ready = TextureAsset::IsReady(baseName);
+			// デコード完了の通知が来るまで眠る
+			std::unique_lock lock{ decode_mutex_ };
+			decoded_cv_.wait(lock, [&]() { return (not decoded_keys_.isEmpty()); });
 		}
-		else if(type == U"Sound")
+
+		DispatchReadyCallbacks();
+	}
+}
+
+bool AssetController::OnAssetReady(const String& asset_type, const String& asset_base_name, ReadyCallback callback)
+{
+	if(auto it = pending_assets_.find(MakeAssetKey(asset_type, asset_base_name)); it != pending_assets_.end())
+	{
+		it->second->callbacks.push_back(std::move(callback));
+		return true;
+	}
+
+	// 同期ロード済み・ロード完了済みなら即座に呼ぶ
+	if(IsAssetReady(asset_type, asset_base_name))
+	{
+		callback();
+		return true;
+	}
+
+	// 未登録のアセットは待っても完了しない
+	return false;
+}
+
+void AssetController::OnSceneReady(ReadyCallback callback)
+{
+	if(is_scene_resolved_)
+	{
+		callback();
+		return;
+	}
+
+	scene_callbacks_.push_back(std::move(callback));
+}
+
+std::shared_future<void> AssetController::GetAssetFuture(const String& asset_type, const String& asset_base_name) const
+{
+	if(auto it = pending_assets_.find(MakeAssetKey(asset_type, asset_base_name)); it != pending_assets_.end())
+	{
+		return it->second->future;
+	}
+
+	if(IsAssetReady(asset_type, asset_base_name))
+	{
+		std::promise<void> ready;
+		ready.set_value();
+		return ready.get_future().share();
+	}
+
+	return {};
+}
+
+std::shared_future<void> AssetController::GetSceneFuture() const
+{
+	return scene_future_;
+}
+
+AssetReadyAwaiter AssetController::WaitAsset(const String& asset_type, const String& asset_base_name)
+{
+	return AssetReadyAwaiter{ *this, asset_type, asset_base_name };
+}
+
+AssetReadyAwaiter AssetController::WaitScene()
+{
+	return AssetReadyAwaiter{ *this, String{}, String{} };
+}
+
+void AssetController::DispatchReadyCallbacks()
+{
+	// 何も完了していなければ atomic を読むだけで戻る
+	if(not has_decoded_.load(std::memory_order_acquire))
+	{
+		return;
+	}
+
+	Array<String> decoded_keys;
+	{
+		std::lock_guard lock{ decode_mutex_ };
+		decoded_keys.swap(decoded_keys_);
+		has_decoded_.store(false, std::memory_order_relaxed);
+	}
+
+	const TraceScope trace_scope{ U"AssetController::DispatchReadyCallbacks", U"asset" };
+
+	for(const auto& key : decoded_keys)
+	{
+		auto it = pending_assets_.find(key);
+		if(it == pending_assets_.end())
 		{
-			ready = AudioAsset::IsReady(baseName);
+			continue;
 		}
-		else if(type == U"Font")
+
+		// コールバック内から再登録されても安全なように先に取り外す
+		std::unique_ptr<PendingAsset> pending = std::move(it->second);
+		pending_assets_.erase(it);
+
+		FinalizeAsset(*pending);
+
+		for(auto& callback : pending->callbacks)
 		{
-			ready = FontAsset::IsReady(baseName);
+			callback();
 		}
+	}
+
+	ResolveSceneIfComplete();
+}
+
+void AssetController::FinalizeAsset(PendingAsset& pending)
+{
+	// GPU へのテクスチャ転送などはメインスレッドで行うので，ゲーム中に終わるとフレーム落ちの原因になりうる
+	const TraceScope trace_scope{ U"AssetController::FinalizeAsset", U"asset", pending.base_name };
+
+	// デコード前にアクセスされて空のデータで仮ロードされている可能性があるので，解放してから読み直す
+	if(pending.type == U"Texture")
+	{
+		TextureAsset::Release(pending.base_name);
+		TextureAsset::Load(pending.base_name);
+		pending.slot->image = Image{};
+	}
+	else if(pending.type == U"Sound")
+	{
+		AudioAsset::Release(pending.base_name);
+		AudioAsset::Load(pending.base_name);
+		pending.slot->wave = Wave{};
+	}
+	else if(pending.type == U"Sfx")
+	{
+		SfxEngine::GetInstance().SetSoundData(pending.base_name, std::move(pending.slot->wave));
+	}
+
+	// デコードしたデータは捨てたので，以後の読み直し（Release のあとの参照）はファイルから行う
+	pending.slot->is_decoded.store(false, std::memory_order_relaxed);
+	pending.slot->is_finalized.store(true, std::memory_order_release);
 
-		if(!ready)
+	pending.promise.set_value();
+}
+
+void AssetController::ResolveSceneIfComplete()
+{
+	if(is_scene_resolved_ || (not pending_assets_.empty()))
+	{
+		return;
+	}
+
+	is_scene_resolved_ = true;
+	scene_promise_.set_value();
+
+	Array<ReadyCallback> callbacks;
+	callbacks.swap(scene_callbacks_);
+	for(auto& callback : callbacks)
+	{
+		callback();
+	}
+}
+
+void AssetController::StartDecodeWorkers()
+{
+	if(not decode_workers_.empty())
+	{
+		return;
+	}
+
+	stop_workers_ = false;
+
+	const size_t worker_count = Clamp<size_t>(std::thread::hardware_concurrency(), 1, kMaxDecodeWorkers);
+	for(size_t i = 0; i < worker_count; ++i)
+	{
+		decode_workers_.emplace_back([this]() { DecodeWorkerLoop(); });
+	}
+}
+
+void AssetController::StopDecodeWorkers()
+{
+	{
+		std::lock_guard lock{ decode_mutex_ };
+		stop_workers_ = true;
+	}
+	request_cv_.notify_all();
+
+	for(auto& worker : decode_workers_)
+	{
+		worker.join();
+	}
+	decode_workers_.clear();
+}
+
+void AssetController::DecodeWorkerLoop()
+{
+	TraceRecorder::SetThreadName(U"AssetDecode");
+
+	for(;;)
+	{
+		DecodeRequest request;
 		{
-			remaining.push_back(p);
+			std::unique_lock lock{ decode_mutex_ };
+			request_cv_.wait(lock, [&]() { return (stop_workers_ || (not decode_requests_.empty())); });
+
+			if(stop_workers_)
+			{
+				return;
+			}
+
+			request = std::move(decode_requests_.front());
+			decode_requests_.pop_front();
+			++in_flight_decodes_;
 		}
+
+		// ファイル読み込みとデコードはワーカーで行う（GPU・オーディオ側の生成はメインスレッド）
+		{
+			const String file_name = FileSystem::FileName(request.path);
+			const TraceScope trace_scope{ U"AssetController::Decode", U"asset", file_name };
+
+			if(request.type == U"Texture")
+			{
+				request.slot->image = Image{ request.path };
+			}
+			else if((request.type == U"Sound") || (request.type == U"Sfx"))
+			{
+				request.slot->wave = Wave{ request.path };
+			}
+		}
+		request.slot->is_decoded.store(true, std::memory_order_release);
+
+		{
+			std::lock_guard lock{ decode_mutex_ };
+			--in_flight_decodes_;
+			decoded_keys_.push_back(request.key);
+			has_decoded_.store(true, std::memory_order_release);
+		}
+		decoded_cv_.notify_all();
 	}
+}
 
-	pending_assets_.swap(remaining);
-	return pending_assets_.isEmpty();
+String AssetController::MakeAssetKey(const String& asset_type, const String& asset_base_name)
+{
+	return (asset_type + U":" + asset_base_name);
 }
 
-void AssetController::WaitUntilReady()
+void AssetController::RegisterSfxAsset(const String& asset_base_name, const FilePath& asset_filepath, const SfxOptions& options)
+{
+	SfxEngine::GetInstance().Register(asset_base_name, options);
+
+	// データは SfxEngine が保持するので Siv3D のアセットには登録しない
+	RegisterAsyncAsset(U"Sfx", asset_base_name, asset_filepath);
+	registered_assets_.push_back({ U"Sfx", asset_base_name });
+}
+
+void AssetController::RegisterAsyncAsset(const String& asset_type, const String& asset_base_name, const FilePath& asset_filepath)
 {
-	while(!IsSceneAssetsReady())
+	auto pending = std::make_unique<PendingAsset>();
+	pending->type = asset_type;
+	pending->base_name = asset_base_name;
+	pending->path = asset_filepath;
+	pending->slot = std::make_shared<DecodeSlot>();
+	pending->future = pending->promise.get_future().share();
+
+	const std::shared_ptr<DecodeSlot> slot = pending->slot;
+
+	// デコード完了前に参照された場合は空のデータで仮ロードし，確定時に読み直す
+	if(asset_type == U"Texture")
+	{
+		auto data = std::make_unique<TextureAssetData>(asset_filepath);
+		data->onLoad = [slot, asset_filepath](TextureAssetData& asset, const String&)
+			{
+				if(slot->is_decoded.load(std::memory_order_acquire))
+				{
+					asset.texture = Texture{ slot->image };
+				}
+				else if(slot->is_finalized.load(std::memory_order_acquire))
+				{
+					asset.texture = Texture{ asset_filepath };
+				}
+				return true;
+			};
+		TextureAsset::Register(asset_base_name, std::move(data));
+	}
+	else if(asset_type == U"Sound")
+	{
+		auto data = std::make_unique<AudioAssetData>(asset_filepath);
+		data->onLoad = [slot, asset_filepath](AudioAssetData& asset, const String&)
+			{
+				if(slot->is_decoded.load(std::memory_order_acquire))
+				{
+					asset.audio = Audio{ slot->wave };
+				}
+				else if(slot->is_finalized.load(std::memory_order_acquire))
+				{
+					asset.audio = Audio{ asset_filepath };
+				}
+				return true;
+			};
+		AudioAsset::Register(asset_base_name, std::move(data));
+	}
+
+	const String key = MakeAssetKey(asset_type, asset_base_name);
 	{
-		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		std::lock_guard lock{ decode_mutex_ };
+		decode_requests_.push_back(DecodeRequest{ key, asset_type, asset_filepath, slot });
 	}
+	request_cv_.notify_one();
+
+	pending_assets_.emplace(key, std::move(pending));
 }
 
 void AssetController::RegisterAndLoadAsset(const String& asset_type, const String& asset_filepath, AssetController::LoadMode mode)
@@ -218,29 +618,20 @@ void AssetController::RegisterAndLoadAsset(const String& asset_type, const Strin
 
 		FontAsset::Register(asset_base_name, font_size, asset_filepath);
 
-		if(mode == AssetController::LoadMode::Async)
-		{
-			FontAsset::LoadAsync(asset_base_name);
-			pending_assets_.push_back({ asset_type, asset_base_name });
-		}
-		else
-		{
-			FontAsset::Load(asset_base_name);
-		}
+		// フォントはワーカーでデコードするデータが無いので常に同期ロード
+		FontAsset::Load(asset_base_name);
 
 		markRegistered(asset_type, asset_base_name);
 	}
 	else if(asset_type == U"Sound")
 	{
-		AudioAsset::Register(asset_base_name, asset_filepath);
-
 		if(mode == AssetController::LoadMode::Async)
 		{
-			AudioAsset::LoadAsync(asset_base_name);
-			pending_assets_.push_back({ asset_type, asset_base_name });
+			RegisterAsyncAsset(asset_type, asset_base_name, asset_filepath);
 		}
 		else
 		{
+			AudioAsset::Register(asset_base_name, asset_filepath);
 			AudioAsset::Load(asset_base_name);
 		}
 
@@ -248,15 +639,13 @@ void AssetController::RegisterAndLoadAsset(const String& asset_type, const Strin
 	}
 	else if(asset_type == U"Texture")
 	{
-		TextureAsset::Register(asset_base_name, asset_filepath);
-
 		if(mode == AssetController::LoadMode::Async)
 		{
-			TextureAsset::LoadAsync(asset_base_name);
-			pending_assets_.push_back({ asset_type, asset_base_name });
+			RegisterAsyncAsset(asset_type, asset_base_name, asset_filepath);
 		}
 		else
 		{
+			TextureAsset::Register(asset_base_name, asset_filepath);
 			TextureAsset::Load(asset_base_name);
 		}
 
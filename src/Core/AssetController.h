@@ -1,11 +1,38 @@
 ﻿#pragma once
 
+#include "../Audio/SfxEngine.h"
+
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <Siv3D.hpp>
 #include <thread>
 #include <utility>
 #include <vector>
 
+class AssetController;
+
+// 非同期ロード完了を co_await で待つための Awaitable
+// 再開は AssetController::DispatchReadyCallbacks() を呼んだスレッド（メインスレッド）で行われる
+// 未登録のアセットは待たずにそのまま進み，UnregisterAssets() で読み込みを取りやめたときも再開する
+// （再開後に使えるかどうかは IsAssetReady() で確かめる）
+struct AssetReadyAwaiter
+{
+	AssetController& controller;
+	String asset_type;		// 空ならシーン全体の完了を待つ
+	String asset_base_name;
+
+	bool await_ready() const;
+	bool await_suspend(std::coroutine_handle<> handle) const;
+	void await_resume() const noexcept {}
+};
+
 // アセットの読み込み，登録，登録解除を管理するクラス
 // シーンごとに必要なアセットをJSONファイルから読み込む
 class AssetController
@@ -13,6 +40,8 @@ class AssetController
 public:
 	static AssetController& GetInstance();
 
+	~AssetController();
+
 	// アセットのロードモード
 	enum class LoadMode
 	{
@@ -21,18 +50,49 @@ public:
 		Async // 非同期ロード
 	};
 
+	// ロード完了時に呼ばれるコールバック
+	using ReadyCallback = std::function<void()>;
+
 	// 指定されたシーン名に基づいてアセットを準備(登録・ロード)
+	// 同じシーンのアセットが登録済みなら何もしない（起動時に先に準備した場合など）
 	void PrepareAssets(const String& scene_name);
 
 	// 現在のシーンで登録されているアセットの登録をすべて解除
+	// 読み込みを待っているコールバックは，止まったままにならないように解除したあとで呼ぶ
 	void UnregisterAssets();
 
 	// 現在シーンの非同期読み込みが完了しているか
-	bool IsSceneAssetsReady();
+	bool IsSceneAssetsReady() const;
+
+	// 読み込み中のアセットの名前（asset_type は "Texture" / "Sound" / "Sfx"）
+	Array<String> GetPendingAssetNames(StringView asset_type) const;
+
+	// 指定アセットが登録済みでロードが完了しているか
+	bool IsAssetReady(const String& asset_type, const String& asset_base_name) const;
 
 	// 非同期読み込みが完了するまで待機する（ロード画面で使用）
 	void WaitUntilReady();
 
+	// 指定アセットのロード完了時に callback を呼ぶ
+	// 既に完了している場合はその場で呼ぶ．未完了なら DispatchReadyCallbacks() の中で呼ばれる
+	// 未登録のアセットは完了することがないので，callback を呼ばずに false を返す
+	bool OnAssetReady(const String& asset_type, const String& asset_base_name, ReadyCallback callback);
+
+	// 現在シーンの全アセットのロード完了時に callback を呼ぶ
+	void OnSceneReady(ReadyCallback callback);
+
+	// ロード完了で満たされる future（未登録のアセットは無効な future を返す）
+	std::shared_future<void> GetAssetFuture(const String& asset_type, const String& asset_base_name) const;
+	std::shared_future<void> GetSceneFuture() const;
+
+	// コルーチンから co_await で待つための Awaitable
+	AssetReadyAwaiter WaitAsset(const String& asset_type, const String& asset_base_name);
+	AssetReadyAwaiter WaitScene();
+
+	// ワーカースレッドで完了したデコード結果を確定させ，通知を配送する
+	// メインスレッドで毎フレーム呼ぶ（完了がなければ atomic を1回読むだけ）
+	void DispatchReadyCallbacks();
+
 	// コピーコンストラクタとコピー代入演算子を禁止
 	AssetController(const AssetController&) = delete;
 	AssetController& operator=(const AssetController&) = delete;
@@ -40,6 +100,29 @@ public:
 private:
 	AssetController();
 
+	// ワーカースレッドでデコードしたデータの受け渡し口
+	// 登録時の onLoad がここからデータを取り出してテクスチャ・オーディオを作る
+	// 確定したらデータは捨てるので，そのあと解放されてから参照されたときはファイルから読み直す
+	struct DecodeSlot
+	{
+		Image image;
+		Wave wave;
+		std::atomic<bool> is_decoded{ false };
+		std::atomic<bool> is_finalized{ false };
+	};
+
+	// 非同期ロード中のアセット
+	struct PendingAsset
+	{
+		String type;
+		String base_name;
+		FilePath path;
+		std::shared_ptr<DecodeSlot> slot;
+		std::promise<void> promise;
+		std::shared_future<void> future;
+		Array<ReadyCallback> callbacks;
+	};
+
 	// アセット情報を定義したJSONデータを保持
 	JSON asset_json_;
 
@@ -52,9 +135,57 @@ private:
 	// アセットの登録とロードを行うヘルパー関数
 	void RegisterAndLoadAsset(const String& asset_type, const String& asset_filepath, LoadMode mode);
 
+	// 効果音として SfxEngine に登録し，デコード要求をワーカーに積む
+	void RegisterSfxAsset(const String& asset_base_name, const FilePath& asset_filepath, const SfxOptions& options);
+
+	// 非同期ロード対象として登録し，デコード要求をワーカーに積む
+	void RegisterAsyncAsset(const String& asset_type, const String& asset_base_name, const FilePath& asset_filepath);
+
+	// デコード済みのアセットをメインスレッドで確定させる
+	void FinalizeAsset(PendingAsset& pending);
+
+	// 全アセット完了時の通知
+	void ResolveSceneIfComplete();
+
+	// デコード用ワーカースレッドの本体
+	void DecodeWorkerLoop();
+	void StartDecodeWorkers();
+	void StopDecodeWorkers();
+
+	static String MakeAssetKey(const String& asset_type, const String& asset_base_name);
+
 	// 実際に登録したアセットの一覧を保持して安全に解除できるようにする
 	Array<std::pair<String, String>> registered_assets_; // pair<type, baseName>
 
-	// 非同期ロード中のアセットを追跡する配列 pair<type, baseName>
-	Array<std::pair<String, String>> pending_assets_;
+	// 非同期ロード中のアセット（キーは "type:baseName"）
+	HashTable<String, std::unique_ptr<PendingAsset>> pending_assets_;
+
+	// シーン全体の完了通知
+	std::promise<void> scene_promise_;
+	std::shared_future<void> scene_future_;
+	Array<ReadyCallback> scene_callbacks_;
+	bool is_scene_resolved_ = true;
+
+	// ワーカーへのデコード要求（キーと読み込むパス，書き込み先）
+	struct DecodeRequest
+	{
+		String key;
+		String type;
+		FilePath path;
+		std::shared_ptr<DecodeSlot> slot;
+	};
+	std::deque<DecodeRequest> decode_requests_;
+
+	// デコードが完了したアセットのキー（メインスレッドで確定待ち）
+	Array<String> decoded_keys_;
+	std::atomic<bool> has_decoded_{ false };
+
+	std::mutex decode_mutex_;
+	std::condition_variable request_cv_;	// ワーカー待機用
+	std::condition_variable decoded_cv_;	// WaitUntilReady 用
+	size_t in_flight_decodes_ = 0;
+	bool stop_workers_ = false;
+	std::vector<std::thread> decode_workers_;
+
+	static constexpr size_t kMaxDecodeWorkers = 4;
 };
@@ -0,0 +1,376 @@
+﻿#include "AssetController.h"
+#include "BootLoader.h"
+#include "TraceRecorder.h"
+
+#include <Siv3D.hpp>
+
+#include <chrono>
+
+namespace
+{
+	StringView GetStepName(BootStep step)
+	{
+		switch(step)
+		{
+		case BootStep::Manifest:
+			return U"Manifest";
+		case BootStep::StageParse:
+			return U"StageParse";
+		case BootStep::TilesetDecode:
+			return U"TilesetDecode";
+		case BootStep::BgmOpen:
+			return U"BgmOpen";
+		case BootStep::AssetRegistration:
+			return U"AssetRegistration";
+		case BootStep::StageBuild:
+			return U"StageBuild";
+		case BootStep::TextureDecode:
+			return U"TextureDecode";
+		case BootStep::AudioDecode:
+			return U"AudioDecode";
+		case BootStep::SceneCreate:
+			return U"SceneCreate";
+		default:
+			return U"";
+		}
+	}
+
+	template<class Type>
+	bool IsFutureReady(const std::future<Type>& future)
+	{
+		return (future.valid() && (future.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready));
+	}
+
+	double ToMilliseconds(uint64 us)
+	{
+		return (static_cast<double>(us) / 1000.0);
+	}
+}
+
+BootLoader& BootLoader::GetInstance()
+{
+	static BootLoader instance;
+	return instance;
+}
+
+template<class Function>
+auto BootLoader::RunStepAsync(BootStep step, Function function)
+{
+	StepTiming& timing = GetTiming(step);
+	return std::async(std::launch::async, [&timing, step, function = std::move(function)]()
+	{
+		TraceRecorder::SetThreadName(U"Boot");
+
+		timing.start_us = TraceRecorder::NowMicroseconds();
+		auto result = function();
+		timing.end_us = TraceRecorder::NowMicroseconds();
+
+		TraceRecorder::Complete(GetStepName(step), U"boot", *timing.start_us, *timing.end_us);
+		return result;
+	});
+}
+
+void BootLoader::Start(const StageEntry& stage_entry, const FilePath& bgm_intro_path, const FilePath& bgm_loop_path)
+{
+	if(is_started_)
+	{
+		return;
+	}
+	is_started_ = true;
+
+	stage_entry_ = stage_entry;
+	bgm_intro_path_ = bgm_intro_path;
+	bgm_loop_path_ = bgm_loop_path;
+
+	// 4つとも互いに依存しないので，それぞれのスレッドで同時に読む
+	// GPU とオーディオのオブジェクトはメインスレッドで作るので，ここではファイルの読み込みとデコードだけ
+	manifest_future_ = RunStepAsync(BootStep::Manifest, []()
+	{
+		// コンストラクタで AssetInformation.json を読む
+		AssetController::GetInstance();
+		return true;
+	});
+
+	source_future_ = RunStepAsync(BootStep::StageParse, [entry = stage_entry_]()
+	{
+		return StageCatalog::CreateSource(entry);
+	});
+
+	tileset_future_ = RunStepAsync(BootStep::TilesetDecode, [path = stage_entry_.tileset_path]()
+	{
+		return Image{ path };
+	});
+
+	bgm_future_ = RunStepAsync(BootStep::BgmOpen, [intro_path = bgm_intro_path_, loop_path = bgm_loop_path_]()
+	{
+		// プールのスレッドなので，COM の初期化はこの段階の間だけにする
+		const MusicDecoderThreadScope decoder_thread_scope;
+
+		BgmResult result;
+		String error;
+		if(not intro_path.isEmpty())
+		{
+			result.intro = CreateMusicDecoder(intro_path, error);
+			if(not result.intro)
+			{
+				result.errors << error;
+			}
+		}
+
+		result.loop = CreateMusicDecoder(loop_path, error);
+		if(not result.loop)
+		{
+			result.errors << error;
+		}
+		return result;
+	});
+}
+
+void BootLoader::Update()
+{
+	if(not is_started_)
+	{
+		return;
+	}
+
+	// 読み込みに失敗した例外は get() でメインスレッドに投げ直される
+	if(IsFutureReady(manifest_future_))
+	{
+		manifest_future_.get();
+		MarkStepDone(BootStep::Manifest);
+		is_manifest_loaded_ = true;
+
+		BeginStep(BootStep::AssetRegistration);
+		AssetController::GetInstance().PrepareAssets(U"Game");
+		EndStep(BootStep::AssetRegistration);
+
+		EndStepOnAssetsReady(BootStep::TextureDecode, { U"Texture" });
+		EndStepOnAssetsReady(BootStep::AudioDecode, { U"Sound", U"Sfx" });
+	}
+
+	if(IsFutureReady(source_future_))
+	{
+		stage_source_ = source_future_.get();
+		MarkStepDone(BootStep::StageParse);
+	}
+
+	if(IsFutureReady(tileset_future_))
+	{
+		tileset_image_ = tileset_future_.get();
+		MarkStepDone(BootStep::TilesetDecode);
+	}
+
+	if(IsStepDone(BootStep::StageParse) && IsStepDone(BootStep::TilesetDecode) && (not IsStepDone(BootStep::StageBuild)))
+	{
+		BeginStep(BootStep::StageBuild);
+		stage_.emplace(std::move(stage_source_), Texture{ tileset_image_ });
+		tileset_image_.release();
+		EndStep(BootStep::StageBuild);
+	}
+
+	if(IsFutureReady(bgm_future_))
+	{
+		bgm_ = bgm_future_.get();
+		MarkStepDone(BootStep::BgmOpen);
+
+		for(const String& error : bgm_->errors)
+		{
+			Print << error;
+		}
+	}
+}
+
+bool BootLoader::IsReady() const
+{
+	for(size_t i = 0; i < static_cast<size_t>(BootStep::SceneCreate); ++i)
+	{
+		if(not is_step_done_[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+double BootLoader::GetProgress() const
+{
+	const size_t step_count = static_cast<size_t>(BootStep::SceneCreate);
+
+	size_t done_count = 0;
+	for(size_t i = 0; i < step_count; ++i)
+	{
+		if(is_step_done_[i])
+		{
+			++done_count;
+		}
+	}
+	return (static_cast<double>(done_count) / step_count);
+}
+
+Stage BootLoader::TakeStage(const StageEntry& stage_entry)
+{
+	if(stage_ && (stage_entry.json_path == stage_entry_.json_path))
+	{
+		Stage stage = std::move(*stage_);
+		stage_.reset();
+		return stage;
+	}
+
+	return StageCatalog::CreateStage(stage_entry);
+}
+
+std::pair<std::unique_ptr<IMusicDecoder>, std::unique_ptr<IMusicDecoder>> BootLoader::TakeBgmDecoders(const FilePath& intro_path, const FilePath& loop_path)
+{
+	if(bgm_ && (intro_path == bgm_intro_path_) && (loop_path == bgm_loop_path_))
+	{
+		std::pair<std::unique_ptr<IMusicDecoder>, std::unique_ptr<IMusicDecoder>> decoders{ std::move(bgm_->intro), std::move(bgm_->loop) };
+		bgm_.reset();
+		return decoders;
+	}
+
+	// メインスレッドなので，開けなかったときはその場で出す
+	String error;
+	std::unique_ptr<IMusicDecoder> intro;
+	if(not intro_path.isEmpty())
+	{
+		intro = CreateMusicDecoder(intro_path, error);
+		if(not intro)
+		{
+			Print << error;
+		}
+	}
+
+	std::unique_ptr<IMusicDecoder> loop = CreateMusicDecoder(loop_path, error);
+	if(not loop)
+	{
+		Print << error;
+	}
+	return { std::move(intro), std::move(loop) };
+}
+
+void BootLoader::BeginStep(BootStep step)
+{
+	if(IsStepDone(step))
+	{
+		return;
+	}
+	GetTiming(step).start_us = TraceRecorder::NowMicroseconds();
+}
+
+void BootLoader::EndStep(BootStep step)
+{
+	StepTiming& timing = GetTiming(step);
+	if(IsStepDone(step) || (not timing.start_us))
+	{
+		return;
+	}
+
+	timing.end_us = TraceRecorder::NowMicroseconds();
+	MarkStepDone(step);
+
+	TraceRecorder::Complete(GetStepName(step), U"boot", *timing.start_us, *timing.end_us);
+}
+
+void BootLoader::MarkFirstInteractiveFrame()
+{
+	if(is_reported_ || (not is_started_))
+	{
+		return;
+	}
+	is_reported_ = true;
+
+	const uint64 interactive_us = TraceRecorder::NowMicroseconds();
+	TraceRecorder::Instant(U"FirstInteractiveFrame", U"boot");
+
+	Console << U"BootLoader: 起動の内訳（プロセスの開始からの ms）";
+	for(size_t i = 0; i < timings_.size(); ++i)
+	{
+		const StepTiming& timing = timings_[i];
+		if((not timing.start_us) || (not timing.end_us))
+		{
+			continue;
+		}
+
+		Console << U"  {:<18} {:8.1f} → {:8.1f}（{:.1f}）"_fmt(GetStepName(static_cast<BootStep>(i)),
+			ToMilliseconds(*timing.start_us), ToMilliseconds(*timing.end_us), ToMilliseconds(*timing.end_us - *timing.start_us));
+	}
+	Console << U"BootLoader: 最初に操作を受け付けたフレームまで {:.1f} ms"_fmt(ToMilliseconds(interactive_us));
+
+	WriteReport(interactive_us);
+}
+
+void BootLoader::Shutdown()
+{
+	// 読み込み中に閉じられたときは，ワーカーが終わるのを待ってから捨てる（future のデストラクタが待つ）
+	manifest_future_ = {};
+	source_future_ = {};
+	tileset_future_ = {};
+	bgm_future_ = {};
+
+	stage_.reset();
+	bgm_.reset();
+	stage_source_.reset();
+	tileset_image_.release();
+}
+
+void BootLoader::EndStepOnAssetsReady(BootStep step, std::initializer_list<StringView> asset_types)
+{
+	// デコードは登録したときにワーカーに積まれて始まる
+	GetTiming(step).start_us = GetTiming(BootStep::AssetRegistration).start_us;
+
+	AssetController& assets = AssetController::GetInstance();
+	size_t& remaining_count = remaining_asset_counts_[static_cast<size_t>(step)];
+
+	for(const StringView asset_type : asset_types)
+	{
+		const String type{ asset_type };
+		for(const String& name : assets.GetPendingAssetNames(asset_type))
+		{
+			// 完了は DispatchReadyCallbacks() の中で通知される
+			if(assets.OnAssetReady(type, name, [this, step]()
+				{
+					if(--remaining_asset_counts_[static_cast<size_t>(step)] == 0)
+					{
+						EndStep(step);
+					}
+				}))
+			{
+				++remaining_count;
+			}
+		}
+	}
+
+	if(remaining_count == 0)
+	{
+		EndStep(step);
+	}
+}
+
+void BootLoader::WriteReport(uint64 interactive_us) const
+{
+	// リリースごとに比べられるように，1回の起動を1行として追記する
+	const bool has_header = FileSystem::Exists(kReportPath);
+
+	TextWriter writer{ kReportPath, OpenMode::Append };
+	if(not writer)
+	{
+		return;
+	}
+
+	if(not has_header)
+	{
+		String header = U"date,stage";
+		for(size_t i = 0; i < timings_.size(); ++i)
+		{
+			header += U",{}_ms"_fmt(GetStepName(static_cast<BootStep>(i)));
+		}
+		writer.writeln(header + U",interactive_ms");
+	}
+
+	String line = U"{},{}"_fmt(DateTime::Now().format(U"yyyy-MM-dd HH:mm:ss"), stage_entry_.name);
+	for(const StepTiming& timing : timings_)
+	{
+		line += ((timing.start_us && timing.end_us) ? U",{:.1f}"_fmt(ToMilliseconds(*timing.end_us - *timing.start_us)) : String{ U"," });
+	}
+	writer.writeln(line + U",{:.1f}"_fmt(ToMilliseconds(interactive_us)));
+}
@@ -0,0 +1,139 @@
+﻿#pragma once
+
+#include "../Audio/MusicDecoder.h"
+#include "../World/Stage.h"
+#include "../World/StageCatalog.h"
+
+#include <Siv3D.hpp>
+
+#include <array>
+#include <future>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+
+// 起動時の読み込みの段階
+enum class BootStep : uint8
+{
+	Manifest,			// AssetInformation.json（ワーカー）
+	StageParse,			// ステージのマップ（ワーカー）
+	TilesetDecode,		// タイルセットの画像（ワーカー）
+	BgmOpen,			// BGM のデコーダー（ワーカー）
+	AssetRegistration,	// アセットの登録（メインスレッド）
+	StageBuild,			// タイルセットのテクスチャと先頭の区間（メインスレッド）
+	TextureDecode,		// テクスチャのデコード（AssetController のワーカー）
+	AudioDecode,		// 音声のデコード（AssetController のワーカー）
+	SceneCreate,		// GameScene の初期化（メインスレッド）
+	Count,
+};
+
+// 起動時の読み込みを段階に分け，ワーカースレッドで並行に進める
+// LoadingScene が毎フレーム Update() を呼び，全部終わったら GameScene に切り替える
+// GameScene は読み込んだステージと BGM のデコーダーを Take〜() で受け取る
+//
+// 段階ごとの時刻を記録し，GameScene が最初に操作を受け付けたフレームで
+// プロセスの開始からの時間（time-to-first-interactive-frame）と一緒に Console と kReportPath に書き出す
+// 時刻は TraceRecorder と同じ基準なので，--trace を付ければ各段階がトレースにも出る
+class BootLoader
+{
+public:
+	struct StepTiming
+	{
+		Optional<uint64> start_us;
+		Optional<uint64> end_us;
+	};
+
+	static BootLoader& GetInstance();
+
+	// ワーカーでの読み込みを始める
+	void Start(const StageEntry& stage_entry, const FilePath& bgm_intro_path, const FilePath& bgm_loop_path);
+
+	// ワーカーの結果を受け取り，メインスレッドの段階を進める（読み込み中は毎フレーム呼ぶ）
+	void Update();
+
+	// GameScene に切り替えてよいか
+	bool IsReady() const;
+
+	// 終わった段階の割合（0.0 ～ 1.0．SceneCreate は含めない）
+	double GetProgress() const;
+
+	// AssetController を作り終えたか（作っている間にメインスレッドから触ると，終わるまで待たされる）
+	bool IsManifestLoaded() const { return is_manifest_loaded_; }
+
+	// 起動時に読んだステージがあれば渡す．無ければ（選択が変わった，2回目以降など）その場で作る
+	Stage TakeStage(const StageEntry& stage_entry);
+
+	// 起動時に開いた BGM のデコーダーがあれば渡す．無ければその場で開く
+	std::pair<std::unique_ptr<IMusicDecoder>, std::unique_ptr<IMusicDecoder>> TakeBgmDecoders(const FilePath& intro_path, const FilePath& loop_path);
+
+	// メインスレッドで行う段階の前後に呼ぶ
+	void BeginStep(BootStep step);
+	void EndStep(BootStep step);
+
+	// GameScene が最初に操作を受け付けたフレームで呼ぶ．1回目だけ結果を書き出す
+	void MarkFirstInteractiveFrame();
+
+	// Siv3D のエンジンが終了する前に呼ぶ（受け取られなかったテクスチャなどを捨てる）
+	void Shutdown();
+
+	BootLoader(const BootLoader&) = delete;
+	BootLoader& operator=(const BootLoader&) = delete;
+
+private:
+	BootLoader() = default;
+
+	// ワーカーで開く BGM のデコーダー
+	struct BgmResult
+	{
+		std::unique_ptr<IMusicDecoder> intro;
+		std::unique_ptr<IMusicDecoder> loop;
+
+		// 開けなかったファイル（Print はメインスレッドでしか使えないので，受け取ったときに出す）
+		Array<String> errors;
+	};
+
+	// step の時刻を記録しながら function をワーカーで実行する
+	template<class Function>
+	auto RunStepAsync(BootStep step, Function function);
+
+	StepTiming& GetTiming(BootStep step) { return timings_[static_cast<size_t>(step)]; }
+	bool IsStepDone(BootStep step) const { return is_step_done_[static_cast<size_t>(step)]; }
+
+	// ワーカーの段階は，メインスレッドで結果を受け取ったときに終わったことにする
+	void MarkStepDone(BootStep step) { is_step_done_[static_cast<size_t>(step)] = true; }
+
+	// asset_types のアセットがすべてデコードされたら step を終える（AssetController の完了通知で進める）
+	void EndStepOnAssetsReady(BootStep step, std::initializer_list<StringView> asset_types);
+
+	void WriteReport(uint64 interactive_us) const;
+
+	static constexpr StringView kReportPath = U"profile/boot_times.csv";
+
+	// ワーカーの段階の時刻はワーカーが書くので，結果を受け取るまで読まない
+	std::array<StepTiming, static_cast<size_t>(BootStep::Count)> timings_;
+	std::array<bool, static_cast<size_t>(BootStep::Count)> is_step_done_ = {};
+
+	// デコードの段階で，完了の通知を待っているアセットの数
+	std::array<size_t, static_cast<size_t>(BootStep::Count)> remaining_asset_counts_ = {};
+
+	StageEntry stage_entry_;
+	FilePath bgm_intro_path_;
+	FilePath bgm_loop_path_;
+
+	std::future<bool> manifest_future_;
+	std::future<std::unique_ptr<StageSegmentSource>> source_future_;
+	std::future<Image> tileset_future_;
+	std::future<BgmResult> bgm_future_;
+
+	// ステージを組み立てるまで持っておく
+	std::unique_ptr<StageSegmentSource> stage_source_;
+	Image tileset_image_;
+
+	bool is_started_ = false;
+	bool is_manifest_loaded_ = false;
+	bool is_reported_ = false;
+
+	// メインスレッドで組み立てたステージと，受け取った BGM（GameScene が取り出すまで持つ）
+	Optional<Stage> stage_;
+	Optional<BgmResult> bgm_;
+};
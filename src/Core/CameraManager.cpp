@@ -10,12 +10,12 @@ CameraManager::CameraManager(double fixed_world_x, const Size& view_size)
 	, target_y_(300.0)
 	, current_y_(target_y_ + y_offset_)
 {
-	camera_.setCenter(Vec2{ fixed_world_x_, current_y_ });
 }
 
-void CameraManager::SetTargetY(double target_y)
+void CameraManager::SetTargetY(double target_y, double target_velocity_y)
 {
 	target_y_ = target_y;
+	target_velocity_y_ = target_velocity_y;
 }
 
 void CameraManager::SetYOffsetRatio(double ratio)
@@ -24,21 +24,30 @@ void CameraManager::SetYOffsetRatio(double ratio)
 }
 
 // カメラ中心の目標Yを計算
-double CameraManager::ComputeGoalY() const
+double CameraManager::ComputeGoalY(double target_y, double target_velocity_y) const
 {
-	return target_y_ + y_offset_;
+	// 速く動いているほど進行方向を広く映す（画面端に追いやられないように）
+	const double look_ahead = Clamp(target_velocity_y * kLookAheadTime, -kMaxLookAhead, kMaxLookAhead);
+	return target_y + y_offset_ + look_ahead;
 }
 
-// 補間ヘルパー（線形補間）
-double CameraManager::SmoothTo(double current, double goal, double factor) const
+// 臨界減衰ばね（Game Programming Gems 4 "Critically Damped Ease-In/Ease-Out Smoothing" の近似式）
+void CameraManager::SmoothDamp(double& position, double& velocity, double goal, double delta_time)
 {
-	return Math::Lerp(current, goal, factor);
+	const double omega = 2.0 / kSmoothTime;
+	const double x = omega * delta_time;
+	const double decay = 1.0 / (1.0 + x + 0.48 * x * x + 0.235 * x * x * x);
+
+	const double change = position - goal;
+	const double temp = (velocity + omega * change) * delta_time;
+	velocity = (velocity - omega * temp) * decay;
+	position = goal + (change + temp) * decay;
 }
 
 // カメラ中心座標を計算
-Vec2 CameraManager::ComputeCameraCenter() const
+Vec2 CameraManager::ComputeCameraCenter(double center_y) const
 {
-	return Vec2{ fixed_world_x_, current_y_ };
+	return Vec2{ fixed_world_x_, center_y };
 }
 
 Vec2 CameraManager::HalfViewSize() const
@@ -46,25 +55,48 @@ Vec2 CameraManager::HalfViewSize() const
 	return (view_size_ / 2.0);
 }
 
-void CameraManager::Update()
+void CameraManager::Update(double delta_time)
 {
-	// 目標Yを計算し、現在値を滑らかに更新
-	const double goal_y = ComputeGoalY();
-	current_y_ = SmoothTo(current_y_, goal_y, 0.05);
+	// 目標Yを計算し、経過時間に応じて現在値を更新
+	const double goal_y = ComputeGoalY(target_y_, target_velocity_y_);
+	SmoothDamp(current_y_, current_velocity_y_, goal_y, delta_time);
+}
 
-	// カメラに適用
-	camera_.setCenter(ComputeCameraCenter());
-	camera_.update();
+void CameraManager::SnapToTarget()
+{
+	current_y_ = ComputeGoalY(target_y_, 0.0);
+	current_velocity_y_ = 0.0;
 }
 
 Vec2 CameraManager::GetCameraOffset() const
 {
 	// 中心 - ビュー半分 = 左上のワールド座標
-	const Vec2 center = ComputeCameraCenter();
-	return (center - HalfViewSize());
+	// 描画側でそれぞれ丸めなくて済むよう，ここで一度だけピクセル境界にそろえる
+	const Vec2 center = ComputeCameraCenter(current_y_);
+	return s3d::Floor(center - HalfViewSize());
 }
 
 RectF CameraManager::GetViewRect() const
 {
 	return RectF{ GetCameraOffset(), view_size_ };
 }
+
+RectF CameraManager::GetPredictedViewRect(int32 frames, double frame_time) const
+{
+	// 実際の更新と同じ計算を進めて，通過するY座標の範囲を求める
+	double y = current_y_;
+	double velocity = current_velocity_y_;
+	double min_y = y;
+	double max_y = y;
+
+	for(int32 i = 0; i < frames; ++i)
+	{
+		const double target_y = target_y_ + target_velocity_y_ * frame_time * (i + 1);
+		SmoothDamp(y, velocity, ComputeGoalY(target_y, target_velocity_y_), frame_time);
+		min_y = Min(min_y, y);
+		max_y = Max(max_y, y);
+	}
+
+	const Vec2 half = HalfViewSize();
+	return RectF{ fixed_world_x_ - half.x, min_y - half.y, view_size_.x, (max_y - min_y) + view_size_.y };
+}
@@ -1,44 +1,63 @@
 ﻿#pragma once
 # include <Siv3D.hpp>
 
+// プレイヤーを縦方向に追いかけるカメラ
+// 臨界減衰のばね（オーバーシュートしない）で時間ベースに追従するので，フレームレートによって挙動が変わらない
+// 位置の計算だけで Siv3D のグラフィックスには触らないので，ワーカースレッドの GameWorld からも使える
 class CameraManager
 {
 public:
 	CameraManager(double fixed_world_x, const Size& view_size);
 
-	void SetTargetY(double target_y);
+	// 追従対象のY座標と，その速度[px/秒]（速度の向きに先読みする）
+	void SetTargetY(double target_y, double target_velocity_y = 0.0);
 
 	// カメラのY軸オフセット比率を変更する
 	// (例: 1.0/6.0 = 上1/3, -1.0/6.0 = 下1/3)
 	void SetYOffsetRatio(double ratio);
 
-	void Update();
+	// delta_time[秒] だけ時間を進める
+	void Update(double delta_time);
+
+	// 追いかけずに，すぐに目標の位置へ移す（中断セーブから再開したときなど）
+	void SnapToTarget();
+	// 画面左上のワールド座標（整数にそろえてある）
 	Vec2 GetCameraOffset() const;
 	RectF GetViewRect() const;
 
-private:
-	Camera2D camera_{ Vec2::Zero(), 1.0, Camera2DParameters::NoControl() };
+	// 今から frames フレーム先まで（1フレーム frame_time 秒）にカメラが映す範囲をすべて含む矩形
+	// 対象が今の速度で動き続けると仮定して予測する．ステージやアセットの先読みに使う
+	RectF GetPredictedViewRect(int32 frames, double frame_time) const;
 
+private:
 	// 固定するX座標と，Y軸のオフセット値
 	double fixed_world_x_;
 	double y_offset_;
 
 	Size view_size_;
 
-	// ターゲットのY座標と，現在のカメラのY座標
+	// ターゲットのY座標と速度，現在のカメラのY座標と速度
 	double target_y_ = 0.0;
+	double target_velocity_y_ = 0.0;
 	double current_y_ = 0.0;
+	double current_velocity_y_ = 0.0;
 
-	// カメラ中心の目標Yを計算する（target_y_ + y_offset_）
-	double ComputeGoalY() const;
+	// 追従にかかるおおよその時間[秒]（以前の 1フレーム 0.05 の線形補間(60fps)に近い値）
+	static constexpr double kSmoothTime = 0.3;
 
-	// 現在値を目標に滑らかに補間する
-	double SmoothTo(double current, double goal, double factor) const;
+	// 何秒先まで先読みするかと，その上限[px]
+	static constexpr double kLookAheadTime = 0.25;
+	static constexpr double kMaxLookAhead = 160.0;
+
+	// カメラ中心の目標Yを計算する（target_y + y_offset_ + 先読み）
+	double ComputeGoalY(double target_y, double target_velocity_y) const;
+
+	// 臨界減衰ばねで現在値を目標に近づける（position, velocity を更新する）
+	static void SmoothDamp(double& position, double& velocity, double goal, double delta_time);
 
 	// カメラ中心座標を作成する
-	Vec2 ComputeCameraCenter() const;
+	Vec2 ComputeCameraCenter(double center_y) const;
 
 	// ビューサイズの半分を返す（オフセット計算に使用）
 	Vec2 HalfViewSize() const;
 };
-
@@ -10,6 +10,7 @@ enum class SceneID : int8
 {
 	kTitle = 0,
 	kGame,
+	kLoading,
 };
 using App = s3d::SceneManager<SceneID>;
 
@@ -20,3 +21,11 @@ const InputGroup kInputRight{ KeyRight, KeyD };
 const InputGroup kInputUp{ KeyUp, KeyW };
 const InputGroup kInputDown{ KeyDown, KeyS };
 const InputGroup kInputAction1{ KeySpace };
+const InputGroup kInputDumpTrace{ KeyF9 };
+const InputGroup kInputRewind{ KeyR, KeyBackspace };
+const InputGroup kInputQuickSave{ KeyF5 };
+const InputGroup kInputQuickLoad{ KeyF8 };
+const InputGroup kInputPause{ KeyP };
+const InputGroup kInputSlowDown{ KeyF6 };
+const InputGroup kInputSpeedUp{ KeyF7 };
+const InputGroup kInputToggleStats{ KeyF3 };
@@ -0,0 +1,140 @@
+﻿#pragma once
+
+#include <Siv3D.hpp>
+
+#include <compare>
+#include <limits>
+
+// 小数部 12 ビットの固定小数点数（1 = 4096）
+// 整数の加減乗除だけで計算するので，コンパイラや最適化の設定（FMA の使用など）が違っても結果がビット単位で一致する
+// 表せる範囲は ±524288 程度．座標に使うときは Physics::kMaxFixedCoordinate までにする
+struct Fixed
+{
+	static constexpr int32 kFractionBits = 12;
+	static constexpr int32 kOne = (1 << kFractionBits);
+
+	int32 raw = 0;
+
+	constexpr Fixed() = default;
+
+	// 一番近い値に丸める（2の累乗を掛けるだけなので，double の計算でも環境によって結果は変わらない）
+	explicit constexpr Fixed(double value)
+		: raw{ static_cast<int32>((value * kOne) + ((value < 0.0) ? -0.5 : 0.5)) }
+	{
+	}
+
+	explicit constexpr Fixed(int32 value)
+		: raw{ value * kOne }
+	{
+	}
+
+	static constexpr Fixed FromRaw(int32 raw_value)
+	{
+		Fixed result;
+		result.raw = raw_value;
+		return result;
+	}
+
+	// 表示や描画に渡すとき用（シミュレーションの中では使わない）
+	constexpr double ToDouble() const { return (static_cast<double>(raw) / kOne); }
+
+	constexpr Fixed operator-() const { return FromRaw(-raw); }
+
+	constexpr Fixed operator+(Fixed other) const { return FromRaw(raw + other.raw); }
+	constexpr Fixed operator-(Fixed other) const { return FromRaw(raw - other.raw); }
+
+	// 乗算と除算は 0 に向かって切り捨てる（移動量を掛けたときに，正確な値より遠くへは進まない）
+	constexpr Fixed operator*(Fixed other) const { return FromRaw(static_cast<int32>((static_cast<int64>(raw) * other.raw) / kOne)); }
+	constexpr Fixed operator/(Fixed other) const { return FromRaw(static_cast<int32>((static_cast<int64>(raw) * kOne) / other.raw)); }
+
+	constexpr Fixed operator*(int32 scale) const { return FromRaw(raw * scale); }
+
+	constexpr Fixed& operator+=(Fixed other) { raw += other.raw; return *this; }
+	constexpr Fixed& operator-=(Fixed other) { raw -= other.raw; return *this; }
+	constexpr Fixed& operator*=(Fixed other) { *this = (*this * other); return *this; }
+
+	constexpr auto operator<=>(const Fixed&) const = default;
+};
+
+constexpr Fixed Abs(Fixed value) { return ((value.raw < 0) ? -value : value); }
+
+struct FixedVec2
+{
+	Fixed x;
+	Fixed y;
+
+	constexpr FixedVec2() = default;
+
+	constexpr FixedVec2(Fixed fixed_x, Fixed fixed_y)
+		: x{ fixed_x }, y{ fixed_y }
+	{
+	}
+
+	explicit constexpr FixedVec2(const Vec2& value)
+		: x{ value.x }, y{ value.y }
+	{
+	}
+
+	static constexpr FixedVec2 Zero() { return FixedVec2{}; }
+
+	constexpr bool isZero() const { return ((x.raw == 0) && (y.raw == 0)); }
+
+	constexpr Vec2 ToVec2() const { return Vec2{ x.ToDouble(), y.ToDouble() }; }
+
+	constexpr FixedVec2 operator+(const FixedVec2& other) const { return FixedVec2{ (x + other.x), (y + other.y) }; }
+	constexpr FixedVec2 operator-(const FixedVec2& other) const { return FixedVec2{ (x - other.x), (y - other.y) }; }
+	constexpr FixedVec2 operator*(Fixed scale) const { return FixedVec2{ (x * scale), (y * scale) }; }
+
+	constexpr FixedVec2& operator+=(const FixedVec2& other) { x += other.x; y += other.y; return *this; }
+	constexpr FixedVec2& operator*=(Fixed scale) { x *= scale; y *= scale; return *this; }
+
+	constexpr bool operator==(const FixedVec2&) const = default;
+};
+
+// プレイヤーと敵の位置・速度に使う型
+// BNS_FIXED_POINT_PHYSICS を定義してビルドすると固定小数点になり，リプレイやビルド構成間の比較で結果が一致する
+// どちらの型でも同じコードで書けるように，下の関数をそろえてある
+#ifdef BNS_FIXED_POINT_PHYSICS
+using PhysicsScalar = Fixed;
+using PhysicsVec2 = FixedVec2;
+#else
+using PhysicsScalar = double;
+using PhysicsVec2 = Vec2;
+#endif
+
+namespace Physics
+{
+	constexpr double ToDouble(double value) { return value; }
+	constexpr double ToDouble(Fixed value) { return value.ToDouble(); }
+
+	constexpr Vec2 ToVec2(const Vec2& value) { return value; }
+	constexpr Vec2 ToVec2(const FixedVec2& value) { return value.ToVec2(); }
+
+	// ワールド座標（double）から PhysicsVec2 にする（配置やリスポーンのときだけ使う）
+	constexpr PhysicsVec2 FromVec2(const Vec2& value) { return PhysicsVec2{ value }; }
+
+	// value を含むタイルの番号
+	inline int32 ToTile(double value, int32 tile_size) { return static_cast<int32>(Math::Floor(value / tile_size)); }
+	constexpr int32 ToTile(Fixed value, int32 tile_size)
+	{
+		const int32 tile_raw = (tile_size * Fixed::kOne);
+		const int32 quotient = (value.raw / tile_raw);
+		return (((value.raw % tile_raw) < 0) ? (quotient - 1) : quotient);
+	}
+
+	// 固定小数点の座標に使える最大の値[px]（Fixed の範囲の半分．移動量や箱の大きさを足しても溢れない）
+	// 固定小数点のビルドでは，Stage がステージの行数をこの深さまでに抑える（終わりのないステージもそこで終わる）
+	inline constexpr double kMaxFixedCoordinate = 262144.0;
+
+	// 固定小数点の座標で表せるタイルの行数
+	constexpr int32 GetMaxFixedTileRows(int32 tile_size) { return static_cast<int32>(kMaxFixedCoordinate / tile_size); }
+
+	// 1回の更新で speed 進むとき，distance 進むまでの更新回数
+	// 固定小数点では整数回に切り上げる（その間に行き過ぎる分は呼び出し側で止める）
+	constexpr double TimeToTravel(double distance, double speed) { return (distance / speed); }
+	constexpr double TimeToTravel(Fixed distance, Fixed speed) { return static_cast<double>((static_cast<int64>(distance.raw) + speed.raw - 1) / speed.raw); }
+
+	// 1回の更新で speed 進むとき，elapsed 回の更新で進む距離
+	constexpr double Travel(double speed, double elapsed) { return (speed * elapsed); }
+	constexpr Fixed Travel(Fixed speed, double elapsed) { return Fixed::FromRaw(static_cast<int32>(Min(static_cast<int64>(speed.raw) * static_cast<int64>(elapsed), static_cast<int64>(std::numeric_limits<int32>::max())))); }
+}
@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include "Config.h"
+
+#include <Siv3D.hpp>
+
+// シミュレーションの1ティック分の入力
+// 普段はキーボードから読み，ターボモードでは入力スクリプトから読む（TurboRunner）
+struct GameInput
+{
+	bool left = false;		// 左に移動（押している間）
+	bool right = false;		// 右に移動（押している間）
+	bool swim = false;		// 泳ぐ（押した瞬間）
+	bool ok = false;		// 決定（押した瞬間）
+	bool rewind = false;	// 巻き戻し（押している間）
+
+	// 今のフレームのキーボードの状態
+	static GameInput FromKeyboard()
+	{
+		GameInput input;
+		input.left = kInputLeft.pressed();
+		input.right = kInputRight.pressed();
+		input.swim = kInputAction1.down();
+		input.ok = (kInputOK.down() || KeyEnter.down());
+		input.rewind = kInputRewind.pressed();
+		return input;
+	}
+
+	// 押した瞬間の入力を除いたもの（1フレームに複数ティック進めるとき，2ティック目以降に使う）
+	GameInput WithoutEdges() const
+	{
+		GameInput input = *this;
+		input.swim = false;
+		input.ok = false;
+		return input;
+	}
+
+	// pending の押した瞬間の入力も足したもの（ティックを進めなかったフレームで押された分を，次のフレームに持ち越すとき）
+	GameInput WithEdgesFrom(const GameInput& pending) const
+	{
+		GameInput input = *this;
+		input.swim = (swim || pending.swim);
+		input.ok = (ok || pending.ok);
+		return input;
+	}
+
+	bool HasEdges() const { return (swim || ok); }
+
+	bool operator==(const GameInput&) const = default;
+};
@@ -0,0 +1,159 @@
+﻿#include "JobSystem.h"
+
+#include <Siv3D.hpp>
+
+JobSystem& JobSystem::GetInstance()
+{
+	static JobSystem instance;
+	return instance;
+}
+
+JobSystem::JobSystem()
+{
+	const size_t hardware_threads = Max<size_t>(1, std::thread::hardware_concurrency());
+	const size_t worker_count = Min(hardware_threads, kMaxWorkers);
+
+	// 0番は ParallelFor を呼んだスレッドが使う
+	for(size_t i = 0; i < worker_count; ++i)
+	{
+		queues_.push_back(std::make_unique<WorkQueue>());
+	}
+	for(size_t i = 1; i < worker_count; ++i)
+	{
+		workers_.emplace_back([this, i]() { WorkerLoop(i); });
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard lock{ wake_mutex_ };
+		stop_workers_ = true;
+	}
+	wake_cv_.notify_all();
+
+	for(auto& worker : workers_)
+	{
+		if(worker.joinable())
+		{
+			worker.join();
+		}
+	}
+}
+
+size_t JobSystem::GetChunkCount(size_t count, size_t grain)
+{
+	const size_t chunk_size = Max<size_t>(grain, 1);
+	return ((count + chunk_size - 1) / chunk_size);
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grain, const ChunkFunction& function)
+{
+	const size_t chunk_size = Max<size_t>(grain, 1);
+	const size_t chunk_count = GetChunkCount(count, chunk_size);
+	if(chunk_count == 0)
+	{
+		return;
+	}
+
+	if((chunk_count == 1) || workers_.empty())
+	{
+		for(size_t i = 0; i < chunk_count; ++i)
+		{
+			function((i * chunk_size), Min(count, (i + 1) * chunk_size), i);
+		}
+		return;
+	}
+
+	current_function_ = &function;
+	remaining_chunks_.store(chunk_count, std::memory_order_release);
+
+	// 連続したチャンクをまとめて各ワーカーに配る（盗まれなければ各スレッドが連続した範囲を担当する）
+	const size_t queue_count = queues_.size();
+	for(size_t i = 0; i < chunk_count; ++i)
+	{
+		const size_t queue_index = ((i * queue_count) / chunk_count);
+		WorkQueue& queue = *queues_[queue_index];
+		std::lock_guard lock{ queue.mutex };
+		queue.chunks.push_front(Chunk{ (i * chunk_size), Min(count, (i + 1) * chunk_size), i });
+	}
+
+	{
+		std::lock_guard lock{ wake_mutex_ };
+		++generation_;
+	}
+	wake_cv_.notify_all();
+
+	RunChunks(0);
+
+	std::unique_lock lock{ done_mutex_ };
+	done_cv_.wait(lock, [this]() { return (remaining_chunks_.load(std::memory_order_acquire) == 0); });
+}
+
+bool JobSystem::TryPop(size_t worker_index, Chunk& out_chunk)
+{
+	WorkQueue& queue = *queues_[worker_index];
+	std::lock_guard lock{ queue.mutex };
+	if(queue.chunks.empty())
+	{
+		return false;
+	}
+
+	out_chunk = queue.chunks.back();
+	queue.chunks.pop_back();
+	return true;
+}
+
+bool JobSystem::TrySteal(size_t worker_index, Chunk& out_chunk)
+{
+	const size_t queue_count = queues_.size();
+	for(size_t offset = 1; offset < queue_count; ++offset)
+	{
+		WorkQueue& queue = *queues_[(worker_index + offset) % queue_count];
+		std::lock_guard lock{ queue.mutex };
+		if(queue.chunks.empty())
+		{
+			continue;
+		}
+
+		out_chunk = queue.chunks.front();
+		queue.chunks.pop_front();
+		return true;
+	}
+	return false;
+}
+
+void JobSystem::RunChunks(size_t worker_index)
+{
+	Chunk chunk;
+	while(TryPop(worker_index, chunk) || TrySteal(worker_index, chunk))
+	{
+		(*current_function_)(chunk.begin, chunk.end, chunk.index);
+
+		if(remaining_chunks_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			std::lock_guard lock{ done_mutex_ };
+			done_cv_.notify_one();
+		}
+	}
+}
+
+void JobSystem::WorkerLoop(size_t worker_index)
+{
+	uint64 seen_generation = 0;
+
+	while(true)
+	{
+		{
+			std::unique_lock lock{ wake_mutex_ };
+			wake_cv_.wait(lock, [&]() { return (stop_workers_ || (generation_ != seen_generation)); });
+			if(stop_workers_)
+			{
+				return;
+			}
+			seen_generation = generation_;
+		}
+
+		RunChunks(worker_index);
+	}
+}
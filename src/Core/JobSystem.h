@@ -0,0 +1,124 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <Siv3D.hpp>
+#include <thread>
+#include <vector>
+
+// ループを固定サイズのチャンクに分けてワーカースレッドで並列に回すジョブシステム
+// ワーカーごとにチャンクの待ち行列を持ち，自分の分が無くなったら他のワーカーの分を盗んで処理する（ワークスティーリング）
+// 呼び出したスレッドもワーカー0として処理に加わり，全チャンクが終わるまで戻らない
+// 入れ子の ParallelFor はサポートしない
+// 並列に回した結果が直列と一致するかは --self-check job-stress で確かめる
+class JobSystem
+{
+public:
+	// [begin, end) の範囲を処理する関数．chunk_index はチャンクの通し番号（実行したスレッドに依らない）
+	using ChunkFunction = std::function<void(size_t begin, size_t end, size_t chunk_index)>;
+
+	static JobSystem& GetInstance();
+
+	~JobSystem();
+
+	// 呼び出し元を含めたワーカーの数
+	size_t GetWorkerCount() const { return queues_.size(); }
+
+	// count 個を grain 個ずつに分けたときのチャンク数
+	static size_t GetChunkCount(size_t count, size_t grain);
+
+	// チャンクが1つだけなら呼び出し元でそのまま実行する（小さいループでスレッドを起こさない）
+	void ParallelFor(size_t count, size_t grain, const ChunkFunction& function);
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+private:
+	JobSystem();
+
+	struct Chunk
+	{
+		size_t begin = 0;
+		size_t end = 0;
+		size_t index = 0;
+	};
+
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<Chunk> chunks;
+	};
+
+	// 自分の待ち行列の後ろから取る
+	bool TryPop(size_t worker_index, Chunk& out_chunk);
+
+	// 他のワーカーの待ち行列の前から盗む
+	bool TrySteal(size_t worker_index, Chunk& out_chunk);
+
+	// 取れるチャンクが無くなるまで処理する
+	void RunChunks(size_t worker_index);
+
+	void WorkerLoop(size_t worker_index);
+
+	std::vector<std::unique_ptr<WorkQueue>> queues_;
+	std::vector<std::thread> workers_;
+
+	// 実行中のループ本体（チャンクを積む前に設定するので，チャンクを取ったスレッドからは必ず見える）
+	const ChunkFunction* current_function_ = nullptr;
+	std::atomic<size_t> remaining_chunks_{ 0 };
+
+	std::mutex wake_mutex_;
+	std::condition_variable wake_cv_;
+	uint64 generation_ = 0;
+	bool stop_workers_ = false;
+
+	std::mutex done_mutex_;
+	std::condition_variable done_cv_;
+
+	static constexpr size_t kMaxWorkers = 16;
+};
+
+// 並列ループの副作用（衝突イベントなど）をチャンクごとに溜めておき，チャンク番号順にまとめるバッファ
+// どのスレッドがどのチャンクを処理しても結合後の順序は直列に回した場合と同じになる
+template<class Type>
+class OrderedJobBuffers
+{
+public:
+	// チャンク数に合わせて用意する（確保したメモリはフレームをまたいで使い回す）
+	void Prepare(size_t chunk_count)
+	{
+		if(buffers_.size() < chunk_count)
+		{
+			buffers_.resize(chunk_count);
+		}
+		for(size_t i = 0; i < chunk_count; ++i)
+		{
+			buffers_[i].clear();
+		}
+		chunk_count_ = chunk_count;
+	}
+
+	// チャンク chunk_index 専用のバッファ（そのチャンクを処理しているスレッドだけが触る）
+	Array<Type>& operator[](size_t chunk_index) { return buffers_[chunk_index]; }
+
+	// チャンク番号順に func を呼ぶ
+	template<class Function>
+	void ForEachInOrder(Function&& func) const
+	{
+		for(size_t i = 0; i < chunk_count_; ++i)
+		{
+			for(const auto& item : buffers_[i])
+			{
+				func(item);
+			}
+		}
+	}
+
+private:
+	Array<Array<Type>> buffers_;
+	size_t chunk_count_ = 0;
+};
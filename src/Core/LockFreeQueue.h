@@ -0,0 +1,109 @@
+﻿#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// 固定長のロックフリーキュー（複数スレッドから push / pop してよい）
+// ゲームスレッドからオーディオスレッドへのコマンド送信などに使う
+// 満杯のときは TryPush が false を返すだけでブロックしない
+template<class Type, size_t Capacity>
+class LockFreeQueue
+{
+	static_assert((Capacity >= 2) && ((Capacity & (Capacity - 1)) == 0), "Capacity must be a power of two");
+
+public:
+	LockFreeQueue()
+	{
+		for(size_t i = 0; i < Capacity; ++i)
+		{
+			cells_[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	LockFreeQueue(const LockFreeQueue&) = delete;
+	LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+	bool TryPush(const Type& value)
+	{
+		Cell* cell = nullptr;
+		size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+
+		for(;;)
+		{
+			cell = &cells_[pos & kMask];
+			const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+
+			if(diff == 0)
+			{
+				if(enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if(diff < 0)
+			{
+				// 満杯
+				return false;
+			}
+			else
+			{
+				pos = enqueue_pos_.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->value = value;
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool TryPop(Type& out)
+	{
+		Cell* cell = nullptr;
+		size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+
+		for(;;)
+		{
+			cell = &cells_[pos & kMask];
+			const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos + 1);
+
+			if(diff == 0)
+			{
+				if(dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if(diff < 0)
+			{
+				// 空
+				return false;
+			}
+			else
+			{
+				pos = dequeue_pos_.load(std::memory_order_relaxed);
+			}
+		}
+
+		out = cell->value;
+		cell->sequence.store(pos + Capacity, std::memory_order_release);
+		return true;
+	}
+
+private:
+	static constexpr size_t kMask = (Capacity - 1);
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		Type value{};
+	};
+
+	// push 側と pop 側が同じキャッシュラインを取り合わないように分ける
+	alignas(64) std::array<Cell, Capacity> cells_;
+	alignas(64) std::atomic<size_t> enqueue_pos_{ 0 };
+	alignas(64) std::atomic<size_t> dequeue_pos_{ 0 };
+};
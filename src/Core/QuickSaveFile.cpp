@@ -0,0 +1,84 @@
+﻿#include "Fixed.h"
+#include "QuickSaveFile.h"
+#include "StateSnapshot.h"
+
+#include <Siv3D.hpp>
+
+namespace
+{
+	// 位置と速度の数値の形（double なら 8，固定小数点なら 4）
+	constexpr uint8 kPhysicsScalarSize = static_cast<uint8>(sizeof(PhysicsScalar));
+}
+
+bool QuickSaveFile::Write(FilePathView path, const QuickSaveData& data)
+{
+	Array<uint8> bytes;
+	bytes.reserve(64 + (data.stage_name.size() * sizeof(char32)) + data.snapshot.size() + data.extras.size());
+
+	SnapshotWriter writer{ bytes };
+	writer.Write(kMagic);
+	writer.Write(kVersion);
+	writer.Write(kPhysicsScalarSize);
+	writer.WriteString(data.stage_name);
+	writer.WriteBlock(data.snapshot);
+	writer.WriteBlock(data.extras);
+
+	BinaryWriter file{ path };
+	if(not file)
+	{
+		return false;
+	}
+	return (file.write(bytes.data(), static_cast<int64>(bytes.size())) == static_cast<int64>(bytes.size()));
+}
+
+bool QuickSaveFile::Read(FilePathView path, QuickSaveData& data, String& error)
+{
+	BinaryReader file{ path };
+	if(not file)
+	{
+		error = U"ファイルを開けません";
+		return false;
+	}
+
+	Array<uint8> bytes(static_cast<size_t>(file.size()));
+	if(file.read(bytes.data(), static_cast<int64>(bytes.size())) != static_cast<int64>(bytes.size()))
+	{
+		error = U"ファイルを読めません";
+		return false;
+	}
+
+	SnapshotReader reader{ bytes };
+
+	uint32 magic = 0;
+	uint32 version = 0;
+	uint8 physics_scalar_size = 0;
+	reader.Read(magic);
+	reader.Read(version);
+	reader.Read(physics_scalar_size);
+
+	if((not reader.IsValid()) || (magic != kMagic))
+	{
+		error = U"中断セーブのファイルではありません";
+		return false;
+	}
+
+	if(version != kVersion)
+	{
+		error = U"版が違います（ファイル {}，このゲーム {}）"_fmt(version, kVersion);
+		return false;
+	}
+
+	if(physics_scalar_size != kPhysicsScalarSize)
+	{
+		error = U"物理演算の数値の形が違います（BNS_FIXED_POINT_PHYSICS の有無が違うビルドで保存されました）";
+		return false;
+	}
+
+	if((not reader.ReadString(data.stage_name)) || (not reader.ReadBlock(data.snapshot)) || (not reader.ReadBlock(data.extras)) || (not reader.IsEnd()))
+	{
+		error = U"ファイルが壊れています";
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,31 @@
+﻿#pragma once
+
+#include <Siv3D.hpp>
+
+// 中断セーブのファイルの中身
+struct QuickSaveData
+{
+	// 遊んでいたステージ（StageEntry::name）
+	String stage_name;
+
+	// GameScene::CaptureSnapshot() で詰めた状態（巻き戻しと同じ形）
+	Array<uint8> snapshot;
+
+	// 巻き戻しでは戻さないもの（BGM の再生位置，背景のアクティブ化など）
+	Array<uint8> extras;
+};
+
+// 中断セーブをバイナリのファイルに読み書きする
+// 先頭に識別子と版を置き，中身の形を変えたら kVersion を上げて古いファイルを読まないようにする
+// スナップショットは値をそのままのビット列で持つので，物理演算の数値の形（BNS_FIXED_POINT_PHYSICS）も書いておく
+namespace QuickSaveFile
+{
+	// ファイルの先頭の4バイト（"BNSQ"）
+	inline constexpr uint32 kMagic = 0x51534E42;
+	inline constexpr uint32 kVersion = 3;
+
+	bool Write(FilePathView path, const QuickSaveData& data);
+
+	// 読めなかったときは error に理由を入れて false を返す
+	bool Read(FilePathView path, QuickSaveData& data, String& error);
+}
@@ -0,0 +1,95 @@
+﻿#include "RenderQueue.h"
+
+#include <algorithm>
+#include <Siv3D.hpp>
+
+void RenderQueue::BeginFrame()
+{
+	stats_ = RenderStats{};
+	last_submitted_state_ = kNoState;
+	last_drawn_state_ = kNoState;
+}
+
+uint64 RenderQueue::MakeStateKey(RenderLayer layer, const Texture& texture, bool is_nearest)
+{
+	const uint64 texture_id = (texture.id().value() & 0x7FFFFF);
+	return ((static_cast<uint64>(layer) << 24) | (static_cast<uint64>(is_nearest) << 23) | texture_id);
+}
+
+void RenderQueue::Submit(RenderLayer layer, const TextureRegion& region, const Vec2& pos, bool is_nearest)
+{
+	const uint64 state_key = MakeStateKey(layer, region.texture, is_nearest);
+
+	// 描画の切り替えはテクスチャとサンプラーだけを見る（レイヤーは含めない）
+	const uint64 draw_state = (state_key & 0xFFFFFF);
+	if(draw_state != last_submitted_state_)
+	{
+		if(last_submitted_state_ != kNoState)
+		{
+			++stats_.unsorted_state_change_count;
+		}
+		last_submitted_state_ = draw_state;
+	}
+
+	const uint32 index = static_cast<uint32>(commands_.size());
+	commands_.push_back(SpriteCommand{ region, pos });
+	sort_entries_.push_back(SortEntry{ ((state_key << 32) | index), index });
+}
+
+void RenderQueue::SubmitAt(RenderLayer layer, const TextureRegion& region, const Vec2& center, bool is_nearest)
+{
+	Submit(layer, region, (center - (Vec2{ region.size } / 2.0)), is_nearest);
+}
+
+void RenderQueue::Flush()
+{
+	if(commands_.isEmpty())
+	{
+		return;
+	}
+
+	// キーに積んだ順を含めているので，通常のソートでも同じ状態の中の順序は保たれる
+	std::sort(sort_entries_.begin(), sort_entries_.end(),
+			  [](const SortEntry& a, const SortEntry& b) { return (a.key < b.key); });
+
+	uint64 current_state = kNoState;
+	bool is_nearest_active = false;
+	Optional<ScopedRenderStates2D> sampler;
+
+	for(const auto& entry : sort_entries_)
+	{
+		const uint64 draw_state = ((entry.key >> 32) & 0xFFFFFF);
+		if(draw_state != current_state)
+		{
+			++stats_.batch_count;
+			current_state = draw_state;
+
+			// 前回の Flush の最後と同じ状態ならそのまま続けて描ける
+			if((last_drawn_state_ != kNoState) && (draw_state != last_drawn_state_))
+			{
+				++stats_.state_change_count;
+			}
+			last_drawn_state_ = draw_state;
+
+			// サンプラーは切り替わったときだけ設定し直す
+			const bool is_nearest = ((draw_state >> 23) & 1);
+			if(is_nearest != is_nearest_active)
+			{
+				sampler.reset();
+				if(is_nearest)
+				{
+					sampler.emplace(SamplerState::ClampNearest);
+				}
+				is_nearest_active = is_nearest;
+			}
+		}
+
+		const SpriteCommand& command = commands_[entry.index];
+		command.region.draw(command.pos);
+	}
+
+	stats_.sprite_count += commands_.size();
+
+	commands_.clear();
+	sort_entries_.clear();
+}
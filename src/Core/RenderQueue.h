@@ -0,0 +1,73 @@
+﻿#pragma once
+
+#include <Siv3D.hpp>
+
+// 描画順のレイヤー（小さいほど奥）
+enum class RenderLayer : uint8
+{
+	Decor,		// 背景の生き物など
+	Title,
+	Octopus,
+	Player,
+	Enemy,
+	Stage,
+	OxygenSpot,
+	Foreground,	// HUDより手前に出す文字など
+};
+
+// 1フレーム分の描画統計
+struct RenderStats
+{
+	size_t sprite_count = 0;
+	size_t batch_count = 0;				// 同じテクスチャ・サンプラーで連続して描けたまとまりの数
+	size_t state_change_count = 0;		// 並べ替え後に描画の途中でテクスチャ・サンプラーが切り替わった回数
+	size_t unsorted_state_change_count = 0;	// 積んだ順のまま描いていた場合の切り替え回数（比較用）
+};
+
+// スプライトの描画コマンドを溜めて，レイヤー→サンプラー→テクスチャの順に並べ替えてから描くキュー
+// 同じテクスチャのスプライトが連続するので Siv3D 側で1回の描画にまとめられる
+// 同じレイヤー・同じテクスチャの中では積んだ順が保たれる
+class RenderQueue
+{
+public:
+	// 統計をリセットする（フレームの最初に呼ぶ）
+	void BeginFrame();
+
+	// region を左上 pos に描く
+	void Submit(RenderLayer layer, const TextureRegion& region, const Vec2& pos, bool is_nearest = false);
+
+	// region を中心 center に描く
+	void SubmitAt(RenderLayer layer, const TextureRegion& region, const Vec2& center, bool is_nearest = false);
+
+	// 溜めたコマンドを並べ替えて描画し，空にする
+	// 途中でスプライト以外（全画面の暗転など）を挟むときは，その前に呼ぶ
+	void Flush();
+
+	const RenderStats& GetStats() const { return stats_; }
+
+private:
+	struct SpriteCommand
+	{
+		TextureRegion region;
+		Vec2 pos;
+	};
+
+	// 並べ替え用のキー: レイヤー(8bit) | サンプラー(1bit) | テクスチャID(23bit) | 積んだ順(32bit)
+	struct SortEntry
+	{
+		uint64 key;
+		uint32 index;
+	};
+
+	static uint64 MakeStateKey(RenderLayer layer, const Texture& texture, bool is_nearest);
+
+	Array<SpriteCommand> commands_;
+	Array<SortEntry> sort_entries_;
+
+	// 切り替え回数を数えるため，直前に積んだ／描いたコマンドの状態を覚えておく
+	static constexpr uint64 kNoState = ~uint64{ 0 };
+	uint64 last_submitted_state_ = kNoState;
+	uint64 last_drawn_state_ = kNoState;
+
+	RenderStats stats_;
+};
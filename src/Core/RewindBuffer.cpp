@@ -0,0 +1,316 @@
+﻿#include "RewindBuffer.h"
+
+#include <Siv3D.hpp>
+
+namespace
+{
+	// これより短い 0 の並びは，長さを書くよりそのまま写したほうが小さい
+	constexpr size_t kMinZeroRun = 4;
+
+	// 長さは7ビットずつの可変長で書く（size_t の値なら 10 バイトに収まる）
+	constexpr size_t kMaxVarintBytes = 10;
+
+	size_t GetMaxEncodedSize(size_t size)
+	{
+		// 最初と最後を除けば，0 の並びと写す並びの組は kMinZeroRun + 1 バイトごとに高々1つ
+		return (size + (((size / (kMinZeroRun + 1)) + 2) * (kMaxVarintBytes * 2)));
+	}
+
+	uint8 GetBase(const uint8* base, size_t index)
+	{
+		return (base ? base[index] : 0);
+	}
+
+	size_t WriteVarint(uint8* out, size_t value)
+	{
+		size_t length = 0;
+		while(value >= 0x80)
+		{
+			out[length++] = static_cast<uint8>((value & 0x7F) | 0x80);
+			value >>= 7;
+		}
+		out[length++] = static_cast<uint8>(value);
+		return length;
+	}
+
+	bool ReadVarint(const uint8* in, size_t in_size, size_t& offset, size_t& value)
+	{
+		value = 0;
+		for(size_t shift = 0; shift < (kMaxVarintBytes * 7); shift += 7)
+		{
+			if(offset >= in_size)
+			{
+				return false;
+			}
+
+			const uint8 byte = in[offset++];
+			value |= (static_cast<size_t>(byte & 0x7F) << shift);
+			if((byte & 0x80) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// data と base の XOR を，[0 の長さ][写す長さ][写すバイト列] の繰り返しに詰める
+	// base が nullptr なら data をそのまま詰める（キーフレーム）
+	size_t EncodeXor(const uint8* data, const uint8* base, size_t size, uint8* out)
+	{
+		size_t in = 0;
+		size_t length = 0;
+
+		// 空のスナップショットも1組だけ書く（大きさ 0 の記録を作らない）
+		do
+		{
+			const size_t zero_begin = in;
+			while((in < size) && ((data[in] ^ GetBase(base, in)) == 0))
+			{
+				++in;
+			}
+			const size_t zero_run = (in - zero_begin);
+
+			// 次に十分長い 0 の並びが来るまでを写す
+			const size_t literal_begin = in;
+			while(in < size)
+			{
+				size_t zeros = 0;
+				while(((in + zeros) < size) && ((data[in + zeros] ^ GetBase(base, in + zeros)) == 0))
+				{
+					++zeros;
+				}
+
+				if((zeros >= kMinZeroRun) || ((in + zeros) == size))
+				{
+					break;
+				}
+				in += (zeros + 1);
+			}
+			const size_t literal_run = (in - literal_begin);
+
+			length += WriteVarint(out + length, zero_run);
+			length += WriteVarint(out + length, literal_run);
+			for(size_t i = literal_begin; i < in; ++i)
+			{
+				out[length++] = static_cast<uint8>(data[i] ^ GetBase(base, i));
+			}
+		} while(in < size);
+
+		return length;
+	}
+
+	bool DecodeXor(const uint8* in, size_t in_size, const uint8* base, size_t size, uint8* out)
+	{
+		size_t offset = 0;
+		size_t written = 0;
+
+		do
+		{
+			size_t zero_run = 0;
+			size_t literal_run = 0;
+			if((not ReadVarint(in, in_size, offset, zero_run)) || (not ReadVarint(in, in_size, offset, literal_run)))
+			{
+				return false;
+			}
+
+			if(((size - written) < zero_run) || (((size - written) - zero_run) < literal_run) || ((in_size - offset) < literal_run))
+			{
+				return false;
+			}
+
+			for(size_t i = 0; i < zero_run; ++i, ++written)
+			{
+				out[written] = GetBase(base, written);
+			}
+			for(size_t i = 0; i < literal_run; ++i, ++written)
+			{
+				out[written] = static_cast<uint8>(in[offset++] ^ GetBase(base, written));
+			}
+		} while(written < size);
+
+		return (offset == in_size);
+	}
+}
+
+RewindBuffer::RewindBuffer(size_t capacity_bytes, size_t max_frames)
+	: storage_(capacity_bytes)
+	, records_(Max<size_t>(max_frames, 1))
+{
+}
+
+void RewindBuffer::Push(const Array<uint8>& snapshot)
+{
+	const size_t size = snapshot.size();
+	const size_t max_encoded_size = GetMaxEncodedSize(size);
+	if(max_encoded_size > storage_.size())
+	{
+		// 1フレームも入らないなら，前後がつながらなくなるので全部捨てる
+		Clear();
+		return;
+	}
+
+	if(encode_buffer_.size() < max_encoded_size)
+	{
+		encode_buffer_.resize(max_encoded_size);
+	}
+
+	if(frame_count_ == records_.size())
+	{
+		DropOldest();
+	}
+
+	const uint64 sequence = next_sequence_;
+
+	// 直前のキーフレームから離れすぎたか，大きさが変わった（敵が増減した）らキーフレームにする
+	// 領域を空けるときに差分の元のキーフレームが捨てられたら，キーフレームとして書き直す
+	for(;;)
+	{
+		Optional<uint64> base_sequence;
+		if(frame_count_ > 0)
+		{
+			const Record& newest = GetNewestRecord();
+			if(((sequence - newest.keyframe_sequence) < kKeyframeInterval) && LoadKeyframe(newest.keyframe_sequence) && (keyframe_bytes_.size() == size))
+			{
+				base_sequence = newest.keyframe_sequence;
+			}
+		}
+
+		const uint8* base = (base_sequence ? keyframe_bytes_.data() : nullptr);
+		const size_t encoded_size = EncodeXor(snapshot.data(), base, size, encode_buffer_.data());
+		const size_t offset = Reserve(encoded_size);
+
+		if(base_sequence && ((frame_count_ == 0) || (GetRecord(0).sequence > *base_sequence)))
+		{
+			continue;
+		}
+
+		std::copy_n(encode_buffer_.data(), encoded_size, storage_.data() + offset);
+		write_offset_ = (offset + encoded_size);
+		used_bytes_ += encoded_size;
+
+		Record& record = records_[(first_record_ + frame_count_) % records_.size()];
+		record.sequence = sequence;
+		record.keyframe_sequence = base_sequence.value_or(sequence);
+		record.offset = offset;
+		record.encoded_size = encoded_size;
+		record.raw_size = size;
+		++frame_count_;
+		++next_sequence_;
+
+		if(not base_sequence)
+		{
+			// 次のフレームの差分の元にする
+			keyframe_bytes_.assign(snapshot.begin(), snapshot.end());
+			keyframe_sequence_ = sequence;
+		}
+		return;
+	}
+}
+
+bool RewindBuffer::Pop(Array<uint8>& snapshot)
+{
+	if(frame_count_ == 0)
+	{
+		return false;
+	}
+
+	const Record record = GetNewestRecord();
+
+	bool is_decoded = false;
+	if(record.IsKeyframe() || LoadKeyframe(record.keyframe_sequence))
+	{
+		const uint8* base = (record.IsKeyframe() ? nullptr : keyframe_bytes_.data());
+		snapshot.resize(record.raw_size);
+		is_decoded = DecodeXor(storage_.data() + record.offset, record.encoded_size, base, record.raw_size, snapshot.data());
+	}
+
+	// 一番新しいものは領域の末尾にあるので，その分を次に積むときに使い直す
+	--frame_count_;
+	--next_sequence_;
+	used_bytes_ -= record.encoded_size;
+	write_offset_ = ((frame_count_ == 0) ? 0 : record.offset);
+
+	// 同じ番号で別のフレームを積み直すので，展開しておいたものは使えなくなる
+	if(keyframe_sequence_ == record.sequence)
+	{
+		keyframe_sequence_.reset();
+	}
+
+	return is_decoded;
+}
+
+void RewindBuffer::Clear()
+{
+	first_record_ = 0;
+	frame_count_ = 0;
+	write_offset_ = 0;
+	used_bytes_ = 0;
+	keyframe_sequence_.reset();
+}
+
+bool RewindBuffer::LoadKeyframe(uint64 sequence)
+{
+	if(keyframe_sequence_ == sequence)
+	{
+		return true;
+	}
+
+	if((frame_count_ == 0) || (sequence < GetRecord(0).sequence) || (GetNewestRecord().sequence < sequence))
+	{
+		return false;
+	}
+
+	const Record& record = GetRecord(static_cast<size_t>(sequence - GetRecord(0).sequence));
+	keyframe_bytes_.resize(record.raw_size);
+	if(not DecodeXor(storage_.data() + record.offset, record.encoded_size, nullptr, record.raw_size, keyframe_bytes_.data()))
+	{
+		keyframe_sequence_.reset();
+		return false;
+	}
+
+	keyframe_sequence_ = sequence;
+	return true;
+}
+
+size_t RewindBuffer::Reserve(size_t size)
+{
+	if(frame_count_ == 0)
+	{
+		write_offset_ = 0;
+	}
+
+	size_t offset = write_offset_;
+	if((offset + size) > storage_.size())
+	{
+		// 末尾の余りは使わずに先頭に戻る．余りより後ろにある（一番古い側の）記録を先に捨てる
+		while((frame_count_ > 0) && (GetRecord(0).offset >= write_offset_))
+		{
+			DropOldest();
+		}
+		offset = 0;
+	}
+
+	// 古い順に並んでいるので，重なるものがなくなるまで古いほうから捨てる
+	while(frame_count_ > 0)
+	{
+		const Record& oldest = GetRecord(0);
+		if(((oldest.offset + oldest.encoded_size) <= offset) || ((offset + size) <= oldest.offset))
+		{
+			break;
+		}
+		DropOldest();
+	}
+
+	return offset;
+}
+
+void RewindBuffer::DropOldest()
+{
+	// キーフレームを捨てたら，それを元にした差分も戻せないので続けて捨てる
+	do
+	{
+		used_bytes_ -= GetRecord(0).encoded_size;
+		first_record_ = ((first_record_ + 1) % records_.size());
+		--frame_count_;
+	} while((frame_count_ > 0) && (not GetRecord(0).IsKeyframe()));
+}
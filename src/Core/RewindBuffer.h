@@ -0,0 +1,78 @@
+﻿#pragma once
+
+#include <Siv3D.hpp>
+
+// 毎フレームの状態のスナップショットを，決まった大きさのリングバッファに積んでおく
+// 新しいものから1つずつ取り出せるので，1フレームに1つ取り出せば記録したときと同じ速さで巻き戻る
+//
+// kKeyframeInterval フレームごとにキーフレームを置き，それ以外は直前のキーフレームとの XOR で持つ
+// ほとんどの値はフレーム間で変わらないので XOR は 0 が続き，0 の並びを長さだけにして詰める
+// キーフレームとの差なので，どのフレームもキーフレームと自分の2つを展開すれば戻せる
+//
+// いっぱいになったら古いものから捨てる（キーフレームを捨てたら，それに頼る差分も一緒に捨てる）
+// 作ったあとは確保しないので，遊んでいる間に毎フレーム呼んでもヒープ確保は増えない
+class RewindBuffer
+{
+public:
+	// capacity_bytes：詰めたスナップショットを置く領域の大きさ
+	// max_frames：持てるフレームの数（これを超えても古いものから捨てる）
+	RewindBuffer(size_t capacity_bytes, size_t max_frames);
+
+	// 一番新しいフレームとして積む
+	void Push(const Array<uint8>& snapshot);
+
+	// 一番新しいフレームを snapshot に展開して取り除く．空なら false
+	bool Pop(Array<uint8>& snapshot);
+
+	void Clear();
+
+	bool IsEmpty() const { return (frame_count_ == 0); }
+	size_t GetFrameCount() const { return frame_count_; }
+
+	// 詰めたスナップショットが使っている領域の大きさ
+	size_t GetUsedBytes() const { return used_bytes_; }
+	size_t GetCapacityBytes() const { return storage_.size(); }
+
+	// キーフレームを置く間隔（フレーム数）
+	static constexpr uint64 kKeyframeInterval = 60;
+
+private:
+	struct Record
+	{
+		uint64 sequence = 0;
+		uint64 keyframe_sequence = 0;	// 差分の元にしたキーフレーム（自分がキーフレームなら自分）
+		size_t offset = 0;
+		size_t encoded_size = 0;
+		size_t raw_size = 0;
+
+		bool IsKeyframe() const { return (sequence == keyframe_sequence); }
+	};
+
+	Record& GetRecord(size_t age_from_oldest) { return records_[(first_record_ + age_from_oldest) % records_.size()]; }
+	const Record& GetNewestRecord() const { return records_[(first_record_ + frame_count_ - 1) % records_.size()]; }
+
+	// sequence のキーフレームを keyframe_bytes_ に展開しておく（展開済みなら何もしない）
+	bool LoadKeyframe(uint64 sequence);
+
+	// size バイトを書く場所を空けて，その位置を返す
+	size_t Reserve(size_t size);
+
+	void DropOldest();
+
+	Array<uint8> storage_;
+	size_t write_offset_ = 0;
+	size_t used_bytes_ = 0;
+
+	// 記録の情報（古い順のリング）
+	Array<Record> records_;
+	size_t first_record_ = 0;
+	size_t frame_count_ = 0;
+	uint64 next_sequence_ = 0;
+
+	// 直近に展開したキーフレーム（積むときの差分の元と，取り出すときの展開に使う）
+	Array<uint8> keyframe_bytes_;
+	Optional<uint64> keyframe_sequence_;
+
+	// 詰めたスナップショットを書き出す作業領域
+	Array<uint8> encode_buffer_;
+};
@@ -0,0 +1,25 @@
+﻿#include "SimClock.h"
+
+#include <Siv3D.hpp>
+
+uint32 SimClock::BeginFrame()
+{
+	pending_ticks_ += time_scale_;
+
+	const uint32 tick_count = static_cast<uint32>(Min(pending_ticks_, static_cast<double>(kMaxTicksPerFrame)));
+	pending_ticks_ -= tick_count;
+
+	// 上限で打ち切った分は持ち越さない（あとでまとめて進めて止まらないように）
+	pending_ticks_ = Min(pending_ticks_, 1.0);
+
+	return tick_count;
+}
+
+void SimClock::SetTimeScale(double time_scale)
+{
+	time_scale_ = Clamp(time_scale, 0.0, static_cast<double>(kMaxTicksPerFrame));
+	if(time_scale_ == 0.0)
+	{
+		pending_ticks_ = 0.0;
+	}
+}
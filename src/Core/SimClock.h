@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include <Siv3D.hpp>
+
+// ゲームの進行に使う時計
+// 実時間ではなく，シミュレーションの更新1回（ティック）ずつ進む．無敵時間やアニメーションは，
+// 始まったティックと長さ（ティック数）で表し，実時間の時計（Stopwatch や Scene::Time()）は読まない
+//
+// 時間の倍率を変えると1フレームに進めるティック数が変わる（0 で一時停止，0.5 で2フレームに1回，2 で1フレームに2回）
+// 同じ入力を同じティックに与えれば，フレームレートに関係なく同じ結果になる（--self-check replay で確かめる）
+class SimClock
+{
+public:
+	// 1秒あたりのティック数（メインループの固定フレームレートと同じ）
+	static constexpr uint32 kTicksPerSecond = 60;
+
+	// 1フレームに進めるティック数の上限（倍率を上げすぎても1フレームが重くなりすぎないように）
+	static constexpr uint32 kMaxTicksPerFrame = 8;
+
+	static constexpr uint64 SecondsToTicks(double seconds) { return static_cast<uint64>((seconds * kTicksPerSecond) + 0.5); }
+	static constexpr double TicksToSeconds(uint64 ticks) { return (static_cast<double>(ticks) / kTicksPerSecond); }
+
+	// フレームの初めに呼ぶ．倍率の分だけ時間をためて，このフレームで進めるティック数を返す
+	uint32 BeginFrame();
+
+	// 1ティック進める（シミュレーションを1回更新する前に呼ぶ）
+	void Advance() { ++tick_; }
+
+	// 今のティック（最初の更新が 1）
+	uint64 GetTick() const { return tick_; }
+
+	// 巻き戻しや中断セーブから戻すとき
+	void SetTick(uint64 tick) { tick_ = tick; }
+
+	// since_tick から今までの秒数（since_tick が今より後なら 0）
+	double GetElapsedSeconds(uint64 since_tick) const { return ((tick_ > since_tick) ? TicksToSeconds(tick_ - since_tick) : 0.0); }
+
+	double GetTimeScale() const { return time_scale_; }
+	void SetTimeScale(double time_scale);
+
+	bool IsPaused() const { return (time_scale_ == 0.0); }
+
+private:
+	uint64 tick_ = 0;
+
+	double time_scale_ = 1.0;
+
+	// まだティックにならない端数
+	double pending_ticks_ = 0.0;
+};
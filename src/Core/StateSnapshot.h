@@ -0,0 +1,149 @@
+﻿#pragma once
+
+#include <Siv3D.hpp>
+
+#include <array>
+#include <cstring>
+#include <type_traits>
+
+// シミュレーションの状態をバイト列に詰める
+// 値はそのままのビット列で書くので，同じ実行ファイルの中でだけ読み戻せる
+class SnapshotWriter
+{
+public:
+	// bytes は使い回すバッファ（中身は消して書き直す．容量は残るので毎フレームの確保にならない）
+	explicit SnapshotWriter(Array<uint8>& bytes)
+		: bytes_{ bytes }
+	{
+		bytes_.clear();
+	}
+
+	template<class Type>
+	void Write(const Type& value)
+	{
+		static_assert(std::is_trivially_copyable_v<Type>, "SnapshotWriter::Write にはそのままコピーできる型だけを渡す");
+
+		WriteBytes(&value, sizeof(Type));
+	}
+
+	void WriteBytes(const void* data, size_t size)
+	{
+		const size_t offset = bytes_.size();
+		bytes_.resize(offset + size);
+		if(size != 0)
+		{
+			std::memcpy(bytes_.data() + offset, data, size);
+		}
+	}
+
+	// 文字数に続けて文字を書く
+	void WriteString(StringView text)
+	{
+		Write(static_cast<uint32>(text.size()));
+		WriteBytes(text.data(), (text.size() * sizeof(char32)));
+	}
+
+	// 大きさに続けてバイト列を書く
+	void WriteBlock(const Array<uint8>& block)
+	{
+		Write(static_cast<uint32>(block.size()));
+		WriteBytes(block.data(), block.size());
+	}
+
+private:
+	Array<uint8>& bytes_;
+};
+
+// SnapshotWriter で詰めたバイト列を同じ順に読み出す
+// 足りなくなったら以降の Read() は全て false を返す
+class SnapshotReader
+{
+public:
+	SnapshotReader(const uint8* data, size_t size)
+		: data_{ data }, size_{ size }
+	{
+	}
+
+	explicit SnapshotReader(const Array<uint8>& bytes)
+		: SnapshotReader{ bytes.data(), bytes.size() }
+	{
+	}
+
+	template<class Type>
+	bool Read(Type& value)
+	{
+		static_assert(std::is_trivially_copyable_v<Type>, "SnapshotReader::Read にはそのままコピーできる型だけを渡す");
+
+		return ReadBytes(&value, sizeof(Type));
+	}
+
+	bool ReadBytes(void* data, size_t size)
+	{
+		if((not is_valid_) || ((size_ - offset_) < size))
+		{
+			is_valid_ = false;
+			return false;
+		}
+
+		if(size != 0)
+		{
+			std::memcpy(data, data_ + offset_, size);
+		}
+		offset_ += size;
+		return true;
+	}
+
+	bool ReadString(String& text)
+	{
+		uint32 length = 0;
+		if((not Read(length)) || (((size_ - offset_) / sizeof(char32)) < length))
+		{
+			is_valid_ = false;
+			return false;
+		}
+
+		text.resize(length);
+		return ReadBytes(text.data(), (length * sizeof(char32)));
+	}
+
+	// 短い文字列を確保せずに読む（buffer に収まらなければ失敗する）
+	// text は buffer を指すので，buffer より長く使わない
+	template<size_t Capacity>
+	bool ReadString(std::array<char32, Capacity>& buffer, StringView& text)
+	{
+		uint32 length = 0;
+		if((not Read(length)) || (Capacity < length) || (not ReadBytes(buffer.data(), (length * sizeof(char32)))))
+		{
+			is_valid_ = false;
+			return false;
+		}
+
+		text = StringView{ buffer.data(), length };
+		return true;
+	}
+
+	bool ReadBlock(Array<uint8>& block)
+	{
+		uint32 size = 0;
+		if((not Read(size)) || ((size_ - offset_) < size))
+		{
+			is_valid_ = false;
+			return false;
+		}
+
+		block.resize(size);
+		return ReadBytes(block.data(), size);
+	}
+
+	// 途中で足りなくならずに読めたか
+	bool IsValid() const { return is_valid_; }
+
+	// 最後まで読み切ったか
+	bool IsEnd() const { return (offset_ == size_); }
+
+private:
+	const uint8* data_ = nullptr;
+	size_t size_ = 0;
+	size_t offset_ = 0;
+	bool is_valid_ = true;
+};
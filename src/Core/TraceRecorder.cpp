@@ -0,0 +1,401 @@
+﻿#include "TraceRecorder.h"
+
+#include <Siv3D.hpp>
+
+#include <chrono>
+
+namespace
+{
+	// このスレッドに最後に付けた名前（同じ名前なら付け直さない）
+	thread_local StringView t_thread_name;
+
+	const auto g_trace_epoch = std::chrono::steady_clock::now();
+
+	// スレッドのトラックとは別に，イベントをまとめて表示するトラックの番号と名前
+	constexpr uint32 kSharedTrackBaseId = 1000;
+
+	StringView GetSharedTrackName(TraceTrack track)
+	{
+		switch(track)
+		{
+		case TraceTrack::Bgm:
+			return U"BGM";
+		case TraceTrack::Hitch:
+			return U"Hitch";
+		default:
+			return U"";
+		}
+	}
+
+	void AppendEscaped(String& out, StringView text)
+	{
+		for(const char32 ch : text)
+		{
+			switch(ch)
+			{
+			case U'"':
+				out.append(U"\\\"");
+				break;
+			case U'\\':
+				out.append(U"\\\\");
+				break;
+			case U'\n':
+				out.append(U"\\n");
+				break;
+			default:
+				if(ch < 0x20)
+				{
+					out.append(U"\\u{:04x}"_fmt(static_cast<uint32>(ch)));
+				}
+				else
+				{
+					out.push_back(ch);
+				}
+				break;
+			}
+		}
+	}
+}
+
+// 1つのスレッドのイベントを積むリングバッファ
+// 積むのは持ち主のスレッドだけで，書き出すスレッドは通し番号で書き込み途中のスロットを見分ける
+class TraceRecorder::ThreadBuffer
+{
+public:
+	explicit ThreadBuffer(uint32 id)
+		: id_{ id }, slots_{ std::make_unique<Slot[]>(kEventsPerThread) }
+	{
+	}
+
+	uint32 GetId() const { return id_; }
+
+	void Push(const TraceEvent& event)
+	{
+		const uint64 index = head_.load(std::memory_order_relaxed);
+		Slot& slot = slots_[index & (kEventsPerThread - 1)];
+
+		// 書き込み中は奇数にしておく
+		slot.sequence.store((index * 2) + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.event = event;
+		slot.sequence.store((index * 2) + 2, std::memory_order_release);
+
+		head_.store(index + 1, std::memory_order_release);
+	}
+
+	// 今残っているイベントを out に足す
+	void Snapshot(Array<std::pair<uint32, TraceEvent>>& out) const
+	{
+		const uint64 head = head_.load(std::memory_order_acquire);
+		const uint64 first = (head > kEventsPerThread) ? (head - kEventsPerThread) : 0;
+
+		for(uint64 index = first; index < head; ++index)
+		{
+			const Slot& slot = slots_[index & (kEventsPerThread - 1)];
+
+			const uint64 expected = ((index * 2) + 2);
+			if(slot.sequence.load(std::memory_order_acquire) != expected)
+			{
+				continue;
+			}
+
+			const TraceEvent event = slot.event;
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			// 読んでいる間に上書きされていたら捨てる
+			if(slot.sequence.load(std::memory_order_relaxed) != expected)
+			{
+				continue;
+			}
+
+			out.emplace_back(id_, event);
+		}
+	}
+
+	// 名前は TraceRecorder の buffers_mutex_ で守る
+	String name;
+
+private:
+	struct Slot
+	{
+		std::atomic<uint64> sequence{ 0 };
+		TraceEvent event;
+	};
+
+	uint32 id_ = 0;
+	std::unique_ptr<Slot[]> slots_;
+	std::atomic<uint64> head_{ 0 };
+};
+
+TraceRecorder& TraceRecorder::GetInstance()
+{
+	static TraceRecorder instance;
+	return instance;
+}
+
+void TraceRecorder::SetThreadName(StringView name)
+{
+	if((not IsEnabled()) || (t_thread_name == name))
+	{
+		return;
+	}
+
+	ThreadBuffer& buffer = GetThreadBuffer();
+	t_thread_name = name;
+
+	TraceRecorder& recorder = GetInstance();
+	std::lock_guard lock{ recorder.buffers_mutex_ };
+	buffer.name = String{ name };
+}
+
+uint64 TraceRecorder::NowMicroseconds()
+{
+	return static_cast<uint64>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_trace_epoch).count());
+}
+
+void TraceRecorder::Complete(StringView name, StringView category, uint64 start_us, uint64 end_us, StringView detail)
+{
+	if(not IsEnabled())
+	{
+		return;
+	}
+
+	TraceEvent event;
+	event.name = name;
+	event.category = category;
+	event.start_us = start_us;
+	event.duration_us = ((end_us > start_us) ? (end_us - start_us) : 0);
+	event.phase = 'X';
+	event.SetDetail(detail);
+	Push(event);
+}
+
+void TraceRecorder::Instant(StringView name, StringView category, StringView detail, TraceTrack track)
+{
+	if(not IsEnabled())
+	{
+		return;
+	}
+
+	TraceEvent event;
+	event.name = name;
+	event.category = category;
+	event.start_us = NowMicroseconds();
+	event.phase = 'i';
+	event.track = track;
+	event.SetDetail(detail);
+	Push(event);
+}
+
+void TraceRecorder::ConfigureFromCommandLine(const Array<String>& args)
+{
+	for(size_t i = 0; i < args.size(); ++i)
+	{
+		const String& key = args[i];
+		const bool has_value = ((i + 1) < args.size());
+
+		if(key == U"--trace")
+		{
+			s_is_enabled.store(true, std::memory_order_relaxed);
+		}
+		else if((key == U"--trace-hitch-ms") && has_value)
+		{
+			s_is_enabled.store(true, std::memory_order_relaxed);
+			hitch_threshold_ms_ = Max(ParseOr<double>(args[i + 1], 33.4), 1.0);
+		}
+		else if((key == U"--trace-dir") && has_value)
+		{
+			trace_dir_ = args[i + 1];
+			if(not trace_dir_.ends_with(U'/'))
+			{
+				trace_dir_ += U'/';
+			}
+		}
+	}
+
+	if(IsEnabled())
+	{
+		// メインループを回すスレッドを最初のトラックにする
+		SetThreadName(U"Main");
+		last_frame_us_ = NowMicroseconds();
+
+		Console << U"TraceRecorder: 記録を始めます（F9 で {} に書き出します）"_fmt(trace_dir_);
+		if(hitch_threshold_ms_)
+		{
+			Console << U"TraceRecorder: フレームの間隔が {:.1f}ms を超えたら自動で書き出します"_fmt(*hitch_threshold_ms_);
+		}
+	}
+}
+
+void TraceRecorder::EndFrame()
+{
+	if(not IsEnabled())
+	{
+		return;
+	}
+
+	const uint64 now_us = NowMicroseconds();
+	Complete(U"Frame", U"frame", last_frame_us_, now_us);
+
+	const double frame_ms = (static_cast<double>(now_us - last_frame_us_) / 1000.0);
+	last_frame_us_ = now_us;
+
+	if((not hitch_threshold_ms_) || (frame_ms <= *hitch_threshold_ms_))
+	{
+		return;
+	}
+
+	Instant(U"Hitch", U"hitch", U"{:.1f}ms"_fmt(frame_ms), TraceTrack::Hitch);
+
+	// 続けて落ちたときに書き出しだらけにならないよう，間隔を空ける
+	if(last_hitch_dump_us_ && ((now_us - *last_hitch_dump_us_) < kHitchDumpCooldownUs))
+	{
+		return;
+	}
+
+	if(RequestDump(U"hitch"))
+	{
+		last_hitch_dump_us_ = now_us;
+	}
+}
+
+bool TraceRecorder::RequestDump(StringView reason)
+{
+	if(not IsEnabled())
+	{
+		Console << U"TraceRecorder: --trace を指定して起動したときだけ書き出せます";
+		return false;
+	}
+
+	if(pending_write_.valid() && (pending_write_.wait_for(std::chrono::seconds{ 0 }) != std::future_status::ready))
+	{
+		return false;
+	}
+
+	// バッファの中身だけをここで写し，JSON にするのと書き込みは別スレッドで行う
+	Array<std::pair<uint32, String>> threads;
+	Array<std::pair<uint32, TraceEvent>> events;
+	{
+		std::lock_guard lock{ buffers_mutex_ };
+		for(const auto& buffer : buffers_)
+		{
+			threads.emplace_back(buffer->GetId(), buffer->name);
+			buffer->Snapshot(events);
+		}
+	}
+
+	const FilePath path = (trace_dir_ + U"trace_{}_{:03}_{}.json"_fmt(DateTime::Now().format(U"yyyyMMdd_HHmmss"), dump_count_++, reason));
+	Console << U"TraceRecorder: {} 個のイベントを {} に書き出します"_fmt(events.size(), path);
+
+	pending_write_ = std::async(std::launch::async, [threads = std::move(threads), events = std::move(events), path]()
+	{
+		TextWriter writer{ path };
+		if(writer)
+		{
+			writer.write(ToJson(threads, events));
+		}
+	});
+
+	return true;
+}
+
+TraceRecorder::ThreadBuffer& TraceRecorder::GetThreadBuffer()
+{
+	if(s_thread_buffer)
+	{
+		return *s_thread_buffer;
+	}
+
+	TraceRecorder& recorder = GetInstance();
+	std::lock_guard lock{ recorder.buffers_mutex_ };
+
+	// スレッドが終わってもイベントを書き出せるように，バッファは最後まで持っておく
+	const uint32 id = static_cast<uint32>(recorder.buffers_.size() + 1);
+	recorder.buffers_.push_back(std::make_unique<ThreadBuffer>(id));
+	recorder.buffers_.back()->name = U"Thread {}"_fmt(id);
+
+	s_thread_buffer = recorder.buffers_.back().get();
+	return *s_thread_buffer;
+}
+
+void TraceRecorder::Push(const TraceEvent& event)
+{
+	GetThreadBuffer().Push(event);
+}
+
+String TraceRecorder::ToJson(const Array<std::pair<uint32, String>>& threads, const Array<std::pair<uint32, TraceEvent>>& events)
+{
+	String json;
+	json.reserve((events.size() * 128) + 1024);
+	json.append(U"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	bool is_first = true;
+	const auto append_thread_name = [&](uint32 tid, StringView name, size_t sort_index)
+	{
+		json.append(is_first ? U"" : U",\n");
+		is_first = false;
+
+		json.append(U"{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\""_fmt(tid));
+		AppendEscaped(json, name);
+		json.append(U"\"}}},\n{{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"sort_index\":{}}}}}"_fmt(tid, sort_index));
+	};
+
+	for(const auto& [tid, name] : threads)
+	{
+		append_thread_name(tid, name, tid);
+	}
+	for(const TraceTrack track : { TraceTrack::Bgm, TraceTrack::Hitch })
+	{
+		const uint32 tid = (kSharedTrackBaseId + static_cast<uint32>(track));
+		append_thread_name(tid, GetSharedTrackName(track), tid);
+	}
+
+	for(const auto& [thread_id, event] : events)
+	{
+		const uint32 tid = ((event.track == TraceTrack::Thread) ? thread_id : (kSharedTrackBaseId + static_cast<uint32>(event.track)));
+
+		json.append(U",\n{\"name\":\"");
+		AppendEscaped(json, event.name);
+		json.append(U"\",\"cat\":\"");
+		AppendEscaped(json, event.category);
+		json.append(U"\",\"ph\":\"{}\",\"pid\":1,\"tid\":{},\"ts\":{}"_fmt(static_cast<char32>(event.phase), tid, event.start_us));
+
+		if(event.phase == 'X')
+		{
+			json.append(U",\"dur\":{}"_fmt(event.duration_us));
+		}
+		else
+		{
+			json.append(U",\"s\":\"t\"");
+		}
+
+		if(event.detail_length != 0)
+		{
+			json.append(U",\"args\":{\"detail\":\"");
+			AppendEscaped(json, StringView{ event.detail, event.detail_length });
+			json.append(U"\"}");
+		}
+
+		json.append(U"}");
+	}
+
+	json.append(U"\n]}\n");
+	return json;
+}
+
+TraceScope::TraceScope(StringView name, StringView category, StringView detail)
+	: name_{ name }, category_{ category }, detail_{ detail }, is_recording_{ TraceRecorder::IsEnabled() }
+{
+	if(is_recording_)
+	{
+		start_us_ = TraceRecorder::NowMicroseconds();
+	}
+}
+
+TraceScope::~TraceScope()
+{
+	if(is_recording_)
+	{
+		TraceRecorder::Complete(name_, category_, start_us_, TraceRecorder::NowMicroseconds(), detail_);
+	}
+}
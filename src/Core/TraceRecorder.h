@@ -0,0 +1,134 @@
+﻿#pragma once
+
+#include <Siv3D.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+
+// イベントを表示するトラック
+// Thread は積んだスレッドのトラックで，それ以外はどのスレッドから積んでも1本のトラックにまとまる
+enum class TraceTrack : uint8
+{
+	Thread,
+	Bgm,
+	Hitch,
+};
+
+// 1つのトレースイベント
+// 名前と分類は文字列リテラルを指す（イベントを積むときに文字列を確保しない）
+struct TraceEvent
+{
+	// 詳細（アセット名など）として持てる文字数
+	static constexpr size_t kMaxDetailLength = 23;
+
+	StringView name;
+	StringView category;
+
+	// 記録を始めてからの時刻（マイクロ秒）
+	uint64 start_us = 0;
+	uint64 duration_us = 0;
+
+	// 'X'（区間）か 'i'（瞬間）
+	char phase = 'X';
+	TraceTrack track = TraceTrack::Thread;
+
+	uint8 detail_length = 0;
+	char32 detail[kMaxDetailLength] = {};
+
+	// 長すぎる分は切り捨てて写す
+	void SetDetail(StringView text)
+	{
+		detail_length = static_cast<uint8>(Min(text.size(), kMaxDetailLength));
+		std::copy_n(text.data(), detail_length, detail);
+	}
+};
+
+// フレームの各段階，アセットのデコード，BGM の切り替え，フレーム落ちを時系列で記録し，
+// Chrome のトレースイベント形式の JSON に書き出す（chrome://tracing や Perfetto で開ける）
+//
+// イベントはスレッドごとのリングバッファに積む．積むのはそのスレッドだけなのでロックはいらず，
+// 書き出すときは各スロットの通し番号で，書き込み途中のイベントを読み飛ばす
+// バッファは古いものから上書きされるので，書き出すのは各スレッドの直近 kEventsPerThread 個になる
+//
+// --trace で記録を始め，kInputDumpTrace で書き出す
+// --trace-hitch-ms <ミリ秒> を指定すると，フレームの間隔がそれを超えたときにも自動で書き出す
+class TraceRecorder
+{
+public:
+	// スレッドごとに持てるイベントの数（2の累乗）
+	static constexpr size_t kEventsPerThread = (1 << 13);
+
+	static TraceRecorder& GetInstance();
+
+	static bool IsEnabled() { return s_is_enabled.load(std::memory_order_relaxed); }
+
+	// 呼んだスレッドのトラックに名前を付ける（同じ名前で何度呼んでもよい）
+	static void SetThreadName(StringView name);
+
+	static uint64 NowMicroseconds();
+
+	// 呼んだスレッドのトラックにイベントを積む．どのスレッドから呼んでもよい
+	static void Complete(StringView name, StringView category, uint64 start_us, uint64 end_us, StringView detail = {});
+	static void Instant(StringView name, StringView category, StringView detail = {}, TraceTrack track = TraceTrack::Thread);
+
+	// --trace / --trace-hitch-ms / --trace-dir を読む
+	void ConfigureFromCommandLine(const Array<String>& args);
+
+	// メインループの最後に呼ぶ．前回からの間隔を Frame として記録し，閾値を超えたらフレーム落ちとして書き出す
+	void EndFrame();
+
+	// 今までに積んだイベントを trace_dir_ に書き出す（書き込みは別スレッドで行う）
+	// 前回の書き出しが終わっていなければ何もしない
+	bool RequestDump(StringView reason);
+
+private:
+	class ThreadBuffer;
+
+	TraceRecorder() = default;
+
+	// 呼んだスレッドのバッファ（初めて呼んだときに作って登録する）
+	static ThreadBuffer& GetThreadBuffer();
+
+	static void Push(const TraceEvent& event);
+
+	static String ToJson(const Array<std::pair<uint32, String>>& threads, const Array<std::pair<uint32, TraceEvent>>& events);
+
+	static inline constinit std::atomic<bool> s_is_enabled{ false };
+	static inline thread_local ThreadBuffer* s_thread_buffer = nullptr;
+
+	// フレーム落ちで書き出したあと，次に自動で書き出すまでの間隔
+	static constexpr uint64 kHitchDumpCooldownUs = 5'000'000;
+
+	std::mutex buffers_mutex_;
+	Array<std::unique_ptr<ThreadBuffer>> buffers_;
+
+	FilePath trace_dir_ = U"trace/";
+	Optional<double> hitch_threshold_ms_;
+	uint64 last_frame_us_ = 0;
+	Optional<uint64> last_hitch_dump_us_;
+	uint32 dump_count_ = 0;
+
+	std::future<void> pending_write_;
+};
+
+// スコープの開始から終了までを区間として記録する
+// 名前と分類には文字列リテラルを渡す．detail はスコープを抜けるまで生きている文字列にする
+class TraceScope
+{
+public:
+	explicit TraceScope(StringView name, StringView category = U"frame", StringView detail = {});
+	~TraceScope();
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+	StringView name_;
+	StringView category_;
+	StringView detail_;
+	uint64 start_us_ = 0;
+	bool is_recording_ = false;
+};
@@ -1 +1,30 @@
 ﻿#include "Utility.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+	// Main の中で作られるシングルトンより先に（起動時に）作られるので，破棄はそれらより後になる
+	// それより前に作られた静的オブジェクトの破棄は飛ばし，後始末は OS に任せる
+	struct ExitCode
+	{
+		int32 code = EXIT_SUCCESS;
+
+		~ExitCode()
+		{
+			if(code != EXIT_SUCCESS)
+			{
+				std::fflush(nullptr);
+				std::_Exit(code);
+			}
+		}
+	};
+
+	ExitCode g_exit_code;
+}
+
+void Utility::SetExitCode(int32 code)
+{
+	g_exit_code.code = code;
+}
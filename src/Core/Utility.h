@@ -9,4 +9,8 @@ namespace Utility
 	{
 		return Vec2(std::round(v.x), std::round(v.y));
 	}
+
+	// プロセスの終了コードを設定する
+	// Siv3D の Main は終了コードを返せないので，Main から戻ってエンジンの終了処理とシングルトンの破棄が済んだあとで使う
+	void SetExitCode(int32 code);
 }
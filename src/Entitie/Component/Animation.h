@@ -10,8 +10,8 @@ struct Animation
 
 	// 1フレームあたりの表示時間（秒）
 	// 0.2 に設定すると，0.2秒ごとに次の画像へ切り替わる
-	double frame_duration_sec;
+	double frame_duration_sec = 0.0;
 
 	// アニメーションをループ再生するか
-	bool is_looping;
+	bool is_looping = false;
 };
@@ -1,8 +1,7 @@
 ﻿#include "AnimationController.h"
 
 AnimationController::AnimationController()
-	: current_frame_index_{ 0 }
-	, current_animation_{ nullptr }
+	: current_animation_{ nullptr }
 {
 }
 
@@ -11,7 +10,7 @@ void AnimationController::AddAnimation(const String& name, const Animation& anim
 	animations_[name] = animation;
 }
 
-void AnimationController::Play(const String& name)
+void AnimationController::Play(const String& name, uint64 tick)
 {
 	if(not animations_.contains(name))
 	{
@@ -24,8 +23,7 @@ void AnimationController::Play(const String& name)
 	}
 
 	current_animation_name_ = name;
-	current_frame_index_ = 0;
-	frame_timer_.restart();
+	start_tick_ = tick;
 
 	// アニメーションデータへのポインタをキャッシュ
 	current_animation_ = &animations_.at(name);
@@ -36,42 +34,33 @@ bool AnimationController::IsPlaying(const String& animation_name) const
 	return current_animation_name_ == animation_name;
 }
 
-void AnimationController::Update()
+size_t AnimationController::GetCurrentFrameIndex(const SimClock& clock) const
 {
-	if(not current_animation_)
-	{
-		return;
-	}
-
-	if(frame_timer_.sF() < current_animation_->frame_duration_sec)
+	const size_t frame_count = current_animation_->texture_asset_names.size();
+	if((frame_count <= 1) || (current_animation_->frame_duration_sec <= 0.0))
 	{
-		return;
+		return 0;
 	}
 
-	current_frame_index_++;
-	frame_timer_.restart();
+	const size_t elapsed_frames = static_cast<size_t>(clock.GetElapsedSeconds(start_tick_) / current_animation_->frame_duration_sec);
 
-	if(current_frame_index_ >= current_animation_->texture_asset_names.size())
+	if(current_animation_->is_looping)
 	{
-		if(current_animation_->is_looping)
-		{
-			current_frame_index_ = 0;
-		}
-		else
-		{
-			current_frame_index_ = current_animation_->texture_asset_names.size() - 1;
-		}
+		return (elapsed_frames % frame_count);
 	}
+
+	// ループしないアニメーションは最後のコマで止まる
+	return Min(elapsed_frames, (frame_count - 1));
 }
 
-s3d::Optional<TextureAsset> AnimationController::GetCurrentTextureAsset() const
+s3d::Optional<TextureAsset> AnimationController::GetCurrentTextureAsset(const SimClock& clock) const
 {
 	if(not current_animation_)
 	{
 		return s3d::none;
 	}
 
-	const String& asset_name = current_animation_->texture_asset_names[current_frame_index_];
+	const String& asset_name = current_animation_->texture_asset_names[GetCurrentFrameIndex(clock)];
 
 	if(not TextureAsset::IsRegistered(asset_name))
 	{
@@ -81,3 +70,36 @@ s3d::Optional<TextureAsset> AnimationController::GetCurrentTextureAsset() const
 
 	return TextureAsset(asset_name);
 }
+
+void AnimationController::SaveState(SnapshotWriter& writer) const
+{
+	writer.WriteString(current_animation_name_);
+	writer.Write(start_tick_);
+}
+
+bool AnimationController::LoadState(SnapshotReader& reader)
+{
+	std::array<char32, kMaxStateNameLength> name_buffer;
+	StringView name;
+	uint64 start_tick = 0;
+	if((not reader.ReadString(name_buffer, name)) || (not reader.Read(start_tick)))
+	{
+		return false;
+	}
+
+	// 同じアニメーションなら名前を作り直さない（巻き戻し中は毎フレーム呼ばれる）
+	if(current_animation_name_ != name)
+	{
+		Play(String{ name });
+	}
+	start_tick_ = start_tick;
+	return true;
+}
+
+bool AnimationController::SkipState(SnapshotReader& reader)
+{
+	std::array<char32, kMaxStateNameLength> name_buffer;
+	StringView name;
+	uint64 start_tick = 0;
+	return (reader.ReadString(name_buffer, name) && reader.Read(start_tick));
+}
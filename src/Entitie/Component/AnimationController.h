@@ -1,5 +1,7 @@
 ﻿#pragma once
 
+#include "../../Core/SimClock.h"
+#include "../../Core/StateSnapshot.h"
 #include "Animation.h"
 
 #include <Siv3D.hpp>
@@ -10,20 +12,33 @@ public:
 	AnimationController();
 
 	void AddAnimation(const String& name, const Animation& animation);
-	void Play(const String& name);
+
+	// SimClock のティック tick から再生する（ループするものは tick を省いてよい．コマの位置が時計とそろう）
+	void Play(const String& name, uint64 tick = 0);
 	bool IsPlaying(const String& animation_name) const;
 
-	void Update();
+	// 今のコマは再生を始めたティックからの経過で決まるので，毎フレーム更新する必要はない
+	s3d::Optional<TextureAsset> GetCurrentTextureAsset(const SimClock& clock) const;
+
+	// 再生中のアニメーションの名前と，再生を始めたティックを詰める／戻す
+	void SaveState(SnapshotWriter& writer) const;
+	bool LoadState(SnapshotReader& reader);
 
-	s3d::Optional<TextureAsset> GetCurrentTextureAsset() const;
+	// 戻す先の無い状態を読み飛ばす
+	static bool SkipState(SnapshotReader& reader);
 
 private:
 	HashTable<String, Animation> animations_;
 	String current_animation_name_;
-	size_t current_frame_index_;
-	Stopwatch frame_timer_;
+	uint64 start_tick_ = 0;
 
-	// Update() / GetCurrentTextureAsset() での毎フレームの検索を避けるため，
+	// 再生開始からの経過時間に対応するコマの番号
+	size_t GetCurrentFrameIndex(const SimClock& clock) const;
+
+	// GetCurrentTextureAsset() での毎フレームの検索を避けるため，
 	// 現在のアニメーションデータへのポインタをキャッシュ
 	const Animation* current_animation_ = nullptr;
+
+	// 読み戻すときにアニメーションの名前を置いておく場所の大きさ（文字数）
+	static constexpr size_t kMaxStateNameLength = 64;
 };
\ No newline at end of file
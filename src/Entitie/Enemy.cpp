@@ -1,7 +1,6 @@
 ﻿#include "../World/Stage.h"
 #include "Component/Animation.h"
 #include "Enemy.h"
-#include "Player.h"
 
 #include <Siv3D.hpp>
 #include <variant>
@@ -13,6 +12,12 @@ Enemy::Enemy(const String& type, const Vec2& center_pos)
 	SetupProperties(type);
 	SetupAnimations(type);
 
+	speed_ = PhysicsScalar(Abs(velocity_.x));
+
+	// PlanMotion() を呼ぶまではその場に止めておく
+	leg_.start_x = PhysicsScalar(pos_.x);
+	leg_.end_x = leg_.start_x;
+
 	if(type == U"Coral_L" || type == U"Coral_R")
 	{
 		// Coralは Circle で初期化
@@ -80,6 +85,7 @@ void Enemy::SetupProperties(const String& type)
 	{
 		behavior_ = EnemyBehavior::Patrol;
 		physics_size_ = kFishPhysicsSize;
+		sprite_size_ = kFishSpriteSize;
 		velocity_.x = -kFishSpeed;
 		is_facing_right_ = false;
 		collision_offset_ = 0.0;
@@ -88,6 +94,7 @@ void Enemy::SetupProperties(const String& type)
 	{
 		behavior_ = EnemyBehavior::Patrol;
 		physics_size_ = kSharkPhysicsSize;
+		sprite_size_ = kSharkSpriteSize;
 		velocity_.x = -kSharkSpeed;
 		is_facing_right_ = false;
 		collision_offset_ = 150.0;
@@ -96,6 +103,7 @@ void Enemy::SetupProperties(const String& type)
 	{
 		behavior_ = EnemyBehavior::Patrol;
 		physics_size_ = kDeepseaFishPhysicsSize;
+		sprite_size_ = kDeepseaFishSpriteSize;
 		velocity_.x = -kDeepseaFishSpeed;
 		is_facing_right_ = false;
 		collision_offset_ = 0.0;
@@ -104,6 +112,7 @@ void Enemy::SetupProperties(const String& type)
 	{
 		behavior_ = EnemyBehavior::Patrol;
 		physics_size_ = kSwimmiePhysicsSize;
+		sprite_size_ = kSwimmieSpriteSize;
 		velocity_.x = -kSwimmieSpeed;
 		is_facing_right_ = false;
 		collision_offset_ = 35.0;
@@ -112,29 +121,33 @@ void Enemy::SetupProperties(const String& type)
 	{
 		behavior_ = EnemyBehavior::BackAndForth;
 		physics_size_ = kMorayEelPhysicsSize;
+		sprite_size_ = kMorayEelSpriteSize;
 		velocity_.x = -kMorayEelSpeed;
-		max_travel_distance_ = kBackAndForthDistance;
+		max_travel_distance_ = PhysicsScalar(kBackAndForthDistance);
 	}
 	else if(type == U"MorayEel_R")
 	{
 		behavior_ = EnemyBehavior::BackAndForth;
 		physics_size_ = kMorayEelPhysicsSize;
+		sprite_size_ = kMorayEelSpriteSize;
 		velocity_.x = kMorayEelSpeed;
-		max_travel_distance_ = kBackAndForthDistance;
+		max_travel_distance_ = PhysicsScalar(kBackAndForthDistance);
 	}
 	else if(type == U"Octoleg_L")
 	{
 		behavior_ = EnemyBehavior::BackAndForth;
 		physics_size_ = kOctolegPhysicsSize;
+		sprite_size_ = kOctolegSpriteSize;
 		velocity_.x = -kOctolegSpeed;
-		max_travel_distance_ = kBackAndForthDistance;
+		max_travel_distance_ = PhysicsScalar(kBackAndForthDistance);
 	}
 	else if(type == U"Octoleg_R")
 	{
 		behavior_ = EnemyBehavior::BackAndForth;
 		physics_size_ = kOctolegPhysicsSize;
+		sprite_size_ = kOctolegSpriteSize;
 		velocity_.x = kOctolegSpeed;
-		max_travel_distance_ = kBackAndForthDistance;
+		max_travel_distance_ = PhysicsScalar(kBackAndForthDistance);
 	}
 	else
 	{
@@ -144,14 +157,17 @@ void Enemy::SetupProperties(const String& type)
 		if(type == U"Coral_L")
 		{
 			physics_size_ = kCoralPhysicsSize;
+			sprite_size_ = kCoralSpriteSize;
 		}
 		else if(type == U"Coral_R")
 		{
 			physics_size_ = kCoralPhysicsSize;
+			sprite_size_ = kCoralSpriteSize;
 		}
 		else if(type == U"Clione")
 		{
 			physics_size_ = kClionePhysicsSize;
+			sprite_size_ = kClioneSpriteSize;
 		}
 	}
 }
@@ -245,7 +261,8 @@ void Enemy::SetupAnimations(const String& type)
 		}
 		else
 		{
-			Print << U"エラー: 未知の敵タイプ '{}' です．"_fmt(type);
+			// ワーカーで進めるワールドでも作られるので，ここでは Print しない
+			is_known_type_ = false;
 			anim.texture_asset_names = { U"coral_l" }; // フォールバック
 			anim.is_looping = false;
 		}
@@ -255,136 +272,160 @@ void Enemy::SetupAnimations(const String& type)
 	}
 }
 
-void Enemy::Update(const Stage& stage, const Player& player)
+void Enemy::PlanMotion(const Stage& stage, double time)
 {
-	if(not is_alive_) return;
+	const PhysicsScalar x = GetPhysicsX(time);
+	blocked_turn_count_ = 0;
+
+	if((behavior_ == EnemyBehavior::Stationary) || (speed_ == PhysicsScalar{}))
+	{
+		leg_ = MotionLeg{ time, x, Math::Inf, x, 0 };
+		return;
+	}
 
-	UpdateAI(stage);
-	anim_controller_.Update();
-	UpdateColliderPosition();
-	HandleCollision();
+	// 動いている途中ならその向きのまま，そうでなければ最初の向きで進む
+	const int32 direction = ((leg_.direction != 0) ? leg_.direction : ((velocity_.x > 0) ? 1 : -1));
+	PlanLeg(stage, time, x, direction);
 }
 
-void Enemy::UpdateAI(const Stage& stage)
+void Enemy::OnTurnaround(const Stage& stage)
 {
-	// 振る舞いに応じてロジックを更新
+	const double time = leg_.end_time;
+	const PhysicsScalar x = leg_.end_x;
+	const int32 direction = -leg_.direction;
+
+	blocked_turn_count_ = ((leg_.start_x == leg_.end_x) ? (blocked_turn_count_ + 1) : 0);
+
+	// 巡回する敵だけ向きに合わせて画像を反転する（BackAndForth はスプライトの向きを変えない）
 	if(behavior_ == EnemyBehavior::Patrol)
 	{
-		UpdatePatrol(stage);
+		is_facing_right_ = (direction > 0);
 	}
-	else if(behavior_ == EnemyBehavior::BackAndForth)
+
+	// 左右どちらにも進めない（壁に挟まれている）ときはその場で止める
+	if(blocked_turn_count_ >= 2)
 	{
-		UpdateBackAndForth(stage);
+		leg_ = MotionLeg{ time, x, Math::Inf, x, 0 };
+		return;
 	}
-	// Stationaryの場合は何もしない
+
+	PlanLeg(stage, time, x, direction);
 }
 
-void Enemy::UpdateColliderPosition()
+void Enemy::SetMotionState(const MotionState& state)
 {
-	std::visit([&](auto& shape)
-			   {
-				   if constexpr(std::is_same_v<std::decay_t<decltype(shape)>, s3d::Circle> ||
-								std::is_same_v<std::decay_t<decltype(shape)>, s3d::RectF>)
-				   {
-					   shape.setCenter(pos_);
-				   }
-			   }, collider_.shape);
+	leg_ = state.leg;
+	blocked_turn_count_ = state.blocked_turn_count;
+	is_facing_right_ = state.is_facing_right;
+	is_alive_ = state.is_alive;
 }
 
-void Enemy::HandleCollision()
+void Enemy::WriteMotionState(SnapshotWriter& writer, const MotionState& state)
 {
-	// 本ゲームでは特に敵側で行う処理なし
+	writer.Write(state.leg.start_time);
+	writer.Write(state.leg.start_x);
+	writer.Write(state.leg.end_time);
+	writer.Write(state.leg.end_x);
+	writer.Write(state.leg.direction);
+	writer.Write(state.blocked_turn_count);
+	writer.Write(state.is_facing_right);
+	writer.Write(state.is_alive);
 }
 
-// 巡回ロジック
-void Enemy::UpdatePatrol(const Stage& stage)
+bool Enemy::ReadMotionState(SnapshotReader& reader, MotionState& state)
 {
-	const double next_x = pos_.x + velocity_.x;
-	const double half_width = physics_size_.x / 2.0;
-	const double tile_size = stage.GetTileSize();
+	reader.Read(state.leg.start_time);
+	reader.Read(state.leg.start_x);
+	reader.Read(state.leg.end_time);
+	reader.Read(state.leg.end_x);
+	reader.Read(state.leg.direction);
+	reader.Read(state.blocked_turn_count);
+	reader.Read(state.is_facing_right);
+	reader.Read(state.is_alive);
+	return reader.IsValid();
+}
 
-	if(velocity_.x > 0) // 右に移動中
-	{
-		// collision_offset_を加えて早めに検知
-		const double sensor_x = next_x + half_width + collision_offset_;
-		const double sensor_y = pos_.y;
+void Enemy::PlanLeg(const Stage& stage, double time, PhysicsScalar x, int32 direction)
+{
+	const PhysicsScalar end_x = ((behavior_ == EnemyBehavior::Patrol)
+		? FindTurnaroundX(stage, x, direction)
+		: (PhysicsScalar(start_pos_.x) + (max_travel_distance_ * direction)));
 
-		if(stage.IsSolid(sensor_x, sensor_y))
-		{
-			pos_.x = (std::floor(sensor_x / tile_size) * tile_size) - half_width - collision_offset_;
-			velocity_.x *= -1.0;
-			is_facing_right_ = false;
-		}
-		else
-		{
-			pos_.x = next_x;
-		}
-	}
-	else if(velocity_.x < 0) // 左に移動中
-	{
-		// collision_offset_を加えて早めに検知
-		const double sensor_x = next_x - half_width - collision_offset_;
-		const double sensor_y = pos_.y;
+	// すでに向きを変える位置を越えていたら，その位置に戻してすぐに向きを変える
+	const PhysicsScalar distance = Max(((end_x - x) * direction), PhysicsScalar{});
+	const PhysicsScalar start_x = ((distance > PhysicsScalar{}) ? x : end_x);
 
-		if(stage.IsSolid(sensor_x, sensor_y))
-		{
-			pos_.x = (std::floor(sensor_x / tile_size) * tile_size) + tile_size + half_width + collision_offset_;
-			velocity_.x *= -1.0;
-			is_facing_right_ = true;
-		}
-		else
-		{
-			pos_.x = next_x;
-		}
-	}
+	leg_ = MotionLeg{ time, start_x, (time + Physics::TimeToTravel(distance, speed_)), end_x, direction };
 }
 
-// 前後往復ロジック
-void Enemy::UpdateBackAndForth(const Stage& stage)
+PhysicsScalar Enemy::FindTurnaroundX(const Stage& stage, PhysicsScalar x, int32 direction) const
 {
-	// 現在の移動方向に従って位置を更新
-	pos_.x += velocity_.x;
+	// 進む向きの端に collision_offset_ を加えた位置（センサー）が壁のタイルに入ったら向きを変える
+	const PhysicsScalar reach((physics_size_.x / 2.0) + collision_offset_);
+	const int32 tile_size = stage.GetTileSize();
+	const int32 tile_y = Physics::ToTile(pos_.y, tile_size);
+	const int32 sensor_tile_x = Physics::ToTile((x + (reach * direction)), tile_size);
 
-	// 開始位置からの移動距離を計算
-	const double distance_from_start = std::abs(pos_.x - start_pos_.x);
-
-	// 最大移動距離に達したら方向を反転
-	if(distance_from_start >= max_travel_distance_)
+	// センサーがいる空きタイルの並びの端までは壁に当たらない
+	if(const auto run = stage.GetOpenRun(sensor_tile_x, tile_y))
 	{
-		// 方向反転（スプライトの向きは変えない）
-		velocity_.x *= -1.0;
+		return ((direction > 0)
+			? (PhysicsScalar((run->last_x + 1) * tile_size) - reach)
+			: (PhysicsScalar(run->first_x * tile_size) + reach));
+	}
 
-		// 距離をリセット
-		travel_distance_ = 0.0;
+	// センサーがすでに壁の中にあるときは，その壁の手前
+	return ((direction > 0)
+		? (PhysicsScalar(sensor_tile_x * tile_size) - reach)
+		: (PhysicsScalar((sensor_tile_x + 1) * tile_size) + reach));
+}
 
-		// 正確な位置に補正（行き過ぎを防ぐ）
-		if(velocity_.x > 0)
-		{
-			pos_.x = start_pos_.x - max_travel_distance_;
-		}
-		else
-		{
-			pos_.x = start_pos_.x + max_travel_distance_;
-		}
+PhysicsScalar Enemy::GetPhysicsX(double time) const
+{
+	if(leg_.direction == 0)
+	{
+		return leg_.start_x;
 	}
+
+	// 固定小数点では向きを変えるのが整数回目の更新になるので，それまでは終点で止めておく
+	const double elapsed = (Min(time, leg_.end_time) - leg_.start_time);
+	const PhysicsScalar travel = Min(Physics::Travel(speed_, elapsed), Abs(leg_.end_x - leg_.start_x));
+	return (leg_.start_x + (travel * leg_.direction));
+}
+
+Vec2 Enemy::GetPos(double time) const
+{
+	return Vec2{ Physics::ToDouble(GetPhysicsX(time)), pos_.y };
+}
+
+void Enemy::UpdateColliderPosition(double time)
+{
+	const Vec2 pos = GetPos(time);
+	std::visit([&](auto& shape)
+			   {
+				   if constexpr(std::is_same_v<std::decay_t<decltype(shape)>, s3d::Circle> ||
+								std::is_same_v<std::decay_t<decltype(shape)>, s3d::RectF>)
+				   {
+					   shape.setCenter(pos);
+				   }
+			   }, collider_.shape);
 }
 
-void Enemy::Draw(const Vec2& camera_offset) const
+void Enemy::Draw(const Vec2& camera_offset, double time, const SimClock& clock, RenderQueue& render_queue) const
 {
 	if(not is_alive_) return;
 
-	if(auto texture_asset = anim_controller_.GetCurrentTextureAsset())
+	if(auto texture_asset = anim_controller_.GetCurrentTextureAsset(clock))
 	{
-		const Vec2 draw_pos = pos_ - camera_offset;
-		const Vec2 final_draw_pos = s3d::Floor(draw_pos);
+		const Vec2 draw_pos = GetPos(time) - camera_offset;
 
 		if(is_facing_right_)
 		{
-			texture_asset->mirrored().drawAt(final_draw_pos);
+			render_queue.SubmitAt(RenderLayer::Enemy, texture_asset->mirrored(), draw_pos);
 		}
 		else
 		{
-			texture_asset->drawAt(final_draw_pos);
+			render_queue.SubmitAt(RenderLayer::Enemy, *texture_asset, draw_pos);
 		}
 	}
 }
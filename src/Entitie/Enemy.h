@@ -1,14 +1,14 @@
 ﻿#pragma once
 
+#include "../Core/Fixed.h"
+#include "../Core/RenderQueue.h"
+#include "../Core/StateSnapshot.h"
 #include "../World/Stage.h"
 #include "Component/AnimationController.h"
 #include "Component/Collider.h"
 
 #include <Siv3D.hpp>
 
-// 前方宣言
-class Player;
-
 // 敵の振る舞いの種類
 enum class EnemyBehavior
 {
@@ -22,44 +22,114 @@ class Enemy
 public:
 	Enemy(const String& type, const Vec2& center_pos);
 
-	void Update(const Stage& stage, const Player& player);
+	// 時刻 time（敵の更新1回 = 1）から先の動きを決め直す
+	// 配置した直後と，ステージの当たり判定が書き換わったときに呼ぶ
+	void PlanMotion(const Stage& stage, double time);
+
+	// 向きを変える時刻（GetNextTurnTime()）になったら呼ぶ．向きを変え，次に向きを変える時刻を求める
+	void OnTurnaround(const Stage& stage);
+
+	// 次に向きを変える時刻（動かない敵は無限大）
+	double GetNextTurnTime() const { return leg_.end_time; }
+
+	// 時刻 time での位置（動きの予定から計算する）
+	Vec2 GetPos(double time) const;
 
-	void Draw(const Vec2& camera_offset) const;
+	// コライダーを時刻 time の位置に合わせる
+	void UpdateColliderPosition(double time);
+
+	void Draw(const Vec2& camera_offset, double time, const SimClock& clock, RenderQueue& render_queue) const;
 
 	Collider& GetCollider() { return collider_; }
 	const Collider& GetCollider() const { return collider_; }
 
 	bool IsAlive() const { return is_alive_; }
 
+	// 知っている種類か（知らない種類は Coral の画像で止めておく．警告は配置した GameWorld が溜める）
+	bool IsKnownType() const { return is_known_type_; }
+
+	// 画像が描かれる範囲（ワールド座標）．画面外判定に使う
+	RectF GetDrawBounds(double time) const { return RectF{ Arg::center(GetPos(time)), sprite_size_ }; }
+
+	// 配置された位置（ステージの区間を捨てるときに，どの区間の敵かを調べるのに使う）
+	const Vec2& GetSpawnPos() const { return start_pos_; }
+
+	// start_x から end_x まで一定の速さで進む区間（direction は -1, 0, 1）
+	// 時刻は更新の回数なので，BNS_FIXED_POINT_PHYSICS でも double で正確に表せる
+	struct MotionLeg
+	{
+		double start_time = 0.0;
+		PhysicsScalar start_x{};
+		double end_time = Math::Inf;
+		PhysicsScalar end_x{};
+		int32 direction = 0;
+	};
+
+	// 巻き戻しで写す状態
+	// 位置と速度は動きの予定から計算できるので，予定だけを持つ
+	struct MotionState
+	{
+		MotionLeg leg;
+		int32 blocked_turn_count = 0;
+		bool is_facing_right = false;
+		bool is_alive = true;
+	};
+
+	MotionState GetMotionState() const { return MotionState{ leg_, blocked_turn_count_, is_facing_right_, is_alive_ }; }
+	void SetMotionState(const MotionState& state);
+
+	// MotionState を1項目ずつ詰める／戻す（構造体ごと写すと，詰め物の不定なバイトまで書いてしまう）
+	static void WriteMotionState(SnapshotWriter& writer, const MotionState& state);
+	static bool ReadMotionState(SnapshotReader& reader, MotionState& state);
+
+	// アニメーションの状態を詰める／戻す
+	void SaveAnimationState(SnapshotWriter& writer) const { anim_controller_.SaveState(writer); }
+	bool LoadAnimationState(SnapshotReader& reader) { return anim_controller_.LoadState(reader); }
+
 private:
-	void UpdatePatrol(const Stage& stage);
-	void UpdateBackAndForth(const Stage& stage);
 
 	void SetupProperties(const String& type);
 	void SetupAnimations(const String& type);
 
-	void UpdateAI(const Stage& stage);
-	void UpdateColliderPosition();
-	void HandleCollision();
+	// 時刻 time に x から direction の向きへ進む区間を作る
+	void PlanLeg(const Stage& stage, double time, PhysicsScalar x, int32 direction);
+
+	// x から direction の向きへ進んだときに向きを変える位置
+	PhysicsScalar FindTurnaroundX(const Stage& stage, PhysicsScalar x, int32 direction) const;
+
+	// 時刻 time でのX座標
+	PhysicsScalar GetPhysicsX(double time) const;
 
 	EnemyBehavior behavior_;
 
+	// 配置された位置（Y座標は動かない）
 	Vec2 pos_;
+
+	// 最初の向きと速さ（1回の更新で進む距離）
 	Vec2 velocity_ = Vec2::Zero();
+	PhysicsScalar speed_{};
+
+	MotionLeg leg_;
+
+	// 続けて1マスも進めずに向きを変えた回数（左右どちらにも進めないときは止める）
+	int32 blocked_turn_count_ = 0;
 
 	// 物理演算(壁との当たり判定)用のサイズ
 	Vec2 physics_size_;
 
+	// 画像のサイズ（未知のタイプは Coral の画像で代用される）
+	Vec2 sprite_size_ = kCoralSpriteSize;
+
 	// 壁との衝突検知のオフセット（大きいほど早く反転）
 	double collision_offset_ = 0.0;
 
 	bool is_alive_ = true;
+	bool is_known_type_ = true;
 	bool is_facing_right_ = false;
 
 	// BackAndForth用の変数
 	Vec2 start_pos_ = Vec2::Zero();
-	double travel_distance_ = 0.0;
-	double max_travel_distance_ = 0.0;
+	PhysicsScalar max_travel_distance_{};
 
 	AnimationController anim_controller_;
 	Collider collider_{ Circle{0,0,1}, ColliderTag::kEnemy };
@@ -73,6 +143,15 @@ private:
 	static constexpr Size kMorayEelPhysicsSize = { 48, 32 };
 	static constexpr Size kOctolegPhysicsSize = { 40, 40 };
 
+	static constexpr Size kFishSpriteSize = { 64, 64 };
+	static constexpr Size kCoralSpriteSize = { 128, 128 };
+	static constexpr Size kClioneSpriteSize = { 64, 64 };
+	static constexpr Size kSharkSpriteSize = { 384, 128 };
+	static constexpr Size kDeepseaFishSpriteSize = { 64, 64 };
+	static constexpr Size kSwimmieSpriteSize = { 128, 64 };
+	static constexpr Size kMorayEelSpriteSize = { 256, 64 };
+	static constexpr Size kOctolegSpriteSize = { 448, 192 };
+
 	static constexpr Size kFishColliderSize = { 32, 24 };
 	static constexpr double kCoralColliderRadius = 28.0;
 	static constexpr Size kClioneColliderSize = { 18, 24 };
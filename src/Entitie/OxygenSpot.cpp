@@ -31,8 +31,6 @@ void OxygenSpot::SetupAnimation()
 
 void OxygenSpot::Update()
 {
-	anim_controller_.Update();
-
 	// コライダーの中心をスポット位置に追従させる
 	UpdateColliderCenter();
 }
@@ -51,13 +49,12 @@ void OxygenSpot::UpdateColliderCenter()
 			   }, collider_.shape);
 }
 
-void OxygenSpot::Draw(const Vec2& camera_offset) const
+void OxygenSpot::Draw(const Vec2& camera_offset, const SimClock& clock, RenderQueue& render_queue) const
 {
-	if(auto texture_asset = anim_controller_.GetCurrentTextureAsset())
+	if(auto texture_asset = anim_controller_.GetCurrentTextureAsset(clock))
 	{
 		const Vec2 draw_pos = pos_ - camera_offset;
-		const Vec2 final_draw_pos = s3d::Floor(draw_pos);
-		texture_asset->drawAt(final_draw_pos);
+		render_queue.SubmitAt(RenderLayer::OxygenSpot, *texture_asset, draw_pos);
 	}
 }
 
@@ -1,5 +1,6 @@
 ﻿#pragma once
 
+#include "../Core/RenderQueue.h"
 #include "../World/Stage.h"
 #include "Component/AnimationController.h"
 #include "Component/Collider.h"
@@ -13,10 +14,13 @@ public:
 
 	void Update();
 
-	void Draw(const Vec2& camera_offset) const;
+	void Draw(const Vec2& camera_offset, const SimClock& clock, RenderQueue& render_queue) const;
 
 	Vec2 GetPos() const;
 
+	// 画像が描かれる範囲（ワールド座標）．画面外判定に使う
+	RectF GetDrawBounds() const { return RectF{ Arg::center(pos_), kSpriteSize }; }
+
 	// GameSceneが当たり判定に使う
 	Collider& GetCollider() { return collider_; }
 	const Collider& GetCollider() const { return collider_; }
@@ -33,4 +37,6 @@ private:
 
 	// コライダーの形状に応じて中心を更新するヘルパー
 	void UpdateColliderCenter();
+
+	static constexpr Size kSpriteSize = { 64, 192 };
 };
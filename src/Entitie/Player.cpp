@@ -1,16 +1,23 @@
-﻿#include "../Core/Config.h"
-#include "../Core/Utility.h"
+﻿#include "../Core/Utility.h"
 #include "../World/Stage.h"
+#include "../World/TileSweep.h"
 #include "Component/Animation.h"
 #include "Player.h"
 
 #include <Siv3D.hpp>
 
-Player::Player()
+Player::Player(bool is_audible)
 	: oxygen_(kMaxOxygen)
 {
 	SetupAnimations();
 	anim_controller_.Play(U"float_idle");
+
+	// 鳴らさないプレイヤーでは番号が無効なままになり，SfxEngine を作りもしない
+	if(is_audible)
+	{
+		swim_sound_id_ = SfxEngine::GetInstance().GetOrCreateId(U"water_craw");
+		damage_sound_id_ = SfxEngine::GetInstance().GetOrCreateId(U"damage2");
+	}
 }
 
 void Player::SetupAnimations()
@@ -67,65 +74,68 @@ void Player::SetupAnimations()
 	anim_controller_.AddAnimation(U"ending", ending_animation);
 }
 
-void Player::Update(const Stage& stage)
+void Player::Update(const Stage& stage, const SimClock& clock, const GameInput& input)
 {
-	just_took_damage_ = false;
+	const uint64 tick = clock.GetTick();
+
 	UpdateOxygen();
 
 	// 入力は条件がシンプルなので先にチェック
 	if(not is_oxygen_empty_ && not is_in_ending_)
 	{
-		HandleInput();
+		HandleInput(input, tick);
 	}
 
 	UpdatePhysics(stage);
-	UpdateAnimation();
+	UpdateAnimation(tick);
 
-	anim_controller_.Update();
-
-	if(is_invincible_ && invincible_timer_.sF() > kInvincibleDurationSec)
+	if(is_invincible_ && ((tick - invincible_start_tick_) > kInvincibleDurationTicks))
 	{
 		is_invincible_ = false; // 無敵時間終了
 	}
 
 	// 衝突処理は独立関数に切り出し
-	HandleCollisions();
+	HandleCollisions(tick);
 }
 
 // 入力処理
-void Player::HandleInput()
+void Player::HandleInput(const GameInput& input, uint64 tick)
 {
 	is_moving_x_ = false;
-	if(kInputLeft.pressed())
+	if(input.left)
 	{
 		velocity_.x = Max(velocity_.x - horizontal_accel_, -horizontal_speed_max_);
 		is_moving_x_ = true;
 		is_facing_right_ = false;
 	}
-	else if(kInputRight.pressed())
+	else if(input.right)
 	{
 		velocity_.x = Min(velocity_.x + horizontal_accel_, horizontal_speed_max_);
 		is_moving_x_ = true;
 		is_facing_right_ = true;
 	}
 
-	if(kInputAction1.down())
+	if(input.swim)
 	{
-		OnSwimPressed();
+		OnSwimPressed(tick);
 	}
 }
 
-void Player::OnSwimPressed()
+void Player::OnSwimPressed(uint64 tick)
 {
 	velocity_.y = swim_power_;
-	anim_controller_.Play(U"float_idle");
-	anim_controller_.Play(U"swim");
+	anim_controller_.Play(U"float_idle", tick);
+	anim_controller_.Play(U"swim", tick);
 
 	// swim時に酸素を少し消費
 	ModifyOxygen(-kOxygenSwimCost);
 
 	// 効果音は非同期ロード次第で再生されるため、呼び出しは安全
-	sound_controller_.Play(U"water_craw", false);
+	// 連打しても前の音を止めずに重ねて鳴らす（同時発音数は AssetInformation.json で指定）
+	if(swim_sound_id_ != kInvalidSoundId)
+	{
+		SfxEngine::GetInstance().Play(swim_sound_id_);
+	}
 }
 
 // 物理演算と位置更新
@@ -134,27 +144,26 @@ void Player::UpdatePhysics(const Stage& stage)
 	// エンディング中でワープ有効時は中心にLerp
 	if(is_in_ending_ && ending_warp_enabled_)
 	{
-		double dx = ending_target_x_ - pos_.x;
-		pos_.x = Math::Lerp(pos_.x, ending_target_x_, ending_warp_lerp_);
-		if(std::abs(dx) <= ending_snap_threshold_)
+		const PhysicsScalar dx = ending_target_x_ - pos_.x;
+		pos_.x += (dx * ending_warp_lerp_);
+		if(Abs(dx) <= ending_snap_threshold_)
 		{
 			pos_.x = ending_target_x_;
 			ending_warp_enabled_ = false;
-			velocity_.x = 0.0;
+			velocity_.x = PhysicsScalar{};
 			is_moving_x_ = false;
 		}
 	}
 
 	ApplyGravity();
 	ApplyFriction();
-	MoveX(stage);
-	MoveY(stage);
+	Move(stage);
 	UpdateColliderPosition();
 }
 
 void Player::ApplyGravity()
 {
-	if(velocity_.y < 0)
+	if(velocity_.y < PhysicsScalar{})
 	{
 		velocity_.y += (gravity_ * rising_gravity_multiplier_);
 	}
@@ -170,120 +179,76 @@ void Player::ApplyFriction()
 	if(not is_moving_x_)
 	{
 		velocity_.x *= friction_;
-		if(std::abs(velocity_.x) < 0.1)
+		if(Abs(velocity_.x) < kStopSpeed)
 		{
-			velocity_.x = 0.0;
+			velocity_.x = PhysicsScalar{};
 		}
 	}
 }
 
-void Player::MoveX(const Stage& stage)
+void Player::Move(const Stage& stage)
 {
-	double next_x = pos_.x + velocity_.x;
-	double tile_size = stage.GetTileSize();
+	is_grounded_ = false;
 
-	if(velocity_.x > 0)
+	// 1フレームの移動量を一度に掃引するので，タイルより速く動いてもすり抜けない
+	PhysicsVec2 remaining = velocity_;
+	for(int32 i = 0; i < kMaxSlideIterations; ++i)
 	{
-		double sensor_x = next_x + kPhysicsHalfWidth;
-		double sensor_y_top = pos_.y - kPhysicsHalfHeight + 1.0;
-		double sensor_y_bot = pos_.y + kPhysicsHalfHeight - 1.0;
-		double sensor_y_mid = pos_.y;
-
-		if(stage.IsSolid(sensor_x, sensor_y_top) || stage.IsSolid(sensor_x, sensor_y_mid) || stage.IsSolid(sensor_x, sensor_y_bot))
+		if(remaining.isZero())
 		{
-			pos_.x = (std::floor(sensor_x / tile_size) * tile_size) - kPhysicsHalfWidth;
-			velocity_.x = 0;
+			break;
 		}
-		else
-		{
-			pos_.x = next_x;
-		}
-	}
-	else if(velocity_.x < 0)
-	{
-		double sensor_x = next_x - kPhysicsHalfWidth;
-		double sensor_y_top = pos_.y - kPhysicsHalfHeight + 1.0;
-		double sensor_y_bot = pos_.y + kPhysicsHalfHeight - 1.0;
-		double sensor_y_mid = pos_.y;
 
-		if(stage.IsSolid(sensor_x, sensor_y_top) || stage.IsSolid(sensor_x, sensor_y_mid) || stage.IsSolid(sensor_x, sensor_y_bot))
+		const auto hit = TileSweep::SweepBox(stage, pos_, kPhysicsHalfSize, remaining);
+		pos_ += (remaining * hit.time);
+		if(not hit.is_hit)
 		{
-			pos_.x = (std::floor(sensor_x / tile_size) * tile_size) + tile_size + kPhysicsHalfWidth;
-			velocity_.x = 0;
+			break;
 		}
-		else
-		{
-			pos_.x = next_x;
-		}
-	}
-}
-
-void Player::MoveY(const Stage& stage)
-{
-	double next_y = pos_.y + velocity_.y;
-	double tile_size = stage.GetTileSize();
-	is_grounded_ = false;
 
-	if(velocity_.y > 0)
-	{
-		double sensor_y = next_y + kPhysicsHalfHeight;
-		double sensor_x_left = pos_.x - kPhysicsHalfWidth + 1.0;
-		double sensor_x_right = pos_.x + kPhysicsHalfWidth - 1.0;
-		if(stage.IsSolid(sensor_x_left, sensor_y) || stage.IsSolid(sensor_x_right, sensor_y))
-		{
-			pos_.y = (std::floor(sensor_y / tile_size) * tile_size) - kPhysicsHalfHeight;
-			velocity_.y = 0;
-			is_grounded_ = true;
-		}
-		else
-		{
-			pos_.y = next_y;
-		}
-	}
-	else if(velocity_.y < 0 && (not just_took_damage_))
-	{
-		double sensor_y = next_y - kPhysicsHalfHeight;
-		double sensor_x_left = pos_.x - kPhysicsHalfWidth + 1.0;
-		double sensor_x_right = pos_.x + kPhysicsHalfWidth - 1.0;
-		if(stage.IsSolid(sensor_x_left, sensor_y) || stage.IsSolid(sensor_x_right, sensor_y))
+		// 当たった面に垂直な成分だけを止めて，残りで滑らせる
+		remaining *= (PhysicsScalar(1.0) - hit.time);
+		if(hit.normal.x != 0)
 		{
-			pos_.y = (std::floor(sensor_y / tile_size) * tile_size) + tile_size + kPhysicsHalfHeight;
-			velocity_.y = 0;
+			remaining.x = PhysicsScalar{};
+			velocity_.x = PhysicsScalar{};
 		}
-		else
+		if(hit.normal.y != 0)
 		{
-			pos_.y = next_y;
+			remaining.y = PhysicsScalar{};
+			velocity_.y = PhysicsScalar{};
+
+			if(hit.normal.y < 0)
+			{
+				is_grounded_ = true;
+			}
 		}
 	}
-	else if(velocity_.y < 0)
-	{
-		pos_.y = next_y;
-	}
 }
 
 void Player::UpdateColliderPosition()
 {
-	collider.shape = RectF{ Arg::center(pos_), kColliderWidth, kColliderHeight };
+	collider.shape = GetColliderRect();
 }
 
 // アニメーション制御
-void Player::UpdateAnimation()
+void Player::UpdateAnimation(uint64 tick)
 {
 	if(is_in_ending_)
 	{
-		// エンディング開始から3秒経過したらendingアニメーションを再生
-		if(ending_timer_.sF() >= kEndingAnimationDelaySec)
+		// エンディング開始から7秒経過したらendingアニメーションを再生
+		if((tick - ending_start_tick_) >= kEndingAnimationDelayTicks)
 		{
 			if(not anim_controller_.IsPlaying(U"ending"))
 			{
-				anim_controller_.Play(U"ending");
+				anim_controller_.Play(U"ending", tick);
 			}
 		}
 		else
 		{
 			if(not anim_controller_.IsPlaying(U"float_idle"))
 			{
-				anim_controller_.Play(U"float_idle");
+				anim_controller_.Play(U"float_idle", tick);
 			}
 		}
 		return;
@@ -295,22 +260,22 @@ void Player::UpdateAnimation()
 		{
 			return;
 		}
-		anim_controller_.Play(U"dead");
+		anim_controller_.Play(U"dead", tick);
 
 		return;
 	}
 
 	if(anim_controller_.IsPlaying(U"swim"))
 	{
-		if(velocity_.y > 0)
+		if(velocity_.y > PhysicsScalar{})
 		{
 			if(is_moving_x_)
 			{
-				anim_controller_.Play(U"float_move");
+				anim_controller_.Play(U"float_move", tick);
 			}
 			else
 			{
-				anim_controller_.Play(U"float_idle");
+				anim_controller_.Play(U"float_idle", tick);
 			}
 		}
 	}
@@ -320,32 +285,33 @@ void Player::UpdateAnimation()
 		{
 			if(is_moving_x_)
 			{
-				anim_controller_.Play(U"walk");
+				anim_controller_.Play(U"walk", tick);
 			}
 			else
 			{
-				anim_controller_.Play(U"ground_idle");
+				anim_controller_.Play(U"ground_idle", tick);
 			}
 		}
 		else
 		{
 			if(is_moving_x_)
 			{
-				anim_controller_.Play(U"float_move");
+				anim_controller_.Play(U"float_move", tick);
 			}
 			else
 			{
-				anim_controller_.Play(U"float_idle");
+				anim_controller_.Play(U"float_idle", tick);
 			}
 		}
 	}
 }
 
-void Player::Draw(const Vec2& camera_offset) const
+void Player::Draw(const Vec2& camera_offset, const SimClock& clock, RenderQueue& render_queue) const
 {
 	if(is_invincible_)
 	{
-		if((invincible_timer_.ms() % kBlinkIntervalMs) < kBlinkOnDurationMs)
+		const uint64 invincible_ticks = ((clock.GetTick() > invincible_start_tick_) ? (clock.GetTick() - invincible_start_tick_) : 0);
+		if((invincible_ticks % kBlinkIntervalTicks) < kBlinkOnDurationTicks)
 		{
 		}
 		else
@@ -354,35 +320,36 @@ void Player::Draw(const Vec2& camera_offset) const
 		}
 	}
 
-	if(auto texture_asset = anim_controller_.GetCurrentTextureAsset())
+	if(auto texture_asset = anim_controller_.GetCurrentTextureAsset(clock))
 	{
 		// エンディングアニメーション用の特別な描画オフセット
 		const Vec2 draw_offset = anim_controller_.IsPlaying(U"ending") ? kEndingDrawOffset : kDrawOffset;
-		const Vec2 top_left_pos = pos_ - draw_offset;
+		const Vec2 top_left_pos = GetPos() - draw_offset;
 		const Vec2 draw_pos = top_left_pos - camera_offset;
-		const Vec2 final_draw_pos = s3d::Floor(draw_pos);
 
 		if(is_facing_right_)
 		{
-			texture_asset->mirrored().draw(final_draw_pos);
+			render_queue.Submit(RenderLayer::Player, texture_asset->mirrored(), draw_pos);
 		}
 		else
 		{
-			texture_asset->draw(final_draw_pos);
+			render_queue.Submit(RenderLayer::Player, *texture_asset, draw_pos);
 		}
 	}
 	else
 	{
-		RectF{ Arg::center(s3d::Floor(pos_ - camera_offset)),32,32 }.drawFrame(2, 0, Palette::Red);
+		RectF{ Arg::center(GetPos() - camera_offset),32,32 }.drawFrame(2, 0, Palette::Red);
 	}
 }
 
-Vec2 Player::GetPos() const { return pos_; }
+Vec2 Player::GetPos() const { return Physics::ToVec2(pos_); }
+
+Vec2 Player::GetVelocity() const { return Physics::ToVec2(velocity_); }
 
 void Player::SetPos(const Vec2& new_pos)
 {
-	pos_ = new_pos;
-	velocity_ = Vec2::Zero();
+	pos_ = Physics::FromVec2(new_pos);
+	velocity_ = PhysicsVec2::Zero();
 }
 
 void Player::UpdateOxygen()
@@ -426,22 +393,24 @@ void Player::RecoverOxygen()
 	ModifyOxygen(kOxygenRecoveryPerFrame);
 }
 
-void Player::TakeDamage()
+void Player::TakeDamage(uint64 tick)
 {
 	if(is_invincible_ || is_oxygen_empty_ || is_in_ending_)
 	{
 		return;
 	}
 
-	velocity_.x += (is_facing_right_ ? -2.5 : 2.5);
+	velocity_.x += (is_facing_right_ ? -kKnockbackSpeed : kKnockbackSpeed);
 
 	ModifyOxygen(-kOxygenDamageAmount);
 
-	just_took_damage_ = true;
 	is_invincible_ = true;
-	invincible_timer_.restart();
+	invincible_start_tick_ = tick;
 
-	sound_controller_.Play(U"damage2", false);
+	if(damage_sound_id_ != kInvalidSoundId)
+	{
+		SfxEngine::GetInstance().Play(damage_sound_id_);
+	}
 }
 
 double Player::GetOxygen() const { return oxygen_; }
@@ -450,34 +419,103 @@ double Player::GetMaxOxygen() const { return kMaxOxygen; }
 
 bool Player::IsOxygenEmpty() const { return is_oxygen_empty_; }
 
-void Player::Respawn(const Vec2& spawn_pos)
+void Player::Respawn(const Vec2& spawn_pos, const SimClock& clock)
 {
-	pos_ = spawn_pos;
-	velocity_ = Vec2::Zero();
+	pos_ = Physics::FromVec2(spawn_pos);
+	velocity_ = PhysicsVec2::Zero();
 	oxygen_ = kMaxOxygen;
 	is_oxygen_empty_ = false;
 
 	is_in_ending_ = false;
 
 	is_invincible_ = true;
-	invincible_timer_.restart();
+	invincible_start_tick_ = clock.GetTick();
 
-	anim_controller_.Play(U"float_idle");
+	anim_controller_.Play(U"float_idle", clock.GetTick());
 }
 
-void Player::StartEnding(double camera_center_world_x)
+void Player::StartEnding(double camera_center_world_x, const SimClock& clock)
 {
 	is_in_ending_ = true;
-	ending_target_x_ = camera_center_world_x + 80.0;
+	ending_target_x_ = PhysicsScalar(camera_center_world_x + 80.0);
 	ending_warp_enabled_ = true;
 
-	velocity_.y = 0.0;
-	velocity_.x = 0.0;
+	velocity_ = PhysicsVec2::Zero();
 
-	ending_timer_.restart();
+	ending_start_tick_ = clock.GetTick();
+}
+
+void Player::SaveState(SnapshotWriter& writer) const
+{
+	writer.Write(pos_);
+	writer.Write(velocity_);
+	writer.Write(is_moving_x_);
+	writer.Write(is_grounded_);
+	writer.Write(is_facing_right_);
+	writer.Write(is_invincible_);
+	writer.Write(invincible_start_tick_);
+	writer.Write(oxygen_);
+	writer.Write(is_oxygen_empty_);
+	writer.Write(is_in_ending_);
+	writer.Write(ending_start_tick_);
+	writer.Write(ending_target_x_);
+	writer.Write(ending_warp_enabled_);
+
+	anim_controller_.SaveState(writer);
+}
+
+bool Player::LoadState(SnapshotReader& reader)
+{
+	// アニメーションは読めたときだけ切り替わるので，最後に読む
+	SavedState state;
+	if((not ReadSavedState(reader, state)) || (not anim_controller_.LoadState(reader)))
+	{
+		return false;
+	}
+
+	pos_ = state.pos;
+	velocity_ = state.velocity;
+	is_moving_x_ = state.is_moving_x;
+	is_grounded_ = state.is_grounded;
+	is_facing_right_ = state.is_facing_right;
+	is_invincible_ = state.is_invincible;
+	invincible_start_tick_ = state.invincible_start_tick;
+	oxygen_ = state.oxygen;
+	is_oxygen_empty_ = state.is_oxygen_empty;
+	is_in_ending_ = state.is_in_ending;
+	ending_start_tick_ = state.ending_start_tick;
+	ending_target_x_ = state.ending_target_x;
+	ending_warp_enabled_ = state.ending_warp_enabled;
+
+	UpdateColliderPosition();
+	return true;
+}
+
+bool Player::SkipState(SnapshotReader& reader)
+{
+	SavedState state;
+	return (ReadSavedState(reader, state) && AnimationController::SkipState(reader));
+}
+
+bool Player::ReadSavedState(SnapshotReader& reader, SavedState& state)
+{
+	reader.Read(state.pos);
+	reader.Read(state.velocity);
+	reader.Read(state.is_moving_x);
+	reader.Read(state.is_grounded);
+	reader.Read(state.is_facing_right);
+	reader.Read(state.is_invincible);
+	reader.Read(state.invincible_start_tick);
+	reader.Read(state.oxygen);
+	reader.Read(state.is_oxygen_empty);
+	reader.Read(state.is_in_ending);
+	reader.Read(state.ending_start_tick);
+	reader.Read(state.ending_target_x);
+	reader.Read(state.ending_warp_enabled);
+	return reader.IsValid();
 }
 
-void Player::HandleCollisions()
+void Player::HandleCollisions(uint64 tick)
 {
 	if((not is_invincible_) && (not is_oxygen_empty_) && (not is_in_ending_) && collider.is_colliding)
 	{
@@ -485,7 +523,7 @@ void Player::HandleCollisions()
 		{
 			if(tag == ColliderTag::kEnemy)
 			{
-				TakeDamage();
+				TakeDamage(tick);
 				break;
 			}
 		}
@@ -1,21 +1,31 @@
 ﻿#pragma once
 
+#include "../Audio/SfxEngine.h"
+#include "../Core/Fixed.h"
+#include "../Core/GameInput.h"
+#include "../Core/RenderQueue.h"
+#include "../Core/SimClock.h"
+#include "../Core/StateSnapshot.h"
 #include "../World/Stage.h"
 #include "Component/AnimationController.h"
 #include "Component/Collider.h"
-#include "Component/SoundController.h"
 
 #include <Siv3D.hpp>
 
 class Player
 {
 public:
-	Player();
+	// is_audible でなければ効果音を引かない（同時に動かすワールドで SfxEngine に触らないように）
+	explicit Player(bool is_audible = true);
 
-	void Update(const Stage& stage);
-	void Draw(const Vec2& camera_offset) const;
+	// clock は今の更新のティックまで進めてから渡す．input はそのティックの入力
+	void Update(const Stage& stage, const SimClock& clock, const GameInput& input);
+	void Draw(const Vec2& camera_offset, const SimClock& clock, RenderQueue& render_queue) const;
 
 	Vec2 GetPos() const;
+
+	// 1回の Update で進む量[px]
+	Vec2 GetVelocity() const;
 	void SetPos(const Vec2& new_pos);
 
 	double GetOxygen() const;
@@ -23,52 +33,86 @@ public:
 	bool IsOxygenEmpty() const;
 	void RecoverOxygen();
 
-	void Respawn(const Vec2& spawn_pos);
+	void Respawn(const Vec2& spawn_pos, const SimClock& clock);
+
+	void StartEnding(double camera_center_world_x, const SimClock& clock);
+
+	// 巻き戻し・中断セーブ用に，動き・酸素・無敵時間・アニメーションの状態を詰める／戻す
+	// LoadState は最後まで読めたときだけ書き換える（途中で足りなくなったら何も変えずに false）
+	void SaveState(SnapshotWriter& writer) const;
+	bool LoadState(SnapshotReader& reader);
 
-	void StartEnding(double camera_center_world_x);
+	// 戻さずに読み飛ばす（足りなければ false）
+	static bool SkipState(SnapshotReader& reader);
 
 	Collider collider{ RectF{0, 0, 1.0, 1.0}, ColliderTag::kPlayer };
 
+	// 敵・酸素スポットとの当たり判定に使う範囲（collider の形と同じ）
+	RectF GetColliderRect() const { return RectF{ Arg::center(GetPos()), kColliderWidth, kColliderHeight }; }
+
 private:
-	void HandleInput();
+	void HandleInput(const GameInput& input, uint64 tick);
 	void UpdatePhysics(const Stage& stage);
 
 	void ApplyGravity();
 	void ApplyFriction();
-	void MoveX(const Stage& stage);
-	void MoveY(const Stage& stage);
-	void UpdateColliderPosition();
+	// 速度の分だけ動かす．壁に当たったら接触位置で止め，残りの移動は壁に沿って滑らせる
+	void Move(const Stage& stage);
 
-	void UpdateAnimation();
+	void UpdateColliderPosition();
 
-	void TakeDamage();
+	void UpdateAnimation(uint64 tick);
+
+	// SaveState で詰める状態のうち，アニメーション以外
+	struct SavedState
+	{
+		PhysicsVec2 pos;
+		PhysicsVec2 velocity;
+		bool is_moving_x = false;
+		bool is_grounded = false;
+		bool is_facing_right = false;
+		bool is_invincible = false;
+		uint64 invincible_start_tick = 0;
+		double oxygen = 0.0;
+		bool is_oxygen_empty = false;
+		bool is_in_ending = false;
+		uint64 ending_start_tick = 0;
+		PhysicsScalar ending_target_x{};
+		bool ending_warp_enabled = false;
+	};
+
+	static bool ReadSavedState(SnapshotReader& reader, SavedState& state);
+
+	void TakeDamage(uint64 tick);
 
 	void UpdateOxygen();
 	void ModifyOxygen(double amount);
 
 	// Refactor helpers
 	void SetupAnimations();
-	void OnSwimPressed();
-	void HandleCollisions();
+	void OnSwimPressed(uint64 tick);
+	void HandleCollisions(uint64 tick);
 
-	Vec2 pos_{ 0.0, 0.0 };
-	Vec2 velocity_{ 0.0, 0.0 };
+	// 位置と速度は PhysicsScalar で持つ（BNS_FIXED_POINT_PHYSICS では固定小数点）
+	PhysicsVec2 pos_ = PhysicsVec2::Zero();
+	PhysicsVec2 velocity_ = PhysicsVec2::Zero();
 
 	bool is_moving_x_ = false;
 	bool is_grounded_ = false;
 	bool is_facing_right_ = false;
 
+	// 時間は SimClock のティックで数える
 	bool is_invincible_ = false;
-	s3d::Stopwatch invincible_timer_;
-	static constexpr double kInvincibleDurationSec = 2.7;	// 無敵時間
-	static constexpr int32 kBlinkIntervalMs = 300;			// 点滅の間隔
-	static constexpr int32 kBlinkOnDurationMs = 150;		// 点滅中の表示時間
-
-	bool just_took_damage_ = false;
+	uint64 invincible_start_tick_ = 0;
+	static constexpr uint64 kInvincibleDurationTicks = SimClock::SecondsToTicks(2.7);	// 無敵時間
+	static constexpr uint64 kBlinkIntervalTicks = SimClock::SecondsToTicks(0.3);		// 点滅の間隔
+	static constexpr uint64 kBlinkOnDurationTicks = SimClock::SecondsToTicks(0.15);		// 点滅中の表示時間
 
 	// 地形衝突(Physics)用のサイズ(ハーフ)
-	static constexpr double kPhysicsHalfWidth = 25.0;
-	static constexpr double kPhysicsHalfHeight = 62.0;
+	static constexpr PhysicsVec2 kPhysicsHalfSize{ PhysicsScalar(25.0), PhysicsScalar(62.0) };
+
+	// 1フレームで壁に沿って滑らせる回数の上限（角に当たっても縦・横の2回で止まる）
+	static constexpr int32 kMaxSlideIterations = 3;
 
 	// 敵との当たり判定(Collider)用のサイズ
 	static constexpr double kColliderWidth = 60.0;
@@ -79,26 +123,28 @@ private:
 	static constexpr Vec2 kEndingDrawOffset = { 96.0, 128.0 };
 
 	// 物理パラメータ
-	double horizontal_accel_{ 0.6 };
-	double horizontal_speed_max_{ 1.3 };
-	double friction_{ 0.90 };					// 水平方向の抵抗係数(1.0が無抵抗)
-	double gravity_ = 0.06;
-	double swim_power_ = -1.8;					// 水中での上昇力
-	double terminal_velocity_y_ = 1.0;			// Y軸の終端速度
-	double rising_gravity_multiplier_ = 0.4;	// 上昇時の重力軽減倍率(0.0で無重力)
+	PhysicsScalar horizontal_accel_{ 0.6 };
+	PhysicsScalar horizontal_speed_max_{ 1.3 };
+	PhysicsScalar friction_{ 0.90 };					// 水平方向の抵抗係数(1.0が無抵抗)
+	PhysicsScalar gravity_{ 0.06 };
+	PhysicsScalar swim_power_{ -1.8 };					// 水中での上昇力
+	PhysicsScalar terminal_velocity_y_{ 1.0 };			// Y軸の終端速度
+	PhysicsScalar rising_gravity_multiplier_{ 0.4 };	// 上昇時の重力軽減倍率(0.0で無重力)
+	static constexpr PhysicsScalar kStopSpeed{ 0.1 };	// これより遅くなったら止める
+	static constexpr PhysicsScalar kKnockbackSpeed{ 2.5 };	// ダメージを受けたときに後ろへ飛ばされる速さ
 
 	double oxygen_{ 100.0 };		// 酸素量(体力と同義)
 	bool is_oxygen_empty_ = false;	// oxygen_ == 0でtrue
 
 	bool is_in_ending_ = false;
-	s3d::Stopwatch ending_timer_;
-	static constexpr double kEndingAnimationDelaySec = 7.0;
+	uint64 ending_start_tick_ = 0;
+	static constexpr uint64 kEndingAnimationDelayTicks = SimClock::SecondsToTicks(7.0);
 
 	// エンディング中のx軸ワープ制御
-	double ending_target_x_ = 0.0;			// 目標x（ワールド座標）
-	bool ending_warp_enabled_ = false;		// ワープ処理中ならtrue
-	double ending_warp_lerp_ = 0.01;		// Lerpファクター（1.0で即時ワープ）
-	double ending_snap_threshold_ = 1.0;	// この距離以下でスナップ
+	PhysicsScalar ending_target_x_{};				// 目標x（ワールド座標）
+	bool ending_warp_enabled_ = false;				// ワープ処理中ならtrue
+	PhysicsScalar ending_warp_lerp_{ 0.01 };		// Lerpファクター（1.0で即時ワープ）
+	PhysicsScalar ending_snap_threshold_{ 1.0 };	// この距離以下でスナップ
 
 	static constexpr double kMaxOxygen = 100.0;
 	static constexpr double kOxygenDrainPerFrame = 0.013;	// 毎フレームの減少量
@@ -109,5 +155,8 @@ private:
 	static constexpr double kOxygenRecoveryPerFrame = 1.0;			// 回復速度(1秒あたり)
 
 	AnimationController anim_controller_;
-	SoundController sound_controller_;
+
+	// 効果音の番号（名前の検索は構築時の一度だけ）
+	SoundId swim_sound_id_ = kInvalidSoundId;
+	SoundId damage_sound_id_ = kInvalidSoundId;
 };
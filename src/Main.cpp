@@ -1,36 +1,177 @@
-﻿#include "Core/Config.h"
+﻿#include "Audio/SfxEngine.h"
+#include "Core/AllocationTracker.h"
+#include "Core/AssetController.h"
+#include "Core/BootLoader.h"
+#include "Core/Config.h"
+#include "Core/TraceRecorder.h"
+#include "Core/Utility.h"
 #include "Scenes/GameScene.h"
+#include "Scenes/LoadingScene.h"
+#include "Tools/BatchRunner.h"
+#include "Tools/SelfCheck.h"
+#include "Tools/StageGenerator.h"
+#include "Tools/TurboRunner.h"
+#include "World/StageCatalog.h"
 
 #include <Siv3D.hpp>
 
+#include <cstdlib>
+
+// 固定解像度で描いたシーンを，ウィンドウに収まる最大の整数倍で中央に表示する
+// ウィンドウが元の解像度より小さいときだけ縮小する．余白は黒帯になる
+static void PresentScene(const RenderTexture& scene_target)
+{
+	const Size window_size = Scene::Size();
+	const double fit_scale = Min(
+		(static_cast<double>(window_size.x) / kSceneSize.x),
+		(static_cast<double>(window_size.y) / kSceneSize.y));
+	const double scale = (fit_scale >= 1.0) ? Math::Floor(fit_scale) : fit_scale;
+
+	const ScopedRenderStates2D sampler{ SamplerState::ClampNearest };
+	scene_target.scaled(scale).drawAt(Scene::Center());
+}
+
+// ターボモードの1回分．描画もフレームの待ち合わせもせず，次に System::Update() を呼ぶまでまとめて更新する
+// 終わったら false を返す
+static bool UpdateTurbo(App& manager)
+{
+	if(BootLoader::GetInstance().IsManifestLoaded())
+	{
+		AssetController::GetInstance().DispatchReadyCallbacks();
+	}
+
+	const TurboRunner& turbo_runner = TurboRunner::GetInstance();
+	for(uint32 i = 0; i < TurboRunner::kFramesPerSystemUpdate; ++i)
+	{
+		if((not manager.updateScene()) || turbo_runner.IsFinished())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
 void Main()
 {
+	// --gen-stage が指定されたら負荷テスト用のステージを書き出して終了する
+	if(StageGenerator::RunFromCommandLine(System::GetCommandLineArgs()))
+	{
+		return;
+	}
+
+	// --stage v1 / v2 / v3 で遊ぶステージを選ぶ（タイトル画面でも 1 / 2 / 3 キーで切り替えられる）
+	StageCatalog::SelectFromCommandLine(System::GetCommandLineArgs());
+
+	// --self-check [項目,...] で並列化などの結果を自動で確かめ，結果を書き出して終了する
+	if(SelfCheck::RunFromCommandLine(System::GetCommandLineArgs()))
+	{
+		return;
+	}
+
+	// --batch <ワールド数> で，選んだステージのワールドをいくつも全てのコアで同時に進め，結果を書き出して終了する
+	if(BatchRunner::RunFromCommandLine(System::GetCommandLineArgs()))
+	{
+		return;
+	}
+
+	// --alloc-budget <回数> で，ゲームプレイ中の1フレームのヒープ確保が予算以内かを調べる
+	AllocationTracker& allocation_tracker = AllocationTracker::GetInstance();
+	allocation_tracker.ConfigureFromCommandLine(System::GetCommandLineArgs());
+
+	// --trace でフレームの各段階やアセットのデコードを記録し，F9 でトレースの JSON を書き出す
+	// --trace-hitch-ms <ミリ秒> を指定すると，フレーム落ちしたときにも書き出す
+	TraceRecorder& trace_recorder = TraceRecorder::GetInstance();
+	trace_recorder.ConfigureFromCommandLine(System::GetCommandLineArgs());
+
+	// --turbo <入力スクリプト> で，描画・待ち合わせ・音なしにスクリプトの入力でゲームを進め，要約を書き出して終了する
+	// --record-input <出力先> で，遊んだ入力をスクリプトの形で書き出す
+	TurboRunner& turbo_runner = TurboRunner::GetInstance();
+	if(not turbo_runner.ConfigureFromCommandLine(System::GetCommandLineArgs()))
+	{
+		return;
+	}
+
 	// ウィンドウの初期設定
 	Window::SetTitle(U"シンカイサンタ");
 	Window::SetStyle(WindowStyle::Sizable);
-	Scene::SetTextureFilter(TextureFilter::Nearest);
 	Window::Resize(kSceneSize);
-	Scene::SetLetterbox(ColorF{ 0, 0, 0 });
-	Scene::SetResizeMode(ResizeMode::Keep);
-	Window::Maximize();
 	Graphics::SetVSyncEnabled(false);
 
+	// ターボモードでは何も描かないのでウィンドウはしまっておき，音も出さない
+	if(turbo_runner.IsEnabled())
+	{
+		Window::Minimize();
+		GlobalAudio::SetVolume(0.0);
+	}
+	else
+	{
+		Window::Maximize();
+	}
+
+	// シーンは常に kSceneSize のレンダーテクスチャに描き，最後に1回だけ拡大してウィンドウに表示する
+	// ウィンドウの大きさに関係なく描画の負荷は一定で，座標もこの解像度のピクセルにそろう
+	Scene::SetResizeMode(ResizeMode::Actual);
+	Scene::SetBackground(ColorF{ 0, 0, 0 });
+	const RenderTexture scene_target{ kSceneSize, kGameBackgroundColor };
+
 	// FPS固定のためのストップウォッチ
 	Stopwatch FPS_SW;
 	FPS_SW.start();
 
 	// シーンマネージャーを作成
+	// 読み込み画面から始め，起動時の読み込みが終わったらゲーム画面に切り替える
 	App manager;
+	manager.add<LoadingScene>(SceneID::kLoading);
 	manager.add<GameScene>(SceneID::kGame);
 
-	manager.init(SceneID::kGame, 1000.0ms / 60);
+	manager.init(SceneID::kLoading, 1000.0ms / 60);
 
 	// ウィンドウを閉じるユーザアクションのみを終了操作に設定
 	System::SetTerminationTriggers(UserAction::CloseButtonClicked);
 
 	while(System::Update())
 	{
-		if(not manager.update())
+		if(turbo_runner.IsEnabled())
+		{
+			if(not UpdateTurbo(manager))
+			{
+				break;
+			}
+			continue;
+		}
+
+		allocation_tracker.BeginFrame();
+
+		// 非同期ロードが完了したアセットを確定させ，待っている処理に通知する
+		// （AssetController は起動時にワーカーで作るので，できあがるまでは触らない）
+		if(BootLoader::GetInstance().IsManifestLoaded())
+		{
+			AssetController::GetInstance().DispatchReadyCallbacks();
+		}
+
+		{
+			// ピクセルアートなので拡大縮小せずに描く前提で，最近傍でサンプリングする
+			const ScopedRenderTarget2D target{ scene_target.clear(kGameBackgroundColor) };
+			const ScopedRenderStates2D sampler{ SamplerState::ClampNearest };
+
+			if(not manager.update())
+			{
+				break;
+			}
+		}
+
+		{
+			const TraceScope trace_scope{ U"PresentScene" };
+			PresentScene(scene_target);
+		}
+
+		if(kInputDumpTrace.down())
+		{
+			trace_recorder.RequestDump(U"manual");
+		}
+
+		allocation_tracker.EndFrame();
+		if(allocation_tracker.IsTestFinished())
 		{
 			break;
 		}
@@ -39,5 +180,20 @@ void Main()
 		while(FPS_SW.msF() < 1000.0 / 60) {}
 		//ストップウォッチをリスタート
 		FPS_SW.restart();
+
+		// 待ち時間も含めたフレームの間隔で，フレーム落ちを調べる
+		trace_recorder.EndFrame();
+	}
+
+	turbo_runner.Shutdown();
+
+	// Siv3D のエンジンが終了する前に効果音の出力を止め，使われなかった起動時の読み込み結果を捨てる
+	SfxEngine::GetInstance().Shutdown();
+	BootLoader::GetInstance().Shutdown();
+
+	// Main は終了コードを返せないので，テストの失敗はエンジンの終了処理の後で終了コードにして伝える
+	if(allocation_tracker.HasTestFailed())
+	{
+		Utility::SetExitCode(EXIT_FAILURE);
 	}
 }
@@ -0,0 +1,73 @@
+﻿#include "GameHud.h"
+
+#include <cmath>
+#include <Siv3D.hpp>
+
+GameHud::GameHud()
+	: meter_layer_(Size{ kProgressMeterWidth, kSceneSize.y }, ColorF{ 0.0, 0.0 })
+{
+}
+
+double GameHud::ToMeterY(double ratio)
+{
+	return (kSceneSize.y * Clamp(ratio, 0.0, 1.0));
+}
+
+void GameHud::Bake(const Array<double>& spot_ratios, bool show_progress_meter)
+{
+	show_progress_meter_ = show_progress_meter;
+
+	meter_layer_.clear(ColorF{ 0.0, 0.0 });
+	if(not show_progress_meter_)
+	{
+		return;
+	}
+
+	// 透明なテクスチャに半透明の色を重ねてもアルファが薄まらないようにする
+	const ScopedRenderTarget2D target{ meter_layer_ };
+	const ScopedRenderStates2D blend{ BlendState::MaxAlpha };
+
+	const double screen_height = kSceneSize.y;
+	const double meter_center_x = (kProgressMeterWidth / 2.0);
+
+	RectF{ 0, 0, static_cast<double>(kProgressMeterWidth), screen_height }.draw(kUIGaugeBackgroundColor);
+
+	Line{ meter_center_x, 0, meter_center_x, screen_height }.draw(1, kProgressLineColor);
+
+	for(const double spot_ratio : spot_ratios)
+	{
+		RectF{ Arg::center(meter_center_x, ToMeterY(spot_ratio)), kProgressSpotMarkerWidth, kProgressMarkerHeight }.draw(kProgressSpotColor);
+	}
+}
+
+void GameHud::Draw(double oxygen, double max_oxygen, double progress_ratio) const
+{
+	const RectF gauge{ kOxygenGaugePos, kOxygenGaugeSize };
+	gauge.draw(kUIGaugeBackgroundColor);
+
+	ColorF oxygen_color = kOxygenColorDanger;
+	if(oxygen > kOxygenWarningThreshold)
+	{
+		oxygen_color = kOxygenColorSafe;
+	}
+	else if(oxygen > kOxygenDangerThreshold)
+	{
+		oxygen_color = kOxygenColorWarning;
+	}
+
+	const double oxygen_ratio = (max_oxygen > 0.0) ? Clamp(oxygen / max_oxygen, 0.0, 1.0) : 0.0;
+	const double fill_height = std::round(kOxygenGaugeSize.y * oxygen_ratio);
+	RectF{ gauge.x, (gauge.y + gauge.h - fill_height), gauge.w, fill_height }.draw(oxygen_color);
+
+	// 枠は中身より手前に描く
+	gauge.drawFrame(2, 0, Palette::White);
+
+	if(show_progress_meter_)
+	{
+		const double meter_x = (kSceneSize.x - kProgressMeterWidth);
+		meter_layer_.draw(Vec2{ meter_x, 0 });
+
+		const double meter_center_x = meter_x + (kProgressMeterWidth / 2.0);
+		RectF{ Arg::center(meter_center_x, std::round(ToMeterY(progress_ratio))), kProgressPlayerMarkerWidth, kProgressMarkerHeight }.draw(kProgressPlayerColor);
+	}
+}
@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include "../Core/Config.h"
+
+#include <Siv3D.hpp>
+
+// ゲーム画面のHUD（酸素ゲージと進捗メーター）
+// 酸素スポットのマーカーが並ぶ進捗メーターの背景だけを，ステージ読み込み時にメーターの大きさのレンダーテクスチャに焼き込む
+// 酸素量とプレイヤーマーカーは図形数個なので，毎フレームそのまま描く
+class GameHud
+{
+public:
+	GameHud();
+
+	// 進捗メーターの背景（縦線と酸素スポットのマーカー）を焼き込む
+	// spot_ratios は各酸素スポットの進捗率（0.0 ～ 1.0）．show_progress_meter が false ならメーターを出さない
+	void Bake(const Array<double>& spot_ratios, bool show_progress_meter);
+
+	// HUD全体を描画する
+	void Draw(double oxygen, double max_oxygen, double progress_ratio) const;
+
+private:
+	// 画面上の進捗率からメーター上のY座標を求める
+	static double ToMeterY(double ratio);
+
+	// 進捗メーターの背景（画面の右端に置く）
+	RenderTexture meter_layer_;
+
+	bool show_progress_meter_ = false;
+
+	static constexpr Vec2 kOxygenGaugePos = { 20, 20 };
+	static constexpr Size kOxygenGaugeSize = { 24, 200 };
+	static constexpr ColorF kUIGaugeBackgroundColor = ColorF{ 0.0, 0.5 };
+
+	static constexpr ColorF kOxygenColorSafe = Palette::Limegreen;
+	static constexpr ColorF kOxygenColorWarning = Palette::Yellow;
+	static constexpr ColorF kOxygenColorDanger = Palette::Red;
+
+	static constexpr double kOxygenWarningThreshold = 70.0;
+	static constexpr double kOxygenDangerThreshold = 30.0;
+
+	static constexpr int32 kProgressMeterWidth = 10;
+
+	static constexpr ColorF kProgressLineColor = Palette::White;			// メーターの縦線の色
+	static constexpr ColorF kProgressPlayerColor = Palette::Yellow;		// プレイヤーマーカーの色
+	static constexpr ColorF kProgressSpotColor = Palette::Limegreen;	// 酸素スポットマーカーの色
+	static constexpr double kProgressPlayerMarkerWidth = 14.0;			// プレイヤーマーカーの幅
+	static constexpr double kProgressSpotMarkerWidth = 8.0;				// スポットマーカーの幅
+	static constexpr double kProgressMarkerHeight = 4.0;				// マーカーの高さ
+};
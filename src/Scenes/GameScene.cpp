@@ -1,357 +1,524 @@
-﻿#include "../Core/AssetController.h"
+﻿#include "../Core/AllocationTracker.h"
+#include "../Core/AssetController.h"
 #include "../Core/Config.h"
-#include "../World/SpawnInfo.h"
+#include "../Core/TraceRecorder.h"
+#include "../Tools/TurboRunner.h"
 #include "GameScene.h"
 
 #include <Siv3D.hpp>
-#include <variant>
 
 GameScene::GameScene(const App::Scene::InitData& init)
 	: IScene(init)
-	, camera_manager_(
-		(stage_.GetWidth()* stage_.GetTileSize()) / 2.0,
-		kSceneSize
-	)
-	, map_total_height_(stage_.GetHeight()* stage_.GetTileSize())
 {
+	BootLoader& boot_loader = BootLoader::GetInstance();
+	boot_loader.BeginStep(BootStep::SceneCreate);
+
+	// 起動時に BootLoader が準備してあれば何もしない
 	AssetController::GetInstance().PrepareAssets(U"Game");
 
-	SpawnEntities();
+	BakeHud();
+
+	stage_reloader_.Watch(world_.GetStage().GetSourceFiles());
 
-	camera_manager_.SetTargetY(player_.GetPos().y);
-	camera_manager_.SetYOffsetRatio(kTitleEndingCameraOffsetYRatio);
+	// BGMはストリーミング再生（イントロ→ループはストリーム内でサンプル単位で切り替わる）
+	auto [bgm_intro, bgm_loop] = boot_loader.TakeBgmDecoders(FilePath{ kBgmIntroPath }, FilePath{ kBgmLoopPath });
+	bgm_player_.Open(std::move(bgm_intro), std::move(bgm_loop), &AudioMixer::GetInstance().GetBus(AudioBusId::Music));
+	bgm_player_.Play();
 
-	//イントロBGMを再生開始（準備ができるまで保留して毎フレームチェック）
-	StartOrDeferBGM(U"deepsea_intro", false);
+	boot_loader.EndStep(BootStep::SceneCreate);
 }
 
 GameScene::~GameScene()
 {
-	bgm_controller_.StopAll();
+	bgm_player_.Stop();
+	SfxEngine::GetInstance().StopAll();
 	AssetController::GetInstance().UnregisterAssets();
 }
 
-void GameScene::StartOrDeferBGM(const String& asset, bool loop)
+void GameScene::ResetStage(bool keep_player_pos)
 {
-	//既に現在再生中のBGMと同じなら何もしない
-	if(not current_playing_bgm_asset_.isEmpty() && current_playing_bgm_asset_ == asset)
-	{
-		return;
-	}
+	world_.ResetStage(StageCatalog::CreateStage(StageCatalog::GetSelected()), keep_player_pos);
+	BakeHud();
 
-	// 即時再生できるなら再生して記録する
-	if(AudioAsset::IsRegistered(asset) && AudioAsset::IsReady(asset))
-	{
-		bgm_controller_.Play(asset, loop);
-		current_playing_bgm_asset_ = asset;
-		// clear pending
-		pending_bgm_asset_.clear();
-		pending_bgm_loop_ = false;
-		return;
-	}
+	stage_reloader_.Watch(world_.GetStage().GetSourceFiles());
 
-	//まだ準備できていない場合は保留して毎フレームチェックする
-	pending_bgm_asset_ = asset;
-	pending_bgm_loop_ = loop;
+	rewind_buffer_.Clear();
 }
 
-void GameScene::ProcessPendingBGM()
+void GameScene::UpdateStageHotReload()
 {
-	if(pending_bgm_asset_.isEmpty())
+	for(const auto& path : stage_reloader_.PollChangedFiles())
 	{
-		return;
-	}
+		const String file_name = FileSystem::FileName(path);
+		const TraceScope trace_scope{ U"GameScene::UpdateStageHotReload", U"frame", file_name };
+		const Stopwatch stopwatch{ StartImmediately::Yes };
+		const StageReloadDiff diff = world_.GetStage().ReloadFile(path);
 
-	// 登録され準備完了したら再生する
-	if(AudioAsset::IsRegistered(pending_bgm_asset_) && AudioAsset::IsReady(pending_bgm_asset_))
-	{
-		bgm_controller_.Play(pending_bgm_asset_, pending_bgm_loop_);
-		current_playing_bgm_asset_ = pending_bgm_asset_;
-		pending_bgm_asset_.clear();
-		pending_bgm_loop_ = false;
-	}
-}
-
-void GameScene::SpawnEntities()
-{
-	const auto& spawn_points = stage_.GetSpawnPoints();
-
-	for(const auto& info : spawn_points)
-	{
-		if(info.type.isEmpty())
+		switch(diff.result)
 		{
-			Print << U"Warning: Tiled object_spawn に 'Type' が設定されていないオブジェクトがあります．";
-			continue;
-		}
-
-		const Vec2 center_pos = info.pos + (info.size / 2.0);
+		case StageReloadResult::NotWatched:
+			break;
+		case StageReloadResult::Failed:
+			Console << U"Stage: 読み直しに失敗しました（次の保存で再試行します） → {}"_fmt(path);
+			break;
+		case StageReloadResult::Restructured:
+			// 大きさが変わったときはステージごと作り直す（プレイヤーの位置はそのまま）
+			ResetStage(true);
+			Console << U"Stage: 作り直しました → {}（{:.1f} ms）"_fmt(path, stopwatch.msF());
+			break;
+		case StageReloadResult::Updated:
+			world_.ApplySpawnDiff(diff);
+			BakeHud();
+			if(not diff.changed_collision_rows.isEmpty())
+			{
+				world_.ReplanEnemies();
 
-		if(info.type == U"Player")
-		{
-			player_.SetPos(center_pos);
-			player_start_pos_ = center_pos;
-		}
-		else if(info.type == U"Oxygen")
-		{
-			oxygen_spots_.emplace_back(center_pos, info.size);
-		}
-		else
-		{
-			enemies_.emplace_back(info.type, center_pos);
+				// 記録した動きは書き換える前の当たり判定で決めたものなので，巻き戻せなくする
+				rewind_buffer_.Clear();
+			}
+			Console << U"Stage: 読み直しました → {}（当たり判定 {} 行，タイル {} 枚，スポーン -{} +{}，{:.1f} ms）"_fmt(
+				path, diff.changed_collision_rows.size(), diff.changed_tile_count,
+				diff.removed_spawns.size(), diff.added_spawns.size(), stopwatch.msF());
+			break;
 		}
 	}
 }
 
 void GameScene::UpdateBGM()
 {
-	// pending 再生があれば毎フレームチェックして可能なら再生
-	ProcessPendingBGM();
-
-	//イントロが実際に再生されていて終了したらループBGMに切り替え
-	if(not is_intro_finished_)
+	// プレイヤーが死んだらBGMを停止
+	if(world_.GetPlayer().IsOxygenEmpty())
 	{
-		// intro が現在再生中か再生済みかを current_playing_bgm_asset_で管理
-		if(current_playing_bgm_asset_ == U"deepsea_intro")
+		if(bgm_player_.IsPlaying())
 		{
-			if(not bgm_controller_.IsPlaying(U"deepsea_intro"))
-			{
-				is_intro_finished_ = true;
-				StartOrDeferBGM(U"deepsea", true);
-			}
+			bgm_player_.Stop();
+			SfxEngine::GetInstance().StopAll();
 		}
-		// else: introまだ準備できてない／再生されてない -> 待つ
-	}
-
-	// プレイヤーが死んだらBGMを停止
-	if(player_.IsOxygenEmpty())
-	{
-		bgm_controller_.StopAll();
-		current_playing_bgm_asset_.clear();
-		pending_bgm_asset_.clear();
-		pending_bgm_loop_ = false;
 		return;
 	}
 
-	// 深度に応じて音量を調整
-	const double total_travel = map_total_height_ - player_start_pos_.y;
+	// 深度に応じて音量とこもり具合を調整
+	// 値はバスに送るだけで，なめらかな変化はオーディオスレッド側で行う
+	const double total_travel = world_.GetMapTotalHeight() - world_.GetPlayerStartPos().y;
 	if(total_travel > 0)
 	{
-		double depth_ratio = (player_.GetPos().y - player_start_pos_.y) / total_travel;
-		depth_ratio = Clamp(depth_ratio, 0.0, 1.0);
+		const double depth_ratio = world_.GetDepthRatio();
 
 		// 深くなるほど音量を下げる
 		const double volume = Math::Lerp(1.0, 0.0, depth_ratio);
 
-		// 両方のBGMの音量を設定
-		bgm_controller_.SetVolume(U"deepsea_intro", volume);
-		bgm_controller_.SetVolume(U"deepsea", volume);
+		// カットオフは対数軸で補間する
+		const double cutoff = kSurfaceCutoffHz * Math::Pow(kDeepSeaCutoffHz / kSurfaceCutoffHz, depth_ratio);
+
+		AudioBus& music_bus = AudioMixer::GetInstance().GetBus(AudioBusId::Music);
+		music_bus.SetGain(volume);
+		music_bus.SetLowPassCutoff(cutoff);
+
+		// 効果音も深いほどこもらせる．操作の手応えが消えないように，音量は下げずにこもり具合も控えめにする
+		const double sfx_cutoff = kSurfaceCutoffHz * Math::Pow(kDeepSeaSfxCutoffHz / kSurfaceCutoffHz, depth_ratio);
+		AudioMixer::GetInstance().GetBus(AudioBusId::Sfx).SetLowPassCutoff(sfx_cutoff);
 	}
 }
 
 void GameScene::update()
 {
+	const AllocationScope allocation_scope{ U"GameScene::update" };
+	const TraceScope trace_scope{ U"GameScene::update" };
+
+	// 起動から最初に操作を受け付けるまでの時間を記録する（2回目以降は何もしない）
+	BootLoader::GetInstance().MarkFirstInteractiveFrame();
+
+	// ターボモードではキーボードもステージのファイルも見ない（入力はスクリプトから読む）
+	const bool is_turbo = TurboRunner::GetInstance().IsEnabled();
+
+	// ステージのファイルが書き換えられていたら反映する
+	if(not is_turbo)
+	{
+		UpdateStageHotReload();
+	}
+
 	// BGMの状態を更新
 	UpdateBGM();
 
+	if(not is_turbo)
+	{
+		// 遊んでいる間（死んだあとも含む）に中断セーブし，タイトルを含むいつでも再開できる
+		if(kInputQuickSave.down() && ((world_.GetState() == GameState::Playing) || (world_.GetState() == GameState::GameOver)))
+		{
+			SaveQuickSave(kQuickSavePath);
+		}
+		if(kInputQuickLoad.down())
+		{
+			LoadQuickSave(kQuickSavePath);
+		}
+
+		UpdateTimeScale();
+
+		if(kInputToggleStats.down())
+		{
+			is_stats_visible_ = (not is_stats_visible_);
+		}
+
+		// 前のフレームでティックが使わなかった押した瞬間の入力は持ち越す（使ったなら tick_input_ にはもう残っていない）
+		tick_input_ = GameInput::FromKeyboard().WithEdgesFrom(tick_input_);
+
+		const Input stage_keys[] = { Key1, Key2, Key3, Key4 };
+		for(size_t i = 0; i < std::size(stage_keys); ++i)
+		{
+			if(stage_keys[i].down())
+			{
+				pending_stage_index_ = i;
+			}
+		}
+	}
+
 #if 0 // デバッグ用: 0 にすると無効化
 	// Eキーでエンディング付近にワープ
 	if(KeyE.down())
 	{
-		Vec2 current_pos = player_.GetPos();
-		current_pos.y = 7600.0;
-		player_.SetPos(current_pos);
+		Vec2 current_pos = world_.GetPlayer().GetPos();
+		current_pos.y = world_.GetEndingZoneY() - 50.0;
+		world_.GetPlayer().SetPos(current_pos);
 		//Print << U"DEBUG: Warped to ending zone!";
 	}
 #endif
 
-	switch(current_state_)
+	// 倍率の分だけティックを進める（一時停止中は 0 回，倍速なら1フレームに複数回）
+	// 押した瞬間の入力は，そのフレームの最初のティックにだけ渡す
+	const uint32 tick_count = world_.GetClock().BeginFrame();
+	for(uint32 i = 0; i < tick_count; ++i)
 	{
-	case GameState::Title:
+		UpdateTick();
+		tick_input_ = tick_input_.WithoutEdges();
+	}
+
+	// ワールドが溜めた警告のうち，まだ出していないものを出す
+	const Array<String>& warnings = world_.GetWarnings();
+	for(; printed_warning_count_ < warnings.size(); ++printed_warning_count_)
 	{
-		for(auto& spot : oxygen_spots_)
-		{
-			spot.Update();
-		}
+		Print << warnings[printed_warning_count_];
+	}
 
-		if(kInputOK.down() || KeyEnter.down())
-		{
-			current_state_ = GameState::Playing;
-		}
+	// カメラのなめらかな追従は表示のためのものなので，実時間で進める
+	// 区間の読み込みは GameWorld::Tick() がティックごとに決めるので，ここで進め方が違っても遊んだ結果は変わらない
+	world_.UpdateCamera(GetFrameDeltaTime(), tick_count);
+}
 
-		camera_manager_.SetYOffsetRatio(kTitleEndingCameraOffsetYRatio);
-		break;
+void GameScene::UpdateTimeScale()
+{
+	double time_scale = world_.GetClock().GetTimeScale();
+
+	if(kInputPause.down())
+	{
+		time_scale = (world_.GetClock().IsPaused() ? 1.0 : 0.0);
 	}
-	case GameState::Playing:
+	else if(kInputSlowDown.down())
 	{
-		player_.Update(stage_);
+		time_scale *= 0.5;
+	}
+	else if(kInputSpeedUp.down())
+	{
+		time_scale = ((time_scale == 0.0) ? 0.125 : (time_scale * 2.0));
+	}
+	else
+	{
+		return;
+	}
 
-		if(player_.GetPos().y >= kEndingZoneY)
-		{
-			current_state_ = GameState::Ending;
+	world_.GetClock().SetTimeScale(time_scale);
+	Console << U"SimClock: 時間の倍率 {}"_fmt(world_.GetClock().GetTimeScale());
+}
 
-			// エンディング開始時刻を記録
-			ending_start_time_ = Scene::Time();
+double GameScene::GetFrameDeltaTime() const
+{
+	if(TurboRunner::GetInstance().IsEnabled())
+	{
+		return SimClock::TicksToSeconds(1);
+	}
+	return Scene::DeltaTime();
+}
 
-			const double camera_center_x = camera_manager_.GetViewRect().center().x;
-			player_.StartEnding(camera_center_x);
-			break;
-		}
+void GameScene::UpdateTick()
+{
+	TurboRunner& turbo_runner = TurboRunner::GetInstance();
+	const GameState state = world_.GetState();
 
-		if(player_.IsOxygenEmpty())
+	// タイトルを過ぎてからの入力は，ターボモードならスクリプトから読み，そうでなければ（--record-input なら）記録する
+	if(state != GameState::Title)
+	{
+		if(turbo_runner.IsEnabled())
 		{
-			current_state_ = GameState::GameOver;
-			OnPlayerDied();
-			break;
+			tick_input_ = turbo_runner.NextInput();
 		}
-
-		for(auto& spot : oxygen_spots_)
+		else
 		{
-			spot.Update();
+			turbo_runner.RecordInput(tick_input_);
 		}
-		for(auto& enemy : enemies_)
+	}
+
+	GameInput input = tick_input_;
+
+	if(state == GameState::Title)
+	{
+		// ヒープ確保のテストとターボモードではタイトルを飛ばしてすぐに遊び始める
+		if(AllocationTracker::GetInstance().IsTestMode() || turbo_runner.IsEnabled())
 		{
-			enemy.Update(stage_, player_);
+			input.ok = true;
 		}
 
-		player_.collider.ClearCollisionResult();
-		for(auto& enemy : enemies_) { enemy.GetCollider().ClearCollisionResult(); }
-		for(auto& spot : oxygen_spots_) { spot.GetCollider().ClearCollisionResult(); }
-		auto& player_collider = player_.collider;
-		for(auto& enemy : enemies_)
+		// タイトル画面で 1 / 2 / 3 キーを押すとステージを切り替える
+		if(pending_stage_index_ && (*pending_stage_index_ != StageCatalog::GetSelectedIndex()))
 		{
-			if(not enemy.IsAlive()) continue;
-			auto& enemy_collider = enemy.GetCollider();
-			bool is_collided = std::visit([&](const auto& s1) { return std::visit([&](const auto& s2) { return s1.intersects(s2); }, enemy_collider.shape); }, player_collider.shape);
-			if(is_collided)
-			{
-				player_collider.is_colliding = true;
-				player_collider.collided_tags.push_back(enemy_collider.tag);
+			StageCatalog::Select(*pending_stage_index_);
+			ResetStage(false);
+		}
+	}
 
-				enemy_collider.is_colliding = true;
-				enemy_collider.collided_tags.push_back(player_collider.tag);
-			}
+	// タイトル以外で押されたステージのキーは使わずに捨てる
+	pending_stage_index_.reset();
+
+	if(state == GameState::Playing)
+	{
+		AllocationTracker::GetInstance().MarkGameplayFrame();
+	}
+
+	// 死んだあとはリスポーンの代わりに，死ぬ前まで巻き戻してやり直せる
+	GameWorldEvents events;
+	const bool is_rewound = (((state == GameState::Playing) || (state == GameState::GameOver)) && UpdateRewind());
+	if(not is_rewound)
+	{
+		events = world_.Tick(input);
+
+		// リスポーン時にBGMをイントロから再開
+		if(events.is_respawned)
+		{
+			bgm_player_.Play();
 		}
-		for(auto& spot : oxygen_spots_)
+
+		// 遊び続けているティックだけを積む（死んだティックやリスポーンしたティックは積まない）
+		// ターボモードでは，スクリプトが巻き戻さなければ使われないので積まない（詰めて XOR する手間が倍速の分だけ増える）
+		const bool is_rewind_recorded = ((not turbo_runner.IsEnabled()) || turbo_runner.UsesRewind());
+		if(is_rewind_recorded && (state == GameState::Playing) && (world_.GetState() == GameState::Playing))
 		{
-			auto& spot_collider = spot.GetCollider();
-			bool is_collided = std::visit([&](const auto& s1) { return std::visit([&](const auto& s2) { return s1.intersects(s2); }, spot_collider.shape); }, player_collider.shape);
-			if(is_collided)
-			{
-				player_collider.is_colliding = true;
-				player_collider.collided_tags.push_back(spot_collider.tag);
-				player_.RecoverOxygen();
-			}
+			const AllocationScope rewind_scope{ U"GameScene::RecordRewind" };
+			const TraceScope rewind_trace{ U"GameScene::RecordRewind" };
+			CaptureSnapshot(snapshot_bytes_);
+			rewind_buffer_.Push(snapshot_bytes_);
 		}
+	}
 
-		camera_manager_.SetYOffsetRatio(kPlayingCameraOffsetYRatio);
-		break;
+	if(turbo_runner.IsEnabled() && (world_.GetState() != GameState::Title))
+	{
+		turbo_runner.RecordTick(world_, events);
 	}
-	case GameState::Ending:
+}
+
+void GameScene::CaptureSnapshot(Array<uint8>& bytes) const
+{
+	SnapshotWriter writer{ bytes };
+	world_.SaveState(writer);
+}
+
+bool GameScene::RestoreSnapshot(const Array<uint8>& bytes, bool snap_camera)
+{
+	SnapshotReader reader{ bytes };
+	return world_.LoadState(reader, snap_camera);
+}
+
+bool GameScene::SaveQuickSave(FilePathView path) const
+{
+	const Stopwatch stopwatch{ StartImmediately::Yes };
+
+	QuickSaveData data;
+	data.stage_name = StageCatalog::GetSelected().name;
+	CaptureSnapshot(data.snapshot);
+
+	SnapshotWriter writer{ data.extras };
+	writer.Write(world_.GetPassedSpotPos().has_value());
+	writer.Write(world_.GetPassedSpotPos().value_or(Vec2::Zero()));
+	writer.Write(bgm_player_.IsPlaying());
+
+	// MusicPosition は詰め物があるので1項目ずつ書く
+	const MusicPosition bgm_position = bgm_player_.GetPosition();
+	writer.Write(bgm_position.is_in_loop);
+	writer.Write(bgm_position.frame);
+
+	// 背景オブジェクトはアクティブになったティックからの経過時間で動く（ティックはスナップショットで戻る）
+	writer.Write(static_cast<uint32>(background_activation_ticks_.size()));
+	for(const auto& [key, activation_tick] : background_activation_ticks_)
 	{
-		player_.Update(stage_);
-		for(auto& spot : oxygen_spots_) { spot.Update(); }
+		writer.WriteString(key);
+		writer.Write(activation_tick);
+	}
 
-		camera_manager_.SetYOffsetRatio(kTitleEndingCameraOffsetYRatio);
-		break;
+	if(not QuickSaveFile::Write(path, data))
+	{
+		Console << U"QuickSave: 書き込めませんでした → {}"_fmt(path);
+		return false;
 	}
-	case GameState::GameOver:
+
+	Console << U"QuickSave: 保存しました → {}（{} バイト，{:.2f} ms）"_fmt(path, (data.snapshot.size() + data.extras.size()), stopwatch.msF());
+	return true;
+}
+
+bool GameScene::LoadQuickSave(FilePathView path)
+{
+	const Stopwatch stopwatch{ StartImmediately::Yes };
+
+	QuickSaveData data;
+	String error;
+	if(not QuickSaveFile::Read(path, data, error))
 	{
-		player_.Update(stage_);
+		Console << U"QuickSave: 再開できません（{}） → {}"_fmt(error, path);
+		return false;
+	}
 
-		if(kInputOK.down() || KeyEnter.down())
+	// ステージを切り替える前に，スナップショットと付け足した情報が全て読めるか確かめる
+	SnapshotReader reader{ data.extras };
+
+	bool has_passed_spot = false;
+	Vec2 passed_spot_pos;
+	bool is_bgm_playing = false;
+	MusicPosition bgm_position;
+	reader.Read(has_passed_spot);
+	reader.Read(passed_spot_pos);
+	reader.Read(is_bgm_playing);
+	reader.Read(bgm_position.is_in_loop);
+	reader.Read(bgm_position.frame);
+
+	uint32 decor_count = 0;
+	reader.Read(decor_count);
+	std::unordered_map<String, uint64> activation_ticks;
+	for(uint32 i = 0; (i < decor_count) && reader.IsValid(); ++i)
+	{
+		String key;
+		uint64 activation_tick = 0;
+		if(reader.ReadString(key) && reader.Read(activation_tick))
 		{
-			Vec2 respawn_pos = FindNearestRespawnSpot();
-			player_.Respawn(respawn_pos);
-			current_state_ = GameState::Playing;
+			activation_ticks[key] = activation_tick;
+		}
+	}
 
-			// リスポーン時にBGMを再開
-			is_intro_finished_ = false;
-			StartOrDeferBGM(U"deepsea_intro", false);
+	if((not reader.IsValid()) || (not GameWorld::CanLoadState(data.snapshot)))
+	{
+		Console << U"QuickSave: 状態を戻せません → {}"_fmt(path);
+		return false;
+	}
 
-			// エンディングタイマーをリセット
-			ending_start_time_ = -1.0;
+	// 別のステージで保存したものなら，そのステージを作ってから戻す
+	if(data.stage_name != StageCatalog::GetSelected().name)
+	{
+		if(not StageCatalog::SelectByName(data.stage_name))
+		{
+			Console << U"QuickSave: ステージ {} がありません → {}"_fmt(data.stage_name, path);
+			return false;
 		}
+		ResetStage(false);
+	}
+
+	// プレイヤーを戻してカメラをその位置に移し，その深さの区間を読み込んで配置した敵にも記録した動きを戻す
+	if(not RestoreSnapshot(data.snapshot, true))
+	{
+		Console << U"QuickSave: 状態を戻せません → {}"_fmt(path);
+		return false;
+	}
+
+	world_.SetPassedSpotPos(has_passed_spot ? Optional<Vec2>{ passed_spot_pos } : none);
+	background_activation_ticks_ = std::move(activation_ticks);
 
-		camera_manager_.SetYOffsetRatio(kPlayingCameraOffsetYRatio);
-		break;
+	if(is_bgm_playing)
+	{
+		bgm_player_.PlayFrom(bgm_position);
 	}
+	else
+	{
+		bgm_player_.Stop();
 	}
 
-	camera_manager_.SetTargetY(player_.GetPos().y);
-	camera_manager_.Update();
-}
+	// 巻き戻しの記録は再開する前の流れのものなので捨てる
+	rewind_buffer_.Clear();
+	is_rewinding_ = false;
 
-void GameScene::OnPlayerDied()
-{
-	//Print << U"GAME SCENE: OXYGEN ZERO!";
+	Console << U"QuickSave: 再開しました → {}（{:.2f} ms）"_fmt(path, stopwatch.msF());
+	return true;
 }
 
-Vec2 GameScene::FindNearestRespawnSpot() const
+bool GameScene::UpdateRewind()
 {
-	const double dead_y = player_.GetPos().y;
-	Vec2 best_spot_pos = Vec2::Zero();
-	double min_distance = std::numeric_limits<double>::max();
-
-	for(const auto& spot : oxygen_spots_)
+	if(not tick_input_.rewind)
 	{
-		const Vec2 spot_pos = spot.GetPos();
-
-		if(spot_pos.y < dead_y)
+		if(is_rewinding_)
 		{
-			const double distance_y = dead_y - spot_pos.y;
-			if(distance_y < min_distance)
+			is_rewinding_ = false;
+
+			// 死んで止まっていた BGM は，戻ったところから流し直す
+			if((world_.GetState() == GameState::Playing) && (not bgm_player_.IsPlaying()))
 			{
-				min_distance = distance_y;
-				best_spot_pos = spot_pos;
+				bgm_player_.Play();
 			}
 		}
+		return false;
 	}
 
-	if(best_spot_pos == Vec2::Zero())
+	const AllocationScope allocation_scope{ U"GameScene::UpdateRewind" };
+	const TraceScope trace_scope{ U"GameScene::UpdateRewind" };
+
+	// 1フレームに1つ戻すので，記録したときと同じ速さで巻き戻る．最も古いフレームまで戻ったらそこで止める
+	if(rewind_buffer_.Pop(snapshot_bytes_))
 	{
-		return player_start_pos_;
+		RestoreSnapshot(snapshot_bytes_);
 	}
 
-	return best_spot_pos;
+	is_rewinding_ = true;
+	return true;
 }
 
 void GameScene::draw() const
 {
+	const AllocationScope allocation_scope{ U"GameScene::draw" };
+	const TraceScope trace_scope{ U"GameScene::draw" };
+
 	static constexpr ColorF kSurfaceColor = kGameBackgroundColor;
 
-	const double total_travel = map_total_height_ - player_start_pos_.y;
-	double depth_ratio = 0.0;
-	if(total_travel > 0)
-	{
-		depth_ratio = (player_.GetPos().y - player_start_pos_.y) / total_travel;
-	}
-	depth_ratio = Clamp(depth_ratio, 0.0, 1.0);
+	const Stage& stage = world_.GetStage();
+	const Player& player = world_.GetPlayer();
+	const SimClock& sim_clock = world_.GetClock();
+	const GameState current_state = world_.GetState();
 
+	const double depth_ratio = world_.GetDepthRatio();
+
+	// 背景色はシーン用のレンダーテクスチャに直接塗る（Scene::SetBackground はウィンドウの余白の色になるため）
 	const ColorF current_bg_color = kSurfaceColor.lerp(kDeepSeaColor, depth_ratio);
-	Scene::SetBackground(current_bg_color);
+	Rect{ kSceneSize }.draw(current_bg_color);
+
+	const Vec2 camera_offset = world_.GetCamera().GetCameraOffset();
+	const RectF view_rect = world_.GetCamera().GetViewRect();
 
-	const Vec2 camera_offset = camera_manager_.GetCameraOffset();
-	const RectF view_rect = camera_manager_.GetViewRect();
+	// スプライトはすべてキューに積み，レイヤー→テクスチャ順に並べ替えてから描く
+	render_queue_.BeginFrame();
 
 	// ヘルパー関数：背景を簡単に描画（プレイヤーの近くにいる場合のみ）
-	const double render_distance = stage_.GetTileSize() * 12; // 12マス分の距離
-	const Vec2 player_pos = player_.GetPos();
+	const double render_distance = stage.GetTileSize() * 12; // 12マス分の距離
+	const Vec2 player_pos = player.GetPos();
 
-	auto DrawBackground = [&](const String& texture_name, const Vec2& center_pos, bool isFlip = false, const Vec2& velocity = Vec2{ 0.0, 0.0 }, bool isWave = false)
+	auto DrawBackground = [&](const String& texture_name, const Vec2& center_pos, bool isFlip = false, const Vec2& velocity = Vec2{ 0.0, 0.0 }, bool isWave = false, RenderLayer layer = RenderLayer::Decor)
 		{
+			const AllocationScope background_scope{ U"GameScene::DrawBackground" };
+			const TraceScope background_trace{ U"GameScene::DrawBackground" };
+
 			// 各背景オブジェクトを識別するためのユニークキーを生成
 			const String unique_key = U"{}_{:.1f}_{:.1f}"_fmt(texture_name, center_pos.x, center_pos.y);
 
 			// プレイヤーとの距離をチェック（初期位置で）
 			const double distance = player_pos.distanceFrom(center_pos);
 
-			// プレイヤーが範囲内に入った場合、アクティブ化時刻を記録
+			// プレイヤーが範囲内に入った場合、アクティブ化したティックを記録
 			if(distance <= render_distance)
 			{
-				if(background_activation_times_.find(unique_key) == background_activation_times_.end())
+				if(background_activation_ticks_.find(unique_key) == background_activation_ticks_.end())
 				{
-					// まだ記録されていない場合、現在時刻を記録
-					background_activation_times_[unique_key] = Scene::Time();
+					// まだ記録されていない場合、現在のティックを記録
+					background_activation_ticks_[unique_key] = sim_clock.GetTick();
 				}
 			}
 
@@ -359,10 +526,10 @@ void GameScene::draw() const
 			Vec2 animated_pos = center_pos;
 
 			// アクティブ化されている場合のみ、移動を計算
-			if(background_activation_times_.find(unique_key) != background_activation_times_.end())
+			if(background_activation_ticks_.find(unique_key) != background_activation_ticks_.end())
 			{
-				const double activation_time = background_activation_times_[unique_key];
-				const double elapsed_time = Scene::Time() - activation_time;
+				const uint64 activation_tick = background_activation_ticks_[unique_key];
+				const double elapsed_time = sim_clock.GetElapsedSeconds(activation_tick);
 
 				// アクティブ化時刻からの経過時間に応じて速度分だけ移動
 				animated_pos.x += elapsed_time * velocity.x;
@@ -384,16 +551,16 @@ void GameScene::draw() const
 			}
 
 			const Vec2 kDrawOffset = { 64.0, 64.0 };
-			const Vec2 final_pos = s3d::Floor((animated_pos - kDrawOffset) - camera_offset);
+			const Vec2 final_pos = (animated_pos - kDrawOffset) - camera_offset;
 
 			// 左右反転して描画
 			if(isFlip)
 			{
-				TextureAsset(texture_name).mirrored().draw(final_pos);
+				render_queue_.Submit(layer, TextureAsset(texture_name).mirrored(), final_pos);
 			}
 			else
 			{
-				TextureAsset(texture_name).draw(final_pos);
+				render_queue_.Submit(layer, TextureAsset(texture_name), final_pos);
 			}
 		};
 
@@ -432,153 +599,130 @@ void GameScene::draw() const
 	// プレイヤー開始位置にtitleを描画
 	if(TextureAsset::IsRegistered(U"title"))
 	{
-		const Vec2 title_world_pos = player_start_pos_;
+		const Vec2 title_world_pos = world_.GetPlayerStartPos();
 		Vec2 title_screen_pos = title_world_pos - camera_offset;
 		title_screen_pos += Vec2{ -330.0, -400.0 }; // 少し上にオフセット
-		TextureAsset(U"title").draw(title_screen_pos);
+		render_queue_.Submit(RenderLayer::Title, TextureAsset(U"title"), title_screen_pos);
 	}
 
 	// エンディング座標にoctopusを描画（背景の直後、他のオブジェクトより前）
 	{
 		// エンディング開始から8.4秒後に笑顔へ切り替え
-		const bool showSmile = (current_state_ == GameState::Ending)
-			&& (ending_start_time_ >= 0.0)
-			&& ((Scene::Time() - ending_start_time_) >= kOctopusSmileDelay);
+		const Optional<uint64>& ending_start_tick = world_.GetEndingStartTick();
+		const bool showSmile = (current_state == GameState::Ending)
+			&& ending_start_tick
+			&& (sim_clock.GetElapsedSeconds(*ending_start_tick) >= kOctopusSmileDelay);
 
 		const String texName = showSmile ? U"octopus_smile" : U"octopus";
 
 		if(TextureAsset::IsRegistered(texName))
 		{
-			const Vec2 octopus_world_pos = Vec2{ stage_.GetWidth() * stage_.GetTileSize() / 2.0,7300.0 };
+			const Vec2 octopus_world_pos = Vec2{ stage.GetWidth() * stage.GetTileSize() / 2.0, world_.GetOctopusY() };
 			const Vec2 octopus_screen_pos = octopus_world_pos - camera_offset;
-			TextureAsset(texName).drawAt(octopus_screen_pos);
+			render_queue_.SubmitAt(RenderLayer::Octopus, TextureAsset(texName), octopus_screen_pos);
 		}
 
 		// 笑顔になった後に画面を暗くしオーバレイ画像を描画
 		if(showSmile)
 		{
 			// showSmile になってからの経過時間を計算
-			const double smile_elapsed_time = Scene::Time() - ending_start_time_ - kOctopusSmileDelay;
+			const double smile_elapsed_time = sim_clock.GetElapsedSeconds(*ending_start_tick) - kOctopusSmileDelay;
 
 			// 0.8 秒以上経過してから画面を薄暗くする
 			if(smile_elapsed_time >= 0.8)
 			{
+				// 暗転より奥のスプライトを先に描いておく
+				render_queue_.Flush();
+
 				//画面全体を薄暗く
-				Rect{ 0, 0, Scene::Width(), Scene::Height() }.draw(ColorF{ 0, 0, 0, kEndingDarkenAlpha });
+				Rect{ kSceneSize }.draw(ColorF{ 0, 0, 0, kEndingDarkenAlpha });
 
 				// オーバレイ画像が存在すれば中央より少し上に描画
 				if(TextureAsset::IsRegistered(kEndingOverlayTexture))
 				{
 					constexpr int overlayYOffset = -190; // 少し上に
-					TextureAsset(kEndingOverlayTexture).drawAt(Scene::Center().movedBy(0, overlayYOffset));
+					TextureAsset(kEndingOverlayTexture).drawAt((kSceneSize / 2).movedBy(0, overlayYOffset));
 				}
 			}
 		}
 	}
 
-	player_.Draw(camera_offset);
-
-	for(const auto& enemy : enemies_)
-	{
-		enemy.Draw(camera_offset);
-	}
+	player.Draw(camera_offset, sim_clock, render_queue_);
 
-	stage_.Draw(camera_offset, view_rect);
+	world_.DrawVisibleEntities(camera_offset, view_rect, render_queue_);
 
-	for(const auto& spot : oxygen_spots_)
 	{
-		spot.Draw(camera_offset);
+		const AllocationScope stage_scope{ U"Stage::Draw" };
+		const TraceScope stage_trace{ U"Stage::Draw" };
+		stage.Draw(camera_offset, view_rect, render_queue_);
 	}
 
-	DrawOxygenGauge();
-	DrawProgressMeter();
-
-	if(current_state_ == GameState::Title)
-	{
-		DrawBackground(U"title_text", Vec2{ stage_.GetWidth() * stage_.GetTileSize() / 2.0 - 100, 600 });
-	}
-	else if(current_state_ == GameState::Ending)
 	{
+		const AllocationScope flush_scope{ U"RenderQueue::Flush" };
+		const TraceScope flush_trace{ U"RenderQueue::Flush" };
+		render_queue_.Flush();
 	}
-	else if(current_state_ == GameState::GameOver)
+
 	{
+		const AllocationScope hud_scope{ U"GameHud::Draw" };
+		const TraceScope hud_trace{ U"GameHud::Draw" };
+		const double total_travel = world_.GetMapTotalHeight() - world_.GetPlayerStartPos().y;
+		const double progress_ratio = (total_travel > 0) ? (world_.GetDepth() / total_travel) : 0.0;
+		hud_.Draw(player.GetOxygen(), player.GetMaxOxygen(), progress_ratio);
 	}
-}
 
-void GameScene::DrawOxygenGauge() const
-{
-	RectF{ kOxygenGaugePos, kOxygenGaugeSize }.draw(kUIGaugeBackgroundColor);
-
-	const double current_oxygen = player_.GetOxygen();
-	const double max_oxygen = player_.GetMaxOxygen();
-
-	const double oxygen_ratio = (current_oxygen / max_oxygen);
-
-	ColorF gauge_color;
-	if(current_oxygen > kOxygenWarningThreshold)
+	if(current_state == GameState::Title)
 	{
-		gauge_color = kOxygenColorSafe;
+		DrawBackground(U"title_text", Vec2{ stage.GetWidth() * stage.GetTileSize() / 2.0 - 100, 600 }, false, Vec2{ 0.0, 0.0 }, false, RenderLayer::Foreground);
+		render_queue_.Flush();
 	}
-	else if(current_oxygen > kOxygenDangerThreshold)
+	else if(current_state == GameState::Ending)
 	{
-		gauge_color = kOxygenColorWarning;
 	}
-	else
+	else if(current_state == GameState::GameOver)
 	{
-		gauge_color = kOxygenColorDanger;
 	}
 
-	const double current_height = kOxygenGaugeSize.y * oxygen_ratio;
-
-	RectF{
-		kOxygenGaugePos.x,
-		kOxygenGaugePos.y + (kOxygenGaugeSize.y - current_height),
-		kOxygenGaugeSize.x,
-		current_height
-	}.draw(gauge_color);
-
-	RectF{ kOxygenGaugePos, kOxygenGaugeSize }.drawFrame(2, 0, Palette::White);
-}
-
-void GameScene::DrawProgressMeter() const
-{
-	const double screen_height = Scene::Height();
-	const double screen_right_x = Scene::Width() - kProgressMeterWidth;
-	const double meter_center_x = screen_right_x + (kProgressMeterWidth / 2.0);
-
-	const double total_travel = map_total_height_ - player_start_pos_.y;
-	if(total_travel <= 0)
+	if(is_stats_visible_)
 	{
-		return;
+		DrawStats();
 	}
+}
 
-	RectF{ screen_right_x, 0, kProgressMeterWidth, screen_height }.draw(kUIGaugeBackgroundColor);
+void GameScene::DrawStats() const
+{
+	const RenderStats& stats = render_queue_.GetStats();
+	const CullStats& cull_stats = world_.GetCullStats();
+	const AllocationStats& allocations = AllocationTracker::GetInstance().GetLastFrameStats();
+	const AllocationStats& other_allocations = AllocationTracker::GetInstance().GetLastFrameOtherThreadStats();
+
+	const String text = U"sprites: {} batches: {} state changes: {} (unsorted: {})\n"
+		U"entities drawn: {} culled: {}\n"
+		U"stage segments: {}\n"
+		U"allocations: {} ({} bytes), other threads: {} ({} bytes)"_fmt(
+			stats.sprite_count, stats.batch_count, stats.state_change_count, stats.unsorted_state_change_count,
+			cull_stats.drawn_count, cull_stats.culled_count,
+			world_.GetStage().GetResidentSegments().size(),
+			allocations.count, allocations.bytes, other_allocations.count, other_allocations.bytes);
+
+	const DrawableText drawable = stats_font_(text);
+	drawable.region(kStatsPos).stretched(4).draw(kStatsBackgroundColor);
+	drawable.draw(kStatsPos, Palette::White);
+}
 
-	Line{ meter_center_x, 0, meter_center_x, screen_height }.draw(1, kProgressLineColor);
+void GameScene::BakeHud()
+{
+	const double total_travel = world_.GetMapTotalHeight() - world_.GetPlayerStartPos().y;
 
-	for(const auto& spot : oxygen_spots_)
+	// 持っている区間だけでなく，ステージ全体の酸素スポットをマーカーにする
+	Array<double> spot_ratios;
+	if(total_travel > 0)
 	{
-		double spot_y = 0.0;
-		std::visit([&](const auto& shape)
-				   {
-					   if constexpr(requires { shape.center(); })
-					   {
-						   spot_y = shape.center().y;
-					   }
-				   }, spot.GetCollider().shape);
-
-		double spot_ratio = (spot_y - player_start_pos_.y) / total_travel;
-		spot_ratio = Clamp(spot_ratio, 0.0, 1.0);
-
-		const double marker_y = screen_height * spot_ratio;
-
-		RectF{ Arg::center(meter_center_x, marker_y), kProgressSpotMarkerWidth, kProgressMarkerHeight }.draw(kProgressSpotColor);
+		for(const auto& spot_pos : world_.GetStage().GetOxygenSpotPositions())
+		{
+			spot_ratios << ((spot_pos.y - world_.GetPlayerStartPos().y) / total_travel);
+		}
 	}
 
-	double progress_ratio = (player_.GetPos().y - player_start_pos_.y) / total_travel;
-	progress_ratio = Clamp(progress_ratio, 0.0, 1.0);
-
-	const double marker_y = screen_height * progress_ratio;
-
-	RectF{ Arg::center(meter_center_x, marker_y), kProgressPlayerMarkerWidth, kProgressMarkerHeight }.draw(kProgressPlayerColor);
+	hud_.Bake(spot_ratios, (total_travel > 0));
 }
@@ -1,23 +1,21 @@
 ﻿#pragma once
 
-#include "../Core/CameraManager.h"
+#include "../Audio/AudioBus.h"
+#include "../Audio/MusicPlayer.h"
+#include "../Audio/SfxEngine.h"
+#include "../Core/BootLoader.h"
 #include "../Core/Config.h"
-#include "../Entitie/Component/SoundController.h"
-#include "../Entitie/Enemy.h"
-#include "../Entitie/OxygenSpot.h"
-#include "../Entitie/Player.h"
-#include "../World/Stage.h"
+#include "../Core/GameInput.h"
+#include "../Core/QuickSaveFile.h"
+#include "../Core/RenderQueue.h"
+#include "../Core/RewindBuffer.h"
+#include "../World/GameWorld.h"
+#include "../World/StageCatalog.h"
+#include "../World/StageHotReloader.h"
+#include "GameHud.h"
 
 #include <Siv3D.hpp>
 
-enum class GameState
-{
-	Title,
-	Playing,
-	Ending,
-	GameOver
-};
-
 class GameScene : public App::Scene
 {
 public:
@@ -27,78 +25,109 @@ public:
 	void update() override;
 	void draw() const override;
 
+	// BGM（起動時に LoadingScene が先に開いておく）
+	static constexpr StringView kBgmIntroPath = U"asset/Sound/deepsea_intro.mp3";
+	static constexpr StringView kBgmLoopPath = U"asset/Sound/deepsea.mp3";
+
 private:
-	void SpawnEntities();
-	void OnPlayerDied();
+	// StageCatalog で選ばれているステージを読み直し，敵・酸素スポット・HUD を作り直す
+	// keep_player_pos ならプレイヤーは今の位置のまま
+	void ResetStage(bool keep_player_pos);
 
-	void DrawOxygenGauge() const;
-	void DrawProgressMeter() const;
+	// 書き換えられたステージのファイルを読み直し，変わったところだけを反映する
+	void UpdateStageHotReload();
 
-	Vec2 FindNearestRespawnSpot() const;
+	// HUDの静的な部分（酸素スポットのマーカーなど）を焼き込む
+	void BakeHud();
 
 	void UpdateBGM();
 
-	// helper to start or defer bgm playback
-	void StartOrDeferBGM(const String& asset, bool loop);
-	void ProcessPendingBGM();
+	// P で一時停止，F6 / F7 で時間の倍率を半分／倍にする（デバッグ用）
+	void UpdateTimeScale();
 
-	// stage_を先に宣言(CameraManagerの初期化で使うため)
-	Stage stage_{ U"asset/Stage/v3/tilemap_v3.json", U"asset/Stage/v3/tileset.png", U"collision_layer" };
+	// 描画とカリングの統計，メモリ確保の回数を左下に出す（F3 で切り替える．デバッグ用）
+	void DrawStats() const;
 
-	CameraManager camera_manager_;
-	Player player_;
-	GameState current_state_ = GameState::Title;
-	s3d::Array<Enemy> enemies_;
-	s3d::Array<OxygenSpot> oxygen_spots_;
+	// 1ティック分の入力を決めて world_ を進め，巻き戻しとターボモードの記録をする
+	void UpdateTick();
 
-	SoundController bgm_controller_;
-	bool is_intro_finished_ = false;
+	// カメラの追従に使う1フレームの時間（ターボモードでは実時間によらず1ティック分）
+	double GetFrameDeltaTime() const;
 
-	// pending bgm playback when asset not yet ready
-	String pending_bgm_asset_;
-	bool pending_bgm_loop_ = false;
-	// which BGM actually started playing (empty if none)
-	String current_playing_bgm_asset_;
+	// シミュレーションの状態をバイト列に詰める／戻す（GameWorld::SaveState / LoadState）
+	void CaptureSnapshot(Array<uint8>& bytes) const;
+	bool RestoreSnapshot(const Array<uint8>& bytes, bool snap_camera = false);
 
-	Vec2 player_start_pos_ = Vec2::Zero();
-	double map_total_height_ = 0.0;
+	// 中断セーブ．スナップショットに BGM の再生位置と背景のアクティブ化を足してファイルに書く
+	bool SaveQuickSave(FilePathView path) const;
 
-	// 背景オブジェクトがアクティブになった時刻を記録（プレイヤーが近づいた時刻）
-	mutable std::unordered_map<String, double> background_activation_times_;
+	// 中断セーブから再開する．別のステージのものならステージを作り直す
+	// 敵は作り直さず，プレイヤーのいる深さの区間を読み込んで配置したものに記録した動きを戻す
+	// 読めないところがあれば，ステージも今の状態もそのままにして false を返す
+	bool LoadQuickSave(FilePathView path);
 
-	static constexpr Vec2 kOxygenGaugePos = { 20, 20 };
-	static constexpr Size kOxygenGaugeSize = { 24, 200 };
-	static constexpr ColorF kUIGaugeBackgroundColor = ColorF{ 0.0, 0.5 };
+	// kInputRewind を押している間，記録したフレームを新しいほうから1フレームずつ戻す
+	// 巻き戻したフレームなら true を返す（そのフレームはシミュレーションを進めない）
+	bool UpdateRewind();
 
-	static constexpr ColorF kOxygenColorSafe = Palette::Limegreen;
-	static constexpr ColorF kOxygenColorWarning = Palette::Yellow;
-	static constexpr ColorF kOxygenColorDanger = Palette::Red;
+	// シミュレーション（ステージ，プレイヤー，敵，酸素スポット，時計，カメラ）
+	// 起動時に BootLoader が読み込んだステージを受け取る
+	GameWorld world_{ BootLoader::GetInstance().TakeStage(StageCatalog::GetSelected()) };
 
-	static constexpr double kOxygenWarningThreshold = 70.0;
-	static constexpr double kOxygenDangerThreshold = 30.0;
+	// ステージのファイルの書き換えを監視する（保存するとゲームを止めずに反映される）
+	StageHotReloader stage_reloader_;
 
-	// 深度による背景色
-	static constexpr ColorF kDeepSeaColor = ColorF{ 0.0, 0.1, 0.3 }; // 紺色
+	// 今のティックの入力（フレームの初めにキーボードから読み，ターボモードではティックごとにスクリプトから読む）
+	// 押した瞬間の入力はティックが使うまで残す（一時停止中やスローでティックを進めないフレームに押しても失わない）
+	GameInput tick_input_;
+
+	// タイトル画面で 1 / 2 / 3 / 4 キー（v1 / v2 / v3 / endless）で選ばれ，まだティックが使っていないステージの番号
+	Optional<size_t> pending_stage_index_;
+
+	// GameWorld::GetWarnings() のうち，もう画面に出した数
+	size_t printed_warning_count_ = 0;
+
+	// 統計の表示（kInputToggleStats で切り替える）
+	bool is_stats_visible_ = false;
+	const Font stats_font_{ 14 };
+	static constexpr Vec2 kStatsPos = { 60, 780 };
+	static constexpr ColorF kStatsBackgroundColor = ColorF{ 0.0, 0.6 };
 
-	static constexpr double kProgressMeterWidth = 10.0;
+	// BGM（ストリーミング再生）
+	MusicPlayer bgm_player_;
 
-	static constexpr ColorF kProgressLineColor = Palette::White;			// メーターの縦線の色
-	static constexpr ColorF kProgressPlayerColor = Palette::Yellow;		// プレイヤーマーカーの色
-	static constexpr ColorF kProgressSpotColor = Palette::Limegreen;	// 酸素スポットマーカーの色
-	static constexpr double kProgressPlayerMarkerWidth = 14.0;			// プレイヤーマーカーの幅
-	static constexpr double kProgressSpotMarkerWidth = 8.0;				// スポットマーカーの幅
-	static constexpr double kProgressMarkerHeight = 4.0;				// マーカーの高さ
+	// 遊んでいる間の状態を毎フレーム積んでおく（死んだときにリスポーンの代わりに巻き戻せる）
+	// 5分間で数 MB に収まる．古いものから捨てる
+	static constexpr size_t kRewindCapacityBytes = (4 << 20);
+	static constexpr size_t kRewindMaxFrames = (60 * 60 * 5);
+	RewindBuffer rewind_buffer_{ kRewindCapacityBytes, kRewindMaxFrames };
+	bool is_rewinding_ = false;
 
-	// タイトル・エンディング画面用のカメラオフセット
-	static constexpr double kTitleEndingCameraOffsetYRatio = -1.0 / 4.9;
-	// ゲームプレイ用のカメラオフセット(上1/3にPlayer)
-	static constexpr double kPlayingCameraOffsetYRatio = 1.0 / 6.0;
+	// スナップショットを詰める作業領域（毎フレームの確保を避けるため使い回す）
+	Array<uint8> snapshot_bytes_;
 
-	// エンディングに移行するY座標
-	static constexpr double kEndingZoneY = 7650.0;
+	// 中断セーブのファイル
+	static constexpr StringView kQuickSavePath = U"save/quicksave.bin";
+
+	// 背景オブジェクトがアクティブになったティックを記録（プレイヤーが近づいたとき）
+	mutable std::unordered_map<String, uint64> background_activation_ticks_;
+
+	// スプライトをテクスチャ順に並べ替えてまとめて描くためのキュー
+	mutable RenderQueue render_queue_;
+
+	// 酸素ゲージと進捗メーター（メーターの背景だけステージ読み込み時に焼き込む）
+	GameHud hud_;
+
+	// 深度に応じたBGMのローパス（水面ではほぼ素通し，深海ではこもった音になる）
+	static constexpr double kSurfaceCutoffHz = 20000.0;
+	static constexpr double kDeepSeaCutoffHz = 350.0;
+
+	// 効果音のローパス（深海でも聞き取れるように BGM より高い）
+	static constexpr double kDeepSeaSfxCutoffHz = 1500.0;
+
+	// 深度による背景色
+	static constexpr ColorF kDeepSeaColor = ColorF{ 0.0, 0.1, 0.3 }; // 紺色
 
-	// エンディング開始からの経過時間計測（秒）
-	double ending_start_time_ = -1.0;
 	static constexpr double kOctopusSmileDelay = 7.0 + 8.6; // エンディング開始から8.4 秒後に笑顔に切替
 	static constexpr double kEndingDarkenAlpha = 0.45; // 笑顔後に画面を薄暗くするアルファ
 	static constexpr StringView kEndingOverlayTexture = U"ending_text"; //追加で描画する画像名（AssetInformation.json に登録必要）
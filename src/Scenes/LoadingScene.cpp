@@ -0,0 +1,39 @@
+﻿#include "../Core/BootLoader.h"
+#include "GameScene.h"
+#include "LoadingScene.h"
+
+#include <Siv3D.hpp>
+
+LoadingScene::LoadingScene(const InitData& init)
+	: IScene(init)
+{
+	BootLoader::GetInstance().Start(StageCatalog::GetSelected(), FilePath{ GameScene::kBgmIntroPath }, FilePath{ GameScene::kBgmLoopPath });
+}
+
+void LoadingScene::update()
+{
+	BootLoader& boot_loader = BootLoader::GetInstance();
+	boot_loader.Update();
+
+	if(boot_loader.IsReady())
+	{
+		// 最初に操作できるまでの時間を測っているので，フェードは入れない
+		changeScene(SceneID::kGame, 0s);
+	}
+}
+
+void LoadingScene::draw() const
+{
+	const Vec2 center{ (kSceneSize.x / 2.0), (kSceneSize.y / 2.0) };
+
+	for(int32 i = 0; i < kDotCount; ++i)
+	{
+		const double x = (center.x + ((i - (kDotCount - 1) / 2.0) * kDotSpacing));
+		const double y = (center.y - 24.0 - (Math::Abs(Math::Sin((Scene::Time() * kDotBobSpeed) - i)) * kDotBobHeight));
+		Circle{ x, y, kDotRadius }.draw(kBarColor);
+	}
+
+	const RectF bar{ Arg::center(center), kBarSize };
+	bar.draw(kBarBackgroundColor);
+	RectF{ bar.x, bar.y, (bar.w * BootLoader::GetInstance().GetProgress()), bar.h }.draw(kBarColor);
+}
@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include "../Core/Config.h"
+
+#include <Siv3D.hpp>
+
+// 起動時の読み込み画面
+// BootLoader に読み込みを進めさせ，終わったら GameScene に切り替える
+// アセットの読み込みを待たずに出せるように，図形だけで進み具合を描く
+class LoadingScene : public App::Scene
+{
+public:
+	LoadingScene(const InitData& init);
+
+	void update() override;
+	void draw() const override;
+
+private:
+	// 進み具合のバー
+	static constexpr SizeF kBarSize = { 320, 8 };
+	static constexpr ColorF kBarBackgroundColor = ColorF{ 0.0, 0.5 };
+	static constexpr ColorF kBarColor = ColorF{ 1.0, 0.9 };
+
+	// 泡のように上下する点（読み込みが止まっていないことを示す）
+	static constexpr int32 kDotCount = 3;
+	static constexpr double kDotRadius = 5.0;
+	static constexpr double kDotSpacing = 20.0;
+	static constexpr double kDotBobHeight = 6.0;
+	static constexpr double kDotBobSpeed = 4.0;
+};
@@ -0,0 +1,304 @@
+﻿#include "../Core/JobSystem.h"
+#include "../World/StageCatalog.h"
+#include "BatchRunner.h"
+
+#include <Siv3D.hpp>
+
+BatchRunner::BatchRunner(const BatchRunnerConfig& config)
+	: config_(config)
+	, max_ticks_(SimClock::SecondsToTicks(config.minutes * 60.0))
+{
+}
+
+bool BatchRunner::Prepare()
+{
+	const StageEntry& entry = StageCatalog::GetSelected();
+
+	// ワールドは描画しないので，見た目用のレイヤーは読み込んだところで捨てる
+	const std::unique_ptr<StageSegmentSource> source = StageCatalog::CreateSource(entry);
+	stage_data_ = SharedSegmentSource::Build(*source, true);
+	if(not stage_data_)
+	{
+		Console << U"BatchRunner: 終わりのないステージ {} は共有できません"_fmt(entry.name);
+		return false;
+	}
+
+	Array<InputScript> scripts;
+	for(const FilePath& path : config_.script_paths)
+	{
+		InputScript script;
+		String error;
+		if(not script.Load(path, error))
+		{
+			Console << U"BatchRunner: 入力スクリプトを読めません（{}） → {}"_fmt(error, path);
+			return false;
+		}
+		scripts << std::move(script);
+	}
+
+	// 描画も効果音も無いワールドにする．JobSystem はワールドを並べるのに使うので，ワールドの中では使わない
+	GameWorldOptions options;
+	options.use_job_system = false;
+	options.is_audible = false;
+
+	runs_.reserve(config_.world_count);
+	for(size_t i = 0; i < config_.world_count; ++i)
+	{
+		auto run = std::make_unique<WorldRun>();
+		run->world = std::make_unique<GameWorld>(Stage{ std::make_unique<SharedSegmentSource>(stage_data_), Texture{} }, options);
+
+		if(scripts.isEmpty())
+		{
+			const uint64 seed = (config_.seed + i);
+			run->script = InputScript::CreateRandom(seed);
+			run->script_name = U"random:{}"_fmt(seed);
+		}
+		else
+		{
+			run->script = scripts[i % scripts.size()];
+			run->script_name = FileSystem::FileName(config_.script_paths[i % scripts.size()]);
+		}
+
+		runs_.push_back(std::move(run));
+	}
+
+	return true;
+}
+
+void BatchRunner::RunWorld(WorldRun& run) const
+{
+	const Stopwatch stopwatch{ StartImmediately::Yes };
+	GameWorld& world = *run.world;
+
+	while(run.stats.GetTickCount() < max_ticks_)
+	{
+		const GameWorldEvents events = TickScripted(world, run.script, run.stats);
+
+		// エンディングの演出は入力に関係なく進むだけなので，着いたところで終える
+		if(events.is_ending_reached)
+		{
+			break;
+		}
+	}
+
+	run.wall_sec = stopwatch.sF();
+}
+
+GameWorldEvents BatchRunner::TickScripted(GameWorld& world, InputScript& script, RunStats& stats)
+{
+	// タイトルは飛ばし，スクリプトが押さなくても死んだら少し待ってリスポーンする
+	GameInput input;
+	if(world.GetState() == GameState::Title)
+	{
+		input.ok = true;
+	}
+	else
+	{
+		input = script.Next();
+		input.ok = (input.ok || stats.IsRespawnDue());
+	}
+
+	// 描画しないので表示用のカメラは進めない（区間の読み込みは Tick() の中で決まる）
+	const GameWorldEvents events = world.Tick(input);
+
+	if(world.GetState() != GameState::Title)
+	{
+		stats.Record(world, events);
+	}
+	return events;
+}
+
+bool BatchRunner::Run()
+{
+	const Stopwatch prepare_stopwatch{ StartImmediately::Yes };
+	if(not Prepare())
+	{
+		return false;
+	}
+
+	Console << U"BatchRunner: {} のワールドを {} 個作りました（{:.1f} ms，区間 {} 個を共有）．最大 {} 分（{} ティック）ずつ進めます"_fmt(
+		StageCatalog::GetSelected().name, runs_.size(), prepare_stopwatch.msF(), stage_data_->segments.size(), config_.minutes, max_ticks_);
+
+	if(config_.is_scaling_run)
+	{
+		// 同じスクリプトのワールドをワーカー1つで進めてから作り直すので，どちらも同じティック数を進める
+		const double serial_sec = RunWorlds(false);
+		const double serial_ticks_per_sec = ((serial_sec > 0.0) ? (GetTotalTicks() / serial_sec) : 0.0);
+		Console << U"BatchRunner: ワーカー 1 で {:.2f} 秒，{:.0f} ティック/秒"_fmt(serial_sec, serial_ticks_per_sec);
+
+		runs_.clear();
+		if(not Prepare())
+		{
+			return false;
+		}
+	}
+
+	const double wall_sec = RunWorlds(true);
+
+	PrintWarnings();
+	PrintSummary(wall_sec);
+	if(not WriteReport())
+	{
+		Console << U"BatchRunner: 書き出せませんでした → {}"_fmt(config_.report_path);
+	}
+
+	// ワールドは Stage のテクスチャを持つので，メインスレッドで片付ける
+	runs_.clear();
+	return true;
+}
+
+double BatchRunner::RunWorlds(bool is_parallel)
+{
+	const Stopwatch stopwatch{ StartImmediately::Yes };
+
+	if(not is_parallel)
+	{
+		for(const auto& run : runs_)
+		{
+			RunWorld(*run);
+		}
+		return stopwatch.sF();
+	}
+
+	// ワールドは互いに何も共有しない（区間のデータは読むだけ）ので，1つずつチャンクにしてワーカーに配る
+	// ワールドごとの長さはまちまちなので，空いたワーカーが残りを盗んで均す
+	JobSystem::GetInstance().ParallelFor(runs_.size(), 1, [&](size_t begin, size_t end, size_t)
+		{
+			for(size_t i = begin; i < end; ++i)
+			{
+				RunWorld(*runs_[i]);
+			}
+		});
+	return stopwatch.sF();
+}
+
+uint64 BatchRunner::GetTotalTicks() const
+{
+	uint64 total_ticks = 0;
+	for(const auto& run : runs_)
+	{
+		total_ticks += run->stats.GetTickCount();
+	}
+	return total_ticks;
+}
+
+void BatchRunner::PrintWarnings() const
+{
+	// ワールドごとに読み込んだ区間が違うので，全てのワールドの分を合わせる
+	Array<String> warnings;
+	for(const auto& run : runs_)
+	{
+		for(const auto& warning : run->world->GetWarnings())
+		{
+			if(not warnings.contains(warning))
+			{
+				warnings << warning;
+			}
+		}
+	}
+
+	for(const auto& warning : warnings)
+	{
+		Console << U"BatchRunner: {}"_fmt(warning);
+	}
+}
+
+void BatchRunner::PrintSummary(double wall_sec) const
+{
+	uint64 total_ticks = 0;
+	size_t ending_count = 0;
+	uint64 death_count = 0;
+	double max_depth_ratio_sum = 0.0;
+	for(const auto& run : runs_)
+	{
+		total_ticks += run->stats.GetTickCount();
+		ending_count += (run->stats.GetEndingTick() ? 1 : 0);
+		death_count += run->stats.GetDeathCount();
+		max_depth_ratio_sum += run->stats.GetMaxDepthRatio();
+	}
+
+	const double ticks_per_sec = ((wall_sec > 0.0) ? (total_ticks / wall_sec) : 0.0);
+	const double world_count = static_cast<double>(Max<size_t>(runs_.size(), 1));
+
+	Console << U"BatchRunner: {} 個のワールドを合わせて {} ティック（{:.1f} 秒）進めました（実時間 {:.2f} 秒，{:.0f} ティック/秒，ワーカー {}）"_fmt(
+		runs_.size(), total_ticks, SimClock::TicksToSeconds(total_ticks), wall_sec, ticks_per_sec, JobSystem::GetInstance().GetWorkerCount());
+	Console << U"  エンディングに着いた数: {} / {}，死んだ回数の平均: {:.2f}，最大の深さの平均: {:.1f}%（ワールドごと → {}）"_fmt(
+		ending_count, runs_.size(), (death_count / world_count), ((max_depth_ratio_sum / world_count) * 100.0), config_.report_path);
+}
+
+bool BatchRunner::WriteReport() const
+{
+	TextWriter writer{ config_.report_path };
+	if(not writer)
+	{
+		return false;
+	}
+
+	writer.writeln(U"world,script,ticks,ending_seconds,deaths,max_depth,max_depth_ratio,min_oxygen,average_oxygen,wall_ms");
+	for(size_t i = 0; i < runs_.size(); ++i)
+	{
+		const WorldRun& run = *runs_[i];
+		const RunStats& stats = run.stats;
+		const String ending_seconds = (stats.GetEndingTick() ? U"{:.1f}"_fmt(SimClock::TicksToSeconds(*stats.GetEndingTick())) : String{});
+
+		writer.writeln(U"{},{},{},{},{},{:.1f},{:.4f},{:.2f},{:.2f},{:.1f}"_fmt(
+			i, run.script_name, stats.GetTickCount(), ending_seconds, stats.GetDeathCount(), stats.GetMaxDepth(),
+			stats.GetMaxDepthRatio(), stats.GetMinOxygen(), stats.GetAverageOxygen(), (run.wall_sec * 1000.0)));
+	}
+	return true;
+}
+
+bool BatchRunner::RunFromCommandLine(const Array<String>& args)
+{
+	const auto it = std::find(args.begin(), args.end(), U"--batch");
+	if(it == args.end())
+	{
+		return false;
+	}
+
+	BatchRunnerConfig config;
+	if((it + 1) != args.end())
+	{
+		config.world_count = ParseOr<size_t>(*(it + 1), config.world_count);
+	}
+
+	for(size_t i = 0; (i + 1) < args.size(); ++i)
+	{
+		const String& key = args[i];
+		const String& value = args[i + 1];
+
+		if(key == U"--batch-script")
+		{
+			for(const auto& path : value.split(U','))
+			{
+				if(not path.isEmpty())
+				{
+					config.script_paths << path;
+				}
+			}
+		}
+		else if(key == U"--batch-seed")
+		{
+			config.seed = ParseOr<uint64>(value, config.seed);
+		}
+		else if(key == U"--batch-minutes")
+		{
+			config.minutes = Max(ParseOr<double>(value, config.minutes), 0.0);
+		}
+		else if(key == U"--batch-report")
+		{
+			config.report_path = value;
+		}
+	}
+	config.is_scaling_run = args.contains(U"--batch-scaling");
+
+	if(config.world_count == 0)
+	{
+		Console << U"BatchRunner: --batch の後にワールドの数を指定してください";
+		return true;
+	}
+
+	BatchRunner runner{ config };
+	runner.Run();
+	return true;
+}
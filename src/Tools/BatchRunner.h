@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include "../World/GameWorld.h"
+#include "../World/StageSegmentSource.h"
+#include "InputScript.h"
+#include "RunStats.h"
+
+#include <Siv3D.hpp>
+
+#include <memory>
+
+// 一括実行の設定
+struct BatchRunnerConfig
+{
+	size_t world_count = 1;
+
+	// ワールドに順に割り当てる入力スクリプト（空ならシード値から作ったでたらめな入力）
+	Array<FilePath> script_paths;
+	uint64 seed = 1;
+
+	// 1つのワールドを進める最大の時間（シミュレーションの時間）
+	double minutes = 10.0;
+
+	FilePath report_path = U"profile/batch_report.csv";
+
+	// 全てのワーカーで進める前に，同じワールドを呼び出し元のスレッドだけで進めて速さを比べる
+	bool is_scaling_run = false;
+};
+
+// 独立した GameWorld をいくつも作り，JobSystem のワーカーで同時に最後まで進める（バランス調整の統計を取る）
+//
+// --batch <ワールド数> で起動すると，ウィンドウもシーンも使わずに --stage で選んだステージのワールドを作る
+// ステージの区間は最初に1回だけ読み込み，全てのワールドで読み取り専用のまま共有する（SharedSegmentSource）
+// 入力は --batch-script a.txt,b.txt の順にワールドへ割り当て（ワールドのほうが多ければ繰り返す），
+// 指定が無ければ --batch-seed <シード> とワールドの番号から作る（InputScript::CreateRandom）
+// タイトルを飛ばし，死んだら RunStats::kAutoRespawnTicks 後にリスポーンする
+// エンディングに着くか --batch-minutes <分> が過ぎたらそのワールドは終わる
+// ワールドごとの結果を --batch-report <出力先>（CSV）に，全体の速さを Console に書き出す
+// --batch-scaling を付けると，先に同じワールドをワーカー1つ（呼び出し元のスレッドだけ）で進め，1秒あたりのティック数を比べる
+//
+// 1つのワールドは1つのワーカーが最後まで進める（JobSystem は入れ子にできないので，ワールドの中では並列にしない）
+class BatchRunner
+{
+public:
+	explicit BatchRunner(const BatchRunnerConfig& config);
+
+	// ワールドを作って最後まで進め，結果を書き出す．始められなかったら false
+	bool Run();
+
+	// 引数に --batch が無ければ何もせず false を返す
+	static bool RunFromCommandLine(const Array<String>& args);
+
+	// スクリプトの入力でワールドを1ティック進める（タイトルを飛ばし，死んだら RunStats::kAutoRespawnTicks 後にリスポーンする）
+	static GameWorldEvents TickScripted(GameWorld& world, InputScript& script, RunStats& stats);
+
+private:
+	struct WorldRun
+	{
+		std::unique_ptr<GameWorld> world;
+		InputScript script;
+		String script_name;
+		RunStats stats;
+		double wall_sec = 0.0;
+	};
+
+	// 共有する区間を読み込み，ワールドと入力を用意する（メインスレッドで呼ぶ）
+	bool Prepare();
+
+	// 1つのワールドを最後まで進める（ワーカーから呼ぶ．他のワールドには触らない）
+	void RunWorld(WorldRun& run) const;
+
+	// 全てのワールドを最後まで進め，かかった実時間[秒]を返す（is_parallel でなければ呼び出し元のスレッドだけで順に進める）
+	double RunWorlds(bool is_parallel);
+
+	// 全てのワールドを合わせたティック数
+	uint64 GetTotalTicks() const;
+
+	// ワールドが溜めた警告を，重複を除いて書き出す（メインスレッドで呼ぶ）
+	void PrintWarnings() const;
+
+	void PrintSummary(double wall_sec) const;
+	bool WriteReport() const;
+
+	BatchRunnerConfig config_;
+	uint64 max_ticks_ = 0;
+
+	std::shared_ptr<const SharedSegmentSource::Data> stage_data_;
+
+	// ワールドごとに別々に確保する（隣のワールドの記録と同じキャッシュラインを書き換え合わないように）
+	Array<std::unique_ptr<WorldRun>> runs_;
+};
@@ -0,0 +1,188 @@
+﻿#include "InputScript.h"
+
+#include <Siv3D.hpp>
+
+bool InputScript::Load(FilePathView path, String& error)
+{
+	TextReader reader{ path };
+	if(not reader)
+	{
+		error = U"ファイルを開けません";
+		return false;
+	}
+
+	lines_.clear();
+	is_looping_ = false;
+	line_index_ = 0;
+	tick_in_line_ = 0;
+
+	String text;
+	for(size_t line_number = 1; reader.readLine(text); ++line_number)
+	{
+		// コメントを除く
+		if(const size_t comment_pos = text.indexOf(U'#'); comment_pos != String::npos)
+		{
+			text.resize(comment_pos);
+		}
+
+		text.replace(U'\t', U' ');
+		Array<String> tokens = text.split(U' ');
+		tokens.remove_if([](const String& token) { return token.isEmpty(); });
+		if(tokens.isEmpty())
+		{
+			continue;
+		}
+
+		if(tokens[0] == U"loop")
+		{
+			is_looping_ = true;
+			continue;
+		}
+
+		Line line;
+		line.tick_count = ParseOr<uint32>(tokens[0], 0);
+		if(line.tick_count == 0)
+		{
+			error = U"{} 行目: ティック数が正しくありません（{}）"_fmt(line_number, tokens[0]);
+			return false;
+		}
+
+		for(size_t i = 1; i < tokens.size(); ++i)
+		{
+			const String& key = tokens[i];
+			if(key == U"left")
+			{
+				line.input.left = true;
+			}
+			else if(key == U"right")
+			{
+				line.input.right = true;
+			}
+			else if(key == U"swim")
+			{
+				line.input.swim = true;
+			}
+			else if(key == U"ok")
+			{
+				line.input.ok = true;
+			}
+			else if(key == U"rewind")
+			{
+				line.input.rewind = true;
+			}
+			else
+			{
+				error = U"{} 行目: 知らないキーです（{}）"_fmt(line_number, key);
+				return false;
+			}
+		}
+
+		lines_ << line;
+	}
+
+	return true;
+}
+
+bool InputScript::UsesRewind() const
+{
+	return lines_.any([](const Line& line) { return line.input.rewind; });
+}
+
+bool InputScript::Save(FilePathView path) const
+{
+	TextWriter writer{ path };
+	if(not writer)
+	{
+		return false;
+	}
+
+	for(const Line& line : lines_)
+	{
+		String text = Format(line.tick_count);
+		if(line.input.left)
+		{
+			text += U" left";
+		}
+		if(line.input.right)
+		{
+			text += U" right";
+		}
+		if(line.input.swim)
+		{
+			text += U" swim";
+		}
+		if(line.input.ok)
+		{
+			text += U" ok";
+		}
+		if(line.input.rewind)
+		{
+			text += U" rewind";
+		}
+		writer.writeln(text);
+	}
+
+	if(is_looping_)
+	{
+		writer.writeln(U"loop");
+	}
+	return true;
+}
+
+InputScript InputScript::CreateRandom(uint64 seed)
+{
+	SmallRNG rng{ seed };
+
+	InputScript script;
+	script.is_looping_ = true;
+	script.lines_.reserve(kRandomLineCount);
+
+	for(size_t i = 0; i < kRandomLineCount; ++i)
+	{
+		Line line;
+		line.tick_count = Random(kRandomMinTicks, kRandomMaxTicks, rng);
+
+		// 左右と止まるのは 1/3 ずつ．泳ぐと浮くので，泳ぐのは一部の行だけにして沈みながら動き回る
+		const int32 direction = Random(0, 2, rng);
+		line.input.left = (direction == 1);
+		line.input.right = (direction == 2);
+		line.input.swim = (RandomClosedOpen(0.0, 1.0, rng) < kRandomSwimRate);
+		script.lines_ << line;
+	}
+
+	return script;
+}
+
+GameInput InputScript::Next()
+{
+	if(line_index_ == lines_.size())
+	{
+		if((not is_looping_) || lines_.isEmpty())
+		{
+			return GameInput{};
+		}
+		line_index_ = 0;
+	}
+
+	const Line& line = lines_[line_index_];
+	const GameInput input = ((tick_in_line_ == 0) ? line.input : line.input.WithoutEdges());
+
+	if(++tick_in_line_ == line.tick_count)
+	{
+		++line_index_;
+		tick_in_line_ = 0;
+	}
+	return input;
+}
+
+void InputScript::Append(const GameInput& input)
+{
+	// 押した瞬間の入力があるティックは新しい行にする（行の最初のティックでしか押せないので）
+	if((not input.HasEdges()) && (not lines_.isEmpty()) && (lines_.back().input.WithoutEdges() == input))
+	{
+		++lines_.back().tick_count;
+		return;
+	}
+
+	lines_ << Line{ 1, input };
+}
@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include "../Core/GameInput.h"
+
+#include <Siv3D.hpp>
+
+// ティックごとの入力を並べたもの（ターボモードで再生し，--record-input で書き出す）
+//
+// テキストで，1行に「ティック数 キー...」を書く．キーは left / right / swim / ok / rewind
+// left / right / rewind はその行のティックの間ずっと押し，swim / ok はその行の最初のティックで押す
+// キーを書かない行は何も押さずに待つ．loop と書いた行があると，最後まで進んだら最初の行から繰り返す
+// # から後はコメント
+//
+//   # 0.5秒ごとに泳ぎながら右に進む
+//   1 swim right
+//   29 right
+//   loop
+class InputScript
+{
+public:
+	// 読めなかったときは error に理由（行番号つき）を入れて false を返す
+	bool Load(FilePathView path, String& error);
+	bool Save(FilePathView path) const;
+
+	// seed から決まる，でたらめに泳ぎ回る loop のスクリプト（BatchRunner でスクリプトを指定しないワールド用）
+	static InputScript CreateRandom(uint64 seed);
+
+	// 次のティックの入力（最後まで進んだら，loop なら最初から，そうでなければ何も押さない）
+	GameInput Next();
+
+	// 1ティック分の入力を末尾に足す（押し続けているキーが前の行と同じなら，前の行を延ばす）
+	void Append(const GameInput& input);
+
+	bool IsEmpty() const { return lines_.isEmpty(); }
+
+	// rewind を押す行があるか
+	bool UsesRewind() const;
+
+private:
+	struct Line
+	{
+		uint32 tick_count = 0;
+		GameInput input;
+	};
+
+	Array<Line> lines_;
+	bool is_looping_ = false;
+
+	// 再生している位置
+	size_t line_index_ = 0;
+	uint32 tick_in_line_ = 0;
+
+	// CreateRandom() で作る行数，1行のティック数の範囲，泳ぐ行の割合
+	static constexpr size_t kRandomLineCount = 256;
+	static constexpr uint32 kRandomMinTicks = 4;
+	static constexpr uint32 kRandomMaxTicks = 45;
+	static constexpr double kRandomSwimRate = 0.15;
+};
@@ -0,0 +1,56 @@
+﻿#include "RunStats.h"
+
+#include <Siv3D.hpp>
+
+void RunStats::EnableSamples(uint64 max_ticks)
+{
+	is_sampling_ = true;
+	samples_.reserve(static_cast<size_t>(max_ticks / kSampleIntervalTicks) + 1);
+}
+
+void RunStats::Record(const GameWorld& world, const GameWorldEvents& events)
+{
+	++tick_count_;
+
+	const Player& player = world.GetPlayer();
+	const double depth = world.GetDepth();
+	const double oxygen = player.GetOxygen();
+
+	dead_tick_count_ = (player.IsOxygenEmpty() ? (dead_tick_count_ + 1) : 0);
+	if(events.is_player_died)
+	{
+		++death_count_;
+	}
+	if(events.is_ending_reached)
+	{
+		ending_tick_ = tick_count_;
+	}
+
+	max_depth_ = Max(max_depth_, depth);
+	max_depth_ratio_ = Max(max_depth_ratio_, world.GetDepthRatio());
+	last_depth_ = depth;
+	min_oxygen_ = Min(min_oxygen_, oxygen);
+	oxygen_sum_ += oxygen;
+	last_oxygen_ = oxygen;
+
+	if(is_sampling_ && ((tick_count_ % kSampleIntervalTicks) == 0))
+	{
+		samples_ << Sample{ tick_count_, depth, oxygen };
+	}
+}
+
+bool RunStats::WriteSamples(FilePathView path) const
+{
+	TextWriter writer{ path };
+	if(not writer)
+	{
+		return false;
+	}
+
+	writer.writeln(U"seconds,depth,oxygen");
+	for(const Sample& sample : samples_)
+	{
+		writer.writeln(U"{:.0f},{:.1f},{:.2f}"_fmt(SimClock::TicksToSeconds(sample.tick), sample.depth, sample.oxygen));
+	}
+	return true;
+}
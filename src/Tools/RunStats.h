@@ -0,0 +1,66 @@
+﻿#pragma once
+
+#include "../Core/SimClock.h"
+#include "../World/GameWorld.h"
+
+#include <Siv3D.hpp>
+
+// 1回の遊びの記録（到達した深さ，死んだ回数，エンディングまでの時間，酸素）
+// タイトルを過ぎてから GameWorld::Tick() のたびに Record() を呼ぶ（TurboRunner と BatchRunner で使う）
+class RunStats
+{
+public:
+	// 深さと酸素の推移を kSampleIntervalTicks ごとに取っておく（max_ticks は確保する目安）
+	void EnableSamples(uint64 max_ticks);
+
+	void Record(const GameWorld& world, const GameWorldEvents& events);
+
+	// 死んでから kAutoRespawnTicks が過ぎた（スクリプトが押さなくても決定を押してリスポーンする）
+	bool IsRespawnDue() const { return (dead_tick_count_ >= kAutoRespawnTicks); }
+
+	uint64 GetTickCount() const { return tick_count_; }
+	uint32 GetDeathCount() const { return death_count_; }
+	double GetMaxDepth() const { return max_depth_; }
+	double GetMaxDepthRatio() const { return max_depth_ratio_; }
+	double GetLastDepth() const { return last_depth_; }
+	double GetMinOxygen() const { return ((tick_count_ > 0) ? min_oxygen_ : 0.0); }
+	double GetAverageOxygen() const { return ((tick_count_ > 0) ? (oxygen_sum_ / tick_count_) : 0.0); }
+	double GetLastOxygen() const { return last_oxygen_; }
+
+	// エンディングに着いたティック（タイトルを過ぎてから数える．着いていなければ none）
+	const Optional<uint64>& GetEndingTick() const { return ending_tick_; }
+
+	// 推移を CSV（seconds,depth,oxygen）に書き出す
+	bool WriteSamples(FilePathView path) const;
+
+	// 死んでから決定を押すまでのティック数
+	static constexpr uint64 kAutoRespawnTicks = SimClock::SecondsToTicks(1.0);
+
+	// 推移を記録する間隔
+	static constexpr uint64 kSampleIntervalTicks = SimClock::kTicksPerSecond;
+
+private:
+	uint64 tick_count_ = 0;
+
+	// 死んでからのティック数（生きている間は 0）
+	uint64 dead_tick_count_ = 0;
+	uint32 death_count_ = 0;
+
+	double max_depth_ = 0.0;
+	double max_depth_ratio_ = 0.0;
+	double last_depth_ = 0.0;
+	double min_oxygen_ = Math::Inf;
+	double oxygen_sum_ = 0.0;
+	double last_oxygen_ = 0.0;
+	Optional<uint64> ending_tick_;
+
+	// kSampleIntervalTicks ごとの深さと酸素
+	struct Sample
+	{
+		uint64 tick = 0;
+		double depth = 0.0;
+		double oxygen = 0.0;
+	};
+	bool is_sampling_ = false;
+	Array<Sample> samples_;
+};
@@ -0,0 +1,783 @@
+﻿#include "../Core/JobSystem.h"
+#include "../Core/RewindBuffer.h"
+#include "../Core/StateSnapshot.h"
+#include "../Core/Utility.h"
+#include "../World/GameWorld.h"
+#include "../World/Stage.h"
+#include "../World/StageCatalog.h"
+#include "../World/TileLayerCodec.h"
+#include "../World/TileSweep.h"
+#include "BatchRunner.h"
+#include "InputScript.h"
+#include "RunStats.h"
+#include "SelfCheck.h"
+#include "StageGenerator.h"
+
+#include <Siv3D.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+
+namespace
+{
+	struct CheckOptions
+	{
+		size_t loops = 2000;
+
+		// physics-hash と replay で進めるティック数と入力（script_path が空ならシード値から作ったでたらめな入力）
+		uint64 ticks = SimClock::SecondsToTicks(5.0 * 60.0);
+		uint64 seed = 1;
+		FilePath script_path;
+
+		// physics-hash の結果と比べるハッシュ（別の環境で出したもの）
+		Optional<uint64> expected_hash;
+	};
+
+#ifdef BNS_FIXED_POINT_PHYSICS
+	constexpr StringView kPhysicsName = U"固定小数点";
+#else
+	constexpr StringView kPhysicsName = U"double";
+#endif
+
+	// ループの番号と要素の番号から作る，要素ごとに違う値
+	uint64 MixIndex(uint64 loop, uint64 index)
+	{
+		uint64 x = ((loop << 32) ^ index) + 0x9E3779B97F4A7C15ull;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return (x ^ (x >> 31));
+	}
+
+	bool CheckJobStress(const CheckOptions& options)
+	{
+		JobSystem& job_system = JobSystem::GetInstance();
+		const std::thread::id caller_id = std::this_thread::get_id();
+
+		// ゲームの粒度（GameWorld::kEntityUpdateGrain）では小さいステージが並列にならないので，細かく切って必ず並列の道を通す
+		constexpr size_t kMaxCount = 4000;
+		constexpr size_t kMaxGrain = 64;
+
+		SmallRNG rng{ 12345 };
+		OrderedJobBuffers<uint64> buffers;
+		Array<uint64> merged;
+		Array<uint32> visits;
+		merged.reserve(kMaxCount);
+		visits.reserve(kMaxCount);
+
+		size_t parallel_loops = 0;
+		std::atomic<uint64> worker_chunks{ 0 };
+
+		for(size_t loop = 0; loop < options.loops; ++loop)
+		{
+			const size_t count = static_cast<size_t>(Random<uint64>(0, kMaxCount, rng));
+			const size_t grain = static_cast<size_t>(Random<uint64>(1, kMaxGrain, rng));
+			const size_t chunk_count = JobSystem::GetChunkCount(count, grain);
+
+			buffers.Prepare(chunk_count);
+			visits.assign(count, 0);
+
+			// 要素はどれか1つのチャンクにしか属さないので，visits は正しく分けられていれば競合しない
+			job_system.ParallelFor(count, grain, [&](size_t begin, size_t end, size_t chunk_index)
+				{
+					if(std::this_thread::get_id() != caller_id)
+					{
+						worker_chunks.fetch_add(1, std::memory_order_relaxed);
+					}
+
+					for(size_t i = begin; i < end; ++i)
+					{
+						++visits[i];
+						buffers[chunk_index] << MixIndex(loop, i);
+					}
+				});
+
+			merged.clear();
+			buffers.ForEachInOrder([&](uint64 value) { merged << value; });
+
+			bool is_ok = (merged.size() == count);
+			for(size_t i = 0; is_ok && (i < count); ++i)
+			{
+				is_ok = ((visits[i] == 1) && (merged[i] == MixIndex(loop, i)));
+			}
+
+			if(not is_ok)
+			{
+				Console << U"  {} 回目（要素 {} 個，粒度 {}）で，結合した結果が直列に回した結果と違います"_fmt(loop, count, grain);
+				return false;
+			}
+
+			parallel_loops += ((chunk_count > 1) ? 1 : 0);
+		}
+
+		Console << U"  {} 回のうち {} 回をワーカー {} 個で並列に回し，{} チャンクを呼び出し元以外のスレッドが処理しました"_fmt(
+			options.loops, parallel_loops, job_system.GetWorkerCount(), worker_chunks.load());
+
+		if((job_system.GetWorkerCount() > 1) && (worker_chunks.load() == 0))
+		{
+			Console << U"  ワーカーが1つもチャンクを処理していません";
+			return false;
+		}
+		return true;
+	}
+
+	// 文字列で描いた格子（'#' が壁）をそのまま1区間にする，確認用のステージ
+	class GridSegmentSource : public StageSegmentSource
+	{
+	public:
+		explicit GridSegmentSource(const Array<StringView>& rows, int32 tile_size = 16)
+			: rows_(rows)
+			, tile_size_(tile_size)
+		{
+		}
+
+		int32 GetWidth() const override { return static_cast<int32>(rows_.front().size()); }
+		int32 GetTileSize() const override { return tile_size_; }
+		int32 GetSegmentRows() const override { return static_cast<int32>(rows_.size()); }
+		Optional<int32> GetTotalRows() const override { return static_cast<int32>(rows_.size()); }
+
+		void LoadSegment(int32 segment_index, StageSegment& out) override
+		{
+			out.Reset(segment_index, 0, GetWidth(), GetSegmentRows());
+			for(int32 y = 0; y < GetSegmentRows(); ++y)
+			{
+				for(int32 x = 0; x < GetWidth(); ++x)
+				{
+					if(rows_[y][x] == U'#')
+					{
+						out.SetSolid(x, y);
+					}
+				}
+				out.RebuildOpenRuns(y);
+			}
+		}
+
+	private:
+		Array<StringView> rows_;
+		int32 tile_size_ = 16;
+	};
+
+	struct SweepCase
+	{
+		StringView name;
+		Vec2 center;
+		Vec2 half_size;
+		Vec2 displacement;
+
+		// 当たらないなら none
+		Optional<double> time;
+		Point normal{ 0, 0 };
+	};
+
+	template <class Hit>
+	bool IsExpectedHit(const SweepCase& sweep_case, const Hit& hit)
+	{
+		if(not sweep_case.time)
+		{
+			return (not hit.is_hit);
+		}
+
+		// 固定小数点は越えた境界ごとに時刻を切り捨てるので，その分だけ早く当たってよい
+		constexpr double kTolerance = (16.0 / Fixed::kOne);
+		const double time = Physics::ToDouble(hit.time);
+		return (hit.is_hit && (hit.normal == sweep_case.normal) && (time <= (*sweep_case.time + 1e-9)) && (time >= (*sweep_case.time - kTolerance)));
+	}
+
+	bool CheckTileSweep(const CheckOptions&)
+	{
+		// 1タイル 16px．外周と (3, 2) が壁
+		const Stage stage{ std::make_unique<GridSegmentSource>(Array<StringView>{
+			U"##########",
+			U"#........#",
+			U"#..#.....#",
+			U"#........#",
+			U"#........#",
+			U"#........#",
+			U"#........#",
+			U"##########",
+		}), Texture{} };
+
+		// 箱は 8px 四方
+		const Vec2 half{ 4.0, 4.0 };
+		const Array<SweepCase> cases =
+		{
+			// 右下へ斜めに動き，x と y が同じ時刻に (3, 2) の壁の角へちょうど着く
+			// その時刻の箱は新しい列にも行にもまだ掛かっておらず，壁は斜め先のタイルだけ
+			{ U"corner tie", Vec2{ 40.0, 24.0 }, half, Vec2{ 12.0, 12.0 }, (4.0 / 12.0), Point{ -1, 0 } },
+
+			// 同じ角へ縦のほうが速く向かうときは床に当たったことにする
+			{ U"corner tie (vertical)", Vec2{ 40.0, 20.0 }, half, Vec2{ 4.0, 8.0 }, 1.0, Point{ 0, -1 } },
+
+			// 壁のない斜め下へ抜ける
+			{ U"open diagonal", Vec2{ 40.0, 24.0 }, half, Vec2{ -8.0, 24.0 }, none },
+
+			// 右の壁（x = 144 の境界）に当たる
+			{ U"wall", Vec2{ 24.0, 88.0 }, half, Vec2{ 200.0, 0.0 }, (116.0 / 200.0), Point{ -1, 0 } },
+
+			// 1回で何タイルも進んでも床（y = 112 の境界）をすり抜けない
+			{ U"floor tunneling", Vec2{ 88.0, 24.0 }, half, Vec2{ 0.0, 1000.0 }, (84.0 / 1000.0), Point{ 0, -1 } },
+
+			// 天井（y = 16 の境界）に当たる
+			{ U"ceiling", Vec2{ 120.0, 88.0 }, half, Vec2{ 0.0, -100.0 }, (68.0 / 100.0), Point{ 0, 1 } },
+		};
+
+		// 1タイル 256px．外周が壁
+		// 境界までの距離を固定小数点の最小の移動量で割ると，時刻が Q12 の範囲（±524288）を超える
+		const Stage wide_stage{ std::make_unique<GridSegmentSource>(Array<StringView>{
+			U"####",
+			U"#..#",
+			U"#..#",
+			U"####",
+		}, 256), Texture{} };
+
+		const Vec2 tiny_step{ (1.0 / Fixed::kOne), 0.0 };
+		const Array<SweepCase> wide_cases =
+		{
+			// 次の境界（x = 512）まで 252px あり，1/4096px 動いても越えない（その先の x = 768 が壁）
+			{ U"tiny step on wide tiles", Vec2{ 256.0, 384.0 }, half, tiny_step, none },
+
+			// 左向きも同じ（x = 256 の境界まで 248px．その先が壁）
+			{ U"tiny step on wide tiles (left)", Vec2{ 508.0, 384.0 }, half, -tiny_step, none },
+
+			// 大きなタイルでも普通の移動量なら右の壁に当たる
+			{ U"wall on wide tiles", Vec2{ 760.0, 384.0 }, half, Vec2{ 8.0, 0.0 }, 0.5, Point{ -1, 0 } },
+		};
+
+		bool is_passed = true;
+		const auto report = [&](const SweepCase& sweep_case, StringView type_name, bool is_hit, double time, const Point& normal)
+			{
+				const String expected = (sweep_case.time ? U"時刻 {:.4f}，法線 {}"_fmt(*sweep_case.time, sweep_case.normal) : String{ U"当たらない" });
+				Console << U"  {}（{}）: 当たり {}，時刻 {:.4f}，法線 {}（期待: {}）"_fmt(sweep_case.name, type_name, is_hit, time, normal, expected);
+				is_passed = false;
+			};
+
+		const auto run_cases = [&](const Stage& case_stage, const Array<SweepCase>& case_list)
+			{
+				for(const auto& sweep_case : case_list)
+				{
+					const TileSweep::Hit hit = TileSweep::SweepBox(case_stage, sweep_case.center, sweep_case.half_size, sweep_case.displacement);
+					if(not IsExpectedHit(sweep_case, hit))
+					{
+						report(sweep_case, U"double", hit.is_hit, hit.time, hit.normal);
+					}
+
+					const TileSweep::FixedHit fixed_hit = TileSweep::SweepBox(case_stage, FixedVec2{ sweep_case.center }, FixedVec2{ sweep_case.half_size }, FixedVec2{ sweep_case.displacement });
+					if(not IsExpectedHit(sweep_case, fixed_hit))
+					{
+						report(sweep_case, U"fixed", fixed_hit.is_hit, fixed_hit.time.ToDouble(), fixed_hit.normal);
+					}
+				}
+			};
+
+		run_cases(stage, cases);
+		run_cases(wide_stage, wide_cases);
+		return is_passed;
+	}
+
+	// base64 の data を持つタイルレイヤー（compression が空なら圧縮しない）
+	JSON MakeBase64Layer(const String& data, StringView compression)
+	{
+		JSON layer;
+		layer[U"data"] = data;
+		layer[U"encoding"] = U"base64";
+		if(not compression.isEmpty())
+		{
+			layer[U"compression"] = compression;
+		}
+		return layer;
+	}
+
+	bool CheckTileCodec(const CheckOptions&)
+	{
+		// 生成したステージの壁を見た目用の壁のタイルにしたレイヤー．ところどころに反転・回転のフラグを立て，読むときに落ちるか確かめる
+		StageGeneratorConfig config;
+		config.width = 37;
+		config.height = 53;
+		config.enemy_count = 0;
+		config.oxygen_count = 0;
+
+		StageGenerator generator{ config };
+		generator.Build();
+		const Grid<bool>& walls = generator.GetWalls();
+
+		const size_t tile_count = walls.num_elements();
+		Array<int32> tiles(tile_count, 0);
+		Array<int32> expected(tile_count, 0);
+		for(size_t i = 0; i < tile_count; ++i)
+		{
+			if(walls.data()[i])
+			{
+				const uint32 flags = ((static_cast<uint32>(i % 8) << 29) & TileLayerCodec::kFlipFlagsMask);
+				tiles[i] = static_cast<int32>(static_cast<uint32>(StageGenerator::kViewWallTileId) | flags);
+				expected[i] = StageGenerator::kViewWallTileId;
+			}
+		}
+
+		bool is_passed = true;
+		Array<int32> decoded;
+		const auto expect_decoded = [&](StringView case_name, const JSON& layer)
+			{
+				String error;
+				if(not TileLayerCodec::Decode(layer, tile_count, decoded, error))
+				{
+					Console << U"  {}: 読めませんでした（{}）"_fmt(case_name, error);
+					is_passed = false;
+				}
+				else if(decoded != expected)
+				{
+					Console << U"  {}: 読んだタイルが書いたタイルと違います"_fmt(case_name);
+					is_passed = false;
+				}
+			};
+
+		// 壊れたデータは落ちずに false を返し，理由を入れなければならない
+		const auto expect_error = [&](StringView case_name, const JSON& layer, size_t count)
+			{
+				String error;
+				if(TileLayerCodec::Decode(layer, count, decoded, error) || error.isEmpty())
+				{
+					Console << U"  {}: 壊れたデータなのにエラーになりません"_fmt(case_name);
+					is_passed = false;
+				}
+			};
+
+		// 数値の配列（Tiled の "CSV"）．フラグの立った GID は uint32 のまま書く
+		String csv_text = U"{\"data\":[";
+		for(size_t i = 0; i < tile_count; ++i)
+		{
+			csv_text += Format(static_cast<uint32>(tiles[i]));
+			csv_text += ((i + 1) < tile_count ? U"," : U"");
+		}
+		csv_text += U"]}";
+		expect_decoded(U"csv", JSON::Parse(csv_text));
+
+		for(const TileLayerCompression compression : { TileLayerCompression::None, TileLayerCompression::Zlib, TileLayerCompression::Zstd })
+		{
+			const StringView compression_name = TileLayerCodec::GetCompressionName(compression);
+			const String name = (compression_name.isEmpty() ? String{ U"base64" } : U"base64 + {}"_fmt(compression_name));
+			const String encoded = TileLayerCodec::EncodeBase64(tiles, compression);
+			expect_decoded(name, MakeBase64Layer(encoded, compression_name));
+
+			// タイルの数が合わない
+			expect_error(U"{}（タイルの数が違う）"_fmt(name), MakeBase64Layer(encoded, compression_name), (tile_count + 1));
+
+			if(compression == TileLayerCompression::None)
+			{
+				continue;
+			}
+
+			// 圧縮したデータの後ろ半分が無い
+			const Blob compressed = Base64::Decode(encoded);
+			const String truncated = Base64::Encode(Blob{ compressed.data(), (compressed.size() / 2) });
+			expect_error(U"{}（途中で切れている）"_fmt(name), MakeBase64Layer(truncated, compression_name), tile_count);
+
+			// 圧縮していないデータに圧縮形式が書いてある
+			expect_error(U"{}（圧縮されていない）"_fmt(name), MakeBase64Layer(TileLayerCodec::EncodeBase64(tiles, TileLayerCompression::None), compression_name), tile_count);
+
+			// base64 ではない文字列
+			expect_error(U"{}（base64 ではない）"_fmt(name), MakeBase64Layer(U"@@ not base64 @@", compression_name), tile_count);
+		}
+
+		// 対応していない圧縮形式とエンコード，文字列の data を配列として読む
+		expect_error(U"gzip", MakeBase64Layer(TileLayerCodec::EncodeBase64(tiles, TileLayerCompression::Zlib), U"gzip"), tile_count);
+
+		JSON unknown_encoding = MakeBase64Layer(TileLayerCodec::EncodeBase64(tiles, TileLayerCompression::None), U"");
+		unknown_encoding[U"encoding"] = U"hex";
+		expect_error(U"encoding hex", unknown_encoding, tile_count);
+
+		expect_error(U"csv（data が文字列）", JSON::Parse(U"{\"data\":\"1,2,3\"}"), tile_count);
+
+		Console << U"  {} x {} のレイヤーを配列と base64（圧縮なし・zlib・zstd）で書いて読み直しました"_fmt(walls.width(), walls.height());
+		return is_passed;
+	}
+
+	// バイト列の FNV-1a ハッシュ
+	uint64 HashBytes(const Array<uint8>& bytes)
+	{
+		uint64 hash = 0xCBF29CE484222325ull;
+		for(const uint8 byte : bytes)
+		{
+			hash = ((hash ^ byte) * 0x100000001B3ull);
+		}
+		return hash;
+	}
+
+	// --stage で選んだステージのワールドを script の入力で ticks ティック進め，最後の状態のハッシュを返す
+	uint64 RunWorldHash(const CheckOptions& options, InputScript script, bool use_job_system)
+	{
+		GameWorldOptions world_options;
+		world_options.use_job_system = use_job_system;
+		world_options.is_audible = false;
+
+		GameWorld world{ Stage{ StageCatalog::CreateSource(StageCatalog::GetSelected()), Texture{} }, world_options };
+		RunStats stats;
+		for(uint64 tick = 0; tick < options.ticks; ++tick)
+		{
+			BatchRunner::TickScripted(world, script, stats);
+		}
+
+		Array<uint8> bytes;
+		SnapshotWriter writer{ bytes };
+		world.SaveState(writer);
+		return HashBytes(bytes);
+	}
+
+	// --self-check-script か --self-check-seed の入力を読む
+	bool LoadScript(const CheckOptions& options, InputScript& script, String& script_name)
+	{
+		if(options.script_path.isEmpty())
+		{
+			script = InputScript::CreateRandom(options.seed);
+			script_name = U"random:{}"_fmt(options.seed);
+			return true;
+		}
+
+		String error;
+		if(not script.Load(options.script_path, error))
+		{
+			Console << U"  入力スクリプトを読めません（{}） → {}"_fmt(error, options.script_path);
+			return false;
+		}
+		script_name = FileSystem::FileName(options.script_path);
+		return true;
+	}
+
+	bool CheckPhysicsHash(const CheckOptions& options)
+	{
+		InputScript script;
+		String script_name;
+		if(not LoadScript(options, script, script_name))
+		{
+			return false;
+		}
+
+		// 敵の更新を並列にしても直列と同じ結果になるか
+		const uint64 serial_hash = RunWorldHash(options, script, false);
+		const uint64 parallel_hash = RunWorldHash(options, script, true);
+
+		Console << U"  {} を {}（{}）で {} ティック進めたハッシュ: {:016X}"_fmt(
+			StageCatalog::GetSelected().name, script_name, kPhysicsName, options.ticks, serial_hash);
+
+		if(parallel_hash != serial_hash)
+		{
+			Console << U"  JobSystem で並列に進めたハッシュが違います: {:016X}"_fmt(parallel_hash);
+			return false;
+		}
+		if(options.expected_hash && (serial_hash != *options.expected_hash))
+		{
+			Console << U"  期待したハッシュ {:016X} と違います"_fmt(*options.expected_hash);
+			return false;
+		}
+		return true;
+	}
+
+	// ワールドを script の入力で ticks ティック進め，ティックごとの状態（GameWorld::SaveState と持っている区間の範囲）のハッシュを返す
+	// frame_rng が無ければターボモードと同じく1フレームに1ティックずつ進め，表示用のカメラも 1/60 秒ずつ進める
+	// frame_rng があれば，時間の倍率やフレーム落ちのように1フレームに 0 ～ 3 ティック進め，表示用のカメラをばらばらの時間だけ進める
+	Array<uint64> RunWorldTickHashes(const CheckOptions& options, InputScript script, SmallRNG* frame_rng)
+	{
+		GameWorldOptions world_options;
+		world_options.use_job_system = false;
+		world_options.is_audible = false;
+
+		GameWorld world{ Stage{ StageCatalog::CreateSource(StageCatalog::GetSelected()), Texture{} }, world_options };
+		RunStats stats;
+		Array<uint8> bytes;
+		Array<uint64> hashes;
+		hashes.reserve(static_cast<size_t>(options.ticks));
+
+		while(hashes.size() < options.ticks)
+		{
+			const uint32 tick_count = (frame_rng ? static_cast<uint32>(Random<uint64>(0, 3, *frame_rng)) : 1);
+			for(uint32 i = 0; (i < tick_count) && (hashes.size() < options.ticks); ++i)
+			{
+				BatchRunner::TickScripted(world, script, stats);
+
+				SnapshotWriter writer{ bytes };
+				world.SaveState(writer);
+				writer.Write(world.GetStage().GetResidentTopY());
+				writer.Write(world.GetStage().GetResidentBottomY());
+				hashes << HashBytes(bytes);
+			}
+
+			const double delta_time = (frame_rng ? Random(1.0 / 240.0, 1.0 / 15.0, *frame_rng) : SimClock::TicksToSeconds(1));
+			world.UpdateCamera(delta_time, tick_count);
+		}
+		return hashes;
+	}
+
+	bool CheckReplay(const CheckOptions& options)
+	{
+		InputScript script;
+		String script_name;
+		if(not LoadScript(options, script, script_name))
+		{
+			return false;
+		}
+
+		// 同じ入力なら，1フレームに進めるティック数やフレームの時間が違っても，どのティックでも同じ状態になるか
+		SmallRNG frame_rng{ options.seed };
+		const Array<uint64> turbo_hashes = RunWorldTickHashes(options, script, nullptr);
+		const Array<uint64> frame_hashes = RunWorldTickHashes(options, script, &frame_rng);
+
+		for(size_t i = 0; i < turbo_hashes.size(); ++i)
+		{
+			if(frame_hashes[i] != turbo_hashes[i])
+			{
+				Console << U"  {} を {} で進めると，{} ティック目の状態がフレームの進め方で変わります"_fmt(StageCatalog::GetSelected().name, script_name, (i + 1));
+				return false;
+			}
+		}
+
+		Console << U"  {} を {} で {} ティック進め，どのティックの状態もフレームの進め方に関係なく同じでした"_fmt(
+			StageCatalog::GetSelected().name, script_name, turbo_hashes.size());
+		return true;
+	}
+
+	// 巻き戻しに積むスナップショットの並び．ワールドを進めた GameWorld::SaveState の間に，
+	// 大きさの変わるフレーム，長い 0 の並び（長さが2～3バイトの可変長になる），でたらめなバイト列，空のフレームを混ぜる
+	Array<Array<uint8>> MakeRewindFrames(const CheckOptions& options)
+	{
+		constexpr uint64 kTickCount = 600;
+
+		GameWorldOptions world_options;
+		world_options.use_job_system = false;
+		world_options.is_audible = false;
+
+		GameWorld world{ Stage{ StageCatalog::CreateSource(StageCatalog::GetSelected()), Texture{} }, world_options };
+		InputScript script = InputScript::CreateRandom(options.seed);
+		RunStats stats;
+		SmallRNG rng{ options.seed };
+
+		Array<Array<uint8>> frames;
+		Array<uint8> bytes;
+		for(uint64 tick = 0; tick < kTickCount; ++tick)
+		{
+			BatchRunner::TickScripted(world, script, stats);
+			SnapshotWriter writer{ bytes };
+			world.SaveState(writer);
+			frames << bytes;
+
+			if(tick == 100)
+			{
+				Array<uint8> grown = bytes;
+				grown.resize((bytes.size() + 24), 0x5A);
+				frames << grown;
+			}
+			else if(tick == 200)
+			{
+				Array<uint8> zeros(20000, 0);
+				for(const size_t changed : { size_t{ 0 }, size_t{ 150 }, size_t{ 19999 } })
+				{
+					zeros[changed] = static_cast<uint8>(changed + 1);
+					frames << zeros;
+				}
+			}
+			else if(tick == 300)
+			{
+				Array<uint8> noise(bytes.size());
+				for(auto& byte : noise)
+				{
+					byte = static_cast<uint8>(Random<uint64>(0, 255, rng));
+				}
+				frames << noise;
+			}
+			else if(tick == 400)
+			{
+				frames << Array<uint8>{};
+			}
+		}
+		return frames;
+	}
+
+	bool CheckRewindBuffer(const CheckOptions& options)
+	{
+		const Array<Array<uint8>> frames = MakeRewindFrames(options);
+
+		size_t total_bytes = 0;
+		for(const auto& frame : frames)
+		{
+			total_bytes += frame.size();
+		}
+
+		struct RewindCase
+		{
+			StringView name;
+			size_t capacity_bytes;
+			size_t max_frames;
+
+			// 1フレームも捨てずに全て持っていられるはずか
+			bool keeps_all;
+		};
+
+		// 全て入る大きさと，領域やフレーム数が足りずに古いものを捨てる大きさ
+		// small storage には長い 0 の並びのフレームが入らないので，それを積んだところで全て捨てる道も通る
+		const Array<RewindCase> cases =
+		{
+			{ U"all frames", (total_bytes * 2), frames.size(), true },
+			{ U"small storage", (frames.front().size() * 16), frames.size(), false },
+			{ U"few frames", (total_bytes * 2), (RewindBuffer::kKeyframeInterval + 30), false },
+		};
+
+		bool is_passed = true;
+		Array<uint8> bytes;
+		for(const auto& rewind_case : cases)
+		{
+			RewindBuffer buffer{ rewind_case.capacity_bytes, rewind_case.max_frames };
+
+			// 積んだフレームの番号（捨てられたものも残る．取り出すものは常にこの末尾と一致する）
+			Array<size_t> pushed;
+			size_t popped_count = 0;
+			bool is_case_passed = true;
+
+			const auto pop_and_compare = [&]()
+				{
+					if(buffer.IsEmpty())
+					{
+						pushed.clear();
+						return false;
+					}
+
+					if((not buffer.Pop(bytes)) || (bytes != frames[pushed.back()]))
+					{
+						Console << U"  {}: {} 番目に積んだフレームが同じバイト列に戻りません"_fmt(rewind_case.name, pushed.back());
+						is_case_passed = false;
+					}
+					pushed.pop_back();
+					++popped_count;
+					return is_case_passed;
+				};
+
+			// 遊んでいるときのように，ときどき何フレームか巻き戻してから記録を続ける
+			SmallRNG rng{ options.seed };
+			for(size_t i = 0; is_case_passed && (i < frames.size()); ++i)
+			{
+				buffer.Push(frames[i]);
+				pushed << i;
+
+				if(Random<uint64>(0, 15, rng) == 0)
+				{
+					for(uint64 k = Random<uint64>(1, 10, rng); (k > 0) && pop_and_compare(); --k)
+					{
+					}
+				}
+			}
+
+			const size_t kept_count = buffer.GetFrameCount();
+			if(is_case_passed && (rewind_case.keeps_all != (kept_count == pushed.size())))
+			{
+				Console << U"  {}: 積んだ {} フレームのうち {} フレームが残っています"_fmt(rewind_case.name, pushed.size(), kept_count);
+				is_case_passed = false;
+			}
+
+			while(is_case_passed && pop_and_compare())
+			{
+			}
+
+			Console << U"  {}: {} フレームを積み，{} フレームを取り出しました（最後に残っていたのは {} フレーム）"_fmt(rewind_case.name, frames.size(), popped_count, kept_count);
+			is_passed = (is_passed && is_case_passed);
+		}
+		return is_passed;
+	}
+
+	struct CheckEntry
+	{
+		StringView name;
+		bool (*function)(const CheckOptions&);
+	};
+
+	constexpr CheckEntry kChecks[] =
+	{
+		{ U"job-stress", CheckJobStress },
+		{ U"tile-sweep", CheckTileSweep },
+		{ U"tile-codec", CheckTileCodec },
+		{ U"physics-hash", CheckPhysicsHash },
+		{ U"replay", CheckReplay },
+		{ U"rewind", CheckRewindBuffer },
+	};
+}
+
+bool SelfCheck::RunFromCommandLine(const Array<String>& args)
+{
+	const auto it = std::find(args.begin(), args.end(), U"--self-check");
+	if(it == args.end())
+	{
+		return false;
+	}
+
+	// 続けて項目の名前が無ければ全ての項目を調べる
+	Array<String> names;
+	if(((it + 1) != args.end()) && (not (it + 1)->starts_with(U"--")))
+	{
+		for(const auto& name : (it + 1)->split(U','))
+		{
+			if(not name.isEmpty())
+			{
+				names << name;
+			}
+		}
+	}
+
+	CheckOptions options;
+	for(size_t i = 0; (i + 1) < args.size(); ++i)
+	{
+		const String& key = args[i];
+		const String& value = args[i + 1];
+
+		if(key == U"--self-check-loops")
+		{
+			options.loops = Max<size_t>(ParseOr<size_t>(value, options.loops), 1);
+		}
+		else if(key == U"--self-check-ticks")
+		{
+			options.ticks = ParseOr<uint64>(value, options.ticks);
+		}
+		else if(key == U"--self-check-seed")
+		{
+			options.seed = ParseOr<uint64>(value, options.seed);
+		}
+		else if(key == U"--self-check-script")
+		{
+			options.script_path = value;
+		}
+		else if(key == U"--self-check-expect-hash")
+		{
+			options.expected_hash = ParseIntOpt<uint64>(value, Arg::radix = 16);
+		}
+	}
+
+	for(const auto& name : names)
+	{
+		if(std::none_of(std::begin(kChecks), std::end(kChecks), [&](const CheckEntry& check) { return (check.name == name); }))
+		{
+			Console << U"SelfCheck: 項目 {} はありません"_fmt(name);
+			Utility::SetExitCode(EXIT_FAILURE);
+			return true;
+		}
+	}
+
+	size_t failed_count = 0;
+	size_t run_count = 0;
+	for(const auto& check : kChecks)
+	{
+		if((not names.isEmpty()) && (not names.contains(String{ check.name })))
+		{
+			continue;
+		}
+
+		Console << U"SelfCheck: {}"_fmt(check.name);
+		const Stopwatch stopwatch{ StartImmediately::Yes };
+		const bool is_passed = check.function(options);
+		Console << U"SelfCheck: {}  {}（{:.1f} ms）"_fmt((is_passed ? U"PASS" : U"FAIL"), check.name, stopwatch.msF());
+
+		++run_count;
+		failed_count += (is_passed ? 0 : 1);
+	}
+
+	Console << U"SelfCheck: {} 項目のうち {} 項目が失敗しました"_fmt(run_count, failed_count);
+	if(failed_count != 0)
+	{
+		Utility::SetExitCode(EXIT_FAILURE);
+	}
+	return true;
+}
@@ -0,0 +1,29 @@
+﻿#pragma once
+
+#include <Siv3D.hpp>
+
+// 遊んでいるだけでは確かめにくい部分（並列に回した結果など）を自動で確かめる
+//
+// --self-check で全ての項目を，--self-check job-stress,... で指定した項目だけを調べ，結果を Console に書き出して終了する
+// 失敗した項目があれば終了コードを EXIT_FAILURE にする
+//
+// job-stress: JobSystem::ParallelFor を大きさと粒度を変えながら何度も回し，OrderedJobBuffers で結合した結果が
+//             直列に回した結果と一致し，どの要素もちょうど1回ずつ処理されたか（--self-check-loops <回数>）
+// tile-sweep: TileSweep::SweepBox が小さな格子で壁・床・角に正しく当たるか（double と固定小数点の両方）
+//             大きなタイルをごく小さな移動量で動かしても，固定小数点の時刻が溢れて当たったことにならないか
+// tile-codec: 生成したステージのタイルレイヤーを TileLayerCodec で配列と base64（圧縮なし・zlib・zstd）に書き，読み直して同じになるか
+//             途中で切れた圧縮データや対応していない形式を，落ちずにエラーとして返すか
+// physics-hash: --stage のワールドを入力スクリプトで進めた最後の状態のハッシュを出し，JobSystem で並列にしても同じか
+//               （--self-check-ticks <ティック数>，--self-check-script <パス> か --self-check-seed <シード>）
+//               FixedPhysics 構成（BNS_FIXED_POINT_PHYSICS）ではコンパイラや最適化の設定，マシンが違っても同じハッシュになるはずなので，
+//               別の環境で出したハッシュを --self-check-expect-hash <16進数> に渡して比べる
+// replay: 同じ入力で，ターボモードのように1フレームに1ティックずつ進めたときと，人が遊ぶときのように
+//         1フレームのティック数や時間がばらばらなときとで，ティックごとの状態が一致するか（ticks / script / seed は physics-hash と同じ）
+// rewind: ワールドのスナップショットに大きさの変わるものや長い 0 の並びを混ぜて RewindBuffer に積み，ときどき巻き戻しながら
+//         取り出したものが積んだものとバイト単位で同じか（領域やフレーム数が足りずに古いものを捨てる大きさでも）
+class SelfCheck
+{
+public:
+	// 引数に --self-check が無ければ何もせず false を返す
+	static bool RunFromCommandLine(const Array<String>& args);
+};
@@ -0,0 +1,335 @@
+﻿#include "StageGenerator.h"
+
+#include <Siv3D.hpp>
+
+StageGenerator::StageGenerator(const StageGeneratorConfig& config)
+	: config_(config)
+	, rng_(config.seed)
+{
+	config_.width = Max(config_.width, 3);
+	config_.height = Max(config_.height, config_.clear_top_rows + 2);
+	config_.wall_density = Clamp(config_.wall_density, 0.0, 0.9);
+
+	enemy_mix_ = config_.enemy_mix;
+	if(enemy_mix_.isEmpty())
+	{
+		for(const auto& type : GetEnemyTypes())
+		{
+			enemy_mix_.emplace_back(type, 1.0);
+		}
+	}
+	for(const auto& mix : enemy_mix_)
+	{
+		total_weight_ += Max(mix.second, 0.0);
+	}
+}
+
+const Array<String>& StageGenerator::GetEnemyTypes()
+{
+	static const Array<String> types = {
+		U"Fish", U"Shark", U"DeepseaFish", U"Swimmie",
+		U"MorayEel_L", U"MorayEel_R", U"Octoleg_L", U"Octoleg_R",
+		U"Coral_L", U"Coral_R", U"Clione",
+	};
+	return types;
+}
+
+bool StageGenerator::Generate(const FilePath& output_path)
+{
+	const Stopwatch stopwatch{ StartImmediately::Yes };
+
+	Build();
+
+	if(not WriteJson(output_path))
+	{
+		Console << U"StageGenerator: 書き込みに失敗しました → {}"_fmt(output_path);
+		return false;
+	}
+
+	Console << U"StageGenerator: {}x{} タイル，スポーン {} 個 → {}（{:.1f} 秒）"_fmt(
+		config_.width, config_.height, spawns_.size(), output_path, stopwatch.sF());
+	return true;
+}
+
+void StageGenerator::Build()
+{
+	GenerateWalls();
+	GenerateSpawns();
+}
+
+void StageGenerator::GenerateWalls()
+{
+	walls_ = Grid<bool>(config_.width, config_.height, false);
+
+	for(int32 y = 0; y < config_.height; ++y)
+	{
+		// 左右の端は常に壁
+		walls_[y][0] = true;
+		walls_[y][config_.width - 1] = true;
+
+		if(y < config_.clear_top_rows)
+		{
+			continue;
+		}
+
+		for(int32 x = 1; x < (config_.width - 1); ++x)
+		{
+			walls_[y][x] = (RandomClosedOpen(0.0, 1.0, rng_) < config_.wall_density);
+		}
+	}
+
+	// 一番下は床にする
+	if(config_.close_bottom)
+	{
+		for(int32 x = 0; x < config_.width; ++x)
+		{
+			walls_[config_.height - 1][x] = true;
+		}
+	}
+}
+
+Optional<Vec2> StageGenerator::PickFreeTileCenter(int32 min_row)
+{
+	// 壁の割合は上限 0.9 なので，数十回試せばほぼ必ず見つかる
+	constexpr int32 kMaxAttempts = 64;
+
+	// 床がある場合は一番下の行を除く
+	const int32 max_row = (config_.height - (config_.close_bottom ? 2 : 1));
+
+	for(int32 attempt = 0; attempt < kMaxAttempts; ++attempt)
+	{
+		const int32 x = Random(1, config_.width - 2, rng_);
+		const int32 y = Random(min_row, max_row, rng_);
+		if(not walls_[y][x])
+		{
+			return Vec2{ (x + 0.5) * config_.tile_size, (y + 0.5) * config_.tile_size };
+		}
+	}
+	return none;
+}
+
+const String& StageGenerator::PickEnemyType()
+{
+	double value = RandomClosedOpen(0.0, total_weight_, rng_);
+	for(const auto& mix : enemy_mix_)
+	{
+		value -= Max(mix.second, 0.0);
+		if(value < 0.0)
+		{
+			return mix.first;
+		}
+	}
+	return enemy_mix_.back().first;
+}
+
+void StageGenerator::GenerateSpawns()
+{
+	spawns_.clear();
+	spawns_.reserve(1 + config_.enemy_count + config_.oxygen_count);
+
+	// プレイヤーは上端中央（壁なしの行）
+	if(config_.place_player)
+	{
+		spawns_.push_back(SpawnInfo{ U"Player", Vec2{ (config_.width * config_.tile_size) / 2.0, (config_.clear_top_rows / 2.0) * config_.tile_size }, Vec2::Zero() });
+	}
+
+	if(total_weight_ > 0.0)
+	{
+		for(int32 i = 0; i < config_.enemy_count; ++i)
+		{
+			if(const auto pos = PickFreeTileCenter(config_.clear_top_rows))
+			{
+				spawns_.push_back(SpawnInfo{ PickEnemyType(), *pos, Vec2::Zero() });
+			}
+		}
+	}
+
+	for(int32 i = 0; i < config_.oxygen_count; ++i)
+	{
+		if(const auto pos = PickFreeTileCenter(config_.clear_top_rows))
+		{
+			spawns_.push_back(SpawnInfo{ U"Oxygen", *pos, Vec2::Zero() });
+		}
+	}
+}
+
+bool StageGenerator::WriteJson(const FilePath& output_path) const
+{
+	TextWriter writer{ output_path };
+	if(not writer)
+	{
+		return false;
+	}
+
+	// Tiled 1.11 が書き出す形式に合わせる（Stage が読むのは width / height / tilewidth / layers だけ）
+	writer.writeln(U"{ \"compressionlevel\":-1,");
+	writer.writeln(U" \"height\":{},"_fmt(config_.height));
+	writer.writeln(U" \"infinite\":false,");
+	writer.writeln(U" \"layers\":[");
+
+	// タイルレイヤーは1行ずつ文字列にして書き出す
+	auto WriteTileLayer = [&](int32 id, StringView name, int32 wall_tile_id, bool is_visible)
+		{
+			writer.writeln(U"  {");
+
+			// 圧縮するときは Tiled と同じく，GID の並びを圧縮して base64 にする
+			if(config_.tile_compression != TileLayerCompression::None)
+			{
+				Array<int32> tiles(static_cast<size_t>(config_.width) * config_.height, 0);
+				for(int32 y = 0; y < config_.height; ++y)
+				{
+					for(int32 x = 0; x < config_.width; ++x)
+					{
+						if(walls_[y][x])
+						{
+							tiles[(static_cast<size_t>(y) * config_.width) + x] = wall_tile_id;
+						}
+					}
+				}
+
+				writer.writeln(U"   \"compression\":\"{}\","_fmt(TileLayerCodec::GetCompressionName(config_.tile_compression)));
+				writer.write(U"   \"data\":\"");
+				writer.write(TileLayerCodec::EncodeBase64(tiles, config_.tile_compression));
+				writer.writeln(U"\",");
+				writer.writeln(U"   \"encoding\":\"base64\",");
+			}
+			else
+			{
+				writer.write(U"   \"data\":[");
+
+				const String wall_text = Format(wall_tile_id);
+				const String empty_text = U"0";
+				String line;
+				for(int32 y = 0; y < config_.height; ++y)
+				{
+					line.clear();
+					for(int32 x = 0; x < config_.width; ++x)
+					{
+						if((x > 0) || (y > 0))
+						{
+							line.push_back(U',');
+						}
+						line.append(walls_[y][x] ? wall_text : empty_text);
+					}
+					writer.write(line);
+				}
+
+				writer.writeln(U"],");
+			}
+			writer.writeln(U"   \"height\":{}, \"id\":{}, \"name\":\"{}\", \"opacity\":1, \"type\":\"tilelayer\", \"visible\":{}, \"width\":{}, \"x\":0, \"y\":0"_fmt(
+				config_.height, id, name, (is_visible ? U"true" : U"false"), config_.width));
+			writer.writeln(U"  },");
+		};
+
+	WriteTileLayer(1, U"view_layer", kViewWallTileId, true);
+	WriteTileLayer(2, U"collision_layer", kCollisionWallTileId, false);
+
+	writer.writeln(U"  {");
+	writer.writeln(U"   \"draworder\":\"topdown\", \"id\":3, \"name\":\"spawn_layer\",");
+	writer.writeln(U"   \"objects\":[");
+	for(size_t i = 0; i < spawns_.size(); ++i)
+	{
+		const SpawnInfo& spawn = spawns_[i];
+		const bool is_last = ((i + 1) == spawns_.size());
+		writer.writeln(U"    {{ \"height\":0, \"id\":{}, \"name\":\"\", \"point\":true, \"rotation\":0, \"type\":\"{}\", \"visible\":true, \"width\":0, \"x\":{}, \"y\":{} }}{}"_fmt(
+			(i + 1), spawn.type, spawn.pos.x, spawn.pos.y, (is_last ? U"" : U",")));
+	}
+	writer.writeln(U"   ],");
+	writer.writeln(U"   \"opacity\":1, \"type\":\"objectgroup\", \"visible\":true, \"x\":0, \"y\":0");
+	writer.writeln(U"  }],");
+
+	writer.writeln(U" \"nextlayerid\":4,");
+	writer.writeln(U" \"nextobjectid\":{},"_fmt(spawns_.size() + 1));
+	writer.writeln(U" \"orientation\":\"orthogonal\",");
+	writer.writeln(U" \"renderorder\":\"right-down\",");
+	writer.writeln(U" \"tiledversion\":\"1.11.2\",");
+	writer.writeln(U" \"tileheight\":{},"_fmt(config_.tile_size));
+	writer.writeln(U" \"tilesets\":[{ \"firstgid\":1, \"source\":\"tileset.tsx\" }],");
+	writer.writeln(U" \"tilewidth\":{},"_fmt(config_.tile_size));
+	writer.writeln(U" \"type\":\"map\",");
+	writer.writeln(U" \"version\":\"1.10\",");
+	writer.writeln(U" \"width\":{}"_fmt(config_.width));
+	writer.writeln(U"}");
+
+	return true;
+}
+
+bool StageGenerator::RunFromCommandLine(const Array<String>& args)
+{
+	const auto it = std::find(args.begin(), args.end(), U"--gen-stage");
+	if(it == args.end())
+	{
+		return false;
+	}
+
+	if((it + 1) == args.end())
+	{
+		Console << U"StageGenerator: --gen-stage の後に出力先を指定してください";
+		return true;
+	}
+
+	const FilePath output_path = *(it + 1);
+	StageGeneratorConfig config;
+
+	for(size_t i = 0; (i + 1) < args.size(); ++i)
+	{
+		const String& key = args[i];
+		const String& value = args[i + 1];
+
+		if(key == U"--width")
+		{
+			config.width = ParseOr<int32>(value, config.width);
+		}
+		else if(key == U"--height")
+		{
+			config.height = ParseOr<int32>(value, config.height);
+		}
+		else if(key == U"--density")
+		{
+			config.wall_density = ParseOr<double>(value, config.wall_density);
+		}
+		else if(key == U"--enemies")
+		{
+			config.enemy_count = ParseOr<int32>(value, config.enemy_count);
+		}
+		else if(key == U"--oxygen")
+		{
+			config.oxygen_count = ParseOr<int32>(value, config.oxygen_count);
+		}
+		else if(key == U"--seed")
+		{
+			config.seed = ParseOr<uint64>(value, config.seed);
+		}
+		else if(key == U"--compression")
+		{
+			if(value == U"zlib")
+			{
+				config.tile_compression = TileLayerCompression::Zlib;
+			}
+			else if(value == U"zstd")
+			{
+				config.tile_compression = TileLayerCompression::Zstd;
+			}
+			else
+			{
+				Console << U"StageGenerator: 圧縮形式 '{}' には対応していません（zlib / zstd）"_fmt(value);
+			}
+		}
+		else if(key == U"--mix")
+		{
+			// 例: Fish=1,Shark=0.5,Clione=2
+			for(const auto& entry : value.split(U','))
+			{
+				const auto pair = entry.split(U'=');
+				if(pair.size() == 2)
+				{
+					config.enemy_mix.emplace_back(pair[0], ParseOr<double>(pair[1], 0.0));
+				}
+			}
+		}
+	}
+
+	StageGenerator generator{ config };
+	generator.Generate(output_path);
+	return true;
+}
@@ -0,0 +1,89 @@
+﻿#pragma once
+
+#include "../World/SpawnInfo.h"
+#include "../World/TileLayerCodec.h"
+
+#include <Siv3D.hpp>
+
+// 負荷テスト用のステージ生成設定
+struct StageGeneratorConfig
+{
+	int32 width = 200;			// マップの幅（タイル数）
+	int32 height = 20000;		// マップの高さ（タイル数）
+	int32 tile_size = 64;
+
+	double wall_density = 0.15;	// 内側のタイルが壁になる割合（0.0 ～ 0.9）
+	int32 enemy_count = 50000;
+	int32 oxygen_count = 500;
+
+	// 敵の種類と出現の重み（空なら Enemy が扱える全種類を同じ重みで使う）
+	Array<std::pair<String, double>> enemy_mix;
+
+	uint64 seed = 12345;
+
+	// 上端から何行を壁なしにするか（プレイヤーの開始位置）
+	int32 clear_top_rows = 8;
+
+	// 一番下の行を床にするか（区間ごとに作って縦につなげるときは false）
+	bool close_bottom = true;
+
+	// プレイヤーの開始位置を置くか
+	bool place_player = true;
+
+	// 書き出すタイルレイヤーの形式（None なら数値の配列，それ以外は base64 にして圧縮する）
+	TileLayerCompression tile_compression = TileLayerCompression::None;
+};
+
+// Stage が読める形式（Tiled の JSON．view_layer / collision_layer / spawn_layer）で負荷テスト用のステージを書き出す
+// 数百万タイルになるので JSON オブジェクトは組み立てず，テキストとして直接書き出す
+class StageGenerator
+{
+public:
+	explicit StageGenerator(const StageGeneratorConfig& config);
+
+	// 生成して output_path に書き出す．失敗したら false
+	bool Generate(const FilePath& output_path);
+
+	// 書き出さずに壁とスポーン位置だけを作る（結果は GetWalls / GetSpawns で受け取る）
+	void Build();
+
+	// 壁かどうか（true = 壁）
+	const Grid<bool>& GetWalls() const { return walls_; }
+
+	// スポーン位置（Tiled の点オブジェクトと同じく size は 0，pos はタイルの中心）
+	const Array<SpawnInfo>& GetSpawns() const { return spawns_; }
+
+	// コマンドライン引数から設定を読み取って生成する
+	// --gen-stage <出力先> [--width N] [--height N] [--density D] [--enemies N] [--oxygen N] [--seed N] [--mix Fish=1,Shark=0.5,...] [--compression zlib|zstd]
+	// 引数に --gen-stage が無ければ何もせず false を返す
+	// 書き出したステージは --stage-file <出力先> で遊べる（StageCatalog::SelectFromCommandLine）
+	static bool RunFromCommandLine(const Array<String>& args);
+
+	// Enemy が扱える敵の種類
+	static const Array<String>& GetEnemyTypes();
+
+	// v3 のタイルセットで使っている壁のタイル（見た目用と当たり判定用）
+	static constexpr int32 kViewWallTileId = 13;
+	static constexpr int32 kCollisionWallTileId = 73;
+
+private:
+	void GenerateWalls();
+	void GenerateSpawns();
+
+	// 壁でないタイルをランダムに選び，その中心座標を返す
+	Optional<Vec2> PickFreeTileCenter(int32 min_row);
+
+	// 重みに従って敵の種類を選ぶ
+	const String& PickEnemyType();
+
+	bool WriteJson(const FilePath& output_path) const;
+
+	StageGeneratorConfig config_;
+	SmallRNG rng_;
+
+	Grid<bool> walls_;
+	Array<SpawnInfo> spawns_;
+
+	Array<std::pair<String, double>> enemy_mix_;
+	double total_weight_ = 0.0;
+};
@@ -0,0 +1,148 @@
+﻿#include "../World/StageCatalog.h"
+#include "TurboRunner.h"
+
+#include <Siv3D.hpp>
+
+TurboRunner& TurboRunner::GetInstance()
+{
+	static TurboRunner instance;
+	return instance;
+}
+
+bool TurboRunner::ConfigureFromCommandLine(const Array<String>& args)
+{
+	double minutes = kDefaultMinutes;
+
+	for(size_t i = 0; (i + 1) < args.size(); ++i)
+	{
+		const String& key = args[i];
+		const String& value = args[i + 1];
+
+		if(key == U"--turbo")
+		{
+			script_path_ = value;
+		}
+		else if(key == U"--turbo-minutes")
+		{
+			minutes = Max(ParseOr<double>(value, minutes), 0.0);
+		}
+		else if(key == U"--turbo-report")
+		{
+			report_path_ = value;
+		}
+		else if(key == U"--record-input")
+		{
+			record_path_ = value;
+		}
+	}
+
+	if(script_path_.isEmpty())
+	{
+		return true;
+	}
+
+	String error;
+	if(not script_.Load(script_path_, error))
+	{
+		Console << U"TurboRunner: 入力スクリプトを読めません（{}） → {}"_fmt(error, script_path_);
+		return false;
+	}
+
+	is_enabled_ = true;
+	uses_rewind_ = script_.UsesRewind();
+	max_ticks_ = SimClock::SecondsToTicks(minutes * 60.0);
+	stats_.EnableSamples(max_ticks_);
+
+	Console << U"TurboRunner: {} の入力で最大 {} 分（{} ティック）を進めます"_fmt(script_path_, minutes, max_ticks_);
+	return true;
+}
+
+GameInput TurboRunner::NextInput()
+{
+	GameInput input = script_.Next();
+
+	// スクリプトが押さなくても，死んだら少し待ってリスポーンする
+	if(stats_.IsRespawnDue())
+	{
+		input.ok = true;
+	}
+	return input;
+}
+
+void TurboRunner::RecordInput(const GameInput& input)
+{
+	if(not record_path_.isEmpty())
+	{
+		recorded_script_.Append(input);
+	}
+}
+
+void TurboRunner::RecordTick(const GameWorld& world, const GameWorldEvents& events)
+{
+	if(stats_.GetTickCount() == 0)
+	{
+		stopwatch_.restart();
+	}
+
+	stats_.Record(world, events);
+
+	// エンディングの演出は入力に関係なく進むだけなので，着いたところで終える
+	if(events.is_ending_reached || (stats_.GetTickCount() >= max_ticks_))
+	{
+		is_finished_ = true;
+	}
+}
+
+void TurboRunner::Shutdown()
+{
+	if(is_enabled_)
+	{
+		stopwatch_.pause();
+		PrintSummary();
+		WriteReport();
+	}
+
+	if((not record_path_.isEmpty()) && (not recorded_script_.IsEmpty()))
+	{
+		if(recorded_script_.Save(record_path_))
+		{
+			Console << U"TurboRunner: 入力を書き出しました → {}"_fmt(record_path_);
+		}
+		else
+		{
+			Console << U"TurboRunner: 入力を書き出せませんでした → {}"_fmt(record_path_);
+		}
+	}
+}
+
+void TurboRunner::PrintSummary() const
+{
+	const uint64 tick_count = stats_.GetTickCount();
+	const double wall_sec = stopwatch_.sF();
+	const double ticks_per_sec = ((wall_sec > 0.0) ? (tick_count / wall_sec) : 0.0);
+
+	Console << U"TurboRunner: {} を {} ティック（{:.1f} 秒）進めました（実時間 {:.2f} 秒，{:.0f} ティック/秒）"_fmt(
+		StageCatalog::GetSelected().name, tick_count, SimClock::TicksToSeconds(tick_count), wall_sec, ticks_per_sec);
+	Console << U"  深さ: 最大 {:.0f} px（{:.1f}%），最後 {:.0f} px"_fmt(stats_.GetMaxDepth(), (stats_.GetMaxDepthRatio() * 100.0), stats_.GetLastDepth());
+	Console << U"  死んだ回数: {}"_fmt(stats_.GetDeathCount());
+
+	if(const Optional<uint64>& ending_tick = stats_.GetEndingTick())
+	{
+		Console << U"  エンディングまで: {:.1f} 秒"_fmt(SimClock::TicksToSeconds(*ending_tick));
+	}
+	else
+	{
+		Console << U"  エンディングまで: 着いていません";
+	}
+
+	Console << U"  酸素: 最小 {:.1f}，平均 {:.1f}，最後 {:.1f}（1秒ごとの推移 → {}）"_fmt(
+		stats_.GetMinOxygen(), stats_.GetAverageOxygen(), stats_.GetLastOxygen(), report_path_);
+}
+
+void TurboRunner::WriteReport() const
+{
+	if(not stats_.WriteSamples(report_path_))
+	{
+		Console << U"TurboRunner: 書き出せませんでした → {}"_fmt(report_path_);
+	}
+}
@@ -0,0 +1,78 @@
+﻿#pragma once
+
+#include "../Core/GameInput.h"
+#include "../Core/SimClock.h"
+#include "../World/GameWorld.h"
+#include "InputScript.h"
+#include "RunStats.h"
+
+#include <Siv3D.hpp>
+
+// 描画・フレームの待ち合わせ・音を省いて，ゲームの更新をできるだけ速く回す（バランス調整用）
+//
+// --turbo <入力スクリプト> でターボモードにする．タイトルを飛ばし，スクリプトの入力で GameScene の状態遷移
+// （Playing → GameOver / Ending）をそのまま進める．死んだら RunStats::kAutoRespawnTicks 後に決定を押してリスポーンする
+// エンディングに着くか，--turbo-minutes <分>（シミュレーションの時間）が過ぎたら終わる
+// 1秒あたりの更新回数と要約（到達した深さ，死んだ回数，エンディングまでの時間，酸素）を Console に，
+// 深さと酸素の1秒ごとの推移を --turbo-report <出力先>（CSV）に書き出す
+//
+// --record-input <出力先> を付けて普通に遊ぶと，タイトルを過ぎてからの入力をスクリプトの形で書き出す
+class TurboRunner
+{
+public:
+	static TurboRunner& GetInstance();
+
+	// --turbo / --turbo-minutes / --turbo-report / --record-input を読む
+	// スクリプトが読めなかったら false を返す（起動をやめる）
+	bool ConfigureFromCommandLine(const Array<String>& args);
+
+	bool IsEnabled() const { return is_enabled_; }
+	bool IsFinished() const { return is_finished_; }
+
+	// スクリプトが巻き戻すか（巻き戻さないなら，GameScene は巻き戻しの記録を積まなくてよい）
+	bool UsesRewind() const { return uses_rewind_; }
+
+	// 次のティックの入力
+	GameInput NextInput();
+
+	// 普通に遊んでいる間の1ティック分の入力を記録する（--record-input が無ければ何もしない）
+	void RecordInput(const GameInput& input);
+
+	// GameScene がタイトルを過ぎてから1ティックごとに呼ぶ（エンディングに着くか時間が過ぎたら終わる）
+	void RecordTick(const GameWorld& world, const GameWorldEvents& events);
+
+	// 要約と記録した入力を書き出す（終了する前に呼ぶ）
+	void Shutdown();
+
+	// ウィンドウのメッセージを処理する（System::Update() を呼ぶ）までにまとめて進めるフレーム数
+	static constexpr uint32 kFramesPerSystemUpdate = 1000;
+
+	TurboRunner(const TurboRunner&) = delete;
+	TurboRunner& operator=(const TurboRunner&) = delete;
+
+private:
+	TurboRunner() = default;
+
+	void PrintSummary() const;
+	void WriteReport() const;
+
+	static constexpr double kDefaultMinutes = 10.0;
+	static constexpr StringView kDefaultReportPath = U"profile/turbo_report.csv";
+
+	bool is_enabled_ = false;
+	bool is_finished_ = false;
+
+	InputScript script_;
+	FilePath script_path_;
+	bool uses_rewind_ = false;
+	FilePath report_path_{ kDefaultReportPath };
+	uint64 max_ticks_ = 0;
+
+	// タイトルを過ぎてからの記録と，かかった実時間
+	RunStats stats_;
+	Stopwatch stopwatch_;
+
+	// --record-input
+	FilePath record_path_;
+	InputScript recorded_script_;
+};
@@ -0,0 +1,704 @@
+﻿#include "../Core/AllocationTracker.h"
+#include "../Core/Config.h"
+#include "../Core/TraceRecorder.h"
+#include "GameWorld.h"
+#include "SpawnInfo.h"
+
+#include <Siv3D.hpp>
+#include <variant>
+
+GameWorld::GameWorld(Stage&& stage, const GameWorldOptions& options)
+	: options_(options)
+	, stage_(std::move(stage))
+	, camera_manager_(
+		(stage_.GetWidth()* stage_.GetTileSize()) / 2.0,
+		kSceneSize
+	)
+	, stream_camera_(camera_manager_)
+	, player_(options.is_audible)
+	, map_total_height_(stage_.GetHeight()* stage_.GetTileSize())
+{
+	SpawnEntities();
+
+	camera_manager_.SetTargetY(player_.GetPos().y);
+	camera_manager_.SetYOffsetRatio(kTitleEndingCameraOffsetYRatio);
+	stream_camera_ = camera_manager_;
+	StreamStageSegments();
+}
+
+void GameWorld::SpawnEntities()
+{
+	// 最初に持っている区間（先頭の区間）からプレイヤーの開始位置も取る
+	for(const auto& segment : stage_.GetResidentSegments())
+	{
+		SpawnSegmentEntities(segment, true);
+	}
+
+	// 開始位置が置かれていないマップ（v1）では上端の中央から始める
+	if(player_start_pos_ == Vec2::Zero())
+	{
+		player_start_pos_ = Vec2{ (stage_.GetWidth() * stage_.GetTileSize()) / 2.0, (stage_.GetTileSize() / 2.0) };
+		player_.SetPos(player_start_pos_);
+	}
+
+	RebuildEntityIndices();
+}
+
+void GameWorld::SpawnSegmentEntities(const StageSegment& segment, bool place_player)
+{
+	for(const auto& info : segment.spawns)
+	{
+		SpawnEntity(info, place_player);
+	}
+}
+
+void GameWorld::SpawnEntity(const SpawnInfo& info, bool place_player)
+{
+	if(info.type.isEmpty())
+	{
+		AddWarning(U"Warning: Tiled object_spawn に 'Type' が設定されていないオブジェクトがあります．");
+		return;
+	}
+
+	const Vec2 center_pos = info.pos + (info.size / 2.0);
+
+	if(info.type == U"Player")
+	{
+		// 先頭の区間を読み直したときにプレイヤーを戻さないように，最初の1回だけ使う
+		if(place_player)
+		{
+			player_.SetPos(center_pos);
+			player_start_pos_ = center_pos;
+		}
+	}
+	else if(info.type == U"Oxygen")
+	{
+		oxygen_spots_.emplace_back(center_pos, info.size);
+	}
+	else
+	{
+		enemies_.emplace_back(info.type, center_pos);
+		enemies_.back().PlanMotion(stage_, entity_time_);
+
+		if(not enemies_.back().IsKnownType())
+		{
+			AddWarning(U"エラー: 未知の敵タイプ '{}' です．"_fmt(info.type));
+		}
+	}
+}
+
+void GameWorld::AddWarning(String&& warning)
+{
+	if(not warnings_.contains(warning))
+	{
+		warnings_ << std::move(warning);
+	}
+}
+
+void GameWorld::StreamStageSegments()
+{
+	const AllocationScope allocation_scope{ U"GameWorld::StreamStageSegments" };
+	const TraceScope trace_scope{ U"GameWorld::StreamStageSegments" };
+	const RectF keep_rect = stream_camera_.GetPredictedViewRect(kStageStreamLookAheadFrames, SimClock::TicksToSeconds(1));
+	const StageResidencyChange& change = stage_.UpdateResidency(keep_rect);
+	if(change.IsEmpty())
+	{
+		return;
+	}
+
+	// 捨てた区間にいた敵・酸素スポットを取り除く（読み直したときは配置し直しになる）
+	const double resident_top = stage_.GetResidentTopY();
+	const double resident_bottom = stage_.GetResidentBottomY();
+	auto IsOutside = [&](double y) { return ((y < resident_top) || (resident_bottom <= y)); };
+
+	for(const auto& spot : oxygen_spots_)
+	{
+		const Vec2 spot_pos = spot.GetPos();
+		if((spot_pos.y < resident_top) && ((not passed_spot_pos_) || (passed_spot_pos_->y < spot_pos.y)))
+		{
+			passed_spot_pos_ = spot_pos;
+		}
+	}
+
+	oxygen_spots_.remove_if([&](const OxygenSpot& spot) { return IsOutside(spot.GetPos().y); });
+	enemies_.remove_if([&](const Enemy& enemy) { return IsOutside(enemy.GetSpawnPos().y); });
+
+	for(const int32 segment_index : change.loaded)
+	{
+		for(const auto& segment : stage_.GetResidentSegments())
+		{
+			if(segment.index == segment_index)
+			{
+				SpawnSegmentEntities(segment, false);
+				break;
+			}
+		}
+	}
+
+	RebuildEntityIndices();
+}
+
+void GameWorld::RebuildEntityIndices()
+{
+	// 敵・酸素スポットは縦に動かないので，今の描画範囲で索引を作っておく
+	enemy_index_.Clear();
+	for(size_t i = 0; i < enemies_.size(); ++i)
+	{
+		const RectF bounds = enemies_[i].GetDrawBounds(entity_time_);
+		enemy_index_.Insert(static_cast<uint32>(i), bounds.topY(), bounds.bottomY());
+	}
+
+	// 敵の番号が変わるので，向きを変える予定も積み直す
+	turnaround_events_ = {};
+	for(size_t i = 0; i < enemies_.size(); ++i)
+	{
+		const double turn_time = enemies_[i].GetNextTurnTime();
+		if(turn_time < Math::Inf)
+		{
+			turnaround_events_.push(TurnaroundEvent{ turn_time, static_cast<uint32>(i) });
+		}
+	}
+
+	oxygen_spot_index_.Clear();
+	for(size_t i = 0; i < oxygen_spots_.size(); ++i)
+	{
+		const RectF bounds = oxygen_spots_[i].GetDrawBounds();
+		oxygen_spot_index_.Insert(static_cast<uint32>(i), bounds.topY(), bounds.bottomY());
+	}
+}
+
+void GameWorld::ReplanEnemies()
+{
+	for(auto& enemy : enemies_)
+	{
+		enemy.PlanMotion(stage_, entity_time_);
+	}
+	RebuildEntityIndices();
+}
+
+void GameWorld::ResetStage(Stage&& stage, bool keep_player_pos)
+{
+	const Vec2 player_pos = player_.GetPos();
+
+	stage_ = std::move(stage);
+	map_total_height_ = (stage_.GetHeight() * stage_.GetTileSize());
+
+	enemies_.clear();
+	oxygen_spots_.clear();
+	passed_spot_pos_.reset();
+	player_start_pos_ = Vec2::Zero();
+
+	if(not keep_player_pos)
+	{
+		camera_manager_ = CameraManager{ (stage_.GetWidth() * stage_.GetTileSize()) / 2.0, kSceneSize };
+		camera_manager_.SetYOffsetRatio(kTitleEndingCameraOffsetYRatio);
+		stream_camera_ = camera_manager_;
+	}
+
+	SpawnEntities();
+	if(keep_player_pos)
+	{
+		player_.SetPos(player_pos);
+	}
+
+	camera_manager_.SetTargetY(player_.GetPos().y);
+	stream_camera_.SetTargetY(player_.GetPos().y);
+	StreamStageSegments();
+}
+
+void GameWorld::ApplySpawnDiff(const StageReloadDiff& diff)
+{
+	if(diff.removed_spawns.isEmpty() && diff.added_spawns.isEmpty())
+	{
+		return;
+	}
+
+	// 消えたスポーンの位置に配置されていたものを1つずつ取り除く
+	for(const auto& info : diff.removed_spawns)
+	{
+		const Vec2 center_pos = info.pos + (info.size / 2.0);
+
+		if(info.type == U"Oxygen")
+		{
+			const auto it = std::find_if(oxygen_spots_.begin(), oxygen_spots_.end(), [&](const OxygenSpot& spot) { return (spot.GetPos() == center_pos); });
+			if(it != oxygen_spots_.end())
+			{
+				oxygen_spots_.erase(it);
+			}
+		}
+		else if(info.type != U"Player")
+		{
+			const auto it = std::find_if(enemies_.begin(), enemies_.end(), [&](const Enemy& enemy) { return (enemy.GetSpawnPos() == center_pos); });
+			if(it != enemies_.end())
+			{
+				enemies_.erase(it);
+			}
+		}
+	}
+
+	// 増えたスポーンを配置する．開始位置が動いたときもプレイヤーは今の位置のまま
+	for(const auto& info : diff.added_spawns)
+	{
+		if(info.type == U"Player")
+		{
+			player_start_pos_ = info.pos + (info.size / 2.0);
+			continue;
+		}
+		SpawnEntity(info, false);
+	}
+
+	RebuildEntityIndices();
+}
+
+void GameWorld::ParallelFor(size_t count, size_t grain, const JobSystem::ChunkFunction& function) const
+{
+	if(options_.use_job_system)
+	{
+		JobSystem::GetInstance().ParallelFor(count, grain, function);
+		return;
+	}
+
+	// チャンクの分け方と番号は JobSystem と同じにする（OrderedJobBuffers をそのまま使える）
+	const size_t chunk_size = Max<size_t>(grain, 1);
+	const size_t chunk_count = JobSystem::GetChunkCount(count, chunk_size);
+	for(size_t i = 0; i < chunk_count; ++i)
+	{
+		function((i * chunk_size), Min(count, (i + 1) * chunk_size), i);
+	}
+}
+
+void GameWorld::UpdateEntities()
+{
+	const AllocationScope allocation_scope{ U"GameWorld::UpdateEntities" };
+	const TraceScope trace_scope{ U"GameWorld::UpdateEntities" };
+
+	// 並列に更新するのは酸素スポットだけ（敵は下の予定表で向きを変えるものだけを順に処理する）
+	// 各スポットは const な Stage と自分の状態しか読み書きしないので，チャンクに分けて並列に更新できる
+	ParallelFor(oxygen_spots_.size(), kEntityUpdateGrain, [&](size_t begin, size_t end, size_t)
+		{
+			for(size_t i = begin; i < end; ++i)
+			{
+				oxygen_spots_[i].Update();
+			}
+		});
+
+	// 敵は向きを変える時刻になったものだけを処理する（それ以外の位置は時刻から計算できる）
+	// 狭い所を速く往復する敵は1回の更新で何度も向きを変えることがあるので，時刻を過ぎた予定は全て処理する
+	entity_time_ += 1.0;
+	while((not turnaround_events_.empty()) && (turnaround_events_.top().time <= entity_time_))
+	{
+		const TurnaroundEvent event = turnaround_events_.top();
+		turnaround_events_.pop();
+
+		Enemy& enemy = enemies_[event.enemy_id];
+		if(enemy.GetNextTurnTime() != event.time) continue;
+
+		enemy.OnTurnaround(stage_);
+
+		const double next_time = enemy.GetNextTurnTime();
+		if(next_time < Math::Inf)
+		{
+			turnaround_events_.push(TurnaroundEvent{ next_time, event.enemy_id });
+		}
+	}
+}
+
+void GameWorld::DetectPlayerCollisions()
+{
+	const AllocationScope allocation_scope{ U"GameWorld::DetectPlayerCollisions" };
+	const TraceScope trace_scope{ U"GameWorld::DetectPlayerCollisions" };
+	auto& player_collider = player_.collider;
+
+	player_collider.ClearCollisionResult();
+
+	// スポット側のコライダーは各チャンクが自分の担当分だけ書き換える
+	// プレイヤー側への反映はチャンクごとのバッファに溜め，後で番号順に行う（直列と同じ順序になる）
+	// 先頭のバッファは敵の分（索引で絞り込むと数体しか残らないので，並列にはしない）
+	const size_t spot_chunks = JobSystem::GetChunkCount(oxygen_spots_.size(), kEntityUpdateGrain);
+	player_contacts_.Prepare(1 + spot_chunks);
+
+	// 敵は縦に動かないので，プレイヤーと高さが重なるものだけを今の位置に合わせて調べる
+	const RectF player_rect = player_.GetColliderRect();
+	visible_ids_.clear();
+	enemy_index_.Query(player_rect.topY(), player_rect.bottomY(), visible_ids_);
+	for(const uint32 id : visible_ids_)
+	{
+		Enemy& enemy = enemies_[id];
+		if(not enemy.IsAlive()) continue;
+
+		enemy.UpdateColliderPosition(entity_time_);
+		const auto& enemy_collider = enemy.GetCollider();
+		bool is_collided = std::visit([&](const auto& s1) { return std::visit([&](const auto& s2) { return s1.intersects(s2); }, enemy_collider.shape); }, player_collider.shape);
+		if(is_collided)
+		{
+			player_contacts_[0].push_back(PlayerContact{ enemy_collider.tag, false });
+		}
+	}
+
+	ParallelFor(oxygen_spots_.size(), kEntityUpdateGrain, [&](size_t begin, size_t end, size_t chunk_index)
+		{
+			auto& contacts = player_contacts_[1 + chunk_index];
+			for(size_t i = begin; i < end; ++i)
+			{
+				auto& spot_collider = oxygen_spots_[i].GetCollider();
+				spot_collider.ClearCollisionResult();
+
+				bool is_collided = std::visit([&](const auto& s1) { return std::visit([&](const auto& s2) { return s1.intersects(s2); }, spot_collider.shape); }, player_collider.shape);
+				if(is_collided)
+				{
+					contacts.push_back(PlayerContact{ spot_collider.tag, true });
+				}
+			}
+		});
+
+	player_contacts_.ForEachInOrder([&](const PlayerContact& contact)
+		{
+			player_collider.is_colliding = true;
+			player_collider.collided_tags.push_back(contact.tag);
+			if(contact.is_oxygen_spot)
+			{
+				player_.RecoverOxygen();
+			}
+		});
+}
+
+GameWorldEvents GameWorld::Tick(const GameInput& input)
+{
+	GameWorldEvents events;
+
+	sim_clock_.Advance();
+
+	switch(current_state_)
+	{
+	case GameState::Title:
+	{
+		for(auto& spot : oxygen_spots_)
+		{
+			spot.Update();
+		}
+
+		if(input.ok)
+		{
+			current_state_ = GameState::Playing;
+		}
+		break;
+	}
+	case GameState::Playing:
+	{
+		{
+			const AllocationScope player_scope{ U"Player::Update" };
+			const TraceScope player_trace{ U"Player::Update" };
+			player_.Update(stage_, sim_clock_, input);
+		}
+
+		if((not stage_.IsEndless()) && (player_.GetPos().y >= GetEndingZoneY()))
+		{
+			current_state_ = GameState::Ending;
+
+			// エンディング開始のティックを記録
+			ending_start_tick_ = sim_clock_.GetTick();
+
+			const double camera_center_x = camera_manager_.GetViewRect().center().x;
+			player_.StartEnding(camera_center_x, sim_clock_);
+			events.is_ending_reached = true;
+			break;
+		}
+
+		if(player_.IsOxygenEmpty())
+		{
+			current_state_ = GameState::GameOver;
+			events.is_player_died = true;
+			break;
+		}
+
+		UpdateEntities();
+		DetectPlayerCollisions();
+		break;
+	}
+	case GameState::Ending:
+	{
+		player_.Update(stage_, sim_clock_, input);
+		for(auto& spot : oxygen_spots_) { spot.Update(); }
+		break;
+	}
+	case GameState::GameOver:
+	{
+		player_.Update(stage_, sim_clock_, input);
+
+		if(input.ok)
+		{
+			Vec2 respawn_pos = FindNearestRespawnSpot();
+			player_.Respawn(respawn_pos, sim_clock_);
+			current_state_ = GameState::Playing;
+
+			// エンディングタイマーをリセット
+			ending_start_tick_.reset();
+			events.is_respawned = true;
+		}
+		break;
+	}
+	}
+
+	AdvanceStreamCamera();
+	StreamStageSegments();
+	return events;
+}
+
+double GameWorld::GetCameraOffsetYRatio() const
+{
+	if((current_state_ == GameState::Playing) || (current_state_ == GameState::GameOver))
+	{
+		return kPlayingCameraOffsetYRatio;
+	}
+	return kTitleEndingCameraOffsetYRatio;
+}
+
+void GameWorld::UpdateCamera(double delta_time, uint32 tick_count)
+{
+	// プレイヤーの速度は1ティックあたりの移動量なので，秒あたりに直して渡す
+	const double player_velocity_y = (delta_time > 0.0) ? ((player_.GetVelocity().y * tick_count) / delta_time) : 0.0;
+	camera_manager_.SetYOffsetRatio(GetCameraOffsetYRatio());
+	camera_manager_.SetTargetY(player_.GetPos().y, player_velocity_y);
+	camera_manager_.Update(delta_time);
+}
+
+void GameWorld::AdvanceStreamCamera()
+{
+	// 表示用のカメラを 60fps で1フレームに1ティックずつ進めたときと同じ動きになる
+	stream_camera_.SetYOffsetRatio(GetCameraOffsetYRatio());
+	stream_camera_.SetTargetY(player_.GetPos().y, (player_.GetVelocity().y * SimClock::kTicksPerSecond));
+	stream_camera_.Update(SimClock::TicksToSeconds(1));
+}
+
+void GameWorld::SnapCameraToPlayer()
+{
+	camera_manager_.SetYOffsetRatio(GetCameraOffsetYRatio());
+	camera_manager_.SetTargetY(player_.GetPos().y);
+	camera_manager_.SnapToTarget();
+	stream_camera_ = camera_manager_;
+	StreamStageSegments();
+}
+
+double GameWorld::GetDepthRatio() const
+{
+	const double total_travel = map_total_height_ - player_start_pos_.y;
+	if(total_travel <= 0)
+	{
+		return 0.0;
+	}
+	return Clamp((GetDepth() / total_travel), 0.0, 1.0);
+}
+
+void GameWorld::SaveState(SnapshotWriter& writer) const
+{
+	writer.Write(static_cast<uint8>(current_state_));
+	writer.Write(entity_time_);
+	writer.Write(sim_clock_.GetTick());
+	writer.Write(ending_start_tick_.has_value());
+	writer.Write(ending_start_tick_.value_or(0));
+
+	player_.SaveState(writer);
+
+	writer.Write(static_cast<uint32>(enemies_.size()));
+	for(const auto& enemy : enemies_)
+	{
+		writer.Write(enemy.GetSpawnPos());
+		Enemy::WriteMotionState(writer, enemy.GetMotionState());
+		enemy.SaveAnimationState(writer);
+	}
+}
+
+bool GameWorld::LoadState(SnapshotReader& reader, bool snap_camera)
+{
+	// 書き換える前に最後まで読んで確かめる
+	if(not ReadState(reader, restored_state_))
+	{
+		return false;
+	}
+
+	current_state_ = restored_state_.state;
+	entity_time_ = restored_state_.entity_time;
+	sim_clock_.SetTick(restored_state_.tick);
+	ending_start_tick_ = restored_state_.ending_start_tick;
+	player_.LoadState(*restored_state_.player_reader);
+
+	if(snap_camera)
+	{
+		// 区間を読み込んで配置する敵の分も先に確保しておく
+		enemies_.reserve(restored_state_.enemies.size());
+		SnapCameraToPlayer();
+	}
+
+	enemy_index_by_spawn_pos_.clear();
+	is_enemy_restored_.assign(enemies_.size(), false);
+
+	for(size_t i = 0; i < restored_state_.enemies.size(); ++i)
+	{
+		RestoredEnemy& restored = restored_state_.enemies[i];
+
+		// 区間の読み込みで並びが変わっていなければ同じ番号にいる．変わっていたら配置された位置から引く
+		size_t index = i;
+		if((enemies_.size() <= index) || (enemies_[index].GetSpawnPos() != restored.spawn_pos))
+		{
+			if(enemy_index_by_spawn_pos_.empty())
+			{
+				// 同じ位置に何体もいれば先頭の敵にする
+				for(size_t k = 0; k < enemies_.size(); ++k)
+				{
+					enemy_index_by_spawn_pos_.emplace(enemies_[k].GetSpawnPos(), k);
+				}
+			}
+
+			const auto it = enemy_index_by_spawn_pos_.find(restored.spawn_pos);
+			if(it == enemy_index_by_spawn_pos_.end())
+			{
+				continue;
+			}
+			index = it->second;
+		}
+
+		enemies_[index].SetMotionState(restored.motion);
+		enemies_[index].LoadAnimationState(restored.animation_reader);
+		is_enemy_restored_[index] = true;
+	}
+
+	// 記録したときには読み込まれていなかった敵は，今の時刻に配置したことにする
+	for(size_t i = 0; i < enemies_.size(); ++i)
+	{
+		if(not is_enemy_restored_[i])
+		{
+			enemies_[i].PlanMotion(stage_, entity_time_);
+		}
+	}
+
+	RebuildEntityIndices();
+	return true;
+}
+
+bool GameWorld::CanLoadState(const Array<uint8>& bytes)
+{
+	SnapshotReader reader{ bytes };
+	RestoredState restored;
+	return ReadState(reader, restored);
+}
+
+bool GameWorld::ReadState(SnapshotReader& reader, RestoredState& out)
+{
+	uint8 state = 0;
+	bool is_in_ending = false;
+	uint64 ending_start_tick = 0;
+	reader.Read(state);
+	reader.Read(out.entity_time);
+	reader.Read(out.tick);
+	reader.Read(is_in_ending);
+	reader.Read(ending_start_tick);
+
+	if((not reader.IsValid()) || (static_cast<GameState>(state) > GameState::GameOver))
+	{
+		return false;
+	}
+
+	out.state = static_cast<GameState>(state);
+	out.ending_start_tick = (is_in_ending ? Optional<uint64>{ ending_start_tick } : none);
+	out.player_reader = reader;
+
+	uint32 enemy_count = 0;
+	if((not Player::SkipState(reader)) || (not reader.Read(enemy_count)))
+	{
+		return false;
+	}
+
+	out.enemies.clear();
+	for(uint32 i = 0; i < enemy_count; ++i)
+	{
+		Vec2 spawn_pos;
+		Enemy::MotionState motion;
+		if((not reader.Read(spawn_pos)) || (not Enemy::ReadMotionState(reader, motion)))
+		{
+			return false;
+		}
+
+		const SnapshotReader animation_reader = reader;
+		if(not AnimationController::SkipState(reader))
+		{
+			return false;
+		}
+
+		out.enemies << RestoredEnemy{ spawn_pos, motion, animation_reader };
+	}
+	return true;
+}
+
+Vec2 GameWorld::FindNearestRespawnSpot() const
+{
+	const double dead_y = player_.GetPos().y;
+	Vec2 best_spot_pos = Vec2::Zero();
+	double min_distance = std::numeric_limits<double>::max();
+
+	for(const auto& spot : oxygen_spots_)
+	{
+		const Vec2 spot_pos = spot.GetPos();
+
+		if(spot_pos.y < dead_y)
+		{
+			const double distance_y = dead_y - spot_pos.y;
+			if(distance_y < min_distance)
+			{
+				min_distance = distance_y;
+				best_spot_pos = spot_pos;
+			}
+		}
+	}
+
+	// 持っている区間に無ければ，通り過ぎて捨てた区間のスポットに戻す
+	if((best_spot_pos == Vec2::Zero()) && passed_spot_pos_ && (passed_spot_pos_->y < dead_y))
+	{
+		best_spot_pos = *passed_spot_pos_;
+	}
+
+	if(best_spot_pos == Vec2::Zero())
+	{
+		return player_start_pos_;
+	}
+
+	return best_spot_pos;
+}
+
+void GameWorld::DrawVisibleEntities(const Vec2& camera_offset, const RectF& view_rect, RenderQueue& render_queue) const
+{
+	const AllocationScope allocation_scope{ U"GameWorld::DrawVisibleEntities" };
+	const TraceScope trace_scope{ U"GameWorld::DrawVisibleEntities" };
+
+	cull_stats_ = CullStats{};
+
+	// 索引で縦方向に絞り込んでから，画像の範囲と画面が重なるものだけを描く
+	// （索引に引っかからなかったものはテクスチャを引くことすらしない）
+	size_t drawn_count = 0;
+
+	visible_ids_.clear();
+	enemy_index_.Query(view_rect.topY(), view_rect.bottomY(), visible_ids_);
+	for(const uint32 id : visible_ids_)
+	{
+		const Enemy& enemy = enemies_[id];
+		if(enemy.IsAlive() && enemy.GetDrawBounds(entity_time_).intersects(view_rect))
+		{
+			enemy.Draw(camera_offset, entity_time_, sim_clock_, render_queue);
+			++drawn_count;
+		}
+	}
+
+	visible_ids_.clear();
+	oxygen_spot_index_.Query(view_rect.topY(), view_rect.bottomY(), visible_ids_);
+	for(const uint32 id : visible_ids_)
+	{
+		const OxygenSpot& spot = oxygen_spots_[id];
+		if(spot.GetDrawBounds().intersects(view_rect))
+		{
+			spot.Draw(camera_offset, sim_clock_, render_queue);
+			++drawn_count;
+		}
+	}
+
+	cull_stats_.drawn_count = drawn_count;
+	cull_stats_.culled_count = (enemies_.size() + oxygen_spots_.size()) - drawn_count;
+}
@@ -0,0 +1,271 @@
+﻿#pragma once
+
+#include "../Core/CameraManager.h"
+#include "../Core/GameInput.h"
+#include "../Core/JobSystem.h"
+#include "../Core/RenderQueue.h"
+#include "../Core/SimClock.h"
+#include "../Core/StateSnapshot.h"
+#include "../Entitie/Enemy.h"
+#include "../Entitie/OxygenSpot.h"
+#include "../Entitie/Player.h"
+#include "Stage.h"
+#include "VerticalBucketIndex.h"
+
+#include <Siv3D.hpp>
+
+#include <queue>
+
+enum class GameState
+{
+	Title,
+	Playing,
+	Ending,
+	GameOver
+};
+
+// GameWorld の動かし方
+struct GameWorldOptions
+{
+	// 酸素スポットの更新と当たり判定を JobSystem で並列にするか（敵は予定表で順に処理する）
+	// JobSystem は入れ子にできないので，ワールドごと JobSystem のワーカーで動かすとき（BatchRunner）は false にする
+	bool use_job_system = true;
+
+	// 効果音を鳴らすか
+	bool is_audible = true;
+};
+
+// Tick() の間に起きたこと（BGM や記録など，ワールドの外でやることのきっかけ）
+struct GameWorldEvents
+{
+	bool is_player_died = false;
+	bool is_ending_reached = false;
+	bool is_respawned = false;
+};
+
+// 画面外判定の結果（1フレーム分）
+struct CullStats
+{
+	size_t drawn_count = 0;
+	size_t culled_count = 0;
+};
+
+// 1回の遊びのシミュレーション（ステージ，プレイヤー，敵，酸素スポット，時計，カメラ，ゲームの状態）
+// 状態は全てこのインスタンスが持つので，1つのプロセスでいくつでも同時に動かせる（BatchRunner）
+// BGM・巻き戻し・中断セーブ・背景の飾りなど，人が遊ぶためのものは GameScene が持つ
+class GameWorld
+{
+public:
+	explicit GameWorld(Stage&& stage, const GameWorldOptions& options = {});
+
+	// 時計を1ティック進め，ゲームの状態に合わせて更新する
+	// タイトルでは input.ok で遊び始め，GameOver では input.ok でリスポーンする
+	// 最後に区間を読み込むためのカメラを1ティック分進め，その先読み範囲までの区間をそろえる
+	GameWorldEvents Tick(const GameInput& input);
+
+	// フレームの最後に1回呼ぶ．表示用のカメラを delta_time 秒進める（シミュレーションの結果には効かない）
+	// tick_count はそのフレームに進めたティック数（プレイヤーの速度を秒あたりに直すのに使う）
+	void UpdateCamera(double delta_time, uint32 tick_count);
+
+	// 両方のカメラをすぐにプレイヤーの位置へ移し，その深さの区間を読み込んで敵・酸素スポットを配置する
+	void SnapCameraToPlayer();
+
+	// ステージを差し替え，敵・酸素スポットを配置し直す
+	// keep_player_pos ならプレイヤーもカメラも今の位置のまま
+	void ResetStage(Stage&& stage, bool keep_player_pos);
+
+	// 読み直しで増減したスポーンに合わせて敵・酸素スポットを足し引きする
+	void ApplySpawnDiff(const StageReloadDiff& diff);
+
+	// ステージの当たり判定が書き換わったので，全ての敵の動きを決め直す
+	void ReplanEnemies();
+
+	// シミュレーションの状態（プレイヤー・敵の動き・酸素・時刻・ゲームの状態）を詰める／戻す
+	// 敵は配置された位置で対応を取るので，戻した時点で読み込まれていない区間の敵は配置したときの動きのまま
+	// 区間を読み込むためのカメラは含めない（戻したあとはプレイヤーを追いかけ直す）
+	// 読めない内容なら何も変えずに false を返す
+	// snap_camera なら，プレイヤーを戻したところで SnapCameraToPlayer を呼び，その深さの区間に配置した敵にも記録した動きを戻す
+	void SaveState(SnapshotWriter& writer) const;
+	bool LoadState(SnapshotReader& reader, bool snap_camera = false);
+
+	// 何も変えずに，LoadState で戻せる内容か確かめる
+	static bool CanLoadState(const Array<uint8>& bytes);
+
+	// 画面に映る敵・酸素スポットだけを描画キューに積む
+	void DrawVisibleEntities(const Vec2& camera_offset, const RectF& view_rect, RenderQueue& render_queue) const;
+
+	GameState GetState() const { return current_state_; }
+
+	Stage& GetStage() { return stage_; }
+	const Stage& GetStage() const { return stage_; }
+	Player& GetPlayer() { return player_; }
+	const Player& GetPlayer() const { return player_; }
+	const CameraManager& GetCamera() const { return camera_manager_; }
+
+	// 時間の倍率を変えたり，1フレームに進めるティック数を決めたりするのに使う
+	SimClock& GetClock() { return sim_clock_; }
+	const SimClock& GetClock() const { return sim_clock_; }
+
+	const Vec2& GetPlayerStartPos() const { return player_start_pos_; }
+	double GetMapTotalHeight() const { return map_total_height_; }
+
+	// 開始位置からの深さ[px]と，マップの下端までの割合（0.0 ～ 1.0）
+	double GetDepth() const { return (player_.GetPos().y - player_start_pos_.y); }
+	double GetDepthRatio() const;
+
+	// エンディングに移行するY座標と，タコを描くY座標
+	double GetEndingZoneY() const { return (map_total_height_ - kEndingZoneOffsetFromBottom); }
+	double GetOctopusY() const { return (map_total_height_ - kOctopusOffsetFromBottom); }
+
+	// エンディングを始めたティック（エンディング中でなければ none）
+	const Optional<uint64>& GetEndingStartTick() const { return ending_start_tick_; }
+
+	// 捨てた区間にあった酸素スポットのうち，一番深いもの（リスポーン先の候補．スナップショットには含めない）
+	const Optional<Vec2>& GetPassedSpotPos() const { return passed_spot_pos_; }
+	void SetPassedSpotPos(const Optional<Vec2>& pos) { passed_spot_pos_ = pos; }
+
+	const CullStats& GetCullStats() const { return cull_stats_; }
+
+	// 配置のときに見つかったステージの問題（同じものは1回だけ）
+	// ワーカーで進めるワールドからは Print できないので，溜めておいて呼び出し側がメインスレッドで書き出す
+	const Array<String>& GetWarnings() const { return warnings_; }
+
+private:
+	void SpawnEntities();
+
+	// 区間に含まれる敵・酸素スポットを配置する（place_player ならプレイヤーの開始位置も設定する）
+	void SpawnSegmentEntities(const StageSegment& segment, bool place_player);
+	void SpawnEntity(const SpawnInfo& info, bool place_player);
+
+	// まだ溜めていない警告なら溜める
+	void AddWarning(String&& warning);
+
+	// 区間を読み込むためのカメラの先読み範囲に合わせて，ステージの区間を読み込み／破棄し，
+	// 敵・酸素スポットもそれに合わせる
+	void StreamStageSegments();
+
+	// 区間を読み込むためのカメラを1ティック分進める
+	void AdvanceStreamCamera();
+
+	// 敵・酸素スポットの画面外判定用の索引と，敵が向きを変える予定を作り直す（配置が変わったときだけ）
+	void RebuildEntityIndices();
+
+	// 敵・酸素スポットの更新と，プレイヤーとの当たり判定
+	// 敵は向きを変える時刻になったものだけを更新し，位置はその都度計算する
+	void UpdateEntities();
+	void DetectPlayerCollisions();
+
+	// use_job_system なら JobSystem で並列に，そうでなければ同じチャンクに分けて順に実行する
+	void ParallelFor(size_t count, size_t grain, const JobSystem::ChunkFunction& function) const;
+
+	Vec2 FindNearestRespawnSpot() const;
+
+	// ゲームの状態に合わせたカメラのY軸オフセット比率
+	double GetCameraOffsetYRatio() const;
+
+	GameWorldOptions options_;
+
+	// stage_を先に宣言(CameraManagerの初期化で使うため)
+	Stage stage_;
+
+	CameraManager camera_manager_;
+
+	// 区間の読み込みを決めるカメラ（表示用のカメラと同じ動きを，ティックごとに 1/60 秒ずつ進める）
+	// 区間の読み込みは敵・酸素スポットの配置を変えてシミュレーションの結果に効くので，実時間で進む表示用のカメラでは決めない
+	// （フレームレートや時間の倍率が違うと同じ入力でも結果が変わってしまう）
+	CameraManager stream_camera_;
+
+	Player player_;
+	GameState current_state_ = GameState::Title;
+	s3d::Array<Enemy> enemies_;
+	s3d::Array<OxygenSpot> oxygen_spots_;
+
+	// ゲームの進行の時計（Tick() 1回で 1 進む）
+	SimClock sim_clock_;
+
+	// 画面外の敵・酸素スポットを描画前に除くための索引（配置が変わったときに作り直す）
+	VerticalBucketIndex enemy_index_;
+	VerticalBucketIndex oxygen_spot_index_;
+
+	// 敵の動きの時刻（Playing 中の更新1回で 1 進む）
+	double entity_time_ = 0.0;
+
+	// 敵が向きを変える予定（時刻の早い順）
+	// 動きを決め直した敵の古い予定は，取り出したときに時刻が合わないので捨てる
+	struct TurnaroundEvent
+	{
+		double time = 0.0;
+		uint32 enemy_id = 0;
+
+		// 同じ時刻なら番号順（毎回同じ順に処理する）
+		bool operator>(const TurnaroundEvent& other) const { return ((time != other.time) ? (time > other.time) : (enemy_id > other.enemy_id)); }
+	};
+	std::priority_queue<TurnaroundEvent, std::vector<TurnaroundEvent>, std::greater<>> turnaround_events_;
+
+	mutable CullStats cull_stats_;
+
+	// 索引の検索結果を受け取るバッファ（毎フレームの確保を避けるため使い回す）
+	mutable Array<uint32> visible_ids_;
+
+	// 並列の当たり判定で見つかった接触（チャンク順に結合してから反映する）
+	struct PlayerContact
+	{
+		ColliderTag tag;
+		bool is_oxygen_spot = false;
+	};
+	OrderedJobBuffers<PlayerContact> player_contacts_;
+
+	// 1チャンクあたりのエンティティ数（これ以下ならスレッドを使わない）
+	static constexpr size_t kEntityUpdateGrain = 256;
+
+	// 状態を戻すときに読んだ内容（書き換える前にスナップショットを最後まで読むので，いったんここに置く）
+	// プレイヤーと敵のアニメーションは長さが変わるので，読み始める位置だけを覚えておく
+	struct RestoredEnemy
+	{
+		Vec2 spawn_pos;
+		Enemy::MotionState motion;
+		SnapshotReader animation_reader;
+	};
+
+	struct RestoredState
+	{
+		GameState state = GameState::Title;
+		double entity_time = 0.0;
+		uint64 tick = 0;
+		Optional<uint64> ending_start_tick;
+		Optional<SnapshotReader> player_reader;
+		Array<RestoredEnemy> enemies;
+	};
+
+	// SaveState で詰めた内容を最後まで読んで out に入れる．足りなかったり値が範囲外だったりしたら false
+	static bool ReadState(SnapshotReader& reader, RestoredState& out);
+
+	// 状態を戻すときの作業用（毎フレームの確保を避けるため使い回す）
+	// enemy_index_by_spawn_pos_ は並びが変わっていたときだけ作り，配置された位置から敵の番号を引く
+	RestoredState restored_state_;
+	HashTable<Vec2, size_t> enemy_index_by_spawn_pos_;
+	Array<bool> is_enemy_restored_;
+
+	Vec2 player_start_pos_ = Vec2::Zero();
+	double map_total_height_ = 0.0;
+
+	Optional<Vec2> passed_spot_pos_;
+
+	Array<String> warnings_;
+
+	// エンディングを始めたティック（エンディング中でなければ none）
+	Optional<uint64> ending_start_tick_;
+
+	// ステージの区間を何ティック先のカメラ位置まで読み込んでおくか
+	static constexpr int32 kStageStreamLookAheadFrames = 30;
+
+	// タイトル・エンディング画面用のカメラオフセット
+	static constexpr double kTitleEndingCameraOffsetYRatio = -1.0 / 4.9;
+	// ゲームプレイ用のカメラオフセット(上1/3にPlayer)
+	static constexpr double kPlayingCameraOffsetYRatio = 1.0 / 6.0;
+
+	// エンディングに移行する位置とタコの位置（マップの下端からの距離．v3 で Y=7650, 7300 になる値）
+	// 終わりのないステージではエンディングにならない
+	static constexpr double kEndingZoneOffsetFromBottom = 926.0;
+	static constexpr double kOctopusOffsetFromBottom = 1276.0;
+};
@@ -1,38 +1,40 @@
-﻿#include "../Core/Utility.h"
+﻿#include "../Core/Fixed.h"
+#include "../Core/Utility.h"
 #include "SpawnInfo.h"
 # include "Stage.h"
 
+#include <algorithm>
 #include <cmath>
 #include <Siv3D.hpp>
 
 Stage::Stage(const FilePath& json_path, const FilePath& tileset_path, const String& collision_layer_name)
-	: tile_texture_(tileset_path)
-	, collision_layer_name_(collision_layer_name)
+	: Stage(std::make_unique<TiledSegmentSource>(Array<FilePath>{ json_path }, collision_layer_name, kDefaultSegmentRows), tileset_path)
 {
-	LoadFromJson(json_path);
-	CreateTileRegions();
-
-	// 当たり判定レイヤーを検索してポインタを保持
-	FindCollisionLayer();
+}
 
-	// 見つからなかった場合
-	if(not collision_layer_)
-	{
-		throw Error{ U"Stage: 当たり判定レイヤー '{}' が見つかりませんでした．"_fmt(collision_layer_name_) };
-	}
+Stage::Stage(std::unique_ptr<StageSegmentSource> source, const FilePath& tileset_path)
+	: Stage(std::move(source), Texture{ tileset_path })
+{
 }
 
-void Stage::FindCollisionLayer()
+Stage::Stage(std::unique_ptr<StageSegmentSource> source, const Texture& tile_texture)
+	: source_(std::move(source))
+	, map_width_(source_->GetWidth())
+	, total_rows_(source_->GetTotalRows())
+	, tile_size_(source_->GetTileSize())
+	, segment_rows_(source_->GetSegmentRows())
+	, tile_texture_(tile_texture)
 {
-	collision_layer_ = nullptr;
-	for(const auto& layer : layers_)
-	{
-		if(layer.name == collision_layer_name_)
-		{
-			collision_layer_ = &layer;
-			break;
-		}
-	}
+#ifdef BNS_FIXED_POINT_PHYSICS
+	// 座標が固定小数点で表せる深さまでにする（終わりのないステージもそこを底にする）
+	const int32 max_rows = Physics::GetMaxFixedTileRows(tile_size_);
+	total_rows_ = Min(total_rows_.value_or(max_rows), max_rows);
+#endif
+
+	CreateTileRegions();
+
+	// プレイヤーの開始位置などを取り出せるように，先頭の区間だけは最初から持っておく
+	LoadSegmentBack(0);
 }
 
 void Stage::CreateTileRegions()
@@ -53,73 +55,222 @@ void Stage::CreateTileRegions()
 	}
 }
 
-void Stage::LoadFromJson(const FilePath& json_path)
+int32 Stage::ToSegmentIndex(double world_y) const
+{
+	const double segment_height = (static_cast<double>(segment_rows_) * tile_size_);
+	return ClampSegmentIndex(static_cast<int32>(std::floor(world_y / segment_height)));
+}
+
+int32 Stage::ClampSegmentIndex(int32 segment_index) const
 {
-	const JSON json = JSON::Load(json_path);
-	if(not json)
+	if(total_rows_)
 	{
-		throw Error{ U"Stage::LoadFromJson(): JSONファイルの読み込みに失敗しました → {}"_fmt(json_path) };
+		const int32 segment_count = ((*total_rows_ + segment_rows_ - 1) / segment_rows_);
+		segment_index = Min(segment_index, (segment_count - 1));
 	}
+	return Max(segment_index, 0);
+}
 
-	map_width_ = json[U"width"].get<int32>();
-	map_height_ = json[U"height"].get<int32>();
-	tile_size_ = json[U"tilewidth"].get<int32>();
+const StageSegment* Stage::FindResidentSegment(int32 segment_index) const
+{
+	if(resident_segments_.empty())
+	{
+		return nullptr;
+	}
 
-	for(const auto& layer : json[U"layers"].arrayView())
+	// 番号が連続しているので，先頭との差がそのまま位置になる
+	const int32 offset = (segment_index - resident_segments_.front().index);
+	if((offset < 0) || (offset >= static_cast<int32>(resident_segments_.size())))
 	{
-		const String type = layer[U"type"].getString();
-		if(type == U"tilelayer")
-		{
-			ParseTileLayer(layer);
-		}
-		else if(type == U"objectgroup")
-		{
-			ParseObjectLayer(layer);
-		}
+		return nullptr;
+	}
+	return &resident_segments_[offset];
+}
+
+StageSegment Stage::LoadSegment(int32 segment_index)
+{
+	StageSegment segment;
+	if(not spare_segments_.isEmpty())
+	{
+		segment = std::move(spare_segments_.back());
+		spare_segments_.pop_back();
+	}
+
+	source_->LoadSegment(segment_index, segment);
+	for(int32 row = 0; row < segment_rows_; ++row)
+	{
+		segment.RebuildOpenRuns(row);
 	}
+
+	residency_change_.loaded << segment_index;
+	return segment;
+}
+
+void Stage::LoadSegmentFront(int32 segment_index)
+{
+	resident_segments_.push_front(LoadSegment(segment_index));
+}
+
+void Stage::LoadSegmentBack(int32 segment_index)
+{
+	resident_segments_.push_back(LoadSegment(segment_index));
+}
+
+void Stage::DropSegmentFront()
+{
+	residency_change_.dropped << resident_segments_.front().index;
+	spare_segments_ << std::move(resident_segments_.front());
+	resident_segments_.pop_front();
 }
 
-void Stage::ParseTileLayer(const JSON& layer_json)
+void Stage::DropSegmentBack()
 {
-	TileMapLayer new_layer;
-	new_layer.name = layer_json[U"name"].getString();
+	residency_change_.dropped << resident_segments_.back().index;
+	spare_segments_ << std::move(resident_segments_.back());
+	resident_segments_.pop_back();
+}
+
+const StageResidencyChange& Stage::UpdateResidency(const RectF& keep_rect)
+{
+	residency_change_.loaded.clear();
+	residency_change_.dropped.clear();
+
+	const int32 need_first = ToSegmentIndex(keep_rect.topY());
+	const int32 need_last = ToSegmentIndex(keep_rect.bottomY());
+	const int32 keep_first = ClampSegmentIndex(need_first - kSpareSegments);
+	const int32 keep_last = ClampSegmentIndex(need_last + kSpareSegments);
+
+	// 予備の範囲からも外れた区間を捨てる（リスポーンなどで大きく飛んだときは全部捨てる）
+	while((not resident_segments_.empty()) && (resident_segments_.front().index < keep_first))
+	{
+		DropSegmentFront();
+	}
+	while((not resident_segments_.empty()) && (resident_segments_.back().index > keep_last))
+	{
+		DropSegmentBack();
+	}
+
+	// 映る区間は当たり判定に必要なので，足りなければその場で読む
+	if(resident_segments_.empty())
+	{
+		LoadSegmentBack(need_first);
+	}
+	while(resident_segments_.front().index > need_first)
+	{
+		LoadSegmentFront(resident_segments_.front().index - 1);
+	}
+	while(resident_segments_.back().index < need_last)
+	{
+		LoadSegmentBack(resident_segments_.back().index + 1);
+	}
+
+	// 予備の区間は1フレームに1つだけ読む（潜っていく向きの下側を優先）
+	if(resident_segments_.back().index < keep_last)
+	{
+		LoadSegmentBack(resident_segments_.back().index + 1);
+	}
+	else if(resident_segments_.front().index > keep_first)
+	{
+		LoadSegmentFront(resident_segments_.front().index - 1);
+	}
 
-	Grid<int32> grid(map_width_, map_height_);
-	const auto& data = layer_json[U"data"].arrayView();
+	return residency_change_;
+}
 
-	const size_t data_size = layer_json[U"data"].size();
-	for(size_t i = 0; i < data_size; ++i)
+StageReloadDiff Stage::ReloadFile(const FilePath& path)
+{
+	StageReloadDiff diff;
+	diff.result = source_->ReloadFile(path);
+	if(diff.result != StageReloadResult::Updated)
 	{
-		const int32 x = static_cast<s3d::int32>(i) % map_width_;
-		const int32 y = static_cast<s3d::int32>(i) / map_width_;
-		grid[y][x] = data[i].get<int32>();
+		return diff;
 	}
 
-	new_layer.tiles = std::move(grid);
-	layers_ << std::move(new_layer);
+	// 持っていない区間は次に読み込むときに新しい内容になるので，持っている区間だけ差分を取る
+	for(auto& segment : resident_segments_)
+	{
+		source_->LoadSegment(segment.index, reload_scratch_);
+		ApplySegmentDiff(reload_scratch_, segment, diff);
+	}
+
+	return diff;
 }
 
-void Stage::ParseObjectLayer(const JSON& layer_json)
+void Stage::ApplySegmentDiff(const StageSegment& fresh, StageSegment& segment, StageReloadDiff& diff) const
 {
-	if(layer_json[U"name"].getString() != U"spawn_layer")
+	const size_t words_per_row = static_cast<size_t>(segment.words_per_row);
+	for(int32 row = 0; row < segment_rows_; ++row)
 	{
-		return;
+		const auto fresh_row = fresh.collision_bits.begin() + (row * words_per_row);
+		const auto segment_row = segment.collision_bits.begin() + (row * words_per_row);
+		if(not std::equal(fresh_row, (fresh_row + words_per_row), segment_row))
+		{
+			std::copy(fresh_row, (fresh_row + words_per_row), segment_row);
+			segment.RebuildOpenRuns(row);
+			diff.changed_collision_rows << (segment.top_row + row);
+		}
 	}
 
-	for(const auto& object : layer_json[U"objects"].arrayView())
+	for(size_t layer_index = 0; layer_index < segment.view_layers.size(); ++layer_index)
 	{
-		SpawnInfo info;
-		info.type = object[U"type"].getString();
-		info.pos = { object[U"x"].get<double>(), object[U"y"].get<double>() };
-		info.size = { object[U"width"].get<double>(), object[U"height"].get<double>() };
+		const Grid<int32>& fresh_tiles = fresh.view_layers[layer_index].tiles;
+		Grid<int32>& tiles = segment.view_layers[layer_index].tiles;
+		for(int32 row = 0; row < segment_rows_; ++row)
+		{
+			for(int32 x = 0; x < map_width_; ++x)
+			{
+				if(tiles[row][x] != fresh_tiles[row][x])
+				{
+					tiles[row][x] = fresh_tiles[row][x];
+					++diff.changed_tile_count;
+				}
+			}
+		}
+	}
 
-		spawn_points_.push_back(info);
+	// スポーンは数が少ないので総当たりで突き合わせる
+	auto IsSameSpawn = [](const SpawnInfo& a, const SpawnInfo& b)
+		{
+			return (a.type == b.type) && (a.pos == b.pos) && (a.size == b.size);
+		};
+
+	Array<bool> is_matched(fresh.spawns.size(), false);
+	for(const auto& old_spawn : segment.spawns)
+	{
+		bool found = false;
+		for(size_t i = 0; i < fresh.spawns.size(); ++i)
+		{
+			if((not is_matched[i]) && IsSameSpawn(old_spawn, fresh.spawns[i]))
+			{
+				is_matched[i] = true;
+				found = true;
+				break;
+			}
+		}
+		if(not found)
+		{
+			diff.removed_spawns << old_spawn;
+		}
+	}
+	for(size_t i = 0; i < fresh.spawns.size(); ++i)
+	{
+		if(not is_matched[i])
+		{
+			diff.added_spawns << fresh.spawns[i];
+		}
 	}
+
+	segment.spawns = fresh.spawns;
 }
 
-const s3d::Array<SpawnInfo>& Stage::GetSpawnPoints() const
+double Stage::GetResidentTopY() const
 {
-	return spawn_points_;
+	return (static_cast<double>(resident_segments_.front().top_row) * tile_size_);
+}
+
+double Stage::GetResidentBottomY() const
+{
+	return (static_cast<double>(resident_segments_.back().top_row + segment_rows_) * tile_size_);
 }
 
 void Stage::ComputeDrawRange(const RectF& view_rect, int32& out_start_x, int32& out_start_y, int32& out_end_x, int32& out_end_y) const
@@ -128,64 +279,95 @@ void Stage::ComputeDrawRange(const RectF& view_rect, int32& out_start_x, int32&
 	out_start_x = Max(0, static_cast<int32>(std::floor(view_rect.x / tile_size_)));
 	out_start_y = Max(0, static_cast<int32>(std::floor(view_rect.y / tile_size_)));
 	out_end_x = Min(map_width_, static_cast<int32>(std::ceil(view_rect.tr().x / tile_size_)));
-	out_end_y = Min(map_height_, static_cast<int32>(std::ceil(view_rect.br().y / tile_size_)));
+	out_end_y = static_cast<int32>(std::ceil(view_rect.br().y / tile_size_));
+	if(total_rows_)
+	{
+		out_end_y = Min(*total_rows_, out_end_y);
+	}
 }
 
-void Stage::DrawLayerTiles(const TileMapLayer& layer, int32 start_x, int32 start_y, int32 end_x, int32 end_y, const Vec2& camera_offset) const
+void Stage::DrawLayerTiles(const TileMapLayer& layer, int32 top_row, int32 start_x, int32 start_y, int32 end_x, int32 end_y, const Vec2& camera_offset, RenderQueue& render_queue) const
 {
+	// start_y, end_y はステージ全体での行番号，layer.tiles は区間の中での行番号
 	for(int32 y = start_y; y < end_y; ++y)
 	{
 		for(int32 x = start_x; x < end_x; ++x)
 		{
-			const int32 tile_id = layer.tiles[y][x];
+			const int32 tile_id = layer.tiles[y - top_row][x];
 			if(tile_id <= 0) continue;
 
 			const Vec2 world_pos = Vec2{ x * tile_size_, y * tile_size_ };
 			const Vec2 draw_pos = world_pos - camera_offset;
 
-			// 整数にスナップ
-			tile_regions_[tile_id - 1].draw(s3d::Floor(draw_pos));
+			// カメラのオフセットは整数にそろえてあるので，タイルは常にピクセル境界に載る
+			render_queue.Submit(RenderLayer::Stage, tile_regions_[tile_id - 1], draw_pos, true);
 		}
 	}
 }
 
-void Stage::Draw(const Vec2& camera_offset, const RectF& view_rect) const
+void Stage::Draw(const Vec2& camera_offset, const RectF& view_rect, RenderQueue& render_queue) const
 {
-	const ScopedRenderStates2D sampler{ SamplerState::ClampNearest };
+	if(resident_segments_.empty())
+	{
+		return;
+	}
 
 	int32 start_x, start_y, end_x, end_y;
 	ComputeDrawRange(view_rect, start_x, start_y, end_x, end_y);
 
-	for(const auto& layer : layers_)
+	// レイヤーの重なり順を保つため，レイヤーごとに区間をまたいで描く
+	const size_t layer_count = resident_segments_.front().view_layers.size();
+	for(size_t layer_index = 0; layer_index < layer_count; ++layer_index)
 	{
-		// 当たり判定レイヤーは描画しない
-		if(layer.name == collision_layer_name_) continue;
+		for(const auto& segment : resident_segments_)
+		{
+			const int32 first = Max(start_y, segment.top_row);
+			const int32 last = Min(end_y, (segment.top_row + segment_rows_));
+			if(first >= last) continue;
 
-		DrawLayerTiles(layer, start_x, start_y, end_x, end_y, camera_offset);
+			DrawLayerTiles(segment.view_layers[layer_index], segment.top_row, start_x, first, end_x, last, camera_offset, render_queue);
+		}
 	}
 }
 
 // ワールド座標(px)から当たり判定をチェックする関数
 bool Stage::IsSolid(double world_x, double world_y) const
 {
-	// 当たり判定レイヤーがコンストラクタで正常に設定されていない場合は常に「壁なし」
-	if(not collision_layer_)
-	{
-		return false;
-	}
-
 	// ワールド座標(px)をタイル座標(グリッドのインデックス)に変換
 	// (floorを使いマイナス座標に対応)
 	const int32 tile_x = static_cast<int32>(std::floor(world_x / tile_size_));
 	const int32 tile_y = static_cast<int32>(std::floor(world_y / tile_size_));
 
+	return IsSolidTile(tile_x, tile_y);
+}
+
+bool Stage::IsSolidTile(int32 tile_x, int32 tile_y) const
+{
 	// マップの範囲外かチェック
 	// (範囲外は壁として扱う)
-	if((tile_x < 0) || (tile_x >= map_width_) || (tile_y < 0) || (tile_y >= map_height_))
+	if((tile_x < 0) || (tile_x >= map_width_) || (tile_y < 0) || (total_rows_ && (tile_y >= *total_rows_)))
+	{
+		return true;
+	}
+
+	// 読み込んでいない区間も壁として扱う（敵が持っている範囲の外へ出ていかないように）
+	const StageSegment* segment = FindResidentSegment(tile_y / segment_rows_);
+	if(not segment)
 	{
 		return true;
 	}
 
-	// ID > 0 なら「壁あり」と判定
-	return (collision_layer_->tiles[tile_y][tile_x] > 0);
+	return segment->IsSolidAt(tile_x, (tile_y - segment->top_row));
+}
+
+Optional<TileRun> Stage::GetOpenRun(int32 tile_x, int32 tile_y) const
+{
+	if(IsSolidTile(tile_x, tile_y))
+	{
+		return none;
+	}
+
+	const StageSegment* segment = FindResidentSegment(tile_y / segment_rows_);
+	const size_t index = (static_cast<size_t>(tile_y - segment->top_row) * map_width_) + tile_x;
+	return TileRun{ segment->run_first_x[index], segment->run_last_x[index] };
 }
@@ -1,52 +1,150 @@
 ﻿#pragma once
+#include "../Core/RenderQueue.h"
 #include "SpawnInfo.h"
+#include "StageSegment.h"
+#include "StageSegmentSource.h"
 # include <Siv3D.hpp>
 
-struct TileMapLayer
+#include <deque>
+#include <memory>
+
+// UpdateResidency() で読み込んだ区間と捨てた区間の番号
+struct StageResidencyChange
+{
+	Array<int32> loaded;
+	Array<int32> dropped;
+
+	bool IsEmpty() const { return loaded.isEmpty() && dropped.isEmpty(); }
+};
+
+// 1行の中で壁にはさまれた空きタイルの並び（first_x から last_x まで．両端を含む）
+struct TileRun
+{
+	int32 first_x = 0;
+	int32 last_x = 0;
+};
+
+// ファイルを読み直したときに，持っている区間で変わったところ
+struct StageReloadDiff
 {
-	String name;
-	Grid<int32> tiles;
+	StageReloadResult result = StageReloadResult::NotWatched;
+
+	// 当たり判定が変わった行（ステージ全体での行番号）
+	Array<int32> changed_collision_rows;
+
+	// 見た目が変わったタイルの数
+	size_t changed_tile_count = 0;
+
+	// なくなったスポーンと増えたスポーン
+	Array<SpawnInfo> removed_spawns;
+	Array<SpawnInfo> added_spawns;
 };
 
-// Tiledから出力したJSONを元にマップ全体を管理するクラス
+// 縦に長いステージを一定の高さの区間に分けて管理するクラス
+// カメラの近くの区間だけを持つので，どれだけ深く潜ってもメモリと1フレームの処理量は変わらない
 class Stage
 {
 public:
+	// Tiledから出力したJSONを1枚読む
 	Stage(const FilePath& json_path, const FilePath& tileset_path, const String& collision_layer_name);
 
-	void Draw(const Vec2& camera_offset, const RectF& view_rect) const;
+	// 区間の読み込み元を指定する（複数のマップをつなげたもの，自動生成したものなど）
+	Stage(std::unique_ptr<StageSegmentSource> source, const FilePath& tileset_path);
+
+	// タイルセットを作ってあるとき用（起動時に別スレッドで読み込んだものを渡す）
+	Stage(std::unique_ptr<StageSegmentSource> source, const Texture& tile_texture);
+
+	// 1枚のマップを読むときの区間の高さ（行数）
+	static constexpr int32 kDefaultSegmentRows = 16;
+
+	// keep_rect（カメラが映す予定の範囲）に掛かる区間を持ち，そこから離れた区間を捨てる
+	// keep_rect に掛かる区間はその場で読み，上下の予備の区間は1フレームに1つまで読む
+	// 戻り値は次に呼ぶまで有効
+	const StageResidencyChange& UpdateResidency(const RectF& keep_rect);
+
+	// 見えている範囲のタイルを描画キューに積む
+	void Draw(const Vec2& camera_offset, const RectF& view_rect, RenderQueue& render_queue) const;
+
+	// 書き換えられたファイルを読み直し，持っている区間は変わった行とスポーンだけを差し替える
+	// 結果が Restructured のときは何も変えないので，ステージを作り直すこと
+	StageReloadDiff ReloadFile(const FilePath& path);
+
+	// 読み込み元のファイル（書き換えの監視用）
+	Array<FilePath> GetSourceFiles() const { return source_->GetSourceFiles(); }
 
 	// 指定したワールド座標が「壁」タイル上かどうかを判定する
+	// マップの外と，読み込んでいない区間は壁として扱う
 	bool IsSolid(double world_x, double world_y) const;
 
-	const s3d::Array<SpawnInfo>& GetSpawnPoints() const;
+	// タイル座標で判定する（範囲外の扱いは IsSolid と同じ）
+	bool IsSolidTile(int32 tile_x, int32 tile_y) const;
+
+	// 行 tile_y で tile_x を含む空きタイルの並び（読み込み時に作ってあるので表を引くだけ）
+	// tile_x が壁，マップの外，読み込んでいない区間なら none
+	Optional<TileRun> GetOpenRun(int32 tile_x, int32 tile_y) const;
+
+	// 今持っている区間（上から順）
+	const std::deque<StageSegment>& GetResidentSegments() const { return resident_segments_; }
+
+	// 持っている区間が覆う範囲のY座標（ワールド座標，bottom は含まない）
+	double GetResidentTopY() const;
+	double GetResidentBottomY() const;
+
+	// ステージ全体の酸素スポットの位置（分からなければ空）
+	Array<Vec2> GetOxygenSpotPositions() const { return source_->GetOxygenSpotPositions(); }
+
+	// 終わりのないステージか（固定小数点のビルドでは座標の範囲で底を決めるので，常に false）
+	bool IsEndless() const { return (not total_rows_.has_value()); }
 
 	int32 GetWidth() const { return map_width_; }
-	int32 GetHeight() const { return map_height_; }
+	// ステージ全体の行数（終わりのないステージでは 0）
+	int32 GetHeight() const { return total_rows_.value_or(0); }
 	int32 GetTileSize() const { return tile_size_; }
+	int32 GetSegmentRows() const { return segment_rows_; }
 
 private:
+	std::unique_ptr<StageSegmentSource> source_;
+
 	int32 map_width_ = 0;
-	int32 map_height_ = 0;
+	Optional<int32> total_rows_;
 	int32 tile_size_ = 16;
-
-	Array<TileMapLayer> layers_;
+	int32 segment_rows_ = 16;
 
 	Texture tile_texture_;
 	Array<TextureRegion> tile_regions_;
 
-	Array<SpawnInfo> spawn_points_;
+	// 持っている区間（番号が連続するように上から並べる）
+	std::deque<StageSegment> resident_segments_;
 
-	String collision_layer_name_; // コンストラクタで受け取ったレイヤー名
-	const TileMapLayer* collision_layer_ = nullptr; // 当たり判定レイヤーへのポインタ
+	// 捨てた区間（次に読み込むときにメモリを使い回す）
+	Array<StageSegment> spare_segments_;
+
+	StageResidencyChange residency_change_;
+
+	// 読み直した区間を一時的に置く場所（差分を取ってから捨てる）
+	StageSegment reload_scratch_;
+
+	// 表示範囲の上下に余分に持っておく区間の数
+	static constexpr int32 kSpareSegments = 1;
 
-	void LoadFromJson(const FilePath& json_path);
-	void ParseTileLayer(const JSON& layer_json);
-	void ParseObjectLayer(const JSON& layer_json);
 	void CreateTileRegions();
 
-	// new helpers
-	void FindCollisionLayer();
-	void DrawLayerTiles(const TileMapLayer& layer, int32 start_x, int32 start_y, int32 end_x, int32 end_y, const Vec2& camera_offset) const;
+	// Y座標を含む区間の番号（ステージの範囲に収める）
+	int32 ToSegmentIndex(double world_y) const;
+	int32 ClampSegmentIndex(int32 segment_index) const;
+
+	// 番号が segment_index の区間を持っていれば返す
+	const StageSegment* FindResidentSegment(int32 segment_index) const;
+
+	void LoadSegmentFront(int32 segment_index);
+	void LoadSegmentBack(int32 segment_index);
+	StageSegment LoadSegment(int32 segment_index);
+	void DropSegmentFront();
+	void DropSegmentBack();
+
+	// fresh と違うところだけを segment に書き写し，diff に記録する
+	void ApplySegmentDiff(const StageSegment& fresh, StageSegment& segment, StageReloadDiff& diff) const;
+
+	void DrawLayerTiles(const TileMapLayer& layer, int32 top_row, int32 start_x, int32 start_y, int32 end_x, int32 end_y, const Vec2& camera_offset, RenderQueue& render_queue) const;
 	void ComputeDrawRange(const RectF& view_rect, int32& out_start_x, int32& out_start_y, int32& out_end_x, int32& out_end_y) const;
 };
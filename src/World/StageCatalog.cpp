@@ -0,0 +1,131 @@
+﻿#include "StageCatalog.h"
+
+#include <Siv3D.hpp>
+
+Array<StageEntry>& StageCatalog::Entries()
+{
+	static Array<StageEntry> entries = {
+		{ U"v1", U"asset/Stage/v1/tilemap.json", U"asset/Stage/v1/tileset.png", U"collision_layer" },
+		{ U"v2", U"asset/Stage/v2/tilemap_v2.json", U"asset/Stage/v2/tileset.png", U"collision_layer" },
+		{ U"v3", U"asset/Stage/v3/tilemap_v3.json", U"asset/Stage/v3/tileset.png", U"collision_layer" },
+		{ U"endless", U"", U"asset/Stage/v3/tileset.png", U"collision_layer", true },
+	};
+	return entries;
+}
+
+const Array<StageEntry>& StageCatalog::GetEntries()
+{
+	return Entries();
+}
+
+size_t StageCatalog::AddEntry(const StageEntry& entry)
+{
+	Entries().push_back(entry);
+	return (Entries().size() - 1);
+}
+
+size_t& StageCatalog::SelectedIndex()
+{
+	// 何も指定されなければ最新の v3
+	static size_t selected_index = 2;
+	return selected_index;
+}
+
+size_t StageCatalog::GetSelectedIndex()
+{
+	return SelectedIndex();
+}
+
+const StageEntry& StageCatalog::GetSelected()
+{
+	return GetEntries()[SelectedIndex()];
+}
+
+void StageCatalog::Select(size_t index)
+{
+	if(index < GetEntries().size())
+	{
+		SelectedIndex() = index;
+	}
+}
+
+bool StageCatalog::SelectByName(StringView name)
+{
+	const auto& entries = GetEntries();
+	for(size_t i = 0; i < entries.size(); ++i)
+	{
+		if(entries[i].name == name)
+		{
+			Select(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+void StageCatalog::SelectFromCommandLine(const Array<String>& args)
+{
+	const auto file_it = std::find(args.begin(), args.end(), U"--stage-file");
+	if((file_it != args.end()) && ((file_it + 1) != args.end()))
+	{
+		const FilePath json_path = *(file_it + 1);
+
+		FilePath tileset_path{ kDefaultTilesetPath };
+		const auto tileset_it = std::find(args.begin(), args.end(), U"--stage-tileset");
+		if((tileset_it != args.end()) && ((tileset_it + 1) != args.end()))
+		{
+			tileset_path = *(tileset_it + 1);
+		}
+
+		if(not FileSystem::Exists(json_path))
+		{
+			Console << U"StageCatalog: ステージのファイル '{}' がありません"_fmt(json_path);
+			return;
+		}
+		if(not FileSystem::Exists(tileset_path))
+		{
+			Console << U"StageCatalog: タイルセット '{}' がありません"_fmt(tileset_path);
+			return;
+		}
+
+		Select(AddEntry(StageEntry{ FileSystem::BaseName(json_path), json_path, tileset_path, U"collision_layer" }));
+		return;
+	}
+
+	const auto it = std::find(args.begin(), args.end(), U"--stage");
+	if((it == args.end()) || ((it + 1) == args.end()))
+	{
+		return;
+	}
+
+	if(not SelectByName(*(it + 1)))
+	{
+		Console << U"StageCatalog: ステージ '{}' はありません"_fmt(*(it + 1));
+	}
+}
+
+Stage StageCatalog::CreateStage(const StageEntry& entry)
+{
+	return Stage{ CreateSource(entry), entry.tileset_path };
+}
+
+StageGeneratorConfig StageCatalog::GetEndlessConfig()
+{
+	StageGeneratorConfig config;
+	config.width = 11;
+	config.tile_size = 64;
+	config.wall_density = 0.1;
+	config.enemy_count = 3;
+	config.oxygen_count = 1;
+	return config;
+}
+
+std::unique_ptr<StageSegmentSource> StageCatalog::CreateSource(const StageEntry& entry)
+{
+	if(entry.is_endless)
+	{
+		return std::make_unique<GeneratedSegmentSource>(GetEndlessConfig(), Stage::kDefaultSegmentRows);
+	}
+
+	return std::make_unique<TiledSegmentSource>(Array<FilePath>{ entry.json_path }, entry.collision_layer_name, Stage::kDefaultSegmentRows);
+}
@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include "Stage.h"
+
+#include <Siv3D.hpp>
+
+// 選べるステージ1つ分の情報
+struct StageEntry
+{
+	String name;					// コマンドラインや画面で使う名前（v1 / v2 / v3 / endless．--stage-file ならファイル名）
+	FilePath json_path;
+	FilePath tileset_path;
+	String collision_layer_name;
+	bool is_endless = false;		// StageGenerator で区間ごとに作る終わりのないステージ（json_path は使わない）
+};
+
+// 遊べるステージの一覧と，今選ばれているステージ
+// 選択はシーンを作り直しても残るように，ここで持っておく
+class StageCatalog
+{
+public:
+	static const Array<StageEntry>& GetEntries();
+
+	static size_t GetSelectedIndex();
+	static const StageEntry& GetSelected();
+
+	// 範囲外の番号は無視する
+	static void Select(size_t index);
+
+	// 名前で選ぶ．見つからなければ false
+	static bool SelectByName(StringView name);
+
+	// 一覧の最後に足して，その番号を返す
+	static size_t AddEntry(const StageEntry& entry);
+
+	// --stage <名前> があればそのステージを選ぶ
+	// --stage-file <JSON> [--stage-tileset <PNG>] があれば，そのファイル（StageGenerator の出力など）を一覧に足して選ぶ
+	// タイルセットを省くと kDefaultTilesetPath を使う
+	static void SelectFromCommandLine(const Array<String>& args);
+
+	static constexpr StringView kDefaultTilesetPath = U"asset/Stage/v3/tileset.png";
+
+	// 終わりのないステージの作り方（v3 と同じ幅とタイルで，敵と酸素スポットの数は1区間あたり）
+	static StageGeneratorConfig GetEndlessConfig();
+
+	static Stage CreateStage(const StageEntry& entry);
+
+	// マップのファイルを読むだけの部分（タイルセットのテクスチャを作らないので，どのスレッドから呼んでもよい）
+	static std::unique_ptr<StageSegmentSource> CreateSource(const StageEntry& entry);
+
+private:
+	static Array<StageEntry>& Entries();
+	static size_t& SelectedIndex();
+};
@@ -0,0 +1,74 @@
+﻿#include "StageHotReloader.h"
+
+#include <Siv3D.hpp>
+
+void StageHotReloader::Watch(const Array<FilePath>& paths)
+{
+	watchers_.clear();
+	watched_paths_.clear();
+	pending_files_.clear();
+
+	Array<FilePath> directories;
+	for(const auto& path : paths)
+	{
+		const FilePath full_path = FileSystem::FullPath(path);
+		watched_paths_ << full_path;
+
+		const FilePath directory = FileSystem::ParentPath(full_path);
+		if(not directories.contains(directory))
+		{
+			directories << directory;
+		}
+	}
+
+	for(const auto& directory : directories)
+	{
+		watchers_.emplace_back(directory);
+	}
+}
+
+Array<FilePath> StageHotReloader::PollChangedFiles()
+{
+	for(const auto& watcher : watchers_)
+	{
+		for(const auto& change : watcher.retrieveChanges())
+		{
+			// 一時ファイルに書いてから置き換えるエディタもあるので，移動してきた場合も拾う
+			if((change.action != FileAction::Added)
+				&& (change.action != FileAction::Modified)
+				&& (change.action != FileAction::MovedTo))
+			{
+				continue;
+			}
+
+			const FilePath full_path = FileSystem::FullPath(change.path);
+			if(not watched_paths_.contains(full_path))
+			{
+				continue;
+			}
+
+			auto it = std::find_if(pending_files_.begin(), pending_files_.end(), [&](const PendingFile& pending) { return (pending.path == full_path); });
+			if(it == pending_files_.end())
+			{
+				pending_files_.push_back(PendingFile{ full_path, Stopwatch{ StartImmediately::Yes } });
+			}
+			else
+			{
+				it->since_last_change.restart();
+			}
+		}
+	}
+
+	Array<FilePath> settled_paths;
+	pending_files_.remove_if([&](const PendingFile& pending)
+		{
+			if(pending.since_last_change.sF() < kSettleTime)
+			{
+				return false;
+			}
+			settled_paths << pending.path;
+			return true;
+		});
+
+	return settled_paths;
+}
@@ -0,0 +1,33 @@
+﻿#pragma once
+
+#include <Siv3D.hpp>
+
+// ステージのファイルを監視して，書き換えられたものを知らせる
+// エディタは1回の保存で何度かに分けて書き込むことがあるので，変更が落ち着いてから知らせる
+class StageHotReloader
+{
+public:
+	// paths を監視する（前に監視していたものはやめる）
+	void Watch(const Array<FilePath>& paths);
+
+	// 書き換えが落ち着いたファイルを返す（毎フレーム呼ぶ）
+	Array<FilePath> PollChangedFiles();
+
+private:
+	struct PendingFile
+	{
+		FilePath path;
+		Stopwatch since_last_change;
+	};
+
+	// 監視しているファイルを含むディレクトリごとに1つ
+	Array<DirectoryWatcher> watchers_;
+
+	// 監視しているファイル（フルパス）
+	Array<FilePath> watched_paths_;
+
+	Array<PendingFile> pending_files_;
+
+	// 最後の変更からこれだけ経ったら読み直す
+	static constexpr double kSettleTime = 0.15;
+};
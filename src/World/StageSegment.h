@@ -0,0 +1,98 @@
+﻿#pragma once
+
+#include "SpawnInfo.h"
+
+#include <Siv3D.hpp>
+
+struct TileMapLayer
+{
+	String name;
+	Grid<int32> tiles;
+};
+
+// ステージを縦に一定の行数で区切った1区間分のデータ
+// Stage は画面の近くの区間だけを持ち，通り過ぎた区間は捨てる（読み込み先として使い回す）
+struct StageSegment
+{
+	// 上から何番目の区間か
+	int32 index = -1;
+
+	// 区間の先頭行（ステージ全体での行番号）
+	int32 top_row = 0;
+
+	// 見た目用のタイルレイヤー（区間の行数ぶん．当たり判定レイヤーは含まない）
+	Array<TileMapLayer> view_layers;
+
+	// 幅（タイル数）
+	int32 width = 0;
+
+	// 当たり判定のビットマップ（1行あたり words_per_row 個の uint64，ビットが立っていれば壁）
+	Array<uint64> collision_bits;
+	int32 words_per_row = 0;
+
+	// 各タイルを含む空きタイルの並びの左端と右端（壁のタイルでは -1）
+	// 巡回する敵が壁まで何マスあるかを毎フレーム調べずに済むように，読み込み時に作っておく
+	Array<int16> run_first_x;
+	Array<int16> run_last_x;
+
+	// この区間の中にあるスポーン位置（ワールド座標）
+	Array<SpawnInfo> spawns;
+
+	// 幅 segment_width，rows 行の空の区間にする（確保済みのメモリはできるだけ使い回す）
+	void Reset(int32 segment_index, int32 segment_top_row, int32 segment_width, int32 rows)
+	{
+		index = segment_index;
+		top_row = segment_top_row;
+		width = segment_width;
+		words_per_row = ((width + 63) / 64);
+		collision_bits.assign(static_cast<size_t>(words_per_row) * rows, 0);
+		run_first_x.assign(static_cast<size_t>(width) * rows, -1);
+		run_last_x.assign(static_cast<size_t>(width) * rows, -1);
+		for(auto& layer : view_layers)
+		{
+			layer.tiles.assign(width, rows, 0);
+		}
+		spawns.clear();
+	}
+
+	// local_row は区間の先頭からの行番号
+	bool IsSolidAt(int32 x, int32 local_row) const
+	{
+		const uint64 word = collision_bits[(static_cast<size_t>(local_row) * words_per_row) + (x / 64)];
+		return ((word >> (x % 64)) & 1) != 0;
+	}
+
+	void SetSolid(int32 x, int32 local_row)
+	{
+		collision_bits[(static_cast<size_t>(local_row) * words_per_row) + (x / 64)] |= (uint64{ 1 } << (x % 64));
+	}
+
+	// 当たり判定を書き換えた行の空きタイルの並びを作り直す
+	void RebuildOpenRuns(int32 local_row)
+	{
+		const size_t base = (static_cast<size_t>(local_row) * width);
+		int32 x = 0;
+		while(x < width)
+		{
+			if(IsSolidAt(x, local_row))
+			{
+				run_first_x[base + x] = -1;
+				run_last_x[base + x] = -1;
+				++x;
+				continue;
+			}
+
+			int32 last = x;
+			while(((last + 1) < width) && (not IsSolidAt((last + 1), local_row)))
+			{
+				++last;
+			}
+			for(int32 i = x; i <= last; ++i)
+			{
+				run_first_x[base + i] = static_cast<int16>(x);
+				run_last_x[base + i] = static_cast<int16>(last);
+			}
+			x = (last + 1);
+		}
+	}
+};
@@ -0,0 +1,398 @@
+﻿#include "StageSegmentSource.h"
+#include "TileLayerCodec.h"
+
+#include <Siv3D.hpp>
+
+namespace
+{
+	// 区間の見た目用レイヤーを names と同じ並びにそろえる
+	void PrepareViewLayers(StageSegment& segment, const Array<String>& names)
+	{
+		segment.view_layers.resize(names.size());
+		for(size_t i = 0; i < names.size(); ++i)
+		{
+			segment.view_layers[i].name = names[i];
+		}
+	}
+}
+
+TiledSegmentSource::TiledSegmentSource(const Array<FilePath>& json_paths, const String& collision_layer_name, int32 segment_rows)
+	: collision_layer_name_(collision_layer_name)
+	, segment_rows_(Max(segment_rows, 1))
+{
+	if(json_paths.isEmpty())
+	{
+		throw Error{ U"TiledSegmentSource: マップが1つも指定されていません．" };
+	}
+
+	for(size_t file_index = 0; file_index < json_paths.size(); ++file_index)
+	{
+		const FilePath& path = json_paths[file_index];
+		const JSON json = JSON::Load(path);
+		if(not json)
+		{
+			throw Error{ U"TiledSegmentSource: JSONファイルの読み込みに失敗しました → {}"_fmt(path) };
+		}
+
+		const int32 width = json[U"width"].get<int32>();
+		const int32 tile_size = json[U"tilewidth"].get<int32>();
+		if(file_index == 0)
+		{
+			map_width_ = width;
+			tile_size_ = tile_size;
+		}
+		else if((width != map_width_) || (tile_size != tile_size_))
+		{
+			throw Error{ U"TiledSegmentSource: 幅かタイルサイズが最初のマップと違います → {}"_fmt(path) };
+		}
+
+		MapFile file;
+		file.path = path;
+		file.top_row = total_rows_;
+		file.rows = json[U"height"].get<int32>();
+
+		if(not ScanFile(json, file, view_layer_names_))
+		{
+			throw Error{ U"TiledSegmentSource: 当たり判定レイヤー '{}' が見つかりませんでした → {}"_fmt(collision_layer_name_, path) };
+		}
+
+		total_rows_ += file.rows;
+		files_ << file;
+
+		// 最初の区間はすぐに読むので，先頭のファイルは取っておく
+		if(file_index == 0)
+		{
+			CacheFile(0, json);
+		}
+	}
+}
+
+bool TiledSegmentSource::ScanFile(const JSON& json, MapFile& file, Array<String>& view_layer_names) const
+{
+	file.oxygen_spot_positions.clear();
+
+	bool has_collision_layer = false;
+	for(const auto& layer : json[U"layers"].arrayView())
+	{
+		const String type = layer[U"type"].getString();
+		const String name = layer[U"name"].getString();
+
+		if(type == U"tilelayer")
+		{
+			if(name == collision_layer_name_)
+			{
+				has_collision_layer = true;
+			}
+			else if(not view_layer_names.contains(name))
+			{
+				view_layer_names << name;
+			}
+		}
+		else if((type == U"objectgroup") && (name == U"spawn_layer"))
+		{
+			// HUD のマーカー用に酸素スポットの位置だけは最初に集めておく
+			for(const auto& object : layer[U"objects"].arrayView())
+			{
+				if(object[U"type"].getString() != U"Oxygen") continue;
+
+				const Vec2 pos{ object[U"x"].get<double>(), object[U"y"].get<double>() + (file.top_row * tile_size_) };
+				const Vec2 size{ object[U"width"].get<double>(), object[U"height"].get<double>() };
+				file.oxygen_spot_positions << (pos + (size / 2.0));
+			}
+		}
+	}
+	return has_collision_layer;
+}
+
+Array<Vec2> TiledSegmentSource::GetOxygenSpotPositions() const
+{
+	Array<Vec2> positions;
+	for(const auto& file : files_)
+	{
+		positions.append(file.oxygen_spot_positions);
+	}
+	return positions;
+}
+
+Array<FilePath> TiledSegmentSource::GetSourceFiles() const
+{
+	Array<FilePath> paths;
+	for(const auto& file : files_)
+	{
+		paths << file.path;
+	}
+	return paths;
+}
+
+StageReloadResult TiledSegmentSource::ReloadFile(const FilePath& path)
+{
+	const FilePath full_path = FileSystem::FullPath(path);
+
+	for(size_t file_index = 0; file_index < files_.size(); ++file_index)
+	{
+		if(FileSystem::FullPath(files_[file_index].path) != full_path) continue;
+
+		const JSON json = JSON::Load(files_[file_index].path);
+		if(not json)
+		{
+			return StageReloadResult::Failed;
+		}
+
+		// 行数や幅が変わると後ろのファイルの位置までずれるので，作り直してもらう
+		if((json[U"width"].get<int32>() != map_width_)
+			|| (json[U"tilewidth"].get<int32>() != tile_size_)
+			|| (json[U"height"].get<int32>() != files_[file_index].rows))
+		{
+			return StageReloadResult::Restructured;
+		}
+
+		MapFile file = files_[file_index];
+		Array<String> view_layer_names = view_layer_names_;
+		if(not ScanFile(json, file, view_layer_names))
+		{
+			return StageReloadResult::Failed;
+		}
+		if(view_layer_names.size() != view_layer_names_.size())
+		{
+			return StageReloadResult::Restructured;
+		}
+
+		// 展開できなければ前の内容のままにする
+		Array<DecodedLayer> layers;
+		String error;
+		if(not DecodeLayers(json, file.rows, layers, error))
+		{
+			Console << U"TiledSegmentSource: {} → {}"_fmt(error, path);
+			return StageReloadResult::Failed;
+		}
+
+		files_[file_index] = std::move(file);
+		cached_file_index_ = file_index;
+		cached_json_ = json;
+		cached_layers_ = std::move(layers);
+		return StageReloadResult::Updated;
+	}
+
+	return StageReloadResult::NotWatched;
+}
+
+void TiledSegmentSource::LoadFile(size_t file_index)
+{
+	if(cached_file_index_ == file_index)
+	{
+		return;
+	}
+
+	const JSON json = JSON::Load(files_[file_index].path);
+	if(not json)
+	{
+		throw Error{ U"TiledSegmentSource: JSONファイルの読み込みに失敗しました → {}"_fmt(files_[file_index].path) };
+	}
+	CacheFile(file_index, json);
+}
+
+void TiledSegmentSource::CacheFile(size_t file_index, const JSON& json)
+{
+	// 前のファイルの分のメモリを使い回す
+	String error;
+	if(not DecodeLayers(json, files_[file_index].rows, cached_layers_, error))
+	{
+		cached_file_index_.reset();
+		throw Error{ U"TiledSegmentSource: {} → {}"_fmt(error, files_[file_index].path) };
+	}
+
+	cached_file_index_ = file_index;
+	cached_json_ = json;
+}
+
+bool TiledSegmentSource::DecodeLayers(const JSON& json, int32 rows, Array<DecodedLayer>& out, String& error) const
+{
+	const size_t tile_count = (static_cast<size_t>(map_width_) * rows);
+
+	size_t layer_count = 0;
+	for(const auto& layer : json[U"layers"].arrayView())
+	{
+		if(layer[U"type"].getString() != U"tilelayer") continue;
+
+		if(out.size() <= layer_count)
+		{
+			out.emplace_back();
+		}
+		DecodedLayer& decoded = out[layer_count++];
+
+		const String name = layer[U"name"].getString();
+		decoded.is_collision = (name == collision_layer_name_);
+		decoded.view_layer_index = static_cast<size_t>(std::distance(view_layer_names_.begin(), std::find(view_layer_names_.begin(), view_layer_names_.end(), name)));
+
+		if(not TileLayerCodec::Decode(layer, tile_count, decoded.tiles, error))
+		{
+			error = U"タイルレイヤー '{}' を読めません．{}"_fmt(name, error);
+			return false;
+		}
+	}
+
+	out.resize(layer_count);
+	return true;
+}
+
+void TiledSegmentSource::LoadSegment(int32 segment_index, StageSegment& out)
+{
+	const int32 top_row = (segment_index * segment_rows_);
+	const int32 end_row = (top_row + segment_rows_);
+
+	PrepareViewLayers(out, view_layer_names_);
+	out.Reset(segment_index, top_row, map_width_, segment_rows_);
+
+	// 区間が2つのファイルにまたがることもある
+	for(size_t file_index = 0; file_index < files_.size(); ++file_index)
+	{
+		const MapFile& file = files_[file_index];
+		const int32 first = Max(top_row, file.top_row);
+		const int32 last = Min(end_row, (file.top_row + file.rows));
+		if(first >= last) continue;
+
+		LoadFile(file_index);
+		CopyFileRows(file, first, last, out);
+	}
+}
+
+void TiledSegmentSource::CopyFileRows(const MapFile& file, int32 first_row, int32 end_row, StageSegment& out) const
+{
+	for(const auto& layer : cached_layers_)
+	{
+		for(int32 row = first_row; row < end_row; ++row)
+		{
+			const int32* src = &layer.tiles[static_cast<size_t>(row - file.top_row) * map_width_];
+			const int32 local_row = (row - out.top_row);
+
+			if(layer.is_collision)
+			{
+				for(int32 x = 0; x < map_width_; ++x)
+				{
+					if(src[x] > 0)
+					{
+						out.SetSolid(x, local_row);
+					}
+				}
+			}
+			else
+			{
+				std::copy_n(src, map_width_, out.view_layers[layer.view_layer_index].tiles[local_row]);
+			}
+		}
+	}
+
+	for(const auto& layer : cached_json_[U"layers"].arrayView())
+	{
+		const String type = layer[U"type"].getString();
+		const String name = layer[U"name"].getString();
+
+		if((type == U"objectgroup") && (name == U"spawn_layer"))
+		{
+			for(const auto& object : layer[U"objects"].arrayView())
+			{
+				SpawnInfo info;
+				info.type = object[U"type"].getString();
+				info.pos = { object[U"x"].get<double>(), object[U"y"].get<double>() + (file.top_row * tile_size_) };
+				info.size = { object[U"width"].get<double>(), object[U"height"].get<double>() };
+
+				// 中心がこの区間に入っているものだけを持たせる
+				const int32 row = static_cast<int32>(Math::Floor((info.pos.y + (info.size.y / 2.0)) / tile_size_));
+				if((first_row <= row) && (row < end_row))
+				{
+					out.spawns << info;
+				}
+			}
+		}
+	}
+}
+
+GeneratedSegmentSource::GeneratedSegmentSource(const StageGeneratorConfig& config, int32 segment_rows)
+	: config_(config)
+	, segment_rows_(Max(segment_rows, config.clear_top_rows + 2))
+{
+	// StageGenerator と同じく，左右の壁の間に1マスは空ける
+	config_.width = Max(config_.width, 3);
+}
+
+void GeneratedSegmentSource::LoadSegment(int32 segment_index, StageSegment& out)
+{
+	// 区間ごとに独立した乱数列にする（読み直しても同じ区間になる）
+	StageGeneratorConfig config = config_;
+	config.height = segment_rows_;
+	config.seed = (config_.seed ^ (static_cast<uint64>(segment_index) * 0x9E3779B97F4A7C15ull));
+
+	const bool is_first = (segment_index == 0);
+	config.clear_top_rows = (is_first ? config_.clear_top_rows : 0);
+	config.place_player = is_first;
+	config.close_bottom = false;
+
+	StageGenerator generator{ config };
+	generator.Build();
+
+	const int32 top_row = (segment_index * segment_rows_);
+	static const Array<String> kViewLayerNames = { U"view_layer" };
+	PrepareViewLayers(out, kViewLayerNames);
+	out.Reset(segment_index, top_row, config_.width, segment_rows_);
+
+	const Grid<bool>& walls = generator.GetWalls();
+	for(int32 y = 0; y < segment_rows_; ++y)
+	{
+		for(int32 x = 0; x < config_.width; ++x)
+		{
+			if(walls[y][x])
+			{
+				out.view_layers[0].tiles[y][x] = StageGenerator::kViewWallTileId;
+				out.SetSolid(x, y);
+			}
+		}
+	}
+
+	const double offset_y = (top_row * config_.tile_size);
+	for(const auto& spawn : generator.GetSpawns())
+	{
+		out.spawns << SpawnInfo{ spawn.type, spawn.pos.movedBy(0, offset_y), spawn.size };
+	}
+}
+
+std::shared_ptr<const SharedSegmentSource::Data> SharedSegmentSource::Build(StageSegmentSource& source, bool drop_view_layers)
+{
+	const Optional<int32> total_rows = source.GetTotalRows();
+	if(not total_rows)
+	{
+		return nullptr;
+	}
+
+	auto data = std::make_shared<Data>();
+	data->width = source.GetWidth();
+	data->tile_size = source.GetTileSize();
+	data->segment_rows = source.GetSegmentRows();
+	data->total_rows = *total_rows;
+	data->oxygen_spot_positions = source.GetOxygenSpotPositions();
+
+	const int32 segment_count = ((*total_rows + data->segment_rows - 1) / data->segment_rows);
+	data->segments.resize(segment_count);
+	for(int32 i = 0; i < segment_count; ++i)
+	{
+		StageSegment& segment = data->segments[i];
+		source.LoadSegment(i, segment);
+		if(drop_view_layers)
+		{
+			segment.view_layers.clear();
+			segment.view_layers.shrink_to_fit();
+		}
+	}
+
+	return data;
+}
+
+SharedSegmentSource::SharedSegmentSource(std::shared_ptr<const Data> data)
+	: data_(std::move(data))
+{
+}
+
+void SharedSegmentSource::LoadSegment(int32 segment_index, StageSegment& out)
+{
+	// 確保済みのメモリを使い回してコピーする
+	out = data_->segments[segment_index];
+}
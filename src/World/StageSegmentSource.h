@@ -0,0 +1,162 @@
+﻿#pragma once
+
+#include "../Tools/StageGenerator.h"
+#include "StageSegment.h"
+
+#include <Siv3D.hpp>
+
+// ファイルを読み直した結果
+enum class StageReloadResult
+{
+	NotWatched,		// このステージのファイルではない
+	Failed,			// 読み込めなかった（保存の途中など）．前の内容のまま
+	Updated,		// タイルやスポーンだけが変わった（持っている区間と差分を取れる）
+	Restructured	// 大きさやレイヤーの構成が変わった（ステージを作り直す必要がある）
+};
+
+// Stage に区間のデータを渡す側
+// 区間の高さ（行数）はどの区間でも同じで，区間 i はステージ全体の i * GetSegmentRows() 行目から始まる
+class StageSegmentSource
+{
+public:
+	virtual ~StageSegmentSource() = default;
+
+	virtual int32 GetWidth() const = 0;
+	virtual int32 GetTileSize() const = 0;
+	virtual int32 GetSegmentRows() const = 0;
+
+	// ステージ全体の行数（終わりのないステージなら none）
+	virtual Optional<int32> GetTotalRows() const = 0;
+
+	// 区間 segment_index を out に読み込む（out のメモリは使い回してよい）
+	virtual void LoadSegment(int32 segment_index, StageSegment& out) = 0;
+
+	// ステージ全体の酸素スポットの位置（HUD のマーカー用．事前に分からなければ空）
+	virtual Array<Vec2> GetOxygenSpotPositions() const { return {}; }
+
+	// 読み込み元のファイル（書き換えを監視する対象）
+	virtual Array<FilePath> GetSourceFiles() const { return {}; }
+
+	// 書き換えられたファイルを読み直す．以後の LoadSegment() は新しい内容を返す
+	virtual StageReloadResult ReloadFile(const FilePath&) { return StageReloadResult::NotWatched; }
+};
+
+// Tiled で作った複数の JSON を縦につなげて1本のステージとして扱う
+// 最初に全ファイルの高さとスポットの位置だけを調べ，タイルは区間を読み込むときに必要なファイルから取り出す
+// タイルレイヤーは配列のほか，base64（圧縮なし / zlib / zstd）でもよい（TileLayerCodec）
+class TiledSegmentSource : public StageSegmentSource
+{
+public:
+	TiledSegmentSource(const Array<FilePath>& json_paths, const String& collision_layer_name, int32 segment_rows);
+
+	int32 GetWidth() const override { return map_width_; }
+	int32 GetTileSize() const override { return tile_size_; }
+	int32 GetSegmentRows() const override { return segment_rows_; }
+	Optional<int32> GetTotalRows() const override { return total_rows_; }
+
+	void LoadSegment(int32 segment_index, StageSegment& out) override;
+
+	Array<Vec2> GetOxygenSpotPositions() const override;
+
+	Array<FilePath> GetSourceFiles() const override;
+	StageReloadResult ReloadFile(const FilePath& path) override;
+
+private:
+	struct MapFile
+	{
+		FilePath path;
+		int32 top_row = 0;	// つなげたステージでの先頭行
+		int32 rows = 0;
+		Array<Vec2> oxygen_spot_positions;
+	};
+
+	// レイヤーの名前と酸素スポットの位置を調べる．当たり判定レイヤーが無ければ false
+	bool ScanFile(const JSON& json, MapFile& file, Array<String>& view_layer_names) const;
+
+	// タイルレイヤーを展開したもの
+	struct DecodedLayer
+	{
+		bool is_collision = false;
+		size_t view_layer_index = 0;
+		Array<int32> tiles;		// ファイルの全行ぶん（幅 map_width_）
+	};
+
+	// 指定したファイルを読み，直前に読んだものとして取っておく（JSON と展開したタイルレイヤー）
+	void LoadFile(size_t file_index);
+	void CacheFile(size_t file_index, const JSON& json);
+
+	// json のタイルレイヤーを全て展開する．読めなければ false（error に理由を入れる）
+	bool DecodeLayers(const JSON& json, int32 rows, Array<DecodedLayer>& out, String& error) const;
+
+	// ファイルの rows 行を out の区間にコピーする
+	void CopyFileRows(const MapFile& file, int32 first_row, int32 end_row, StageSegment& out) const;
+
+	Array<MapFile> files_;
+	String collision_layer_name_;
+	Array<String> view_layer_names_;
+
+	int32 map_width_ = 0;
+	int32 tile_size_ = 16;
+	int32 segment_rows_ = 16;
+	int32 total_rows_ = 0;
+
+	// 直前に読んだファイル（区間を続けて読むときに同じファイルを何度も開かない）
+	// タイルは読んだときに1回だけ展開しておき，区間には行ごとに写すだけにする
+	Optional<size_t> cached_file_index_;
+	JSON cached_json_;
+	Array<DecodedLayer> cached_layers_;
+};
+
+// StageGenerator で区間ごとに作る，終わりのないステージ（StageCatalog の endless）
+// 区間 i の中身はシード値と i だけで決まるので，捨てた区間をもう一度読み込んでも同じものになる
+class GeneratedSegmentSource : public StageSegmentSource
+{
+public:
+	GeneratedSegmentSource(const StageGeneratorConfig& config, int32 segment_rows);
+
+	int32 GetWidth() const override { return config_.width; }
+	int32 GetTileSize() const override { return config_.tile_size; }
+	int32 GetSegmentRows() const override { return segment_rows_; }
+	Optional<int32> GetTotalRows() const override { return none; }
+
+	void LoadSegment(int32 segment_index, StageSegment& out) override;
+
+private:
+	// StageGeneratorConfig の enemy_count / oxygen_count は1区間あたりの数として使う
+	StageGeneratorConfig config_;
+	int32 segment_rows_ = 16;
+};
+
+// 有限のステージの全区間を最初に1回だけ読み込み，いくつもの Stage で読み取り専用のまま共有する（BatchRunner）
+// LoadSegment() は共有している区間をコピーするだけなので，どのスレッドから呼んでもよい
+class SharedSegmentSource : public StageSegmentSource
+{
+public:
+	struct Data
+	{
+		int32 width = 0;
+		int32 tile_size = 16;
+		int32 segment_rows = 16;
+		int32 total_rows = 0;
+		Array<StageSegment> segments;
+		Array<Vec2> oxygen_spot_positions;
+	};
+
+	// source の全区間を読み込む．終わりのないステージなら nullptr を返す
+	// drop_view_layers なら見た目用のタイルレイヤーを捨てる（描画しない Stage だけで使うとき）
+	static std::shared_ptr<const Data> Build(StageSegmentSource& source, bool drop_view_layers);
+
+	explicit SharedSegmentSource(std::shared_ptr<const Data> data);
+
+	int32 GetWidth() const override { return data_->width; }
+	int32 GetTileSize() const override { return data_->tile_size; }
+	int32 GetSegmentRows() const override { return data_->segment_rows; }
+	Optional<int32> GetTotalRows() const override { return data_->total_rows; }
+
+	void LoadSegment(int32 segment_index, StageSegment& out) override;
+
+	Array<Vec2> GetOxygenSpotPositions() const override { return data_->oxygen_spot_positions; }
+
+private:
+	std::shared_ptr<const Data> data_;
+};
@@ -0,0 +1,130 @@
+﻿#include "TileLayerCodec.h"
+
+#include <Siv3D.hpp>
+
+namespace
+{
+	bool DecodeArray(const JSON& data, size_t tile_count, Array<int32>& out, String& error)
+	{
+		if(data.size() != tile_count)
+		{
+			error = U"タイルの数が合いません（{} / {}）"_fmt(data.size(), tile_count);
+			return false;
+		}
+
+		size_t i = 0;
+		for(const auto& value : data.arrayView())
+		{
+			const uint32 gid = static_cast<uint32>(value.get<int64>());
+			out[i++] = static_cast<int32>(gid & ~TileLayerCodec::kFlipFlagsMask);
+		}
+		return true;
+	}
+
+	bool DecodeBase64(const JSON& data, StringView compression, size_t tile_count, Array<int32>& out, String& error)
+	{
+		Blob bytes = Base64::Decode(data.getString());
+
+		if(compression == U"zlib")
+		{
+			bytes = Zlib::Decompress(bytes);
+		}
+		else if(compression == U"zstd")
+		{
+			bytes = Compression::Decompress(bytes);
+		}
+		else if(not compression.isEmpty())
+		{
+			// gzip は zlib と同じ中身だがヘッダーが違い，Siv3D の Zlib では展開できない
+			error = U"対応していない圧縮形式です（{}）．Tiled で zlib か zstd を選んでください"_fmt(compression);
+			return false;
+		}
+
+		if(bytes.size() != (tile_count * sizeof(uint32)))
+		{
+			error = U"展開したデータの大きさが合いません（{} / {} バイト）"_fmt(bytes.size(), (tile_count * sizeof(uint32)));
+			return false;
+		}
+
+		// 展開したバイト列をそのままタイル番号にする（エンディアンを問わないようにバイトから組み立てる）
+		const uint8* src = bytes.data();
+		for(size_t i = 0; i < tile_count; ++i, src += 4)
+		{
+			const uint32 gid = (static_cast<uint32>(src[0])
+				| (static_cast<uint32>(src[1]) << 8)
+				| (static_cast<uint32>(src[2]) << 16)
+				| (static_cast<uint32>(src[3]) << 24));
+			out[i] = static_cast<int32>(gid & ~TileLayerCodec::kFlipFlagsMask);
+		}
+		return true;
+	}
+}
+
+bool TileLayerCodec::Decode(const JSON& layer, size_t tile_count, Array<int32>& out, String& error)
+{
+	out.resize(tile_count);
+
+	const JSON data = layer[U"data"];
+	const String encoding = (layer.hasElement(U"encoding") ? layer[U"encoding"].getString() : String{ U"csv" });
+
+	if(encoding == U"csv")
+	{
+		if(not data.isArray())
+		{
+			error = U"data が配列ではありません";
+			return false;
+		}
+		return DecodeArray(data, tile_count, out, error);
+	}
+
+	if(encoding == U"base64")
+	{
+		if(not data.isString())
+		{
+			error = U"data が文字列ではありません";
+			return false;
+		}
+		const String compression = (layer.hasElement(U"compression") ? layer[U"compression"].getString() : String{});
+		return DecodeBase64(data, compression, tile_count, out, error);
+	}
+
+	error = U"対応していないエンコードです（{}）"_fmt(encoding);
+	return false;
+}
+
+String TileLayerCodec::EncodeBase64(const Array<int32>& tiles, TileLayerCompression compression)
+{
+	Array<uint8> bytes(tiles.size() * sizeof(uint32));
+	for(size_t i = 0; i < tiles.size(); ++i)
+	{
+		const uint32 gid = static_cast<uint32>(tiles[i]);
+		bytes[(i * 4) + 0] = static_cast<uint8>(gid);
+		bytes[(i * 4) + 1] = static_cast<uint8>(gid >> 8);
+		bytes[(i * 4) + 2] = static_cast<uint8>(gid >> 16);
+		bytes[(i * 4) + 3] = static_cast<uint8>(gid >> 24);
+	}
+
+	const Blob raw{ bytes.data(), bytes.size() };
+	switch(compression)
+	{
+	case TileLayerCompression::Zlib:
+		return Base64::Encode(Zlib::Compress(raw));
+	case TileLayerCompression::Zstd:
+		return Base64::Encode(Compression::Compress(raw));
+	default:
+		return Base64::Encode(raw);
+	}
+}
+
+StringView TileLayerCodec::GetCompressionName(TileLayerCompression compression)
+{
+	switch(compression)
+	{
+	case TileLayerCompression::Zlib:
+		return U"zlib";
+	case TileLayerCompression::Zstd:
+		return U"zstd";
+	default:
+		return U"";
+	}
+}
@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include <Siv3D.hpp>
+
+// Tiled のタイルレイヤーの data の圧縮形式
+enum class TileLayerCompression
+{
+	None,	// JSON の数値の配列（Tiled の "CSV"）
+	Zlib,	// base64 + zlib
+	Zstd,	// base64 + Zstandard
+};
+
+// Tiled のタイルレイヤーの data を読み書きする
+// base64 の形式は，リトルエンディアンの uint32 の GID を左上から並べたものを圧縮し，base64 にしたもの
+namespace TileLayerCodec
+{
+	// GID の上位ビットにある反転・回転のフラグ（このゲームでは使わないので読むときに落とす）
+	inline constexpr uint32 kFlipFlagsMask = 0xE0000000u;
+
+	// layer（Tiled のタイルレイヤーのオブジェクト）の data を tile_count 個のタイル番号にして out に書く
+	// 形式は layer の "encoding" と "compression" で判断する．配列でも base64 でも1回たどるだけで out を埋める
+	// 読めない形式や，数が合わないときは false（error に理由を入れる）
+	bool Decode(const JSON& layer, size_t tile_count, Array<int32>& out, String& error);
+
+	// タイル番号を base64 にする（"encoding":"base64" と一緒に書き出す文字列）
+	String EncodeBase64(const Array<int32>& tiles, TileLayerCompression compression);
+
+	// "compression" に書く名前（None は空）
+	StringView GetCompressionName(TileLayerCompression compression);
+}
@@ -0,0 +1,216 @@
+﻿#include "TileSweep.h"
+
+#include <Siv3D.hpp>
+#include <limits>
+
+namespace
+{
+	// 座標がちょうど境界に載っているときの誤差の許容量[px]
+	// 固定小数点は計算に誤差がないので使わない
+	template <class Scalar>
+	constexpr Scalar kEpsilon = Scalar(1e-6);
+	template <>
+	constexpr Fixed kEpsilon<Fixed> = Fixed{};
+
+	// 境界を越えない軸の「次の時刻」
+	template <class Scalar>
+	constexpr Scalar kNever = Scalar(Math::Inf);
+	template <>
+	constexpr Fixed kNever<Fixed> = Fixed::FromRaw(std::numeric_limits<int32>::max());
+
+	// 境界までの距離を移動量で割って時刻にする
+	// 固定小数点では，移動量が小さいと商が Fixed に収まらない（64px を 1/4096px で割ると 2^18 で，タイルが 128px 以上なら溢れる）
+	// 1 を超える時刻はどれも「この移動では越えない」と同じなので，int64 で割って kNever に飽和させる
+	template <class Scalar>
+	Scalar DivideTime(Scalar distance, Scalar delta)
+	{
+		return (distance / delta);
+	}
+	template <>
+	Fixed DivideTime<Fixed>(Fixed distance, Fixed delta)
+	{
+		const int64 raw = ((static_cast<int64>(distance.raw) * Fixed::kOne) / delta.raw);
+		return Fixed::FromRaw(static_cast<int32>(Clamp<int64>(raw, std::numeric_limits<int32>::min(), kNever<Fixed>.raw)));
+	}
+
+	// 次の境界の時刻を進める（固定小数点では kNever に飽和させる）
+	template <class Scalar>
+	Scalar AddTime(Scalar time, Scalar duration)
+	{
+		return (time + duration);
+	}
+	template <>
+	Fixed AddTime<Fixed>(Fixed time, Fixed duration)
+	{
+		return Fixed::FromRaw(static_cast<int32>(Min<int64>((static_cast<int64>(time.raw) + duration.raw), kNever<Fixed>.raw)));
+	}
+
+	template <class Scalar>
+	int32 CeilToTile(Scalar value, int32 tile_size)
+	{
+		return -Physics::ToTile(-value, tile_size);
+	}
+
+	// 1軸ぶんの境界の追跡（DDA）
+	template <class Scalar>
+	struct AxisWalker
+	{
+		int32 step = 0;								// 進む向き（-1, 0, 1）
+		int32 next_cell = 0;						// 次に入る列（行）
+		Scalar next_time = kNever<Scalar>;			// 次の境界を越える時刻
+		Scalar time_per_cell = kNever<Scalar>;		// 1マス進むのにかかる時刻
+
+		// lead_min / lead_max は移動方向と垂直な辺の座標（箱の左右または上下）
+		AxisWalker(Scalar lead_min, Scalar lead_max, Scalar delta, int32 tile_size)
+		{
+			const Scalar zero{};
+			if(delta > zero)
+			{
+				// 右（下）へ動くときは右（下）の辺が次の境界を越える
+				step = 1;
+				next_cell = CeilToTile((lead_max - kEpsilon<Scalar>), tile_size);
+				next_time = DivideTime((Scalar(next_cell * tile_size) - lead_max), delta);
+				time_per_cell = DivideTime(Scalar(tile_size), delta);
+			}
+			else if(delta < zero)
+			{
+				step = -1;
+				const int32 boundary = Physics::ToTile((lead_min + kEpsilon<Scalar>), tile_size);
+				next_cell = (boundary - 1);
+				next_time = DivideTime((Scalar(boundary * tile_size) - lead_min), delta);
+				time_per_cell = DivideTime(Scalar(tile_size), -delta);
+			}
+
+			// 境界の上にいるときの誤差で負にならないようにする
+			next_time = Max(next_time, zero);
+		}
+
+		void Advance()
+		{
+			next_cell += step;
+			next_time = AddTime(next_time, time_per_cell);
+		}
+	};
+
+	// [min, max) に掛かるタイルの範囲
+	template <class Scalar>
+	void ToCellRange(Scalar min, Scalar max, int32 tile_size, int32& out_first, int32& out_last)
+	{
+		out_first = Physics::ToTile((min + kEpsilon<Scalar>), tile_size);
+		out_last = CeilToTile((max - kEpsilon<Scalar>), tile_size) - 1;
+	}
+
+	// walker の軸が time に境界を越えるか（境界までの残りが誤差の許容量以内なら越えるとみなす）
+	template <class Scalar>
+	bool IsCrossingAt(const AxisWalker<Scalar>& walker, Scalar delta, Scalar time)
+	{
+		return ((walker.step != 0) && (((walker.next_time - time) * Abs(delta)) <= kEpsilon<Scalar>));
+	}
+
+	template <class Scalar>
+	TileSweep::BasicHit<Scalar> MakeHit(Scalar time, const Point& normal)
+	{
+		TileSweep::BasicHit<Scalar> hit;
+		hit.is_hit = true;
+		hit.time = time;
+		hit.normal = normal;
+		return hit;
+	}
+
+	template <class Scalar>
+	TileSweep::BasicHit<Scalar> SweepBoxImpl(
+const Stage& stage, Scalar left, Scalar top, Scalar right, Scalar bottom, Scalar delta_x, Scalar delta_y)
+	{
+		TileSweep::BasicHit<Scalar> hit;
+		const Scalar zero{};
+		const Scalar one(1.0);
+		if((delta_x == zero) && (delta_y == zero))
+		{
+			return hit;
+		}
+
+		const int32 tile_size = stage.GetTileSize();
+		AxisWalker<Scalar> walker_x{ left, right, delta_x, tile_size };
+		AxisWalker<Scalar> walker_y{ top, bottom, delta_y, tile_size };
+
+		// 境界を越える時刻の早い順に，新しく入る列・行だけを調べる
+		while(true)
+		{
+			const Scalar time = Min(walker_x.next_time, walker_y.next_time);
+			if(time > one)
+			{
+				return hit;
+			}
+
+			// 両方の軸が同じ時刻に境界を越えるときは，列と行を両方調べる
+			const bool is_x_crossing = IsCrossingAt(walker_x, delta_x, time);
+			const bool is_y_crossing = IsCrossingAt(walker_y, delta_y, time);
+
+			// その時刻での箱の位置で，進行方向と垂直な範囲を求める
+			int32 first, last;
+			if(is_x_crossing)
+			{
+				const Scalar offset_y = (delta_y * time);
+				ToCellRange((top + offset_y), (bottom + offset_y), tile_size, first, last);
+				for(int32 y = first; y <= last; ++y)
+				{
+					if(stage.IsSolidTile(walker_x.next_cell, y))
+					{
+						return MakeHit(time, Point{ -walker_x.step, 0 });
+					}
+				}
+			}
+
+			if(is_y_crossing)
+			{
+				const Scalar offset_x = (delta_x * time);
+				ToCellRange((left + offset_x), (right + offset_x), tile_size, first, last);
+				for(int32 x = first; x <= last; ++x)
+				{
+					if(stage.IsSolidTile(x, walker_y.next_cell))
+					{
+						return MakeHit(time, Point{ 0, -walker_y.step });
+					}
+				}
+			}
+
+			// 角をちょうど斜めに抜けるときは，その時刻の箱がまだ新しい列にも行にも掛かっていないので，
+			// 上の2つでは斜め先のタイルを調べられない
+			if(is_x_crossing && is_y_crossing && stage.IsSolidTile(walker_x.next_cell, walker_y.next_cell))
+			{
+				// 角に当たったときは，速く動いている軸の面に当たったことにする
+				const bool is_x_face = (Abs(delta_x) >= Abs(delta_y));
+				return MakeHit(time, (is_x_face ? Point{ -walker_x.step, 0 } : Point{ 0, -walker_y.step }));
+			}
+
+			if(is_x_crossing)
+			{
+				walker_x.Advance();
+			}
+			if(is_y_crossing)
+			{
+				walker_y.Advance();
+			}
+		}
+	}
+}
+
+namespace TileSweep
+{
+	Hit SweepBox(const Stage& stage, const RectF& box, const Vec2& displacement)
+	{
+		return SweepBoxImpl(stage, box.leftX(), box.topY(), box.rightX(), box.bottomY(), displacement.x, displacement.y);
+	}
+
+	Hit SweepBox(const Stage& stage, const Vec2& center, const Vec2& half_size, const Vec2& displacement)
+	{
+		return SweepBox(stage, RectF{ (center - half_size), (half_size * 2.0) }, displacement);
+	}
+
+	FixedHit SweepBox(const Stage& stage, const FixedVec2& center, const FixedVec2& half_size, const FixedVec2& displacement)
+	{
+		const FixedVec2 top_left = (center - half_size);
+		const FixedVec2 bottom_right = (center + half_size);
+		return SweepBoxImpl(stage, top_left.x, top_left.y, bottom_right.x, bottom_right.y, displacement.x, displacement.y);
+	}
+}
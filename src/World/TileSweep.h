@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#include "../Core/Fixed.h"
+#include "Stage.h"
+
+#include <Siv3D.hpp>
+
+// 箱をタイルの格子に沿って動かしたときに，最初に壁へ当たる時刻を求める
+namespace TileSweep
+{
+	template <class Scalar>
+	struct BasicHit
+	{
+		bool is_hit = false;
+
+		// 移動量に対する割合（0.0 ～ 1.0．当たらなければ 1.0）
+		Scalar time = Scalar(1.0);
+
+		// 当たった面の向き（右へ動いて壁に当たったら (-1, 0)，床に着いたら (0, -1)）
+		Point normal{ 0, 0 };
+	};
+
+	using Hit = BasicHit<double>;
+	using FixedHit = BasicHit<Fixed>;
+
+	// box を displacement だけ動かしたときの最初の衝突
+	// 箱の先頭の辺がタイルの境界を越えるたびに，新しく入る列（または行）のタイルだけを調べる
+	// 調べる回数は「越えた境界の数 × 箱の幅（高さ）のタイル数」で決まり，移動量が大きくてもすり抜けない
+	Hit SweepBox(const Stage& stage, const RectF& box, const Vec2& displacement);
+
+	// 中心と半分の大きさで箱を指定する（PhysicsVec2 のどちらの型でも呼べる）
+	Hit SweepBox(const Stage& stage, const Vec2& center, const Vec2& half_size, const Vec2& displacement);
+
+	// 固定小数点版．誤差の許容量は使わず，時刻は切り捨てるので，当たった位置が壁にめり込むことはない
+	FixedHit SweepBox(const Stage& stage, const FixedVec2& center, const FixedVec2& half_size, const FixedVec2& displacement);
+}
@@ -0,0 +1,66 @@
+﻿#include "VerticalBucketIndex.h"
+
+#include <cmath>
+#include <Siv3D.hpp>
+
+VerticalBucketIndex::VerticalBucketIndex(double bucket_height)
+	: bucket_height_(bucket_height)
+{
+}
+
+void VerticalBucketIndex::Clear()
+{
+	buckets_.clear();
+	first_buckets_.clear();
+	item_count_ = 0;
+}
+
+int32 VerticalBucketIndex::ToBucket(double y) const
+{
+	return Max(0, static_cast<int32>(std::floor(y / bucket_height_)));
+}
+
+void VerticalBucketIndex::Insert(uint32 id, double top, double bottom)
+{
+	const int32 first = ToBucket(top);
+	const int32 last = ToBucket(bottom);
+
+	if(buckets_.size() <= static_cast<size_t>(last))
+	{
+		buckets_.resize(last + 1);
+	}
+	if(first_buckets_.size() <= id)
+	{
+		first_buckets_.resize(id + 1, -1);
+	}
+
+	for(int32 bucket = first; bucket <= last; ++bucket)
+	{
+		buckets_[bucket].push_back(id);
+	}
+	first_buckets_[id] = first;
+	++item_count_;
+}
+
+void VerticalBucketIndex::Query(double top, double bottom, Array<uint32>& out) const
+{
+	if(buckets_.isEmpty())
+	{
+		return;
+	}
+
+	const int32 first = ToBucket(top);
+	const int32 last = Min(ToBucket(bottom), static_cast<int32>(buckets_.size()) - 1);
+
+	for(int32 bucket = first; bucket <= last; ++bucket)
+	{
+		for(const uint32 id : buckets_[bucket])
+		{
+			// 検索範囲の中で，その要素が最初に現れる区画でだけ返す
+			if(Max(first_buckets_[id], first) == bucket)
+			{
+				out.push_back(id);
+			}
+		}
+	}
+}
@@ -0,0 +1,33 @@
+﻿#pragma once
+
+#include <Siv3D.hpp>
+
+// ワールドを縦方向に一定の高さで区切り，各区画に掛かる要素の番号を持っておく索引
+// この作品のステージは縦長で，敵や酸素スポットは縦に動かないので，縦の範囲だけで絞り込めば十分
+// 検索のコストは画面に掛かる区画と，そこにいる要素の数だけで決まる
+class VerticalBucketIndex
+{
+public:
+	explicit VerticalBucketIndex(double bucket_height = 256.0);
+
+	void Clear();
+
+	// 要素 id が top から bottom までの範囲に掛かっていることを登録する
+	void Insert(uint32 id, double top, double bottom);
+
+	// top から bottom までに掛かる要素の番号を重複なく out に追加する
+	void Query(double top, double bottom, Array<uint32>& out) const;
+
+	size_t GetItemCount() const { return item_count_; }
+
+private:
+	int32 ToBucket(double y) const;
+
+	double bucket_height_;
+	Array<Array<uint32>> buckets_;
+
+	// 要素ごとに最初に登録された区画（複数の区画に掛かる要素を一度だけ返すため）
+	Array<int32> first_buckets_;
+
+	size_t item_count_ = 0;
+};